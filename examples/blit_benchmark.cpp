@@ -0,0 +1,96 @@
+/* vim: set ts=4 sts=4 sw=4 tw=80: */
+#include <SDL++/SDL++.hpp>
+#include <stdexcept>
+#include <iostream>
+#include <iomanip>
+
+using namespace std;
+using namespace SDL;
+
+/*
+ * Times the Blitter's specialized loops against SDL_BlitSurface for every
+ * pair of formats it knows, and shows which pairs Blitter::calibrate() routes
+ * through them on this machine.
+ */
+
+struct Format
+{
+	const char* name;
+	int depth;
+	Uint32 Rmask, Gmask, Bmask, Amask;
+};
+
+const Format formats[] = {
+	{ "RGB565", 16, Rgb565::RMASK, Rgb565::GMASK, Rgb565::BMASK,
+		Rgb565::AMASK },
+	{ "RGB888", 24, Rgb888::RMASK, Rgb888::GMASK, Rgb888::BMASK,
+		Rgb888::AMASK },
+	{ "XRGB8888", 32, Xrgb8888::RMASK, Xrgb8888::GMASK, Xrgb8888::BMASK,
+		Xrgb8888::AMASK },
+	{ "ARGB8888", 32, Argb8888::RMASK, Argb8888::GMASK, Argb8888::BMASK,
+		Argb8888::AMASK },
+	{ "ABGR8888", 32, Abgr8888::RMASK, Abgr8888::GMASK, Abgr8888::BMASK,
+		Abgr8888::AMASK },
+};
+
+const int FORMATS = sizeof(formats) / sizeof(formats[0]);
+const int WIDTH = 640;
+const int HEIGHT = 480;
+const int ROUNDS = 200;
+
+Surface create(const Format& f)
+{
+	return Surface(SDL_SWSURFACE, WIDTH, HEIGHT, f.depth, f.Rmask, f.Gmask,
+			f.Bmask, f.Amask);
+}
+
+/*
+ * Returns the average time of one blit in microseconds.
+ */
+double time_blits(Surface& src, Surface& dst, bool specialized)
+{
+	Uint32 start = SDL_GetTicks();
+	for (int i = 0; i < ROUNDS; i++) {
+		if (specialized) {
+			Blitter::blit(src.raw_ptr(), 0, dst.raw_ptr(), 0);
+		}
+		else {
+			SDL_BlitSurface(src.raw_ptr(), 0, dst.raw_ptr(), 0);
+		}
+	}
+	return (SDL_GetTicks() - start) * 1000.0 / ROUNDS;
+}
+
+int main(int ac, char* av[])
+{
+	Library lib;
+	lib.everything();
+
+	try {
+		Blitter::calibrate();
+		cout << setw(10) << "from" << setw(10) << "to"
+			<< setw(12) << "SDL (us)" << setw(12) << "SDL++ (us)"
+			<< setw(8) << "routed" << endl;
+		for (int s = 0; s < FORMATS; s++) {
+			Surface src = create(formats[s]);
+			src.fill(0, 0x12345678);
+			for (int d = 0; d < FORMATS; d++) {
+				Surface dst = create(formats[d]);
+
+				/* Warm up the caches and SDL's blit mapping. */
+				time_blits(src, dst, false);
+				time_blits(src, dst, true);
+
+				cout << setw(10) << formats[s].name
+					<< setw(10) << formats[d].name
+					<< setw(12) << time_blits(src, dst, false)
+					<< setw(12) << time_blits(src, dst, true)
+					<< setw(8) << (Blitter::faster(*src.format(), *dst.format())
+							? "yes" : "no") << endl;
+			}
+		}
+	}
+	catch (runtime_error& re) {
+		cout << re.what() << endl;
+	}
+}
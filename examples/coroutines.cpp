@@ -0,0 +1,78 @@
+/* vim: set ts=4 sts=4 sw=4 tw=80: */
+/*
+ * Build with a C++20 compiler, e.g. g++ -std=c++20.
+ */
+#include <SDL++/SDL++.hpp>
+#include <stdexcept>
+#include <iostream>
+
+using namespace std;
+using namespace SDL;
+
+/*
+ * Tells the main loop whether we want to keep looping or not.
+ */
+bool keep_running = true;
+
+/*
+ * Waits for a key, then fades the screen from black to white over 64 frames
+ * and back again after half a second. Written as a state machine this would
+ * need a listener, a timer callback and a frame counter.
+ */
+Coroutine fade(CoroutineScheduler& s, Video_surface& screen)
+{
+	SDL_KeyboardEvent key = co_await s.nextEvent<SDL_KeyboardEvent>();
+	cout << "Key " << key.keysym.sym << " pressed. Fading." << endl;
+
+	for (int i = 0; i < 64; i++) {
+		Uint8 c = i * 4;
+		screen.fill(0, SDL_MapRGB(screen.format(), c, c, c));
+		co_await s.nextFrame();
+	}
+
+	co_await s.sleep(500);
+
+	for (int i = 63; i >= 0; i--) {
+		Uint8 c = i * 4;
+		screen.fill(0, SDL_MapRGB(screen.format(), c, c, c));
+		co_await s.nextFrame();
+	}
+}
+
+/*
+ * Ends the main loop when the user closes the window.
+ */
+Coroutine quit(CoroutineScheduler& s)
+{
+	co_await s.nextEvent<SDL_QuitEvent>();
+	cout << "Quit event raised. Exiting." << endl;
+	keep_running = false;
+}
+
+int main(int ac, char* av[])
+{
+	SDLLibrary lib;
+
+	try {
+		Video_surface screen(250, 250, 32);
+
+		/*
+		 * The scheduler resumes our coroutines from inside PollEvent() and
+		 * frame(); there are no extra threads.
+		 */
+		CoroutineScheduler scheduler(lib);
+		scheduler.spawn(fade(scheduler, screen));
+		scheduler.spawn(quit(scheduler));
+
+		while (keep_running == true) {
+			while (lib.PollEvent()) {
+			}
+			scheduler.frame();
+			screen.flip();
+			SDL_Delay(HZ_60);
+		}
+	}
+	catch (runtime_error& re) {
+		cout << re.what() << endl;
+	}
+}
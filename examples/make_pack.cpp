@@ -0,0 +1,44 @@
+/* vim: set ts=4 sts=4 sw=4 tw=80: */
+#include <SDL++/SDL++.hpp>
+#include <stdexcept>
+#include <iostream>
+
+using namespace std;
+using namespace SDL;
+
+/*
+ * Writes files into a pack, each entry named by the path it was given as,
+ * then checks the pack by reading it back:
+ *
+ *     make_pack assets.pack hero.bmp tiles.bmp theme.wav
+ */
+
+int main(int ac, char* av[])
+{
+	if (ac < 2) {
+		cerr << "usage: " << av[0] << " PACK [FILE]..." << endl;
+		return 1;
+	}
+
+	try {
+		Pack::Writer writer;
+		for (int i = 2; i < ac; i++) {
+			writer.add(av[i], av[i]);
+		}
+		writer.write(av[1]);
+
+		Pack pack(av[1]);
+		for (int i = 0; i < pack.size(); i++) {
+			if (!pack.verify(pack.name(i))) {
+				cerr << pack.name(i) << ": bad checksum" << endl;
+				return 1;
+			}
+		}
+		cout << av[1] << ": " << pack.size() << " entries" << endl;
+	}
+	catch (runtime_error& re) {
+		cerr << re.what() << endl;
+		return 1;
+	}
+	return 0;
+}
@@ -0,0 +1,648 @@
+#ifndef SDLPP_COROUTINE_HPP_INCLUDED
+#define SDLPP_COROUTINE_HPP_INCLUDED
+/* vim: set ts=4 sts=4 sw=4 tw=80: */
+
+/*
+ * Coroutines need a C++20 compiler. Older compilers see an empty header, so
+ * SDL++.hpp can include this file unconditionally.
+ */
+#if defined(__cpp_impl_coroutine) && __cpp_impl_coroutine >= 201902L
+
+#include "SDL.h"
+#include <SDL++/EventHook.hpp>
+#include <SDL++/SDLLibrary.hpp>
+#include <coroutine>
+#include <exception>
+#include <stdexcept>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace sdlpp
+{
+	using std::runtime_error;
+	using std::string;
+
+	/**
+	 * Maps an SDL event structure to the event types it is delivered for, in
+	 * the same way SDLLibrary::dispatchEvent maps them to EventDispatcherS.
+	 */
+	template <typename T> struct CoroutineEventTraits;
+
+	template <> struct CoroutineEventTraits<SDL_Event>
+	{
+		static bool matches(Uint8) { return true; }
+		static SDL_Event get(const SDL_Event& e) { return e; }
+	};
+
+	template <> struct CoroutineEventTraits<SDL_ActiveEvent>
+	{
+		static bool matches(Uint8 type) { return type == SDL_ACTIVEEVENT; }
+		static SDL_ActiveEvent get(const SDL_Event& e) { return e.active; }
+	};
+
+	template <> struct CoroutineEventTraits<SDL_KeyboardEvent>
+	{
+		static bool matches(Uint8 type)
+		{ return type == SDL_KEYDOWN || type == SDL_KEYUP; }
+		static SDL_KeyboardEvent get(const SDL_Event& e) { return e.key; }
+	};
+
+	template <> struct CoroutineEventTraits<SDL_MouseMotionEvent>
+	{
+		static bool matches(Uint8 type) { return type == SDL_MOUSEMOTION; }
+		static SDL_MouseMotionEvent get(const SDL_Event& e) { return e.motion; }
+	};
+
+	template <> struct CoroutineEventTraits<SDL_MouseButtonEvent>
+	{
+		static bool matches(Uint8 type)
+		{ return type == SDL_MOUSEBUTTONDOWN || type == SDL_MOUSEBUTTONUP; }
+		static SDL_MouseButtonEvent get(const SDL_Event& e) { return e.button; }
+	};
+
+	template <> struct CoroutineEventTraits<SDL_JoyAxisEvent>
+	{
+		static bool matches(Uint8 type) { return type == SDL_JOYAXISMOTION; }
+		static SDL_JoyAxisEvent get(const SDL_Event& e) { return e.jaxis; }
+	};
+
+	template <> struct CoroutineEventTraits<SDL_JoyBallEvent>
+	{
+		static bool matches(Uint8 type) { return type == SDL_JOYBALLMOTION; }
+		static SDL_JoyBallEvent get(const SDL_Event& e) { return e.jball; }
+	};
+
+	template <> struct CoroutineEventTraits<SDL_JoyHatEvent>
+	{
+		static bool matches(Uint8 type) { return type == SDL_JOYHATMOTION; }
+		static SDL_JoyHatEvent get(const SDL_Event& e) { return e.jhat; }
+	};
+
+	template <> struct CoroutineEventTraits<SDL_JoyButtonEvent>
+	{
+		static bool matches(Uint8 type)
+		{ return type == SDL_JOYBUTTONDOWN || type == SDL_JOYBUTTONUP; }
+		static SDL_JoyButtonEvent get(const SDL_Event& e) { return e.jbutton; }
+	};
+
+	template <> struct CoroutineEventTraits<SDL_QuitEvent>
+	{
+		static bool matches(Uint8 type) { return type == SDL_QUIT; }
+		static SDL_QuitEvent get(const SDL_Event& e) { return e.quit; }
+	};
+
+	template <> struct CoroutineEventTraits<SDL_SysWMEvent>
+	{
+		static bool matches(Uint8 type) { return type == SDL_SYSWMEVENT; }
+		static SDL_SysWMEvent get(const SDL_Event& e) { return e.syswm; }
+	};
+
+	template <> struct CoroutineEventTraits<SDL_ResizeEvent>
+	{
+		static bool matches(Uint8 type) { return type == SDL_VIDEORESIZE; }
+		static SDL_ResizeEvent get(const SDL_Event& e) { return e.resize; }
+	};
+
+	template <> struct CoroutineEventTraits<SDL_ExposeEvent>
+	{
+		static bool matches(Uint8 type) { return type == SDL_VIDEOEXPOSE; }
+		static SDL_ExposeEvent get(const SDL_Event& e) { return e.expose; }
+	};
+
+	/**
+	 * The concrete class Coroutine.
+	 *
+	 * Coroutine is the return type of coroutines that are run by a
+	 * CoroutineScheduler. A coroutine doesn't start running until it is
+	 * handed to CoroutineScheduler::spawn.
+	 *
+	 * @code
+	 * Coroutine blink(CoroutineScheduler& s, Sprite& sprite)
+	 * {
+	 *     co_await s.nextEvent<SDL_KeyboardEvent>();
+	 *     for (int i = 0; i < 3; i++) {
+	 *         sprite.hide();
+	 *         co_await s.sleep(500);
+	 *         sprite.show();
+	 *         co_await s.sleep(500);
+	 *     }
+	 * }
+	 *
+	 * scheduler.spawn(blink(scheduler, sprite));
+	 * @endcode
+	 */
+	class Coroutine
+	{
+	public:
+		struct promise_type
+		{
+			std::exception_ptr exception;
+
+			Coroutine get_return_object()
+			{ return Coroutine(std::coroutine_handle<promise_type>::from_promise(*this)); }
+
+			std::suspend_always initial_suspend() noexcept
+			{ return std::suspend_always(); }
+
+			/*
+			 * Stay suspended at the end so the scheduler can pick up an
+			 * exception before it frees the frame.
+			 */
+			std::suspend_always final_suspend() noexcept
+			{ return std::suspend_always(); }
+
+			void return_void()
+			{ }
+
+			void unhandled_exception()
+			{ exception = std::current_exception(); }
+		};
+
+		typedef std::coroutine_handle<promise_type> handle_type;
+
+		/**
+		 * The move constructor.
+		 */
+		Coroutine(Coroutine&& that) :
+			m_handle(std::exchange(that.m_handle, nullptr))
+		{ }
+
+		/**
+		 * Destroys the coroutine if it was never spawned.
+		 */
+		~Coroutine()
+		{
+			if (m_handle) {
+				m_handle.destroy();
+			}
+		}
+
+	private:
+		friend class CoroutineScheduler;
+
+		explicit Coroutine(handle_type handle) : m_handle(handle)
+		{ }
+
+		Coroutine(const Coroutine&);
+		Coroutine& operator= (const Coroutine&);
+
+		handle_type m_handle;
+	};
+
+	/**
+	 * The concrete class CoroutineScheduler.
+	 *
+	 * A CoroutineScheduler owns spawned CoroutineS and resumes them on the
+	 * thread that pumps the event queue: event and timer waits resume from
+	 * inside SDLLibrary::WaitEvent and SDLLibrary::PollEvent, frame waits
+	 * resume from frame(). No additional threads are involved. A suspended
+	 * coroutine costs its frame and nothing else; the waits are linked
+	 * through the awaiters that live inside the coroutine frames.
+	 */
+	class CoroutineScheduler : public EventHook
+	{
+	public:
+		typedef Coroutine::handle_type handle_type;
+
+		/**
+		 * The user event code of the events we push to resume sleepers.
+		 */
+		enum { RESUME_CODE = 0x53444c2b };
+
+	private:
+		/**
+		 * A suspended coroutine, linked into one of the wait lists.
+		 */
+		struct Waiter
+		{
+			Waiter() : prev(0), next(0), handle() { }
+
+			Waiter* prev;
+			Waiter* next;
+			handle_type handle;
+		};
+
+		/**
+		 * An intrusive, doubly linked FIFO of WaiterS.
+		 */
+		struct WaiterList
+		{
+			WaiterList() : head(0), tail(0) { }
+
+			bool empty() const
+			{ return head == 0; }
+
+			void push_back(Waiter* w)
+			{
+				w->prev = tail;
+				w->next = 0;
+				if (tail != 0) {
+					tail->next = w;
+				}
+				else {
+					head = w;
+				}
+				tail = w;
+			}
+
+			void remove(Waiter* w)
+			{
+				if (w->prev != 0) {
+					w->prev->next = w->next;
+				}
+				else {
+					head = w->next;
+				}
+				if (w->next != 0) {
+					w->next->prev = w->prev;
+				}
+				else {
+					tail = w->prev;
+				}
+				w->prev = w->next = 0;
+			}
+
+			/**
+			 * Moves all of that's waiters to the front of this list.
+			 */
+			void splice_front(WaiterList& that)
+			{
+				if (that.empty()) {
+					return;
+				}
+				if (empty()) {
+					tail = that.tail;
+				}
+				else {
+					that.tail->next = head;
+					head->prev = that.tail;
+				}
+				head = that.head;
+				that.head = that.tail = 0;
+			}
+
+			Waiter* head;
+			Waiter* tail;
+		};
+
+		struct EventWaiter : public Waiter
+		{
+			EventWaiter(bool (*matches)(Uint8)) : Waiter(), matches(matches)
+			{ }
+
+			bool (*matches)(Uint8);
+			SDL_Event event;
+		};
+
+		struct SleepWaiter : public Waiter
+		{
+			SleepWaiter(CoroutineScheduler* scheduler) :
+				Waiter(), scheduler(scheduler), id(0), fired(0)
+			{ }
+
+			CoroutineScheduler* scheduler;
+			SDL_TimerID id;
+
+			/**
+			 * Set by the timer thread once it pushed our resume event. SDL
+			 * then frees the timer, and may hand out its ID again.
+			 */
+			int fired;
+		};
+
+	public:
+		/**
+		 * The awaiter returned by nextFrame().
+		 */
+		class FrameAwaiter
+		{
+		public:
+			bool await_ready() const noexcept
+			{ return false; }
+
+			void await_suspend(handle_type handle)
+			{
+				m_waiter.handle = handle;
+				m_scheduler.m_frame.push_back(&m_waiter);
+			}
+
+			void await_resume() const noexcept
+			{ }
+
+		private:
+			friend class CoroutineScheduler;
+
+			FrameAwaiter(CoroutineScheduler& scheduler) :
+				m_scheduler(scheduler), m_waiter()
+			{ }
+
+			CoroutineScheduler& m_scheduler;
+			Waiter m_waiter;
+		};
+
+		/**
+		 * The awaiter returned by sleep() and sleepUntil().
+		 */
+		class SleepAwaiter
+		{
+		public:
+			bool await_ready() const noexcept
+			{ return m_ms == 0; }
+
+			void await_suspend(handle_type handle)
+			{
+				m_waiter.handle = handle;
+				m_scheduler.m_sleeping.push_back(&m_waiter);
+				m_waiter.id = SDL_AddTimer(m_ms, &trampoline, &m_waiter);
+				if (m_waiter.id == 0) {
+					m_scheduler.m_sleeping.remove(&m_waiter);
+					throw runtime_error(string()
+							+ "SDL_AddTimer returned NULL: "
+							+ SDL_GetError());
+				}
+			}
+
+			void await_resume() const noexcept
+			{ }
+
+		private:
+			friend class CoroutineScheduler;
+
+			SleepAwaiter(CoroutineScheduler& scheduler, Uint32 ms) :
+				m_scheduler(scheduler), m_ms(ms), m_waiter(&scheduler)
+			{ }
+
+			/**
+			 * Runs on SDL's timer thread. We must not resume the coroutine
+			 * here, so we push an event that brings it back to the thread
+			 * that pumps the queue. The waiter may be gone as soon as the
+			 * event is in, so we mark it fired before.
+			 */
+			static Uint32 trampoline(Uint32, void* param)
+			{
+				SleepWaiter* waiter = static_cast<SleepWaiter*>(param);
+				SDL_Event event;
+				event.type = SDL_USEREVENT;
+				event.user.code = RESUME_CODE;
+				event.user.data1 = waiter->scheduler;
+				event.user.data2 = waiter;
+				__atomic_store_n(&waiter->fired, 1, __ATOMIC_RELEASE);
+				if (SDL_PushEvent(&event) == 0) {
+					return 0;
+				}
+				/* The queue is full: try again shortly. */
+				__atomic_store_n(&waiter->fired, 0, __ATOMIC_RELEASE);
+				return 1;
+			}
+
+			CoroutineScheduler& m_scheduler;
+			Uint32 m_ms;
+			SleepWaiter m_waiter;
+		};
+
+		/**
+		 * The awaiter returned by nextEvent().
+		 */
+		template <typename T>
+		class EventAwaiter
+		{
+		public:
+			bool await_ready() const noexcept
+			{ return false; }
+
+			void await_suspend(handle_type handle)
+			{
+				m_waiter.handle = handle;
+				m_scheduler.m_events.push_back(&m_waiter);
+			}
+
+			T await_resume() const
+			{ return CoroutineEventTraits<T>::get(m_waiter.event); }
+
+		private:
+			friend class CoroutineScheduler;
+
+			EventAwaiter(CoroutineScheduler& scheduler) :
+				m_scheduler(scheduler),
+				m_waiter(&CoroutineEventTraits<T>::matches)
+			{ }
+
+			CoroutineScheduler& m_scheduler;
+			EventWaiter m_waiter;
+		};
+
+		/**
+		 * Hooks the scheduler into library's event loop.
+		 */
+		explicit CoroutineScheduler(SDLLibrary& library) :
+			m_library(library), m_frame(), m_events(), m_sleeping(), m_live(0)
+		{
+			m_library.addEventHook(this);
+		}
+
+		/**
+		 * Unhooks the scheduler and destroys all coroutines that are still
+		 * suspended. Timers that are still pending are removed; those that
+		 * fired are already gone, and their IDs may belong to other timers
+		 * by now. Resume events that timers have already pushed are taken
+		 * off the queue, so they never reach SDLLibrary without us.
+		 */
+		virtual ~CoroutineScheduler()
+		{
+			m_library.removeEventHook(this);
+			destroyAll(m_frame);
+			destroyAll(m_events);
+			while (!m_sleeping.empty()) {
+				SleepWaiter* w = static_cast<SleepWaiter*>(m_sleeping.head);
+				if (!__atomic_load_n(&w->fired, __ATOMIC_ACQUIRE)) {
+					SDL_RemoveTimer(w->id);
+				}
+				m_sleeping.remove(w);
+				w->handle.destroy();
+			}
+			dropResumeEvents();
+		}
+
+		/**
+		 * Takes ownership of a coroutine and runs it up to its first
+		 * suspension.
+		 *
+		 * @note An exception that escapes the coroutine is rethrown here, or
+		 * from whichever call resumed it later.
+		 */
+		void spawn(Coroutine coroutine)
+		{
+			handle_type handle = std::exchange(coroutine.m_handle, nullptr);
+			++m_live;
+			resume(handle);
+		}
+
+		/**
+		 * Resumes every coroutine that awaited nextFrame() before this call.
+		 * Call this once per frame, e.g. right after Video_surface::flip().
+		 */
+		void frame()
+		{
+			WaiterList ready;
+			std::swap(ready, m_frame);
+			resumeAll(ready, m_frame);
+		}
+
+		/**
+		 * @return The number of coroutines that haven't finished yet.
+		 */
+		unsigned live() const
+		{ return m_live; }
+
+		/**
+		 * Suspends until the next call to frame().
+		 */
+		FrameAwaiter nextFrame()
+		{ return FrameAwaiter(*this); }
+
+		/**
+		 * Suspends for at least ms milliseconds.
+		 */
+		SleepAwaiter sleep(Uint32 ms)
+		{ return SleepAwaiter(*this, ms); }
+
+		/**
+		 * Suspends until SDL_GetTicks() reaches deadline. Returns immediately
+		 * if the deadline has passed.
+		 */
+		SleepAwaiter sleepUntil(Uint32 deadline)
+		{
+			Sint32 left = static_cast<Sint32>(deadline - SDL_GetTicks());
+			return SleepAwaiter(*this, left > 0 ? left : 0);
+		}
+
+		/**
+		 * Suspends until the library takes the next event of type T off the
+		 * queue, where T is one of the SDL event structures (or SDL_Event for
+		 * any event). The event is still distributed to the
+		 * EventDispatcherS as usual.
+		 *
+		 * @return A copy of the event.
+		 */
+		template <typename T>
+		EventAwaiter<T> nextEvent()
+		{ return EventAwaiter<T>(*this); }
+
+		/* implement EventHook */
+		virtual bool hookEvent(SDL_Event& event)
+		{
+			if (isResumeEvent(event)) {
+				SleepWaiter* w = static_cast<SleepWaiter*>(event.user.data2);
+				m_sleeping.remove(w);
+				resume(w->handle);
+				return true;
+			}
+
+			/*
+			 * Pick the matching waiters first, so coroutines that wait
+			 * again while we resume them don't see this event twice.
+			 */
+			WaiterList ready;
+			Waiter* next = 0;
+			for (Waiter* w = m_events.head; w != 0; w = next) {
+				next = w->next;
+				EventWaiter* ew = static_cast<EventWaiter*>(w);
+				if (ew->matches(event.type)) {
+					m_events.remove(ew);
+					ew->event = event;
+					ready.push_back(ew);
+				}
+			}
+			resumeAll(ready, m_events);
+			return false;
+		}
+
+	private:
+		CoroutineScheduler(const CoroutineScheduler&);
+		CoroutineScheduler& operator= (const CoroutineScheduler&);
+
+		/**
+		 * Resumes a coroutine and frees its frame once it has finished.
+		 */
+		void resume(handle_type handle)
+		{
+			handle.resume();
+			if (handle.done()) {
+				std::exception_ptr e = handle.promise().exception;
+				handle.destroy();
+				--m_live;
+				if (e) {
+					std::rethrow_exception(e);
+				}
+			}
+		}
+
+		/**
+		 * Resumes the waiters in ready. If a coroutine throws, the waiters
+		 * that haven't run yet go back to the front of home.
+		 */
+		void resumeAll(WaiterList& ready, WaiterList& home)
+		{
+			while (!ready.empty()) {
+				Waiter* w = ready.head;
+				ready.remove(w);
+				try {
+					resume(w->handle);
+				}
+				catch (...) {
+					home.splice_front(ready);
+					throw;
+				}
+			}
+		}
+
+		bool isResumeEvent(const SDL_Event& event) const
+		{
+			return event.type == SDL_USEREVENT
+				&& event.user.code == RESUME_CODE
+				&& event.user.data1 == this;
+		}
+
+		/**
+		 * Takes the user events off the queue and puts back all but our
+		 * resume events. Once the timers are removed, no more are pushed.
+		 */
+		void dropResumeEvents()
+		{
+			std::vector<SDL_Event> kept;
+			SDL_Event events[16];
+			int n;
+			while ((n = SDL_PeepEvents(events, 16, SDL_GETEVENT,
+							SDL_EVENTMASK(SDL_USEREVENT))) > 0) {
+				for (int i = 0; i < n; i++) {
+					if (!isResumeEvent(events[i])) {
+						kept.push_back(events[i]);
+					}
+				}
+			}
+			if (!kept.empty()) {
+				SDL_PeepEvents(&kept[0], kept.size(), SDL_ADDEVENT, 0);
+			}
+		}
+
+		void destroyAll(WaiterList& list)
+		{
+			while (!list.empty()) {
+				Waiter* w = list.head;
+				list.remove(w);
+				w->handle.destroy();
+			}
+		}
+
+		SDLLibrary& m_library;
+		WaiterList m_frame;
+		WaiterList m_events;
+		WaiterList m_sleeping;
+		unsigned m_live;
+	};
+}
+
+#endif /* __cpp_impl_coroutine */
+
+#endif /* SDLPP_COROUTINE_HPP_INCLUDED */
@@ -0,0 +1,34 @@
+#ifndef SDLPP_EVENTHOOK_HPP_INCLUDED
+#define SDLPP_EVENTHOOK_HPP_INCLUDED
+/* vim: set ts=4 sts=4 sw=4 tw=80: */
+
+#include "SDL.h"
+
+namespace sdlpp
+{
+	/**
+	 * The abstract class EventHook.
+	 *
+	 * An EventHook sees every event that SDLLibrary::WaitEvent and
+	 * SDLLibrary::PollEvent take off the queue, before the event is
+	 * distributed to the EventDispatcherS. Hooks run on the thread that
+	 * pumps the queue, so they may safely touch anything the main loop owns.
+	 */
+	class EventHook
+	{
+	public:
+		virtual ~EventHook() { }
+
+		/**
+		 * Inspects an event before it is distributed.
+		 *
+		 * @param event the event that was taken off the queue.
+		 *
+		 * @return true if the hook consumed the event and it must not be
+		 * distributed any further, false otherwise.
+		 */
+		virtual bool hookEvent(SDL_Event& event) = 0;
+	};
+}
+
+#endif /* SDLPP_EVENTHOOK_HPP_INCLUDED */
@@ -0,0 +1,105 @@
+#ifndef SDLPP_POINTERINDEX_HPP_INCLUDED
+#define SDLPP_POINTERINDEX_HPP_INCLUDED
+/* vim: set ts=4 sts=4 sw=4 tw=80: */
+
+#include "SDL.h"
+#include <SDL++/PointerListener.hpp>
+#include <map>
+#include <tr1/unordered_map>
+#include <vector>
+
+namespace sdlpp
+{
+	/**
+	 * The concrete class PointerIndex.
+	 *
+	 * Routes mouse events to the PointerListenerS whose region holds the
+	 * pointer, so that a screen with thousands of widgets doesn't ask each
+	 * of them whether an event is theirs. The regions are kept in a uniform
+	 * grid of square cells: finding the listeners at a point only looks at
+	 * the listeners of its cell, whatever their total number.
+	 *
+	 * SDLLibrary keeps one, fed by addPointerListener(); an application
+	 * with its own event loop may keep its own.
+	 */
+	class PointerIndex
+	{
+	public:
+		/**
+		 * @param cellSize The width and height of the cells, in pixels.
+		 * About the size of a typical widget works best: smaller cells
+		 * put large regions in many cells, larger ones put many regions
+		 * in each cell.
+		 */
+		explicit PointerIndex(int cellSize = 64);
+
+		/**
+		 * Registers a listener for the events inside a region, or moves
+		 * its region if it is registered already. Listeners receive
+		 * events in the order they were first registered.
+		 */
+		void addListener(PointerListener * const listener,
+				const SDL_Rect& region);
+
+		/**
+		 * Unregisters a listener. It is safe to do so from within a
+		 * handler.
+		 */
+		void removeListener(PointerListener * const listener);
+
+		bool hasListener(PointerListener * const listener) const;
+
+		/**
+		 * Finds the listeners whose region holds a point.
+		 *
+		 * @param listeners Set to those listeners, in the order they were
+		 * registered.
+		 */
+		void listenersAt(int x, int y,
+				std::vector<PointerListener*>& listeners) const;
+
+		/**
+		 * Hands a mouse motion or button event to the listeners whose
+		 * region holds its position.
+		 *
+		 * @return true if the event was a mouse event, false otherwise.
+		 */
+		bool dispatchEvent(SDL_Event& event);
+
+	private:
+		struct Entry
+		{
+			PointerListener* listener;
+			SDL_Rect region;
+
+			/** When the listener was first registered. */
+			unsigned long serial;
+		};
+
+		typedef std::vector<Entry> Cell;
+		typedef std::tr1::unordered_map<Uint32, Cell> CellMap;
+		typedef std::map<PointerListener*, Entry> EntryMap;
+
+		/**
+		 * @return The cell a coordinate falls in, along one axis.
+		 */
+		int cellOf(int coordinate) const;
+
+		/**
+		 * Adds an entry to, or removes it from, every cell its region
+		 * touches.
+		 */
+		void insertEntry(const Entry& entry);
+		void eraseEntry(const Entry& entry);
+
+		int m_cellSize;
+		unsigned long m_serial;
+		CellMap m_cells;
+		EntryMap m_entries;
+
+		/** The listeners an event goes to, kept to save allocations. */
+		std::vector<PointerListener*> m_hits;
+	};
+}
+
+#endif /* SDLPP_POINTERINDEX_HPP_INCLUDED */
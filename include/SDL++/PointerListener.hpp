@@ -0,0 +1,33 @@
+#ifndef SDLPP_POINTERLISTENER_HPP_INCLUDED
+#define SDLPP_POINTERLISTENER_HPP_INCLUDED
+/* vim: set ts=4 sts=4 sw=4 tw=80: */
+
+#include "SDL.h"
+
+namespace sdlpp
+{
+	/**
+	 * The abstract class PointerListener.
+	 *
+	 * A PointerListener is registered with a region of the screen, such as
+	 * the rectangle of a widget, and receives only the mouse events whose
+	 * position falls inside it. See PointerIndex.
+	 */
+	class PointerListener
+	{
+	public:
+		virtual ~PointerListener() { }
+
+		/**
+		 * Handles the mouse moving to a point of the region.
+		 */
+		virtual void handleMouseMotion(SDL_MouseMotionEvent&) { }
+
+		/**
+		 * Handles a button pressed or released over the region.
+		 */
+		virtual void handleMouseButton(SDL_MouseButtonEvent&) { }
+	};
+}
+
+#endif /* SDLPP_POINTERLISTENER_HPP_INCLUDED */
@@ -23,28 +23,58 @@
     <li><em>SDLPP_NEED_SDL_IMAGE</em> - Enables support for loading a
     multitude of image formats.</li>
   </ul>
+
+  \section lock_profiling Lock profiling
+
+  If you build the library with configure --enable-lock-profiling, every
+  Mutex, Semaphore and Condition records how long threads waited on it. See
+  Lock_profiler. Clients of such a build must define SDLPP_PROFILE_LOCKS as
+  well, or their Mutex::Lock, which is inline, skips the profiler. Without
+  the option the synchronization wrappers carry no profiling code at all, and
+  Mutex::Lock is as cheap as calling SDL_mutexP and SDL_mutexV directly.
  */
 
+#include <SDL++/adaptive_mutex.hpp>
+#include <SDL++/barrier.hpp>
+#include <SDL++/blitter.hpp>
 #include <SDL++/callback.hpp>
 #include <SDL++/cdrom.hpp>
 #include <SDL++/color.hpp>
+#include <SDL++/color_correction.hpp>
+#include <SDL++/compositor.hpp>
 #include <SDL++/condition.hpp>
+#include <SDL++/Coroutine.hpp>
 #include <SDL++/cursor.hpp>
 #include <SDL++/event.hpp>
 #include <SDL++/events.hpp>
 #include <SDL++/joystick.hpp>
+#include <SDL++/latch.hpp>
 #include <SDL++/library_event.hpp>
+#include <SDL++/lock_profiler.hpp>
+#include <SDL++/mipmap.hpp>
 #include <SDL++/mutex.hpp>
 #include <SDL++/overlay.hpp>
+#include <SDL++/overlay_ring.hpp>
+#include <SDL++/pack.hpp>
+#include <SDL++/painter.hpp>
+#include <SDL++/palette_map.hpp>
 #include <SDL++/pixel_format.hpp>
+#include <SDL++/pixel_traits.hpp>
+#include <SDL++/PointerIndex.hpp>
+#include <SDL++/queue.hpp>
 #include <SDL++/rect.hpp>
+#include <SDL++/region.hpp>
+#include <SDL++/rw_lock.hpp>
 #include <SDL++/rw_ops.hpp>
+#include <SDL++/scaler.hpp>
 #include <SDL++/semaphore.hpp>
 #include <SDL++/shared_ptr_base.hpp>
 #include <SDL++/source.hpp>
+#include <SDL++/sprite.hpp>
 #include <SDL++/surface.hpp>
 #include <SDL++/task.hpp>
 #include <SDL++/thread.hpp>
+#include <SDL++/tile_map.hpp>
 #include <SDL++/time.hpp>
 #include <SDL++/timer.hpp>
 #include <SDL++/user_event.hpp>
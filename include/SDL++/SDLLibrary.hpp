@@ -3,6 +3,9 @@
 /* vim: set ts=2 sts=2 sw=2 tw=80: */
 
 #include "SDL.h"
+#include <SDL++/EventHook.hpp>
+#include <SDL++/PointerIndex.hpp>
+#include <vector>
 
 namespace sdlpp
 {
@@ -21,11 +24,56 @@ namespace sdlpp
 		, public EventDispatcher<SDL_ExposeEvent*>
 	{
 		public:
+			SDLLibrary();
+
 			int WaitEvent();
 			int PollEvent();
 
+			/**
+			 * Registers a hook that sees every event before it is
+			 * distributed. Hooks run in the order they were added.
+			 */
+			void addEventHook(EventHook * const hook);
+
+			/**
+			 * Unregisters a hook.
+			 */
+			void removeEventHook(EventHook * const hook);
+
+			/**
+			 * Registers a listener for the mouse events inside a region
+			 * of the screen, or moves its region. Unlike the listeners of
+			 * the mouse EventDispatcherS, which see every mouse event,
+			 * it is found through a PointerIndex, so widgets need not
+			 * test each event themselves.
+			 */
+			void addPointerListener(PointerListener * const listener,
+					const SDL_Rect& region);
+
+			/**
+			 * Unregisters a pointer listener.
+			 */
+			void removePointerListener(PointerListener * const listener);
+
 		private:
+			typedef std::vector<EventHook*> HookList;
+			typedef HookList::iterator HookIterator;
+
 			void dispatchEvent(SDL_Event&);
+			bool hookEvent(SDL_Event&);
+
+			/**
+			 * Ends a hookEvent() call, dropping the hooks that were
+			 * removed during the outermost one.
+			 */
+			void doneHooking();
+
+			HookList m_hooks;
+
+			/** How many hookEvent() calls are running, nested. */
+			int m_hooking;
+
+			PointerIndex m_pointerIndex;
 	};
 }
 
@@ -0,0 +1,165 @@
+#ifndef SDLPP_ADAPTIVE_MUTEX_HPP_INCLUDED
+#define SDLPP_ADAPTIVE_MUTEX_HPP_INCLUDED
+/* vim: set ts=4 sts=4 sw=4 tw=80: */
+
+#include "SDL.h"
+#include <SDL++/shared_ptr_base.hpp>
+
+namespace sdlpp
+{
+	/**
+	 * The state shared by all copies of an Adaptive_mutex.
+	 */
+	struct Adaptive_mutex_state
+	{
+		/** 0: unlocked, 1: locked, 2: locked and there may be waiters. */
+		int word;
+
+		/** The running average of spins needed to take the lock. */
+		int spin_average;
+
+		/** Whether we keep statistics at all. */
+		bool statistics;
+
+		Uint64 acquisitions;
+		Uint64 contended;
+		Uint64 wait_ns;
+	};
+
+	/**
+	 * The concrete class Adaptive_mutex.
+	 *
+	 * Adaptive_mutex is a drop-in alternative to Mutex for very short
+	 * critical sections. An uncontended lock is a single atomic instruction.
+	 * A contended lock spins for a while, using the CPU's pause instruction,
+	 * before it blocks on a futex. The spin limit adapts to the number of
+	 * spins that recently sufficed to take the lock.
+	 *
+	 * Like a Mutex, copies share the same lock, and the helper class
+	 * Adaptive_mutex::Lock does the locking and unlocking.
+	 *
+	 * @note Adaptive_mutex can't be used with Condition, which needs an
+	 * SDL_mutex.
+	 */
+	class Adaptive_mutex : public shared_ptr_base<Adaptive_mutex_state>
+	{
+	public:
+		/**
+		 * Lock statistics.
+		 */
+		struct Statistics
+		{
+			/** The number of times the mutex was locked. */
+			Uint64 acquisitions;
+
+			/** The number of times the mutex was already locked. */
+			Uint64 contended;
+
+			/** The time spent waiting in contended locks, in nanoseconds. */
+			Uint64 wait_ns;
+		};
+
+		/**
+		 * The default constructor.
+		 *
+		 * Creates a new, unlocked mutex.
+		 *
+		 * @param statistics Whether to count acquisitions, contended
+		 * acquisitions and wait time. The counters are updated while the
+		 * lock is held, so they cost no extra atomic operations.
+		 */
+		Adaptive_mutex(bool statistics = false);
+
+		/**
+		 * The copy constructor.
+		 *
+		 * Constructs a shallow copy of the mutex.
+		 */
+		Adaptive_mutex(const Adaptive_mutex& that);
+
+		/**
+		 * @return A snapshot of the lock statistics. All counters are zero if
+		 * the mutex was constructed without statistics.
+		 */
+		Statistics statistics() const;
+
+		/**
+		 * Resets the lock statistics.
+		 */
+		void reset_statistics();
+
+		/**
+		 * The concrete helper class Lock.
+		 *
+		 * This class will lock an Adaptive_mutex on construction and unlock
+		 * it on deconstruction.
+		 */
+		class Lock
+		{
+			public:
+				/**
+				 * Associates a Lock with an Adaptive_mutex and locks it.
+				 */
+				Lock(Adaptive_mutex& mutex) : mutex(mutex)
+				{ mutex.lock(); }
+
+				/**
+				 * Unlocks the associated Adaptive_mutex.
+				 */
+				~Lock()
+				{ mutex.unlock(); }
+
+			private:
+				/**
+				 * The Adaptive_mutex that this Lock is associated with.
+				 */
+				Adaptive_mutex& mutex;
+
+				Lock();
+				Lock(const Lock& that);
+				Lock& operator= (const Lock& that);
+		};
+
+	private:
+		friend class Lock;
+
+		/**
+		 * Locks the mutex.
+		 */
+		inline void lock()
+		{
+			Adaptive_mutex_state* s = p.get();
+			int expected = 0;
+			if (!__atomic_compare_exchange_n(&s->word, &expected, 1, false,
+						__ATOMIC_ACQUIRE, __ATOMIC_RELAXED)) {
+				lock_contended();
+			}
+			if (s->statistics) {
+				__atomic_store_n(&s->acquisitions, s->acquisitions + 1,
+						__ATOMIC_RELAXED);
+			}
+		}
+
+		/**
+		 * Unlocks the mutex.
+		 */
+		inline void unlock()
+		{
+			if (__atomic_exchange_n(&p->word, 0, __ATOMIC_RELEASE) == 2) {
+				wake();
+			}
+		}
+
+		/**
+		 * The slow path of lock(): spin, then block.
+		 */
+		void lock_contended();
+
+		/**
+		 * The slow path of unlock(): wake up one waiter.
+		 */
+		void wake();
+	};
+}
+
+#endif /* SDLPP_ADAPTIVE_MUTEX_HPP_INCLUDED */
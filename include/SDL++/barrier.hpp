@@ -0,0 +1,77 @@
+#ifndef SDLPP_BARRIER_HPP_INCLUDED
+#define SDLPP_BARRIER_HPP_INCLUDED
+/* vim: set ts=4 sts=4 sw=4 tw=80: */
+
+#include "SDL.h"
+#include <SDL++/shared_ptr_base.hpp>
+#include <stdexcept>
+
+namespace sdlpp
+{
+	using std::runtime_error;
+
+	/**
+	 * The state shared by all copies of a Barrier.
+	 */
+	struct Barrier_state
+	{
+		/** The number of threads that take part in each phase. */
+		int count;
+
+		/** The number of threads that still have to arrive. */
+		int remaining;
+
+		/** Bumped when the last thread arrives; waiters sleep on it. */
+		int generation;
+	};
+
+	/**
+	 * The concrete class Barrier.
+	 *
+	 * A Barrier lets a fixed number of threads wait for each other, once per
+	 * phase, e.g. once per frame stage. It resets itself when the last
+	 * thread arrives, so it can be used again for the next phase right away.
+	 *
+	 * Arriving threads spin briefly and then sleep on a futex. The last
+	 * thread to arrive releases all of them with a single wake-up call,
+	 * instead of one Semaphore::post() per thread.
+	 *
+	 * Copies share the same barrier.
+	 */
+	class Barrier : public shared_ptr_base<Barrier_state>
+	{
+	public:
+		/**
+		 * The default constructor.
+		 *
+		 * @param count The number of threads that take part in each phase.
+		 *
+		 * @throw runtime_error If count is 0.
+		 */
+		Barrier(unsigned count);
+
+		/**
+		 * The copy constructor.
+		 *
+		 * Constructs a shallow copy of the barrier.
+		 */
+		Barrier(const Barrier& that);
+
+		/**
+		 * Arrives at the barrier and waits until all threads have arrived.
+		 *
+		 * @return true in exactly one of the threads of each phase (the last
+		 * to arrive), false in all others. The caller that gets true may do
+		 * per-phase bookkeeping.
+		 */
+		bool wait();
+
+		/**
+		 * @return The number of threads that take part in each phase.
+		 */
+		unsigned count() const
+		{ return p->count; }
+	};
+}
+
+#endif /* SDLPP_BARRIER_HPP_INCLUDED */
@@ -0,0 +1,103 @@
+#ifndef SDLPP_BLITTER_HPP_INCLUDED
+#define SDLPP_BLITTER_HPP_INCLUDED
+/* vim: set ts=4 sts=4 sw=4 tw=80: */
+
+#include "SDL.h"
+#include <SDL++/pixel_traits.hpp>
+#include <SDL++/region.hpp>
+
+namespace sdlpp
+{
+	/**
+	 * A loop that copies or converts a rectangle of pixels, as generated by
+	 * Copy_rect and Convert_rect.
+	 */
+	typedef void (*Blit_loop)(const Uint8* src, int src_pitch, Uint8* dst,
+			int dst_pitch, int w, int h, Uint8 alpha);
+
+	/**
+	 * The Blitter class picks a blit loop specialized for the source and
+	 * destination formats, for every pair of Rgb565, Rgb888, Xrgb8888,
+	 * Argb8888 and Abgr8888.
+	 *
+	 * Whether a loop beats SDL_BlitSurface depends on the pair, the CPU and
+	 * the SDL build, so Surface::blit() only uses the loops that
+	 * calibrate() found faster on this machine, and SDL_BlitSurface until
+	 * then. Blits it has no loop for, or that involve colorkeys, alpha
+	 * blending or hardware surfaces, are always left to SDL_BlitSurface.
+	 */
+	class Blitter
+	{
+	public:
+		/**
+		 * Which blits use a specialized loop.
+		 */
+		enum Policy
+		{
+			/** Every pair we have a loop for. */
+			ALWAYS,
+
+			/** Only the pairs calibrate() found faster than SDL. */
+			WHEN_FASTER
+		};
+
+		/**
+		 * Looks up the loop for a pair of formats.
+		 *
+		 * @return The loop, or 0 if either format isn't one we know.
+		 */
+		static Blit_loop find(const SDL_PixelFormat& src,
+				const SDL_PixelFormat& dst);
+
+		/**
+		 * Times every loop against SDL_BlitSurface on this machine, and
+		 * notes which pairs it beats by a tenth or more. This takes some
+		 * tens of milliseconds, so call it once, after SDL_Init and before
+		 * other threads blit.
+		 */
+		static void calibrate();
+
+		/**
+		 * @return Whether calibrate() found the loop for a pair of formats
+		 * faster than SDL_BlitSurface.
+		 */
+		static bool faster(const SDL_PixelFormat& src,
+				const SDL_PixelFormat& dst);
+
+		/**
+		 * Blits src to dst with a specialized loop if there is one and the
+		 * policy allows it, and with SDL_BlitSurface otherwise.
+		 *
+		 * @note This is equivalent to calling SDL_BlitSurface: the
+		 * rectangles are clipped the same way, dst_rect receives the area
+		 * that was drawn, and the pixels come out the same.
+		 *
+		 * @return 0 on success, -1 on error.
+		 */
+		static int blit(SDL_Surface* src, SDL_Rect* src_rect,
+				SDL_Surface* dst, SDL_Rect* dst_rect, Policy policy = ALWAYS);
+
+		/**
+		 * Blits src to dst as the other blit() does, but draws only inside
+		 * a region of dst as well as its clip rectangle. With a
+		 * specialized loop, the surfaces are locked once for all the
+		 * rectangles of the region; otherwise each of them goes through
+		 * SDL_BlitSurface.
+		 *
+		 * @param dst_rect Receives the smallest rectangle holding what was
+		 * drawn.
+		 *
+		 * @return 0 on success, -1 on error.
+		 */
+		static int blit(SDL_Surface* src, SDL_Rect* src_rect,
+				SDL_Surface* dst, SDL_Rect* dst_rect, const Region& clip,
+				Policy policy = ALWAYS);
+
+	private:
+		/* We declare these private to force Blitter uninstantiable. */
+		Blitter();
+		Blitter(const Blitter&);
+	};
+}
+
+#endif /* SDLPP_BLITTER_HPP_INCLUDED */
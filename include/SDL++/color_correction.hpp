@@ -0,0 +1,153 @@
+#ifndef SDLPP_COLOR_CORRECTION_HPP_INCLUDED
+#define SDLPP_COLOR_CORRECTION_HPP_INCLUDED
+/* vim: set ts=4 sts=4 sw=4 tw=80: */
+
+#include "SDL.h"
+#include <SDL++/color.hpp>
+#include <SDL++/rect.hpp>
+#include <SDL++/surface.hpp>
+#include <vector>
+
+namespace sdlpp
+{
+	using std::vector;
+	using std::size_t;
+
+	/**
+	 * The concrete class Color_correction.
+	 *
+	 * A software replacement for SDL_SetGamma and SDL_SetGammaRamp, for
+	 * displays without hardware gamma. Each pixel is first transformed by a
+	 * 3x4 color matrix, then looked up in a per-channel gamma table. Alpha
+	 * is left alone.
+	 *
+	 * The matrix is applied with SSE2 in 4.12 fixed point where available,
+	 * and rows are spread over all CPUs. With the identity matrix, only the
+	 * table lookups remain.
+	 *
+	 * To correct what is on screen, apply() the correction to the rectangles
+	 * you are about to pass to Video_surface::update().
+	 *
+	 * Surfaces with a palette are corrected through their colors instead:
+	 * keep the original palette, and whenever the correction changes, set
+	 * the surface's colors to what apply() returns for the original ones.
+	 * The pixels of such surfaces are indices, so there is nothing to
+	 * correct per rectangle, and correcting colors that were corrected
+	 * before would apply the correction twice.
+	 */
+	class Color_correction
+	{
+	public:
+		/**
+		 * The default constructor.
+		 *
+		 * Creates a correction that leaves colors as they are.
+		 */
+		Color_correction();
+
+		/**
+		 * Sets the gamma tables from gamma values.
+		 *
+		 * @note This calculates the tables the way SDL_SetGamma does: 1.0
+		 * leaves a channel as it is, larger values brighten it.
+		 */
+		void set_gamma(float red, float green, float blue);
+
+		/**
+		 * Sets the gamma tables.
+		 *
+		 * @note The tables have the layout of SDL_SetGammaRamp's: 256
+		 * 16-bit entries per channel. A null pointer leaves that channel's
+		 * table as it is.
+		 */
+		void set_gamma_ramp(const Uint16* red, const Uint16* green,
+				const Uint16* blue);
+
+		/**
+		 * Sets the color matrix.
+		 *
+		 * Each output channel is m[c][0] * r + m[c][1] * g + m[c][2] * b +
+		 * m[c][3], with colors and offsets in the range [0, 255]. The
+		 * coefficients must lie within (-8, 8).
+		 */
+		void set_matrix(const float m[3][4]);
+
+		/**
+		 * Sets the color matrix from the usual picture controls.
+		 *
+		 * @param brightness Added to all channels, from -1 to 1. 0 leaves
+		 * the picture as it is.
+		 * @param contrast Scales the distance from mid-gray. 1 leaves the
+		 * picture as it is.
+		 * @param saturation Scales the distance from the luma of each pixel.
+		 * 0 gives grayscale, 1 leaves the picture as it is.
+		 * @param tint Rotates the hue by this many degrees.
+		 */
+		void set_adjustments(float brightness, float contrast,
+				float saturation, float tint);
+
+		/**
+		 * Resets the gamma tables and the matrix.
+		 */
+		void reset();
+
+		/**
+		 * Corrects a whole surface.
+		 *
+		 * @throw runtime_error if the surface has a palette.
+		 */
+		void apply(Surface& surface);
+
+		/**
+		 * Corrects a rectangle of a surface.
+		 *
+		 * @throw runtime_error if the surface has a palette.
+		 */
+		void apply(Surface& surface, const Rect& area);
+
+		/**
+		 * Corrects some rectangles of a surface, e.g. the damaged region of
+		 * the Video_surface. The rectangles shouldn't overlap, or their
+		 * overlap is corrected twice.
+		 *
+		 * @throw runtime_error if the surface has a palette.
+		 */
+		void apply(Surface& surface, const vector<Rect>& areas);
+
+		/**
+		 * Corrects the colors of a palette, leaving them as they are.
+		 *
+		 * @return The corrected colors, for Surface::set_colors().
+		 */
+		vector<Color> apply(const vector<Color>& colors) const;
+
+		/**
+		 * Corrects an array of colors of four bytes each, in R, G, B, A
+		 * order, as for Pixel_format::map().
+		 */
+		void apply(Uint8* rgba, size_t count) const;
+
+	private:
+		/** The gamma tables, for red, green and blue. */
+		Uint8 tables[3][256];
+
+		/**
+		 * The matrix in 4.12 fixed point. The offsets are scaled down by
+		 * 256, so that they fit the same 16 bits.
+		 */
+		Sint16 matrix[3][4];
+
+		/** Whether the matrix is the identity, so we may skip it. */
+		bool identity_matrix;
+
+		/** Whether the gamma tables are the identity, so we may skip them. */
+		bool identity_tables;
+
+		/**
+		 * Notes whether the tables are the identity.
+		 */
+		void check_tables();
+	};
+}
+
+#endif /* SDLPP_COLOR_CORRECTION_HPP_INCLUDED */
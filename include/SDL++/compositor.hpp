@@ -0,0 +1,169 @@
+#ifndef SDLPP_COMPOSITOR_HPP_INCLUDED
+#define SDLPP_COMPOSITOR_HPP_INCLUDED
+/* vim: set ts=4 sts=4 sw=4 tw=80: */
+
+#include "SDL.h"
+#include <SDL++/rect.hpp>
+#include <SDL++/surface.hpp>
+#include <stdexcept>
+#include <vector>
+
+namespace sdlpp
+{
+	using std::runtime_error;
+	using std::vector;
+
+	/**
+	 * The concrete class Compositor.
+	 *
+	 * Stacks layers, such as a background, the world, the UI and a cursor,
+	 * onto a target surface, usually the Video_surface, and redraws only
+	 * what changed. Tell it which areas of a layer changed with damage(),
+	 * then call compose() once per frame and pass the rectangles it gives
+	 * back to Video_surface::update().
+	 *
+	 * Each layer knows which of its areas are opaque. Damage hidden under
+	 * an opaque area of a layer above is dropped, and while compositing, a
+	 * layer is blitted only where no opaque layer above covers it, so
+	 * pixels are not drawn over and over. A layer without a colorkey or
+	 * surface alpha is opaque as a whole; for others, give their opaque
+	 * areas with set_opaque().
+	 *
+	 * What no layer covers is filled with the background color.
+	 */
+	class Compositor
+	{
+	public:
+		/**
+		 * Creates a compositor with no layers, and all of the target
+		 * damaged.
+		 */
+		explicit Compositor(Surface& target);
+
+		/**
+		 * Stacks a layer on top of the others.
+		 *
+		 * @param x The left of the layer on the target.
+		 * @param y The top of the layer on the target.
+		 *
+		 * @return The index of the layer, from 0 at the bottom.
+		 */
+		int add_layer(Surface& surface, int x = 0, int y = 0);
+
+		int layers() const;
+
+		/**
+		 * Sets the areas of a layer, in its own coordinates, that hide
+		 * what is below them, replacing those it had.
+		 *
+		 * @throw runtime_error If there is no such layer.
+		 */
+		void set_opaque(int layer, const vector<Rect>& areas);
+
+		/**
+		 * Moves a layer, damaging where it was and where it goes.
+		 *
+		 * @throw runtime_error If there is no such layer.
+		 */
+		void move(int layer, int x, int y);
+
+		/**
+		 * Shows or hides a layer, damaging where it is.
+		 *
+		 * @throw runtime_error If there is no such layer.
+		 */
+		void set_visible(int layer, bool on);
+
+		/**
+		 * Sets the color, as a pixel of the target, of what no layer
+		 * covers, and damages all of the target.
+		 */
+		void set_background(Uint32 color);
+
+		/**
+		 * Marks an area of a layer, in its own coordinates, as changed.
+		 * What opaque layers above hide of it is left out.
+		 *
+		 * @throw runtime_error If there is no such layer.
+		 */
+		void damage(int layer, const Rect& area);
+
+		/**
+		 * Marks an area of the target as changed.
+		 */
+		void damage(const Rect& area);
+
+		/**
+		 * Marks all of the target as changed.
+		 */
+		void damage();
+
+		/**
+		 * Redraws the damaged areas of the target.
+		 *
+		 * @param updated Set to the areas redrawn, which don't overlap.
+		 *
+		 * @return false if a blit or fill failed.
+		 */
+		bool compose(vector<Rect>& updated);
+
+	private:
+		/** An area from x0, y0 to x1, y1 excluded. */
+		struct Box
+		{
+			int x0;
+			int y0;
+			int x1;
+			int y1;
+		};
+
+		struct Layer
+		{
+			Surface surface;
+			int x;
+			int y;
+			bool visible;
+
+			/** The opaque areas, in the coordinates of the layer. */
+			vector<Box> opaque;
+		};
+
+		/**
+		 * Cuts a to what it shares with b.
+		 *
+		 * @return false if that is nothing.
+		 */
+		static bool intersect(Box& a, const Box& b);
+
+		/**
+		 * Cuts an area out of a list of areas that don't overlap, keeping
+		 * them so.
+		 */
+		static void subtract(vector<Box>& areas, const Box& cut);
+
+		Layer& layer_at(int layer);
+
+		/**
+		 * @return Where a layer is on the target.
+		 */
+		Box bounds(Layer& layer);
+
+		/**
+		 * Adds an area of the target to the damage, leaving out what the
+		 * opaque areas of layers from first up hide.
+		 */
+		void add_damage(const Box& area, size_t first);
+
+		Surface target;
+		vector<Layer> stack;
+		Uint32 background;
+
+		/** The damaged areas of the target, which don't overlap. */
+		vector<Box> damaged;
+
+		/** The parts of the area being composed each layer shows. */
+		vector<vector<Box> > shown;
+	};
+}
+
+#endif /* SDLPP_COMPOSITOR_HPP_INCLUDED */
@@ -0,0 +1,72 @@
+#ifndef SDLPP_LATCH_HPP_INCLUDED
+#define SDLPP_LATCH_HPP_INCLUDED
+/* vim: set ts=4 sts=4 sw=4 tw=80: */
+
+#include "SDL.h"
+#include <SDL++/shared_ptr_base.hpp>
+
+namespace sdlpp
+{
+	/**
+	 * The state shared by all copies of a Latch.
+	 */
+	struct Latch_state
+	{
+		/** The number of count_down()s still outstanding. */
+		int count;
+	};
+
+	/**
+	 * The concrete class Latch.
+	 *
+	 * A Latch is a single-use countdown: threads wait() until count_down()
+	 * has been called as often as the initial count. Unlike a Barrier, the
+	 * threads that count down don't have to wait, and the threads that wait
+	 * don't have to count down. Once the count reaches zero, the latch stays
+	 * open.
+	 *
+	 * The count_down() that opens the latch wakes all waiters with a single
+	 * futex call.
+	 *
+	 * Copies share the same latch.
+	 */
+	class Latch : public shared_ptr_base<Latch_state>
+	{
+	public:
+		/**
+		 * The default constructor.
+		 *
+		 * @param count How many count_down()s open the latch.
+		 */
+		Latch(unsigned count);
+
+		/**
+		 * The copy constructor.
+		 *
+		 * Constructs a shallow copy of the latch.
+		 */
+		Latch(const Latch& that);
+
+		/**
+		 * Decrements the count by n and wakes the waiters if it reaches zero.
+		 */
+		void count_down(unsigned n = 1);
+
+		/**
+		 * Waits until the count reaches zero.
+		 */
+		void wait();
+
+		/**
+		 * @return true if the count has reached zero. Never blocks.
+		 */
+		bool try_wait() const;
+
+		/**
+		 * Counts down by n and waits until the count reaches zero.
+		 */
+		void arrive_and_wait(unsigned n = 1);
+	};
+}
+
+#endif /* SDLPP_LATCH_HPP_INCLUDED */
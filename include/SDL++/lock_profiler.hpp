@@ -0,0 +1,189 @@
+#ifndef SDLPP_LOCK_PROFILER_HPP_INCLUDED
+#define SDLPP_LOCK_PROFILER_HPP_INCLUDED
+/* vim: set ts=4 sts=4 sw=4 tw=80: */
+
+#include "SDL.h"
+#include <SDL++/semaphore.hpp>
+#include <SDL++/shared_ptr_base.hpp>
+#include <ostream>
+#include <string>
+#include <vector>
+
+namespace sdlpp
+{
+	using std::ostream;
+	using std::string;
+	using std::vector;
+
+	/**
+	 * The profile of a single Mutex, Semaphore or Condition.
+	 */
+	struct Lock_stats
+	{
+		enum Kind { MUTEX, SEMAPHORE, CONDITION };
+
+		/**
+		 * The number of log2 buckets of the wait histogram. Bucket i counts
+		 * the waits that took between 2^i and 2^(i+1) nanoseconds; the last
+		 * bucket also counts everything longer.
+		 */
+		enum { BUCKETS = 32 };
+
+		/** The wrapped SDL object. */
+		const void* object;
+		Kind kind;
+
+		/** The name given with Lock_profiler::name(), if any. */
+		string name;
+
+		/** The SDL thread ID of the thread holding a Mutex, or 0. */
+		Uint32 owner;
+
+		/** The number of completed waits (or locks). */
+		Uint64 acquisitions;
+
+		/** The number of waits that took at least CONTENDED_NS. */
+		Uint64 contended;
+
+		Uint64 total_wait_ns;
+		Uint64 max_wait_ns;
+
+		/** Only collected for MutexES. */
+		Uint64 total_hold_ns;
+		Uint64 max_hold_ns;
+
+		Uint64 histogram[BUCKETS];
+	};
+
+	/**
+	 * The Lock_profiler class collects contention statistics for MutexES,
+	 * SemaphoreS and ConditionS.
+	 *
+	 * Profiling is off unless the library is built with SDLPP_PROFILE_LOCKS
+	 * defined (configure --enable-lock-profiling). Clients must then define
+	 * it too, because Mutex locks inline when it is off; enabled() tells them
+	 * which way the library was built. When it is off, the synchronization
+	 * wrappers do what they did before and nothing is ever recorded.
+	 *
+	 * When it is on, every wait on a Mutex, Semaphore or Condition records
+	 * how long it took, and every Mutex records its owner and how long it was
+	 * held. Call snapshot() or dump() from time to time, e.g. once a second
+	 * or whenever a frame takes too long, to see which object blocks.
+	 *
+	 * @code
+	 * Mutex decode_lock;
+	 * Lock_profiler::name(decode_lock, "decode queue");
+	 * ...
+	 * Lock_profiler::dump(cerr, 5);
+	 * @endcode
+	 */
+	class Lock_profiler
+	{
+	public:
+		/**
+		 * Waits shorter than this count as uncontended.
+		 */
+		static const Uint64 CONTENDED_NS = 1000;
+
+		/**
+		 * Gives a synchronization object a name that shows up in snapshots.
+		 * Does nothing unless it is a live, profiled Mutex, Semaphore or
+		 * Condition.
+		 */
+		template <typename T>
+		static void name(shared_ptr_base<T>& object, const string& name)
+		{ name_object(object.raw_ptr(), name); }
+
+		/**
+		 * Gives a Semaphore a name that shows up in snapshots. Those that
+		 * count in a futex have no SDL_sem to go by.
+		 */
+		static void name(Semaphore& semaphore, const string& name)
+		{
+			name_object(semaphore.state.get() != 0
+					? static_cast<const void*>(semaphore.state.get())
+					: semaphore.raw_ptr(), name);
+		}
+
+		/**
+		 * @return A copy of the statistics of all live objects.
+		 */
+		static vector<Lock_stats> snapshot();
+
+		/**
+		 * @return The n objects with the highest total wait time, highest
+		 * first.
+		 */
+		static vector<Lock_stats> top(size_t n);
+
+		/**
+		 * Writes a table of the n most contended objects to out.
+		 */
+		static void dump(ostream& out, size_t n = 10);
+
+		/**
+		 * Clears all counters. Names are kept.
+		 */
+		static void reset();
+
+		/**
+		 * @return Whether the library was built with SDLPP_PROFILE_LOCKS.
+		 */
+		static bool enabled();
+
+		/*
+		 * The hooks below are called by the synchronization wrappers. Only
+		 * attach() and detach() take the lock that snapshot() takes; the
+		 * others lock just the record, so profiling doesn't serialize
+		 * unrelated objects.
+		 */
+
+		/**
+		 * The statistics of one profiled object, which its wrapper keeps.
+		 */
+		struct Record;
+
+		/**
+		 * @return A monotonic timestamp in nanoseconds.
+		 */
+		static Uint64 now();
+
+		/**
+		 * Starts profiling an object.
+		 *
+		 * @return Its record, for the hooks below.
+		 */
+		static Record* attach(const void* object, Lock_stats::Kind kind);
+
+		/**
+		 * Stops profiling an object that is being destroyed, and frees its
+		 * record.
+		 */
+		static void detach(Record* record);
+
+		/**
+		 * Records a wait that started at start and ended now.
+		 */
+		static void waited(Record* record, Uint64 start);
+
+		/**
+		 * Records a wait like waited(), then records the calling thread as
+		 * the owner of the Mutex.
+		 */
+		static void acquired(Record* record, Uint64 start);
+
+		/**
+		 * Records that the owner of the Mutex is about to release it.
+		 */
+		static void released(Record* record);
+
+	private:
+		static void name_object(const void* object, const string& name);
+
+		/* We declare these private to force Lock_profiler uninstantiable. */
+		Lock_profiler();
+		Lock_profiler(const Lock_profiler&);
+	};
+}
+
+#endif /* SDLPP_LOCK_PROFILER_HPP_INCLUDED */
@@ -0,0 +1,108 @@
+#ifndef SDLPP_MIPMAP_HPP_INCLUDED
+#define SDLPP_MIPMAP_HPP_INCLUDED
+/* vim: set ts=4 sts=4 sw=4 tw=80: */
+
+#include "SDL.h"
+#include <SDL++/shared_ptr_base.hpp>
+#include <SDL++/rect.hpp>
+#include <SDL++/scaler.hpp>
+#include <SDL++/surface.hpp>
+#include <stdexcept>
+
+namespace sdlpp
+{
+	using std::runtime_error;
+
+	/**
+	 * The concrete class Mipmap.
+	 *
+	 * A pyramid of successively half-sized copies of a surface, for views
+	 * that draw the same large surface at many scales. Level 0 is the
+	 * surface itself, and each further level halves the width and height
+	 * of the one before, rounding down, until both are 1.
+	 *
+	 * Levels are built when they are first asked for, each from the one
+	 * before by averaging blocks of 2x2 pixels, with SSE2 where available
+	 * and rows spread over all CPUs. Copies of a Mipmap share their levels,
+	 * and any thread may ask for them.
+	 *
+	 * Levels keep the colorkey and alpha of the surface. Pixels that match
+	 * the colorkey are left out of the averages, and a block made only of
+	 * them stays the colorkey, so the key color doesn't bleed into edges.
+	 */
+	class Mipmap
+	{
+	public:
+		/**
+		 * Creates a pyramid over a surface. No levels are built yet.
+		 */
+		explicit Mipmap(Surface& base);
+
+		/**
+		 * The copy constructor.
+		 *
+		 * Constructs a Mipmap that shares the levels of that.
+		 */
+		Mipmap(const Mipmap& that);
+
+		/**
+		 * @return The number of levels, including the surface itself.
+		 */
+		int levels() const;
+
+		/**
+		 * @return The width of a level.
+		 */
+		int w(int level) const;
+
+		/**
+		 * @return The height of a level.
+		 */
+		int h(int level) const;
+
+		/**
+		 * Gets a level, building it and the ones before it if needed.
+		 *
+		 * @throw runtime_error If there is no such level, or it can't be
+		 * created.
+		 */
+		Surface level(int level);
+
+		/**
+		 * Picks the smallest level that is still at least as large as the
+		 * surface drawn at the given scale, so filtering it never has to
+		 * shrink by more than half.
+		 *
+		 * @param scale The size to draw at, relative to level 0.
+		 */
+		int level_for(double scale) const;
+
+		/**
+		 * Draws the whole surface onto dst_rect, from the level that suits
+		 * the size of dst_rect.
+		 *
+		 * @see Scaler::blit
+		 */
+		bool blit(Surface& dst, Rect& dst_rect,
+				Scaler::Filter filter = Scaler::BILINEAR);
+
+		/**
+		 * Draws part of the surface onto dst_rect, from the level that
+		 * suits the sizes of the rectangles.
+		 *
+		 * @param src_rect The area to draw, in the coordinates of level 0.
+		 *
+		 * @see Scaler::blit
+		 */
+		bool blit(Rect& src_rect, Surface& dst, Rect& dst_rect,
+				Scaler::Filter filter = Scaler::BILINEAR);
+
+	private:
+		Mipmap& operator= (const Mipmap& that);
+
+		struct Chain;
+		shared_ptr<Chain> chain;
+	};
+}
+
+#endif /* SDLPP_MIPMAP_HPP_INCLUDED */
@@ -86,6 +86,27 @@ namespace sdlpp
 	private:
 		friend class Lock;
 
+		/* Condition profiles the Mutex it waits with. */
+		friend class Condition;
+
+#ifdef SDLPP_PROFILE_LOCKS
+		/*
+		 * The profiled versions are out of line, so that the profiler's
+		 * internals stay in the library.
+		 */
+
+		/**
+		 * Locks the mutex.
+		 * @return true on success, false on an error.
+		 */
+		bool lock();
+		
+		/**
+		 * Unlocks the mutex.
+		 * @return true on success, false on an error.
+		 */
+		bool unlock();
+#else
 		/**
 		 * Locks the mutex.
 		 * @return true on success, false on an error.
@@ -99,6 +120,7 @@ namespace sdlpp
 		 */
 		inline bool unlock()
 		{ return SDL_mutexV(shared_ptr_base<SDL_mutex>::p.get()) == 0; }
+#endif /* SDLPP_PROFILE_LOCKS */
 	};
 }
 
@@ -22,13 +22,10 @@ namespace sdlpp
 	 *
 	 * An Overlay is similar to a Surface except it stores a YUV overlay.
 	 *
-	 * @todo We provide direct access to the pixels array. A naive
-	 * programmer could a) forget to lock/unlock the overlay before
-	 * accessing the surface, and b) not calculate the offsets correctly
-	 * that are needed for, say, a IYUV/I420 overlay. Could we provide a
-	 * wrapper class that will lock the surface on construction, unlock the
-	 * surface on destruction and provide operator()(...) access to the
-	 * pixels of the overlay?
+	 * The pixels are only reachable through an Overlay::Lock, which hands
+	 * out an Overlay::Plane for each plane with the width and height that
+	 * plane has in the overlay's format, so nobody has to work out the
+	 * offsets of, say, the chroma planes of an IYUV/I420 overlay.
 	 */
 	class Overlay : public shared_ptr_base<SDL_Overlay>
 	{
@@ -114,10 +111,31 @@ namespace sdlpp
 		 * @note Since SDL doesn't allow a NULL rectangle in the call to
 		 * SDL_DisplayYUVOverlay, we turned dstrect into a reference.
 		 *
-		 * @note This is equivalent to calling SDL_DisplayYUVOverlay.
+		 * @note Hardware overlays are passed to SDL_DisplayYUVOverlay. For
+		 * the others, we convert and scale the planes straight into the
+		 * display surface ourselves, with SSE2 where available and rows
+		 * spread over all CPUs, then update the area like SDL does. Scaling
+		 * picks the nearest pixel, as SDL's software path does.
+		 *
+		 * @return Whether the overlay was displayed.
+		 */
+		bool display(Rect& dstrect);
+
+		/**
+		 * Converts the pixels of a surface into this overlay.
+		 *
+		 * @note Colors are converted with ITU-R BT.601 at video levels.
+		 * Chroma is averaged over each pair of pixels for the packed
+		 * formats, and over each 2x2 block for the planar ones. The
+		 * conversion uses SSE2 where available and spreads rows over all
+		 * CPUs. It is fastest for 32-bpp surfaces, but any format works.
+		 *
+		 * @param source The surface to convert. If it is smaller or larger
+		 * than the overlay, only the area they have in common is converted.
+		 *
+		 * @return false if the overlay has a format we don't know.
 		 */
-		inline bool display(Rect& dstrect)
-		{ return SDL_DisplayYUVOverlay(p.get(), &dstrect); }
+		bool upload(Surface& source);
 
 		enum {
 			/** Planar mode: Y + U + V */
@@ -132,6 +150,61 @@ namespace sdlpp
 			YVYU = SDL_YVYU_OVERLAY,
 		};
 
+		/**
+		 * A view of one plane of a locked Overlay.
+		 *
+		 * For the planar formats, each plane holds one byte per sample: Y
+		 * at full size, U and V at half the width and height. For the
+		 * packed formats, the only plane holds two bytes per pixel, so its
+		 * width is twice the overlay's.
+		 */
+		class Plane
+		{
+			public:
+				Plane(Uint8* pixels, int width, int height, int pitch) :
+					data(pixels), width(width), height(height), stride(pitch)
+				{ }
+
+				/**
+				 * @return The first byte of the plane.
+				 */
+				inline Uint8* pixels() const
+				{ return data; }
+
+				/**
+				 * @return The width of the plane, in bytes.
+				 */
+				inline int w() const
+				{ return width; }
+
+				/**
+				 * @return The number of rows of the plane.
+				 */
+				inline int h() const
+				{ return height; }
+
+				/**
+				 * @return The distance between two rows, in bytes.
+				 */
+				inline int pitch() const
+				{ return stride; }
+
+				/**
+				 * @return The first byte of row y.
+				 */
+				inline Uint8* row(int y) const
+				{ return data + y * stride; }
+
+				inline Uint8& operator()(int x, int y) const
+				{ return data[y * stride + x]; }
+
+			private:
+				Uint8* data;
+				int width;
+				int height;
+				int stride;
+		};
+
 		class Lock
 		{
 			public:
@@ -144,6 +217,36 @@ namespace sdlpp
 				inline Uint8** pixels()
 				{ return overlay.pixels(); }
 
+				/**
+				 * @throw runtime_error If the overlay has no such plane.
+				 */
+				inline Plane plane(int index)
+				{ return overlay.plane(index); }
+
+				/**
+				 * @return The luma plane of a planar overlay.
+				 *
+				 * @throw runtime_error If the overlay is not planar.
+				 */
+				inline Plane y()
+				{ return overlay.plane(overlay.planar_index(0)); }
+
+				/**
+				 * @return The U (Cb) plane of a planar overlay.
+				 *
+				 * @throw runtime_error If the overlay is not planar.
+				 */
+				inline Plane u()
+				{ return overlay.plane(overlay.planar_index(1)); }
+
+				/**
+				 * @return The V (Cr) plane of a planar overlay.
+				 *
+				 * @throw runtime_error If the overlay is not planar.
+				 */
+				inline Plane v()
+				{ return overlay.plane(overlay.planar_index(2)); }
+
 			private:
 				Overlay& overlay;
 
@@ -162,6 +265,17 @@ namespace sdlpp
 		inline Uint8** pixels()
 		{ return p->pixels; }
 
+		/**
+		 * @return A view of a plane of this Overlay.
+		 */
+		Plane plane(int index);
+
+		/**
+		 * @return Where the Y, U or V plane (0, 1 or 2) is kept, which
+		 * differs between IYUV and YV12.
+		 */
+		int planar_index(int component) const;
+
 		/**
 		 * Locks an overlay.
 		 * @return Whether or locking was successful.
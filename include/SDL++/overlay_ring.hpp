@@ -0,0 +1,122 @@
+#ifndef SDLPP_OVERLAY_RING_HPP_INCLUDED
+#define SDLPP_OVERLAY_RING_HPP_INCLUDED
+/* vim: set ts=4 sts=4 sw=4 tw=80: */
+
+#include <SDL++/overlay.hpp>
+#include <SDL++/queue.hpp>
+#include <SDL++/semaphore.hpp>
+#include <vector>
+
+namespace sdlpp
+{
+	using std::vector;
+
+	/**
+	 * The concrete class Overlay_ring.
+	 *
+	 * A fixed set of Overlays of the same size and format, passed around
+	 * between one producer thread that fills them (a video decoder, say)
+	 * and one consumer thread that displays them. The producer fills frame
+	 * N+1 while the consumer shows frame N.
+	 *
+	 * The producer calls begin_frame(), fills the overlay it gets, and hands
+	 * it over with end_frame(). The consumer calls next() or latest() to get
+	 * the frame to show. The consumer never waits: if no new frame is ready,
+	 * it keeps the one it has. The producer waits in begin_frame() when all
+	 * other overlays are queued, which paces a decoder that runs ahead.
+	 *
+	 * The consumer always holds on to the frame it showed last, so a ring of
+	 * count overlays lets the producer run count - 1 frames ahead.
+	 *
+	 * @note Construct the ring on the thread that set the video mode, as
+	 * SDL requires for creating overlays.
+	 */
+	class Overlay_ring
+	{
+	public:
+		/**
+		 * Creates count overlays on a Video_surface.
+		 *
+		 * @throw runtime_error If count is less than 2, or an Overlay
+		 * can't be created.
+		 */
+		Overlay_ring(int width, int height, Uint32 format,
+				Video_surface& display, int count = 3);
+
+		/**
+		 * @return The number of overlays in the ring.
+		 */
+		inline int size() const
+		{ return overlays.size(); }
+
+		/**
+		 * Gets a free overlay to fill, waiting until there is one. Only the
+		 * producer thread may call this.
+		 */
+		Overlay& begin_frame();
+
+		/**
+		 * Gets a free overlay to fill, if there is one. Only the producer
+		 * thread may call this.
+		 *
+		 * @return 0 if all overlays are queued or shown.
+		 */
+		Overlay* try_begin_frame();
+
+		/**
+		 * Queues the overlay from begin_frame() for display. Only the
+		 * producer thread may call this.
+		 */
+		void end_frame();
+
+		/**
+		 * Takes the oldest queued frame, and frees the one taken before.
+		 * Only the consumer thread may call this. Never waits.
+		 *
+		 * @return The frame to show, which is the one taken before if none
+		 * is queued, or 0 if no frame was ever queued.
+		 */
+		Overlay* next();
+
+		/**
+		 * Like next(), but skips to the newest queued frame and frees the
+		 * ones in between, for a consumer that fell behind.
+		 */
+		Overlay* latest();
+
+		/**
+		 * Shows the next() frame.
+		 *
+		 * @return false if no frame was ever queued or displaying failed.
+		 */
+		bool display(Rect& dstrect);
+
+	private:
+		Overlay_ring(const Overlay_ring& that);
+		Overlay_ring& operator= (const Overlay_ring& that);
+
+		/**
+		 * Hands the overlay the consumer held back to the producer.
+		 */
+		void release(int index);
+
+		vector<Overlay> overlays;
+
+		/** Indices of overlays the producer may fill. */
+		Spsc_queue<int> free_frames;
+
+		/** Indices of filled overlays, oldest first. */
+		Spsc_queue<int> ready_frames;
+
+		/** Counts free_frames, for the producer to wait on. */
+		Semaphore free_count;
+
+		/** The overlay the producer is filling, or -1. */
+		int filling;
+
+		/** The overlay the consumer took last, or -1. */
+		int showing;
+	};
+}
+
+#endif /* SDLPP_OVERLAY_RING_HPP_INCLUDED */
@@ -0,0 +1,127 @@
+#ifndef SDLPP_PACK_HPP_INCLUDED
+#define SDLPP_PACK_HPP_INCLUDED
+/* vim: set ts=4 sts=4 sw=4 tw=80: */
+
+#include "SDL.h"
+#include <SDL++/shared_ptr_base.hpp>
+#include <stdexcept>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace sdlpp
+{
+	using std::runtime_error;
+	using std::string;
+
+	class Mapped_file;
+	class RW_ops;
+
+	/**
+	 * The concrete class Pack.
+	 *
+	 * A pack is many files, such as the images of a game, stored as entries
+	 * of one file, so that loading them costs one open rather than one per
+	 * file. The pack is mapped into memory once and its entries are read
+	 * with RW_ops(pack, name), straight from the mapping.
+	 *
+	 * A pack starts with the magic "SDLPPACK", a version and an entry count,
+	 * each 32 bits and little-endian like all numbers in it. An index
+	 * follows, sorted by name: for each entry its offset, length and CRC-32,
+	 * then its name as a 16-bit length and that many bytes. The entries'
+	 * bytes come after the index. Use Pack::Writer to make one.
+	 *
+	 * Copies share the mapping, which lives as long as any copy or any
+	 * RW_ops reading from it.
+	 */
+	class Pack
+	{
+	public:
+		/**
+		 * Maps a pack and reads its index.
+		 *
+		 * @throw runtime_error If the file can't be mapped or isn't a pack.
+		 */
+		explicit Pack(const string& file_name);
+
+		/**
+		 * @return How many entries the pack holds.
+		 */
+		int size() const;
+
+		/**
+		 * @return The name of an entry, in name order.
+		 */
+		string name(int index) const;
+
+		bool contains(const string& name) const;
+
+		/**
+		 * Checks the bytes of an entry against its checksum. Opening an
+		 * entry doesn't, so as not to read it twice.
+		 *
+		 * @throw runtime_error If there is no such entry.
+		 */
+		bool verify(const string& name) const;
+
+		/**
+		 * The concrete class Pack::Writer.
+		 *
+		 * Gathers files and writes them as a pack.
+		 */
+		class Writer
+		{
+		public:
+			/**
+			 * Adds a file, to be read when the pack is written.
+			 *
+			 * @param name The entry's name in the pack.
+			 *
+			 * @throw runtime_error If the name is too long.
+			 */
+			void add(const string& name, const string& file_name);
+
+			/**
+			 * Writes the files added so far as a pack.
+			 *
+			 * @throw runtime_error If two entries have the same name, if a
+			 * file can't be read, or if the pack can't be written or would
+			 * be larger than 4 GB.
+			 */
+			void write(const string& file_name) const;
+
+		private:
+			/** The files to pack, by entry name. */
+			std::vector<std::pair<string, string> > files;
+		};
+
+	private:
+		friend class RW_ops;
+
+		struct Entry
+		{
+			/** The name, in the mapping. It isn't terminated. */
+			const char* name;
+			Uint16 name_length;
+
+			Uint32 offset;
+			Uint32 length;
+			Uint32 checksum;
+		};
+
+		/**
+		 * @return The entry called name, or 0 if there is none.
+		 */
+		const Entry* find(const string& name) const;
+
+		/**
+		 * @return The bytes of an entry.
+		 */
+		const Uint8* data(const Entry& entry) const;
+
+		shared_ptr<Mapped_file> file;
+		std::vector<Entry> entries;
+	};
+}
+
+#endif /* SDLPP_PACK_HPP_INCLUDED */
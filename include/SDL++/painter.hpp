@@ -0,0 +1,169 @@
+#ifndef SDLPP_PAINTER_HPP_INCLUDED
+#define SDLPP_PAINTER_HPP_INCLUDED
+/* vim: set ts=4 sts=4 sw=4 tw=80: */
+
+#include "SDL.h"
+#include <SDL++/pixel_format.hpp>
+#include <SDL++/rect.hpp>
+#include <SDL++/surface.hpp>
+#include <stdexcept>
+#include <vector>
+
+namespace sdlpp
+{
+	using std::runtime_error;
+	using std::vector;
+
+	/**
+	 * The concrete class Painter.
+	 *
+	 * Draws lines, polylines, polygons, circles and rounded rectangles onto
+	 * a surface. A Painter locks the surface for as long as it lives, so
+	 * draw a whole batch of shapes with one Painter rather than making one
+	 * per shape, and don't blit to or from the surface meanwhile.
+	 *
+	 * Shapes are cut into horizontal spans, which are filled with SSE2
+	 * where available, and clipped to the clip rectangle of the surface.
+	 * Colors with an alpha below SDL_ALPHA_OPAQUE are blended, keeping the
+	 * alpha channel of the surface.
+	 *
+	 * Coordinates are in pixels, and pixel (x, y) covers the square from
+	 * (x, y) to (x + 1, y + 1). Without anti-aliasing, shapes cover the
+	 * pixels whose centres they contain, and lines the pixels their ends
+	 * fall in. With anti-aliasing, the edges of shapes are blended by how
+	 * much of each pixel they cover, and lines are drawn as Xiaolin Wu's;
+	 * give lines coordinates in the middle of pixels, such as 10.5, for
+	 * them to look sharp.
+	 */
+	class Painter
+	{
+	public:
+		struct Point
+		{
+			Point(double x_coord = 0, double y_coord = 0) :
+				x(x_coord),
+				y(y_coord)
+			{
+			}
+
+			double x;
+			double y;
+		};
+
+		/**
+		 * Locks the surface to draw on it. The color is opaque black and
+		 * anti-aliasing is off.
+		 *
+		 * @throw runtime_error If the surface can't be locked.
+		 */
+		explicit Painter(Surface& target);
+
+		/**
+		 * Unlocks the surface.
+		 */
+		~Painter();
+
+		/**
+		 * Sets the color for the shapes that follow.
+		 */
+		void set_color(Uint8 r, Uint8 g, Uint8 b,
+				Uint8 a = SDL_ALPHA_OPAQUE);
+
+		/**
+		 * Turns anti-aliasing on or off for the shapes that follow.
+		 */
+		void set_antialiasing(bool on);
+
+		/**
+		 * Draws a line one pixel wide, including both of its ends.
+		 */
+		void line(double x0, double y0, double x1, double y1);
+
+		/**
+		 * Draws lines through the points, and back to the first one if
+		 * closed. Without anti-aliasing, the points where lines meet are
+		 * drawn only once.
+		 */
+		void polyline(const vector<Point>& points, bool closed = false);
+
+		/**
+		 * Fills a polygon, which may be concave or cross itself. Areas
+		 * that the outline winds around are filled (the nonzero rule).
+		 */
+		void polygon(const vector<Point>& points);
+
+		/**
+		 * Fills a circle.
+		 */
+		void circle(double x, double y, double radius);
+
+		/**
+		 * Fills a rectangle with corners rounded to the given radius, or
+		 * to half its shorter side if that is smaller.
+		 */
+		void rounded_rect(const Rect& rect, double radius);
+
+	private:
+		Painter(const Painter& that);
+		Painter& operator= (const Painter& that);
+
+		/**
+		 * Draws a line without anti-aliasing, leaving out its last pixel
+		 * unless last is set.
+		 */
+		void plain_line(double x0, double y0, double x1, double y1,
+				bool last);
+
+		void smooth_line(double x0, double y0, double x1, double y1);
+
+		/**
+		 * Fills or blends pixels [x0, x1) of row y, clipped.
+		 */
+		void fill_span(int y, int x0, int x1);
+
+		/**
+		 * Blends count pixels from column x of row y by their own alphas.
+		 * They must be inside the clip rectangle.
+		 */
+		void blend(int y, int x, const Uint8* alphas, int count);
+
+		/**
+		 * Blends one pixel by the amount of it a line covers, from 0 to
+		 * 255.
+		 */
+		void plot(int x, int y, int amount);
+
+		Surface target;
+		SDL_Surface* surface;
+		Pixel_format format;
+		bool must_lock;
+		bool antialiasing;
+
+		/** Whether pixels have four bytes we may blend as they are. */
+		bool direct;
+
+		Uint32 pixel;
+		Uint8 alpha;
+
+		/** The color repeated over a row, as pixels if direct, or as RGBA. */
+		vector<Uint8> color_row;
+
+		/** The alpha of the color repeated over a row. */
+		vector<Uint8> alpha_row;
+
+		/** The alphas of a row of anti-aliased pixels. */
+		vector<Uint8> coverage;
+
+		/**
+		 * How much of each pixel of a row a polygon covers, in part and
+		 * from where it starts covering pixels whole.
+		 */
+		vector<float> cover;
+		vector<float> cover_delta;
+
+		/** Room for a row of pixels converted to RGBA. */
+		vector<Uint8> scratch;
+	};
+}
+
+#endif /* SDLPP_PAINTER_HPP_INCLUDED */
@@ -0,0 +1,143 @@
+#ifndef SDLPP_PALETTE_MAP_HPP_INCLUDED
+#define SDLPP_PALETTE_MAP_HPP_INCLUDED
+/* vim: set ts=4 sts=4 sw=4 tw=80: */
+
+#include "SDL.h"
+#include <SDL++/surface.hpp>
+#include <stdexcept>
+#include <vector>
+
+namespace sdlpp
+{
+	using std::runtime_error;
+	using std::vector;
+	using std::size_t;
+
+	/**
+	 * The concrete class Palette_map.
+	 *
+	 * Maps RGB colors to the palette of an 8-bit surface. SDL_MapRGB does
+	 * this by comparing the color with every palette entry. A Palette_map
+	 * divides the RGB cube into 16x16x16 cells, and remembers for each cell
+	 * which palette entries can be the nearest to any color inside it. A
+	 * lookup only compares the color with those few entries. Cells are
+	 * worked out the first time a color falls into them.
+	 *
+	 * The results are exactly those of SDL_MapRGB, including the choice
+	 * between equally near entries.
+	 *
+	 * The map notices when the palette was changed through
+	 * Surface::set_colors() or Surface::set_palette() and starts over. If
+	 * you change the palette behind SDL++'s back, call rebuild().
+	 *
+	 * A Palette_map is not thread-safe; give each thread its own.
+	 */
+	class Palette_map
+	{
+	public:
+		/**
+		 * The default constructor.
+		 *
+		 * @param surface The surface whose palette we map to. The map keeps
+		 * a reference to it.
+		 *
+		 * @throw runtime_error If the surface has no palette.
+		 */
+		Palette_map(Surface& surface);
+
+		/**
+		 * Maps an RGB color to the nearest palette entry.
+		 *
+		 * @note This is equivalent to calling SDL_MapRGB.
+		 */
+		Uint8 map(Uint8 r, Uint8 g, Uint8 b)
+		{
+			if (generation
+					!= __atomic_load_n(&Generation, __ATOMIC_RELAXED)) {
+				refresh();
+			}
+			if (r == last_r && g == last_g && b == last_b) {
+				return last_index;
+			}
+			last_r = r;
+			last_g = g;
+			last_b = b;
+			return last_index = search(r, g, b);
+		}
+
+		/**
+		 * Maps an array of RGBA colors to palette entries.
+		 *
+		 * @note This is equivalent to calling SDL_MapRGBA for every color.
+		 * Like SDL, it ignores the alpha channel.
+		 *
+		 * @param rgba count colors of four bytes each, in R, G, B, A order,
+		 * as for Pixel_format::map().
+		 * @param pixels Receives count palette indices.
+		 */
+		void map(const Uint8* rgba, Uint8* pixels, size_t count);
+
+		/**
+		 * Throws away what we know about the palette.
+		 */
+		void rebuild();
+
+		/**
+		 * Tells all Palette_mapS that some palette may have changed. They
+		 * compare their palette the next time they are used.
+		 *
+		 * @note Surface::set_colors() and Surface::set_palette() call this.
+		 */
+		static void palette_changed();
+
+	private:
+		/**
+		 * The palette entries worth comparing for one cell of the RGB cube.
+		 */
+		struct Cell
+		{
+			/** Where the entries start in candidates. */
+			Uint32 first;
+
+			/** How many entries there are, or 0 if we haven't looked yet. */
+			Uint16 count;
+		};
+
+		/**
+		 * Rebuilds the map if the palette differs from our copy of it.
+		 */
+		void refresh();
+
+		/**
+		 * Finds the nearest palette entry.
+		 */
+		Uint8 search(Uint8 r, Uint8 g, Uint8 b);
+
+		/**
+		 * Works out the candidates of a cell.
+		 */
+		void build(Cell& cell, unsigned index);
+
+		/** Bumped by palette_changed(). */
+		static Uint32 Generation;
+
+		Surface surface;
+
+		/** Our copy of the palette. */
+		vector<SDL_Color> colors;
+
+		/** The value of Generation when we last compared the palette. */
+		Uint32 generation;
+
+		/** The cells, indexed by the top four bits of R, G and B. */
+		vector<Cell> cells;
+
+		/** The palette indices of all cells we have built. */
+		vector<Uint8> candidates;
+
+		/** The most recent lookup, for runs of the same color. */
+		Uint8 last_r, last_g, last_b, last_index;
+	};
+}
+
+#endif /* SDLPP_PALETTE_MAP_HPP_INCLUDED */
@@ -14,6 +14,7 @@ namespace sdlpp
 	using std::auto_ptr;
 	using std::vector;
 	using std::string;
+	using std::size_t;
 
 	/**
 	 * Stores surface format information.
@@ -135,6 +136,33 @@ namespace sdlpp
 			return SDL_GetRGBA(pixel, this, &r, &g, &b, &a);
 		}
 
+		/**
+		 * Maps an array of RGBA color values to an array of pixels.
+		 *
+		 * @note This is equivalent to calling SDL_MapRGBA for every color,
+		 * but 16, 24 and 32-bpp formats are converted with SSE2 or AVX2
+		 * where the CPU has it.
+		 *
+		 * @param rgba count colors of four bytes each, in R, G, B, A order.
+		 * @param pixels Receives count pixels of BytesPerPixel bytes each,
+		 * laid out as in a surface row.
+		 */
+		void map(const Uint8* rgba, void* pixels, size_t count);
+
+		/**
+		 * Gets the RGBA values of an array of pixels.
+		 *
+		 * @note This is equivalent to calling SDL_GetRGBA for every pixel,
+		 * but 16, 24 and 32-bpp formats are converted with SSE2 or AVX2
+		 * where the CPU has it.
+		 *
+		 * @param pixels count pixels of BytesPerPixel bytes each, laid out as
+		 * in a surface row.
+		 * @param rgba Receives count colors of four bytes each, in R, G, B, A
+		 * order.
+		 */
+		void get(const void* pixels, Uint8* rgba, size_t count);
+
 	private:
 		/**
 		 * The default constructor.
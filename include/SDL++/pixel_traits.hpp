@@ -0,0 +1,209 @@
+#ifndef SDLPP_PIXEL_TRAITS_HPP_INCLUDED
+#define SDLPP_PIXEL_TRAITS_HPP_INCLUDED
+/* vim: set ts=4 sts=4 sw=4 tw=80: */
+
+#include "SDL.h"
+#include <cstring>
+
+namespace sdlpp
+{
+	/*
+	 * Compile-time descriptions of the common packed pixel formats. Each
+	 * traits class mirrors the fields of an SDL_PixelFormat as constants, so
+	 * loops templated on them compile down to fixed shifts and masks.
+	 *
+	 * The masks are those of the pixel value in native byte order, as SDL
+	 * uses them.
+	 */
+
+	/**
+	 * Loads and stores pixels of 2 bytes.
+	 */
+	struct Pixel_storage_16
+	{
+		static Uint32 load(const Uint8* p)
+		{ return *reinterpret_cast<const Uint16*>(p); }
+
+		static void store(Uint8* p, Uint32 pixel)
+		{ *reinterpret_cast<Uint16*>(p) = pixel; }
+	};
+
+	/**
+	 * Loads and stores pixels of 3 bytes, in the byte order SDL uses for
+	 * 24-bpp surfaces.
+	 */
+	struct Pixel_storage_24
+	{
+		static Uint32 load(const Uint8* p)
+		{
+#if SDL_BYTEORDER == SDL_LIL_ENDIAN
+			return p[0] | p[1] << 8 | p[2] << 16;
+#else
+			return p[0] << 16 | p[1] << 8 | p[2];
+#endif
+		}
+
+		static void store(Uint8* p, Uint32 pixel)
+		{
+#if SDL_BYTEORDER == SDL_LIL_ENDIAN
+			p[0] = pixel;
+			p[1] = pixel >> 8;
+			p[2] = pixel >> 16;
+#else
+			p[0] = pixel >> 16;
+			p[1] = pixel >> 8;
+			p[2] = pixel;
+#endif
+		}
+	};
+
+	/**
+	 * Loads and stores pixels of 4 bytes.
+	 */
+	struct Pixel_storage_32
+	{
+		static Uint32 load(const Uint8* p)
+		{ return *reinterpret_cast<const Uint32*>(p); }
+
+		static void store(Uint8* p, Uint32 pixel)
+		{ *reinterpret_cast<Uint32*>(p) = pixel; }
+	};
+
+	/**
+	 * 16 bpp, 5 bits red, 6 bits green, 5 bits blue.
+	 */
+	struct Rgb565 : public Pixel_storage_16
+	{
+		enum { BYTES = 2,
+			RSHIFT = 11, GSHIFT = 5, BSHIFT = 0, ASHIFT = 0,
+			RLOSS = 3, GLOSS = 2, BLOSS = 3, ALOSS = 8 };
+		static const Uint32 RMASK = 0xf800;
+		static const Uint32 GMASK = 0x07e0;
+		static const Uint32 BMASK = 0x001f;
+		static const Uint32 AMASK = 0;
+	};
+
+	/**
+	 * 24 bpp, 8 bits each of red, green and blue.
+	 */
+	struct Rgb888 : public Pixel_storage_24
+	{
+		enum { BYTES = 3,
+			RSHIFT = 16, GSHIFT = 8, BSHIFT = 0, ASHIFT = 0,
+			RLOSS = 0, GLOSS = 0, BLOSS = 0, ALOSS = 8 };
+		static const Uint32 RMASK = 0xff0000;
+		static const Uint32 GMASK = 0x00ff00;
+		static const Uint32 BMASK = 0x0000ff;
+		static const Uint32 AMASK = 0;
+	};
+
+	/**
+	 * 32 bpp, 8 bits each of red, green and blue, top byte unused.
+	 */
+	struct Xrgb8888 : public Pixel_storage_32
+	{
+		enum { BYTES = 4,
+			RSHIFT = 16, GSHIFT = 8, BSHIFT = 0, ASHIFT = 0,
+			RLOSS = 0, GLOSS = 0, BLOSS = 0, ALOSS = 8 };
+		static const Uint32 RMASK = 0x00ff0000;
+		static const Uint32 GMASK = 0x0000ff00;
+		static const Uint32 BMASK = 0x000000ff;
+		static const Uint32 AMASK = 0;
+	};
+
+	/**
+	 * 32 bpp, 8 bits each of alpha, red, green and blue, from the top.
+	 */
+	struct Argb8888 : public Pixel_storage_32
+	{
+		enum { BYTES = 4,
+			RSHIFT = 16, GSHIFT = 8, BSHIFT = 0, ASHIFT = 24,
+			RLOSS = 0, GLOSS = 0, BLOSS = 0, ALOSS = 0 };
+		static const Uint32 RMASK = 0x00ff0000;
+		static const Uint32 GMASK = 0x0000ff00;
+		static const Uint32 BMASK = 0x000000ff;
+		static const Uint32 AMASK = 0xff000000;
+	};
+
+	/**
+	 * 32 bpp, 8 bits each of alpha, blue, green and red, from the top.
+	 */
+	struct Abgr8888 : public Pixel_storage_32
+	{
+		enum { BYTES = 4,
+			RSHIFT = 0, GSHIFT = 8, BSHIFT = 16, ASHIFT = 24,
+			RLOSS = 0, GLOSS = 0, BLOSS = 0, ALOSS = 0 };
+		static const Uint32 RMASK = 0x000000ff;
+		static const Uint32 GMASK = 0x0000ff00;
+		static const Uint32 BMASK = 0x00ff0000;
+		static const Uint32 AMASK = 0xff000000;
+	};
+
+	/**
+	 * @return Whether fmt is the format described by Traits.
+	 */
+	template <class Traits>
+	bool Is_format(const SDL_PixelFormat& fmt)
+	{
+		return fmt.palette == 0
+			&& fmt.BytesPerPixel == Traits::BYTES
+			&& fmt.Rmask == Traits::RMASK
+			&& fmt.Gmask == Traits::GMASK
+			&& fmt.Bmask == Traits::BMASK
+			&& fmt.Amask == Traits::AMASK;
+	}
+
+	/**
+	 * Converts a pixel from Src to Dst the way SDL's software blitters do:
+	 * channels are truncated or padded with zero bits, alpha is copied if
+	 * both formats have it, and set to alpha otherwise.
+	 */
+	template <class Src, class Dst>
+	inline Uint32 Convert_pixel(Uint32 s, Uint8 alpha)
+	{
+		Uint32 r = ((s & Src::RMASK) >> Src::RSHIFT) << Src::RLOSS;
+		Uint32 g = ((s & Src::GMASK) >> Src::GSHIFT) << Src::GLOSS;
+		Uint32 b = ((s & Src::BMASK) >> Src::BSHIFT) << Src::BLOSS;
+		Uint32 a = Src::AMASK
+			? ((s & Src::AMASK) >> Src::ASHIFT) << Src::ALOSS
+			: alpha;
+		return (r >> Dst::RLOSS) << Dst::RSHIFT
+			| (g >> Dst::GLOSS) << Dst::GSHIFT
+			| (b >> Dst::BLOSS) << Dst::BSHIFT
+			| ((a >> Dst::ALOSS) << Dst::ASHIFT & Dst::AMASK);
+	}
+
+	/**
+	 * Copies or converts a rectangle of pixels from Src to Dst.
+	 *
+	 * @param alpha The alpha value of pixels whose source has no alpha
+	 * channel, i.e. the source surface's per-surface alpha.
+	 */
+	template <class Src, class Dst>
+	void Convert_rect(const Uint8* src, int src_pitch, Uint8* dst,
+			int dst_pitch, int w, int h, Uint8 alpha)
+	{
+		for (; h > 0; h--, src += src_pitch, dst += dst_pitch) {
+			const Uint8* s = src;
+			Uint8* d = dst;
+			for (int x = 0; x < w; x++, s += Src::BYTES, d += Dst::BYTES) {
+				Dst::store(d, Convert_pixel<Src, Dst>(Src::load(s), alpha));
+			}
+		}
+	}
+
+	/**
+	 * Copies a rectangle of pixels between surfaces of the same format.
+	 */
+	template <class Format>
+	void Copy_rect(const Uint8* src, int src_pitch, Uint8* dst,
+			int dst_pitch, int w, int h, Uint8)
+	{
+		std::size_t row = w * Format::BYTES;
+		for (; h > 0; h--, src += src_pitch, dst += dst_pitch) {
+			std::memcpy(dst, src, row);
+		}
+	}
+}
+
+#endif /* SDLPP_PIXEL_TRAITS_HPP_INCLUDED */
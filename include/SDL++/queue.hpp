@@ -0,0 +1,272 @@
+#ifndef SDLPP_QUEUE_HPP_INCLUDED
+#define SDLPP_QUEUE_HPP_INCLUDED
+/* vim: set ts=4 sts=4 sw=4 tw=80: */
+
+#include <cstddef>
+#include <vector>
+
+namespace sdlpp
+{
+	using std::size_t;
+	using std::vector;
+
+	/**
+	 * The size of a cache line. We keep indices that are written by different
+	 * threads at least this far apart so they don't share a line.
+	 */
+	const size_t CACHE_LINE_SIZE = 64;
+
+	/**
+	 * Rounds n up to the next power of two (and at least 2).
+	 */
+	inline size_t Queue_capacity(size_t n)
+	{
+		size_t c = 2;
+		while (c < n) {
+			c <<= 1;
+		}
+		return c;
+	}
+
+	/**
+	 * The concrete class Spsc_queue.
+	 *
+	 * Spsc_queue is a bounded, lock-free ring buffer for exactly one producer
+	 * thread and one consumer thread. Neither push() nor pop() ever block;
+	 * they return false if the queue is full or empty respectively.
+	 *
+	 * The producer and consumer each keep a cached copy of the other side's
+	 * index, so they only touch the other side's cache line when the ring
+	 * looks full or empty.
+	 *
+	 * @note T must be default-constructible and assignable.
+	 */
+	template <typename T>
+	class Spsc_queue
+	{
+	public:
+		/**
+		 * Creates an empty queue that holds at least capacity elements. The
+		 * capacity is rounded up to a power of two.
+		 */
+		explicit Spsc_queue(size_t capacity) :
+			buffer(Queue_capacity(capacity)),
+			mask(buffer.size() - 1),
+			head(0), tail_cache(0),
+			tail(0), head_cache(0)
+		{
+		}
+
+		/**
+		 * Appends an element. Only the producer thread may call this.
+		 *
+		 * @return false if the queue is full.
+		 */
+		bool push(const T& value)
+		{
+			size_t t = __atomic_load_n(&tail, __ATOMIC_RELAXED);
+			if (t - head_cache == buffer.size()) {
+				head_cache = __atomic_load_n(&head, __ATOMIC_ACQUIRE);
+				if (t - head_cache == buffer.size()) {
+					return false;
+				}
+			}
+			buffer[t & mask] = value;
+			__atomic_store_n(&tail, t + 1, __ATOMIC_RELEASE);
+			return true;
+		}
+
+		/**
+		 * Removes the oldest element. Only the consumer thread may call this.
+		 *
+		 * @return false if the queue is empty.
+		 */
+		bool pop(T& value)
+		{
+			size_t h = __atomic_load_n(&head, __ATOMIC_RELAXED);
+			if (h == tail_cache) {
+				tail_cache = __atomic_load_n(&tail, __ATOMIC_ACQUIRE);
+				if (h == tail_cache) {
+					return false;
+				}
+			}
+			value = buffer[h & mask];
+			__atomic_store_n(&head, h + 1, __ATOMIC_RELEASE);
+			return true;
+		}
+
+		/**
+		 * @return The number of elements in the queue. This is only a
+		 * snapshot if the other side is active.
+		 */
+		size_t size() const
+		{
+			return __atomic_load_n(&tail, __ATOMIC_ACQUIRE)
+				- __atomic_load_n(&head, __ATOMIC_ACQUIRE);
+		}
+
+		bool empty() const
+		{ return size() == 0; }
+
+		size_t capacity() const
+		{ return buffer.size(); }
+
+	private:
+		Spsc_queue(const Spsc_queue&);
+		Spsc_queue& operator= (const Spsc_queue&);
+
+		vector<T> buffer;
+		size_t mask;
+
+		char pad0[CACHE_LINE_SIZE];
+
+		/* Written by the consumer. */
+		size_t head;
+		size_t tail_cache;
+
+		char pad1[CACHE_LINE_SIZE - 2 * sizeof(size_t)];
+
+		/* Written by the producer. */
+		size_t tail;
+		size_t head_cache;
+
+		char pad2[CACHE_LINE_SIZE - 2 * sizeof(size_t)];
+	};
+
+	/**
+	 * The concrete class Mpmc_queue.
+	 *
+	 * Mpmc_queue is a bounded, lock-free ring buffer for any number of
+	 * producer and consumer threads. Every slot carries a sequence number
+	 * that tells producers and consumers whether it is theirs to fill or
+	 * drain, so a push or pop costs a single compare-and-swap on the shared
+	 * index in the common case. This is Dmitry Vyukov's bounded MPMC queue.
+	 *
+	 * @note T must be default-constructible and assignable.
+	 */
+	template <typename T>
+	class Mpmc_queue
+	{
+	public:
+		/**
+		 * Creates an empty queue that holds at least capacity elements. The
+		 * capacity is rounded up to a power of two.
+		 */
+		explicit Mpmc_queue(size_t capacity) :
+			cells(Queue_capacity(capacity)),
+			mask(cells.size() - 1),
+			head(0),
+			tail(0)
+		{
+			for (size_t i = 0; i < cells.size(); i++) {
+				cells[i].sequence = i;
+			}
+		}
+
+		/**
+		 * Appends an element.
+		 *
+		 * @return false if the queue is full.
+		 */
+		bool push(const T& value)
+		{
+			Cell* cell;
+			size_t pos = __atomic_load_n(&tail, __ATOMIC_RELAXED);
+			for (;;) {
+				cell = &cells[pos & mask];
+				size_t seq = __atomic_load_n(&cell->sequence, __ATOMIC_ACQUIRE);
+				long diff = static_cast<long>(seq) - static_cast<long>(pos);
+				if (diff == 0) {
+					if (__atomic_compare_exchange_n(&tail, &pos, pos + 1, true,
+								__ATOMIC_RELAXED, __ATOMIC_RELAXED)) {
+						break;
+					}
+				}
+				else if (diff < 0) {
+					return false;
+				}
+				else {
+					pos = __atomic_load_n(&tail, __ATOMIC_RELAXED);
+				}
+			}
+			cell->data = value;
+			__atomic_store_n(&cell->sequence, pos + 1, __ATOMIC_RELEASE);
+			return true;
+		}
+
+		/**
+		 * Removes the oldest element.
+		 *
+		 * @return false if the queue is empty.
+		 */
+		bool pop(T& value)
+		{
+			Cell* cell;
+			size_t pos = __atomic_load_n(&head, __ATOMIC_RELAXED);
+			for (;;) {
+				cell = &cells[pos & mask];
+				size_t seq = __atomic_load_n(&cell->sequence, __ATOMIC_ACQUIRE);
+				long diff = static_cast<long>(seq) - static_cast<long>(pos + 1);
+				if (diff == 0) {
+					if (__atomic_compare_exchange_n(&head, &pos, pos + 1, true,
+								__ATOMIC_RELAXED, __ATOMIC_RELAXED)) {
+						break;
+					}
+				}
+				else if (diff < 0) {
+					return false;
+				}
+				else {
+					pos = __atomic_load_n(&head, __ATOMIC_RELAXED);
+				}
+			}
+			value = cell->data;
+			__atomic_store_n(&cell->sequence, pos + mask + 1, __ATOMIC_RELEASE);
+			return true;
+		}
+
+		/**
+		 * @return The number of elements in the queue. This is only a
+		 * snapshot while other threads are active.
+		 */
+		size_t size() const
+		{
+			size_t t = __atomic_load_n(&tail, __ATOMIC_ACQUIRE);
+			size_t h = __atomic_load_n(&head, __ATOMIC_ACQUIRE);
+			return t > h ? t - h : 0;
+		}
+
+		bool empty() const
+		{ return size() == 0; }
+
+		size_t capacity() const
+		{ return cells.size(); }
+
+	private:
+		Mpmc_queue(const Mpmc_queue&);
+		Mpmc_queue& operator= (const Mpmc_queue&);
+
+		struct Cell
+		{
+			size_t sequence;
+			T data;
+		};
+
+		vector<Cell> cells;
+		size_t mask;
+
+		char pad0[CACHE_LINE_SIZE];
+
+		/* Shared by the consumers. */
+		size_t head;
+
+		char pad1[CACHE_LINE_SIZE - sizeof(size_t)];
+
+		/* Shared by the producers. */
+		size_t tail;
+
+		char pad2[CACHE_LINE_SIZE - sizeof(size_t)];
+	};
+}
+
+#endif /* SDLPP_QUEUE_HPP_INCLUDED */
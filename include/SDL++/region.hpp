@@ -0,0 +1,114 @@
+#ifndef SDLPP_REGION_HPP_INCLUDED
+#define SDLPP_REGION_HPP_INCLUDED
+/* vim: set ts=4 sts=4 sw=4 tw=80: */
+
+#include "SDL.h"
+#include <SDL++/rect.hpp>
+#include <vector>
+
+namespace sdlpp
+{
+	using std::vector;
+
+	/**
+	 * The concrete class Region.
+	 *
+	 * An area of any shape made of rectangles, such as the parts of a
+	 * window that overlapping panels leave visible. Surface::fill() and
+	 * Surface::blit() take a Region to draw through all of it at once,
+	 * rather than once per rectangle.
+	 *
+	 * A region is stored as bands: rows of the same height, top to bottom,
+	 * each holding spans left to right that neither overlap nor touch.
+	 * Bands that are alike and touch are merged, so two regions covering
+	 * the same pixels are stored the same way. Its rectangles are those
+	 * spans, with the top and bottom of their band.
+	 */
+	class Region
+	{
+	public:
+		/**
+		 * Creates an empty region.
+		 */
+		Region();
+
+		/**
+		 * Creates a region covering a rectangle.
+		 */
+		Region(const SDL_Rect& rect);
+
+		bool empty() const;
+
+		/**
+		 * @return The smallest rectangle holding the region.
+		 */
+		Rect bounds() const;
+
+		/**
+		 * @return Whether the region holds pixel (x, y).
+		 */
+		bool contains(int x, int y) const;
+
+		/**
+		 * @return The number of rectangles the region is made of.
+		 */
+		size_t size() const;
+
+		/**
+		 * @return Rectangle i, from the top left to the bottom right. They
+		 * don't overlap.
+		 */
+		Rect operator[] (size_t i) const;
+
+		bool operator== (const Region& that) const;
+		bool operator!= (const Region& that) const;
+
+		/**
+		 * Adds the area of another region to this one.
+		 */
+		Region& unite(const Region& that);
+
+		/**
+		 * Keeps only the area this region shares with another one.
+		 */
+		Region& intersect(const Region& that);
+
+		/**
+		 * Takes the area of another region out of this one.
+		 */
+		Region& subtract(const Region& that);
+
+		/**
+		 * Moves the region by dx to the right and dy down.
+		 */
+		void translate(int dx, int dy);
+
+	private:
+		/** A span in a band, from x0, y0 to x1, y1 excluded. */
+		struct Box
+		{
+			int x0;
+			int y0;
+			int x1;
+			int y1;
+		};
+
+		enum Operation
+		{
+			UNION,
+			INTERSECTION,
+			DIFFERENCE
+		};
+
+		/**
+		 * Replaces this region with what an operation makes of it and
+		 * that.
+		 */
+		void combine(const Region& that, Operation operation);
+
+		/** The spans of every band, top to bottom, left to right. */
+		vector<Box> boxes;
+	};
+}
+
+#endif /* SDLPP_REGION_HPP_INCLUDED */
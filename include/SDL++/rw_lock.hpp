@@ -0,0 +1,164 @@
+#ifndef SDLPP_RW_LOCK_HPP_INCLUDED
+#define SDLPP_RW_LOCK_HPP_INCLUDED
+/* vim: set ts=4 sts=4 sw=4 tw=80: */
+
+#include "SDL.h"
+#include <SDL++/shared_ptr_base.hpp>
+
+namespace sdlpp
+{
+	/**
+	 * The state shared by all copies of an Rw_lock.
+	 */
+	struct Rw_lock_state
+	{
+		/** -1: a writer holds the lock, otherwise the number of readers. */
+		int state;
+
+		/** The number of writers that want the lock. */
+		int writers_waiting;
+
+		/** The number of threads blocked on seq. */
+		int sleepers;
+
+		/** Bumped whenever the lock is released; threads block on it. */
+		int seq;
+	};
+
+	/**
+	 * The concrete class Rw_lock.
+	 *
+	 * Rw_lock is a reader-writer lock: any number of readers may hold it at
+	 * the same time, or a single writer. Waiting writers take precedence over
+	 * new readers, so a steady stream of readers can't starve a writer.
+	 * Taking and releasing an uncontended lock is one atomic instruction; we
+	 * only make a system call when a thread has to sleep.
+	 *
+	 * Copies share the same lock. We provide the helper classes
+	 * Rw_lock::Read_lock and Rw_lock::Write_lock for safe locking and
+	 * unlocking of an Rw_lock.
+	 */
+	class Rw_lock : public shared_ptr_base<Rw_lock_state>
+	{
+	public:
+		/**
+		 * The default constructor.
+		 *
+		 * Creates a new, unlocked reader-writer lock.
+		 */
+		Rw_lock();
+
+		/**
+		 * The copy constructor.
+		 *
+		 * Constructs a shallow copy of the lock.
+		 */
+		Rw_lock(const Rw_lock& that);
+
+		/**
+		 * The concrete helper class Read_lock.
+		 *
+		 * Takes an Rw_lock for reading on construction and releases it on
+		 * deconstruction.
+		 */
+		class Read_lock
+		{
+			public:
+				Read_lock(Rw_lock& lock) : lock(lock)
+				{ lock.lock_read(); }
+
+				~Read_lock()
+				{ lock.unlock_read(); }
+
+			private:
+				Rw_lock& lock;
+
+				Read_lock();
+				Read_lock(const Read_lock& that);
+				Read_lock& operator= (const Read_lock& that);
+		};
+
+		/**
+		 * The concrete helper class Write_lock.
+		 *
+		 * Takes an Rw_lock for writing on construction and releases it on
+		 * deconstruction.
+		 */
+		class Write_lock
+		{
+			public:
+				Write_lock(Rw_lock& lock) : lock(lock)
+				{ lock.lock_write(); }
+
+				~Write_lock()
+				{ lock.unlock_write(); }
+
+			private:
+				Rw_lock& lock;
+
+				Write_lock();
+				Write_lock(const Write_lock& that);
+				Write_lock& operator= (const Write_lock& that);
+		};
+
+	private:
+		friend class Read_lock;
+		friend class Write_lock;
+
+		/**
+		 * Takes the lock for reading.
+		 */
+		inline void lock_read()
+		{
+			Rw_lock_state* s = p.get();
+			int readers = __atomic_load_n(&s->state, __ATOMIC_RELAXED);
+			if (readers < 0
+					|| __atomic_load_n(&s->writers_waiting, __ATOMIC_RELAXED) != 0
+					|| !__atomic_compare_exchange_n(&s->state, &readers,
+						readers + 1, false, __ATOMIC_ACQUIRE, __ATOMIC_RELAXED)) {
+				lock_read_contended();
+			}
+		}
+
+		/**
+		 * Releases a read lock.
+		 */
+		inline void unlock_read()
+		{
+			if (__atomic_sub_fetch(&p->state, 1, __ATOMIC_SEQ_CST) == 0) {
+				release();
+			}
+		}
+
+		/**
+		 * Takes the lock for writing.
+		 */
+		inline void lock_write()
+		{
+			int expected = 0;
+			if (!__atomic_compare_exchange_n(&p->state, &expected, -1, false,
+						__ATOMIC_ACQUIRE, __ATOMIC_RELAXED)) {
+				lock_write_contended();
+			}
+		}
+
+		/**
+		 * Releases a write lock.
+		 */
+		inline void unlock_write()
+		{
+			__atomic_store_n(&p->state, 0, __ATOMIC_SEQ_CST);
+			release();
+		}
+
+		void lock_read_contended();
+		void lock_write_contended();
+
+		/**
+		 * Wakes sleeping threads after the lock became free.
+		 */
+		void release();
+	};
+}
+
+#endif /* SDLPP_RW_LOCK_HPP_INCLUDED */
@@ -13,9 +13,41 @@ namespace sdlpp
 	using std::auto_ptr;
 	using std::string;
 
+	class Pack;
+
 	class RW_ops : public shared_ptr_base<SDL_RWops>
 	{
 	public:
+		/**
+		 * How a mapped file will be read, passed on to the system as a
+		 * hint.
+		 */
+		enum Access
+		{
+			NORMAL,
+
+			/** Front to back, so pages may be read well ahead. */
+			SEQUENTIAL,
+
+			/** Here and there, so reading ahead is wasted. */
+			RANDOM,
+
+			/** Soon and all of it, so start reading it now. */
+			WILL_NEED
+		};
+
+		/**
+		 * Whether a compressed RW_ops reads or writes.
+		 */
+		enum Direction
+		{
+			/** Reads a compressed stream, decompressing it. */
+			DECOMPRESS,
+
+			/** Writes a compressed stream, compressing what is written. */
+			COMPRESS
+		};
+
 		int seek(int offset, int whence);
 		int read(void *ptr, int size, int maxnum);
 		int write(const void *ptr, int size, int num);
@@ -44,6 +76,99 @@ namespace sdlpp
 		 * @throw runtime_error
 		 */
 		RW_ops(const void* mem, int size);
+
+		/**
+		 * Maps a file read-only into memory and reads it from there, as
+		 * SDL_RWFromConstMem does, so that reads are served from the page
+		 * cache with no copy through stdio buffers. The mapping lives as
+		 * long as this object and its copies. Where files can't be mapped,
+		 * the file is read into memory instead.
+		 *
+		 * @param access A hint about how the file will be read.
+		 *
+		 * @throw runtime_error If the file can't be opened or mapped, or
+		 * is larger than an SDL_RWops can address.
+		 */
+		RW_ops(const string& file_name, Access access);
+
+		/**
+		 * @see RW_ops(const string&, Access). Without it, a literal file
+		 * name would pick RW_ops(const void*, int).
+		 */
+		RW_ops(const char* file_name, Access access);
+
+		/**
+		 * Reads and writes another RW_ops through a buffer, so that the many
+		 * small reads of a decoder cost one read of the source per window of
+		 * bytes, and many small writes one write. Seeking within the bytes
+		 * read ahead keeps them; reads and writes of a whole window or more
+		 * go straight through.
+		 *
+		 * Small writes are reported whole once buffered; if the source
+		 * then fails to take them, the next seek or read, or close(),
+		 * returns -1. Closing it writes the pending bytes but leaves the
+		 * source open, as the source is shared, and they are also written
+		 * when the last copy is destroyed. Don't use the source directly
+		 * meanwhile.
+		 *
+		 * @param window The size of the buffer, in bytes.
+		 *
+		 * @throw runtime_error
+		 */
+		RW_ops(const RW_ops& source, int window);
+
+		/**
+		 * Reads another RW_ops ahead in a thread of its own, so that reads
+		 * from a slow source, such as a stream played back as it is read,
+		 * nearly always find their bytes already there. The thread keeps up
+		 * to a given number of blocks read ahead of the reader; reads only
+		 * wait for it when they catch up. Seeking within the blocks read
+		 * ahead keeps them.
+		 *
+		 * It can't be written to. Closing it leaves the source open, as the
+		 * source is shared; the thread stops when the last copy is
+		 * destroyed. Don't use the source directly meanwhile, nor this from
+		 * several threads at once.
+		 *
+		 * @param block_size How many bytes the thread reads at a time.
+		 * @param blocks How many blocks it may read ahead.
+		 *
+		 * @throw runtime_error
+		 */
+		RW_ops(const RW_ops& source, int block_size, int blocks);
+
+		/**
+		 * Reads an entry of a pack, straight from the pack's mapping. The
+		 * mapping lives as long as this object and its copies.
+		 *
+		 * @throw runtime_error If the pack has no such entry.
+		 */
+		RW_ops(const Pack& pack, const string& entry_name);
+
+		/**
+		 * Reads or writes a stream of LZ4-compressed blocks through another
+		 * RW_ops, so that anything that loads from an RW_ops can load
+		 * compressed data unchanged. LZ4 decompresses several times faster
+		 * than disks read, so compressed data loads sooner than raw data.
+		 *
+		 * The stream starts where the source is. It ends with an index of
+		 * its blocks, which a DECOMPRESS stream reads first: the source
+		 * must be able to seek, and the stream must end where the source
+		 * does. Seeking then decompresses just the block it lands in.
+		 *
+		 * A COMPRESS stream can't seek, and writes its index when closed
+		 * or when its last copy is destroyed. Closing leaves the source
+		 * open, as the source is shared. Don't use the source directly
+		 * meanwhile.
+		 *
+		 * @param block_size How many bytes are compressed at a time, when
+		 * writing. Larger blocks compress better, smaller ones seek faster.
+		 *
+		 * @throw runtime_error If the stream can't be started, or isn't a
+		 * compressed stream.
+		 */
+		RW_ops(const RW_ops& source, Direction direction,
+				int block_size = 65536);
 	};
 }
 
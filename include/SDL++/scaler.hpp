@@ -0,0 +1,71 @@
+#ifndef SDLPP_SCALER_HPP_INCLUDED
+#define SDLPP_SCALER_HPP_INCLUDED
+/* vim: set ts=4 sts=4 sw=4 tw=80: */
+
+#include "SDL.h"
+
+namespace sdlpp
+{
+	/**
+	 * The Scaler class blits a rectangle of one surface onto a rectangle of
+	 * another of a different size, which SDL_BlitSurface can't.
+	 *
+	 * Filtering is separable: rows are first resampled horizontally into
+	 * 16-bit intermediates, then blended vertically, with SSE2 where
+	 * available. The destination is cut into tiles of columns so the
+	 * intermediates stay in cache, and rows are spread over all CPUs.
+	 *
+	 * Between surfaces with the same 32-bit format, the channels are
+	 * filtered in place whatever their order. Other formats, such as 16-bit
+	 * ones, go through Pixel_format::get() and Pixel_format::map().
+	 *
+	 * Scaled blits copy the pixels: colorkeys and alpha blending are not
+	 * applied. Scale into a temporary surface and blit that if you need
+	 * them.
+	 *
+	 * Surface::blit_scaled() goes through the Scaler.
+	 */
+	class Scaler
+	{
+	public:
+		enum Filter {
+			/** Takes the pixel nearest to each sample. Fastest. */
+			NEAREST,
+
+			/**
+			 * Blends the four pixels around each sample. Good for
+			 * enlarging and for shrinking to no less than half the size.
+			 */
+			BILINEAR,
+
+			/**
+			 * Averages the pixels under each destination pixel, weighted
+			 * by how much of them it covers. Best for shrinking a lot.
+			 */
+			BOX
+		};
+
+		/**
+		 * Scales src_rect of src to the size of dst_rect and draws it
+		 * there.
+		 *
+		 * @param src_rect The area to read, or 0 for all of src. It is
+		 * clipped to src.
+		 * @param dst_rect The area to draw, or 0 for all of dst. The
+		 * scaling follows its size, then it is clipped to the clip
+		 * rectangle of dst, and receives the area that was drawn.
+		 *
+		 * @return 0 on success, -1 on error.
+		 */
+		static int blit(SDL_Surface* src, SDL_Rect* src_rect,
+				SDL_Surface* dst, SDL_Rect* dst_rect,
+				Filter filter = BILINEAR);
+
+	private:
+		/* We declare these private to force Scaler uninstantiable. */
+		Scaler();
+		Scaler(const Scaler&);
+	};
+}
+
+#endif /* SDLPP_SCALER_HPP_INCLUDED */
@@ -9,6 +9,34 @@ namespace sdlpp
 {
 	using std::runtime_error;
 
+	class Lock_profiler;
+
+	/**
+	 * The state shared by all copies of a Semaphore that counts in a futex
+	 * rather than in an SDL_sem.
+	 */
+	struct Semaphore_state
+	{
+		/** The value of the semaphore; waiters sleep on it. */
+		int value;
+
+		/** The number of threads asleep on value that wait for one. */
+		int sleepers;
+
+		/** The number of threads asleep on value that wait for more. */
+		int batch_sleepers;
+	};
+
+	/**
+	 * The concrete class Semaphore.
+	 *
+	 * On Linux, semaphores the library creates count in a futex word, so
+	 * post(n) wakes up to n waiters with a single system call and wait(n)
+	 * takes n at once. They have no SDL_sem, see raw_ptr(). Semaphores that
+	 * wrap an SDL_sem, and all semaphores elsewhere, go through SDL.
+	 *
+	 * Copies share the same semaphore.
+	 */
 	class Semaphore : public shared_ptr_base<SDL_sem>
 	{
 	public:
@@ -46,17 +74,26 @@ namespace sdlpp
 		 */
 		bool wait();
 
+		/**
+		 * Locks a semaphore n times, suspending the thread until the value
+		 * is at least n.
+		 *
+		 * @note With an SDL_sem, this is n calls to SDL_SemWait, which take
+		 * one at a time.
+		 */
+		bool wait(Uint32 n);
+
 		/**
 		 * Attempts to lock a semaphore but doesn’t suspend the thread.
 		 *
-		 * @throw runtime_error
+		 * @return false if the value is zero.
 		 */
 		bool try_wait();
 
 		/**
 		 * Locks a semaphore, but only wait up to a specified maximum time.
 		 *
-		 * @throw runtime_error
+		 * @return false if the time passed first.
 		 */
 		bool wait_timeout(Uint32 timeout);
 
@@ -65,10 +102,35 @@ namespace sdlpp
 		 */
 		bool post();
 
+		/**
+		 * Unlocks a semaphore n times.
+		 *
+		 * @note With an SDL_sem, this is n calls to SDL_SemPost.
+		 */
+		bool post(Uint32 n);
+
 		/**
 		 * Return the current value of a semaphore.
 		 */
 		Uint32 value();
+
+		/**
+		 * @return The wrapped SDL_sem, or NULL if the semaphore counts in a
+		 * futex.
+		 *
+		 * @deprecated Semaphores the library creates on Linux have no
+		 * SDL_sem. To share a semaphore with code that calls SDL directly,
+		 * create it with SDL_CreateSemaphore and wrap it with
+		 * Semaphore(SDL_sem*).
+		 */
+		SDL_sem* raw_ptr()
+		{ return p.get(); }
+
+	private:
+		friend class Lock_profiler;
+
+		/** The futex count, or NULL if we wrap an SDL_sem. */
+		shared_ptr<Semaphore_state> state;
 	};
 }
 
@@ -0,0 +1,93 @@
+#ifndef SDLPP_SPRITE_HPP_INCLUDED
+#define SDLPP_SPRITE_HPP_INCLUDED
+/* vim: set ts=4 sts=4 sw=4 tw=80: */
+
+#include "SDL.h"
+#include <SDL++/shared_ptr_base.hpp>
+#include <SDL++/rect.hpp>
+#include <SDL++/surface.hpp>
+#include <stdexcept>
+
+namespace sdlpp
+{
+	using std::runtime_error;
+
+	/**
+	 * The concrete class Sprite.
+	 *
+	 * A copy of a surface with its transparent pixels left out. Each row is
+	 * stored as spans of opaque pixels, which are blitted with memcpy, and
+	 * spans of translucent pixels, which are blended with SSE2 where
+	 * available. The gaps between spans are skipped without being read, so
+	 * sparse sprites such as outlines and glyphs blit much faster than
+	 * through a colorkey, and unlike SDL_RLEACCEL this also works for
+	 * surfaces with alpha.
+	 *
+	 * Blits onto surfaces of the format the sprite was built from take the
+	 * fast path. Other formats are converted span by span through
+	 * Pixel_format. Blending keeps the alpha channel of the destination, as
+	 * SDL_BlitSurface does.
+	 *
+	 * Sprites never change once built, and copies share their spans.
+	 */
+	class Sprite
+	{
+	public:
+		/**
+		 * Builds a sprite from a surface. Pixels that match its colorkey,
+		 * if it has SDL_SRCCOLORKEY set, are left out. Pixels are blended
+		 * by the alpha channel or, with SDL_SRCALPHA set, by the per-surface
+		 * alpha; pixels with an alpha of 0 are left out.
+		 *
+		 * @throw runtime_error If the surface can't be locked.
+		 */
+		explicit Sprite(Surface& src);
+
+		/**
+		 * Builds a sprite from a surface and a mask of the same size, as
+		 * above, also leaving out the pixels whose value in the mask is 0.
+		 * The mask may have any format; a 1-bit image loaded with
+		 * SDL_LoadBMP comes out as an 8-bit one, as it should.
+		 *
+		 * @throw runtime_error If the sizes differ, or a surface can't be
+		 * locked.
+		 */
+		Sprite(Surface& src, Surface& mask);
+
+		/**
+		 * @return The width of the sprite.
+		 */
+		int w() const;
+
+		/**
+		 * @return The height of the sprite.
+		 */
+		int h() const;
+
+		/**
+		 * @return The number of pixels that are drawn, out of w() * h().
+		 */
+		int pixels() const;
+
+		/**
+		 * Draws the sprite at dst_rect.x, dst_rect.y.
+		 *
+		 * @param dst_rect Its size is ignored. It is clipped to the clip
+		 * rectangle of dst, and receives the area that was drawn, as with
+		 * SDL_BlitSurface.
+		 */
+		bool blit(Surface& dst, Rect& dst_rect);
+
+		/**
+		 * Draws src_rect of the sprite at dst_rect.x, dst_rect.y, clipping
+		 * both rectangles as SDL_BlitSurface does.
+		 */
+		bool blit(Rect& src_rect, Surface& dst, Rect& dst_rect);
+
+	private:
+		struct Data;
+		shared_ptr<Data> data;
+	};
+}
+
+#endif /* SDLPP_SPRITE_HPP_INCLUDED */
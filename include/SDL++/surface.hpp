@@ -10,6 +10,8 @@
 #include <SDL++/rect.hpp>
 #include <SDL++/color.hpp>
 #include <SDL++/pixel_format.hpp>
+#include <SDL++/region.hpp>
+#include <SDL++/scaler.hpp>
 #ifdef SDLPP_NEED_SDL_IMAGE
 #include <SDL++/rw_ops.hpp>
 #endif /* SDLPP_NEED_SDL_IMAGE */
@@ -158,10 +160,43 @@ namespace sdlpp
 		 */
 		bool blit(Surface& dst, Rect& dst_rect);
 
+		/**
+		  Performs a fast blit from the source surface to the destination
+		  surface, drawing only inside a region of the other surface.
+
+		  @see Blitter::blit
+		 */
+		bool blit(Rect& src_rect, Surface& dst, Rect& dst_rect,
+				const Region& clip);
+
+		/**
+		  Blits the whole surface to parts of the other surface, scaled to
+		  the size of the destination rectangle.
+
+		  @see Scaler::blit
+		 */
+		bool blit_scaled(Surface& dst, Rect& dst_rect,
+				Scaler::Filter filter = Scaler::BILINEAR);
+
+		/**
+		  Blits parts of the surface to parts of the other surface, scaled
+		  to the size of the destination rectangle.
+
+		  @see Scaler::blit
+		 */
+		bool blit_scaled(Rect& src_rect, Surface& dst, Rect& dst_rect,
+				Scaler::Filter filter = Scaler::BILINEAR);
+
 		/**
 		  Fast fill the area described by the rectangle with some color.
 		 */
 		bool fill(Rect* rect, Uint32 color);
+
+		/**
+		  Fast fill the area of a region, inside the clip rectangle, with
+		  some color. Software surfaces are locked once for all of it.
+		 */
+		bool fill(const Region& region, Uint32 color);
 		
 		/**
 		  Converts a surface to the same format as another surface.
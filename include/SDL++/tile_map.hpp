@@ -0,0 +1,161 @@
+#ifndef SDLPP_TILE_MAP_HPP_INCLUDED
+#define SDLPP_TILE_MAP_HPP_INCLUDED
+/* vim: set ts=4 sts=4 sw=4 tw=80: */
+
+#include "SDL.h"
+#include <SDL++/shared_ptr_base.hpp>
+#include <SDL++/rect.hpp>
+#include <SDL++/surface.hpp>
+#include <stdexcept>
+#include <vector>
+
+namespace sdlpp
+{
+	using std::runtime_error;
+	using std::vector;
+
+	/**
+	 * The concrete class Tile_map.
+	 *
+	 * Draws layers of tiles taken from an atlas, a surface holding tiles
+	 * of the same size left to right, top to bottom. Tile i is the i-th of
+	 * them, and EMPTY leaves its cell blank.
+	 *
+	 * Only the tiles inside the view are drawn, and empty ones are
+	 * skipped. Layers marked static are composited into chunks of
+	 * chunk_size by chunk_size tiles the first time they are drawn, so a
+	 * frame costs a few chunk blits per static layer rather than one blit
+	 * per tile. Changing a tile rebuilds only its chunk; call invalidate()
+	 * after changing the pixels of the atlas.
+	 *
+	 * Chunks of opaque tiles keep the format of the atlas and are copied
+	 * as they are. Chunks with empty cells, colorkeyed or translucent
+	 * tiles are 32-bit surfaces with an alpha channel, where the colorkey
+	 * and the empty cells become transparent.
+	 */
+	class Tile_map
+	{
+	public:
+		enum { EMPTY = -1 };
+
+		/**
+		 * Creates a map with all cells empty and no static layers.
+		 *
+		 * @param tile_w The width of a tile, in pixels.
+		 * @param tile_h The height of a tile, in pixels.
+		 * @param columns The width of the map, in tiles.
+		 * @param rows The height of the map, in tiles.
+		 * @param chunk_size The width and height of chunks, in tiles.
+		 *
+		 * @throw runtime_error If a size isn't positive, or the atlas holds
+		 * no whole tile.
+		 */
+		Tile_map(Surface& atlas, int tile_w, int tile_h, int columns,
+				int rows, int layers = 1, int chunk_size = 16);
+
+		int tile_w() const;
+		int tile_h() const;
+		int columns() const;
+		int rows() const;
+		int layers() const;
+
+		/**
+		 * @return The tile at a cell, or EMPTY.
+		 *
+		 * @throw runtime_error If there is no such cell.
+		 */
+		int tile(int layer, int column, int row) const;
+
+		/**
+		 * Puts a tile in a cell, or EMPTY to clear it.
+		 *
+		 * @throw runtime_error If there is no such cell or tile.
+		 */
+		void set_tile(int layer, int column, int row, int tile);
+
+		/**
+		 * Marks a layer as static, so its chunks are cached, or not. Mark
+		 * layers that rarely change, such as the ground.
+		 *
+		 * @throw runtime_error If there is no such layer.
+		 */
+		void set_static(int layer, bool on);
+
+		/**
+		 * Drops every cached chunk, to rebuild them from the atlas.
+		 */
+		void invalidate();
+
+		/**
+		 * Draws every layer, bottom first.
+		 *
+		 * @param view_x The left of the area to draw, in map pixels.
+		 * @param view_y The top of the area to draw, in map pixels.
+		 * @param dst_rect Where to draw it. Its size is that of the area.
+		 *
+		 * @return false if a blit failed.
+		 *
+		 * @throw runtime_error If a chunk can't be created.
+		 */
+		bool draw(Surface& dst, const Rect& dst_rect, int view_x,
+				int view_y);
+
+		/**
+		 * Draws one layer, as draw() does, so that other things may be
+		 * drawn between layers.
+		 *
+		 * @throw runtime_error If there is no such layer, or a chunk can't
+		 * be created.
+		 */
+		bool draw_layer(int layer, Surface& dst, const Rect& dst_rect,
+				int view_x, int view_y);
+
+	private:
+		struct Chunk
+		{
+			Chunk() :
+				dirty(true)
+			{
+			}
+
+			/** The composited tiles, or none if they are all empty. */
+			shared_ptr<Surface> surface;
+			bool dirty;
+		};
+
+		/**
+		 * Composites a chunk of a layer from the atlas.
+		 */
+		void build(int layer, int chunk_column, int chunk_row);
+
+		/**
+		 * @return The index of a cell in cells.
+		 *
+		 * @throw runtime_error If there is no such cell.
+		 */
+		size_t cell(int layer, int column, int row) const;
+
+		Surface atlas;
+		int atlas_columns;
+		int tile_count;
+		int tile_width;
+		int tile_height;
+		int column_count;
+		int row_count;
+		int layer_count;
+		int chunk_size;
+		int chunk_columns;
+		int chunk_rows;
+
+		/** The tiles of every layer, row by row. */
+		vector<int> cells;
+
+		/** Whether each layer is static. */
+		vector<bool> statics;
+
+		/** The chunks of every layer, row by row. */
+		vector<Chunk> chunks;
+	};
+}
+
+#endif /* SDLPP_TILE_MAP_HPP_INCLUDED */
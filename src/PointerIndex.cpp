@@ -0,0 +1,167 @@
+/* vim: set ts=4 sts=4 sw=4 tw=80: */
+#include <SDL++/PointerIndex.hpp>
+
+namespace
+{
+	inline Uint32 Key(int column, int row)
+	{
+		return static_cast<Uint32>(static_cast<Uint16>(column)) << 16
+			| static_cast<Uint16>(row);
+	}
+
+	inline bool Holds(const SDL_Rect& region, int x, int y)
+	{
+		return x >= region.x && x < region.x + region.w
+			&& y >= region.y && y < region.y + region.h;
+	}
+}
+
+namespace sdlpp
+{
+	PointerIndex::PointerIndex(int cellSize) :
+		m_cellSize(cellSize > 0 ? cellSize : 1),
+		m_serial(0)
+	{
+	}
+
+	void PointerIndex::addListener(PointerListener * const listener,
+			const SDL_Rect& region)
+	{
+		EntryMap::iterator i = m_entries.find(listener);
+		if (i == m_entries.end()) {
+			Entry entry = { listener, region, m_serial++ };
+			i = m_entries.insert(std::make_pair(listener, entry)).first;
+		}
+		else {
+			eraseEntry(i->second);
+			i->second.region = region;
+		}
+		insertEntry(i->second);
+	}
+
+	void PointerIndex::removeListener(PointerListener * const listener)
+	{
+		EntryMap::iterator i = m_entries.find(listener);
+		if (i != m_entries.end()) {
+			eraseEntry(i->second);
+			m_entries.erase(i);
+		}
+	}
+
+	bool PointerIndex::hasListener(PointerListener * const listener) const
+	{
+		return m_entries.find(listener) != m_entries.end();
+	}
+
+	void PointerIndex::listenersAt(int x, int y,
+			std::vector<PointerListener*>& listeners) const
+	{
+		listeners.clear();
+		CellMap::const_iterator i = m_cells.find(Key(cellOf(x), cellOf(y)));
+		if (i == m_cells.end()) {
+			return;
+		}
+
+		const Cell& cell = i->second;
+		for (Cell::const_iterator j = cell.begin(); j != cell.end(); ++j) {
+			if (Holds(j->region, x, y)) {
+				listeners.push_back(j->listener);
+			}
+		}
+	}
+
+	bool PointerIndex::dispatchEvent(SDL_Event& event)
+	{
+		int x, y;
+		switch (event.type) {
+			case SDL_MOUSEMOTION:
+				x = event.motion.x;
+				y = event.motion.y;
+				break;
+			case SDL_MOUSEBUTTONDOWN:
+			case SDL_MOUSEBUTTONUP:
+				x = event.button.x;
+				y = event.button.y;
+				break;
+			default:
+				return false;
+		}
+
+		/*
+		 * Take the kept vector so that a handler may dispatch an event of
+		 * its own, and skip the listeners a handler removed.
+		 */
+		std::vector<PointerListener*> hits;
+		hits.swap(m_hits);
+		listenersAt(x, y, hits);
+		for (size_t i = 0; i < hits.size(); i++) {
+			if (!hasListener(hits[i])) {
+				continue;
+			}
+			if (event.type == SDL_MOUSEMOTION) {
+				hits[i]->handleMouseMotion(event.motion);
+			}
+			else {
+				hits[i]->handleMouseButton(event.button);
+			}
+		}
+		hits.swap(m_hits);
+		return true;
+	}
+
+	int PointerIndex::cellOf(int coordinate) const
+	{
+		/* Round down, below 0 as well. */
+		return coordinate >= 0 ? coordinate / m_cellSize
+			: -((-coordinate - 1) / m_cellSize) - 1;
+	}
+
+	void PointerIndex::insertEntry(const Entry& entry)
+	{
+		const SDL_Rect& r = entry.region;
+		if (r.w == 0 || r.h == 0) {
+			return;
+		}
+		const int right = cellOf(r.x + r.w - 1);
+		const int bottom = cellOf(r.y + r.h - 1);
+		for (int row = cellOf(r.y); row <= bottom; row++) {
+			for (int column = cellOf(r.x); column <= right; column++) {
+				/* Keep cells in the order listeners were registered. */
+				Cell& cell = m_cells[Key(column, row)];
+				Cell::iterator at = cell.end();
+				while (at != cell.begin() && (at - 1)->serial > entry.serial) {
+					--at;
+				}
+				cell.insert(at, entry);
+			}
+		}
+	}
+
+	void PointerIndex::eraseEntry(const Entry& entry)
+	{
+		const SDL_Rect& r = entry.region;
+		if (r.w == 0 || r.h == 0) {
+			return;
+		}
+		const int right = cellOf(r.x + r.w - 1);
+		const int bottom = cellOf(r.y + r.h - 1);
+		for (int row = cellOf(r.y); row <= bottom; row++) {
+			for (int column = cellOf(r.x); column <= right; column++) {
+				CellMap::iterator i = m_cells.find(Key(column, row));
+				if (i == m_cells.end()) {
+					continue;
+				}
+				Cell& cell = i->second;
+				for (size_t j = 0; j < cell.size(); j++) {
+					if (cell[j].listener == entry.listener) {
+						cell.erase(cell.begin() + j);
+						break;
+					}
+				}
+				if (cell.empty()) {
+					m_cells.erase(i);
+				}
+			}
+		}
+	}
+}
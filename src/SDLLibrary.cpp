@@ -1,5 +1,9 @@
 /* vim: set ts=2 sts=2 sw=2 tw=80: */
 #include <SDL++/SDLLibrary.hpp>
+#include <algorithm>
+
+SDLLibrary::SDLLibrary() : m_hooks(), m_hooking(0), m_pointerIndex()
+{ }
 
 int SDLLibrary::WaitEvent()
 {
@@ -21,8 +25,74 @@ int SDLLibrary::PollEvent()
 	return rc;
 }
 
+void SDLLibrary::addEventHook(EventHook * const hook)
+{
+	removeEventHook(hook);
+	m_hooks.push_back(hook);
+}
+
+void SDLLibrary::removeEventHook(EventHook * const hook)
+{
+	HookIterator i = std::find(m_hooks.begin(), m_hooks.end(), hook);
+	if (i == m_hooks.end()) {
+		return;
+	}
+	/* hookEvent() is walking the hooks: leave a hole for it to skip. */
+	if (m_hooking > 0) {
+		*i = 0;
+	}
+	else {
+		m_hooks.erase(i);
+	}
+}
+
+void SDLLibrary::addPointerListener(PointerListener * const listener,
+		const SDL_Rect& region)
+{
+	m_pointerIndex.addListener(listener, region);
+}
+
+void SDLLibrary::removePointerListener(PointerListener * const listener)
+{
+	m_pointerIndex.removeListener(listener);
+}
+
+bool SDLLibrary::hookEvent(SDL_Event& event)
+{
+	/*
+	 * A hook may remove itself (or others) while it handles the event,
+	 * which only clears their entries until we are done. Hooks added
+	 * meanwhile see the next event.
+	 */
+	const HookList::size_type count = m_hooks.size();
+	bool consumed = false;
+	++m_hooking;
+	try {
+		for (HookList::size_type i = 0 ; i < count && !consumed ; ++i) {
+			consumed = m_hooks[i] != 0 && m_hooks[i]->hookEvent(event);
+		}
+	}
+	catch (...) {
+		doneHooking();
+		throw;
+	}
+	doneHooking();
+	return consumed;
+}
+
+void SDLLibrary::doneHooking()
+{
+	if (--m_hooking == 0) {
+		m_hooks.erase(std::remove(m_hooks.begin(), m_hooks.end(),
+					static_cast<EventHook*>(0)), m_hooks.end());
+	}
+}
+
 void SDLLibrary::dispatchEvent(SDL_Event& event)
 {
+	if (hookEvent(event)) {
+		return;
+	}
 	switch (event.type) {
 		case SDL_ACTIVEEVENT:
 			EventDispatcher<SDL_ActiveEvent*>::distributeLibraryEvent(&event);
@@ -32,10 +102,12 @@ void SDLLibrary::dispatchEvent(SDL_Event& event)
 			EventDispatcher<SDL_KeyboardEvent*>::distributeLibraryEvent(&event);
 			break;
 		case SDL_MOUSEMOTION:
+			m_pointerIndex.dispatchEvent(event);
 			EventDispatcher<SDL_MouseMotionEvent*>::distributeLibraryEvent(&event);
 			break;
 		case SDL_MOUSEBUTTONDOWN:
 		case SDL_MOUSEBUTTONUP:
+			m_pointerIndex.dispatchEvent(event);
 			EventDispatcher<SDL_MouseButtonEvent*>::distributeLibraryEvent(&event);
 			break;
 		case SDL_JOYAXISMOTION:
@@ -0,0 +1,129 @@
+/* vim: set ts=4 sts=4 sw=4 tw=80: */
+#include <SDL++/adaptive_mutex.hpp>
+#include "sync.hpp"
+
+namespace
+{
+	/**
+	 * We never spin longer than this, no matter how well spinning did
+	 * recently. A pause takes between 10 and 150 cycles depending on the CPU,
+	 * so this is in the order of a few microseconds.
+	 */
+	const int MAX_SPINS = 1000;
+
+	/**
+	 * We always spin at least this long, so that the average can recover
+	 * after a phase of long critical sections.
+	 */
+	const int MIN_SPINS = 10;
+
+	sdlpp::Adaptive_mutex_state* CreateState(bool statistics)
+	{
+		sdlpp::Adaptive_mutex_state* s = new sdlpp::Adaptive_mutex_state;
+		s->word = 0;
+		s->spin_average = MIN_SPINS;
+		s->statistics = statistics;
+		s->acquisitions = 0;
+		s->contended = 0;
+		s->wait_ns = 0;
+		return s;
+	}
+}
+
+namespace sdlpp
+{
+	Adaptive_mutex::Adaptive_mutex(bool statistics) :
+		shared_ptr_base<Adaptive_mutex_state>(CreateState(statistics))
+	{
+	}
+
+	Adaptive_mutex::Adaptive_mutex(const Adaptive_mutex& that) :
+		shared_ptr_base<Adaptive_mutex_state>(that)
+	{
+	}
+
+	Adaptive_mutex::Statistics Adaptive_mutex::statistics() const
+	{
+		Statistics stats;
+		stats.acquisitions = __atomic_load_n(&p->acquisitions, __ATOMIC_RELAXED);
+		stats.contended = __atomic_load_n(&p->contended, __ATOMIC_RELAXED);
+		stats.wait_ns = __atomic_load_n(&p->wait_ns, __ATOMIC_RELAXED);
+		return stats;
+	}
+
+	void Adaptive_mutex::reset_statistics()
+	{
+		lock();
+		__atomic_store_n(&p->acquisitions, 0, __ATOMIC_RELAXED);
+		__atomic_store_n(&p->contended, 0, __ATOMIC_RELAXED);
+		__atomic_store_n(&p->wait_ns, 0, __ATOMIC_RELAXED);
+		unlock();
+	}
+
+	void Adaptive_mutex::lock_contended()
+	{
+		Adaptive_mutex_state* s = p.get();
+		Uint64 start = s->statistics ? sync::now_ns() : 0;
+
+		/*
+		 * Spin up to twice the recent average. Only try the atomic exchange
+		 * when the lock looks free, so we don't bounce the cache line.
+		 */
+		int limit = __atomic_load_n(&s->spin_average, __ATOMIC_RELAXED) * 2;
+		if (limit > MAX_SPINS) {
+			limit = MAX_SPINS;
+		}
+		bool acquired = false;
+		int spins = 0;
+		for (; spins < limit; spins++) {
+			sync::cpu_relax();
+			if (__atomic_load_n(&s->word, __ATOMIC_RELAXED) == 0) {
+				int expected = 0;
+				if (__atomic_compare_exchange_n(&s->word, &expected, 1, false,
+							__ATOMIC_ACQUIRE, __ATOMIC_RELAXED)) {
+					acquired = true;
+					break;
+				}
+			}
+		}
+
+		/*
+		 * Move the average an eighth towards what we needed this time. A
+		 * lock we failed to get by spinning pulls the average up, so the
+		 * next attempt spins longer until we hit MAX_SPINS; glibc's adaptive
+		 * mutexes do the same.
+		 */
+		int average = __atomic_load_n(&s->spin_average, __ATOMIC_RELAXED);
+		average += (spins - average) / 8;
+		if (average < MIN_SPINS) {
+			average = MIN_SPINS;
+		}
+		__atomic_store_n(&s->spin_average, average, __ATOMIC_RELAXED);
+
+		if (!acquired) {
+			/*
+			 * Mark the lock as contended and sleep until the owner wakes us.
+			 * We can't know whether other waiters remain once we get the
+			 * lock, so we keep it marked as contended.
+			 */
+			int c = __atomic_exchange_n(&s->word, 2, __ATOMIC_ACQUIRE);
+			while (c != 0) {
+				sync::futex_wait(&s->word, 2);
+				c = __atomic_exchange_n(&s->word, 2, __ATOMIC_ACQUIRE);
+			}
+		}
+
+		/* We hold the lock now, so plain increments are safe. */
+		if (s->statistics) {
+			__atomic_store_n(&s->contended, s->contended + 1,
+					__ATOMIC_RELAXED);
+			__atomic_store_n(&s->wait_ns, s->wait_ns + (sync::now_ns() - start),
+					__ATOMIC_RELAXED);
+		}
+	}
+
+	void Adaptive_mutex::wake()
+	{
+		sync::futex_wake(&p->word, 1);
+	}
+}
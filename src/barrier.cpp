@@ -0,0 +1,72 @@
+/* vim: set ts=4 sts=4 sw=4 tw=80: */
+#include <SDL++/barrier.hpp>
+#include "sync.hpp"
+
+namespace
+{
+	/**
+	 * How often we re-check the generation before we go to sleep. Frame
+	 * stages are usually well balanced, so the last thread often arrives
+	 * while the others are still spinning.
+	 */
+	const int SPINS = 200;
+
+	sdlpp::Barrier_state* CreateState(unsigned count)
+	{
+		if (count == 0) {
+			throw std::runtime_error("A barrier needs at least one thread");
+		}
+		sdlpp::Barrier_state* s = new sdlpp::Barrier_state;
+		s->count = count;
+		s->remaining = count;
+		s->generation = 0;
+		return s;
+	}
+}
+
+namespace sdlpp
+{
+	Barrier::Barrier(unsigned count) :
+		shared_ptr_base<Barrier_state>(CreateState(count))
+	{
+	}
+
+	Barrier::Barrier(const Barrier& that) :
+		shared_ptr_base<Barrier_state>(that)
+	{
+	}
+
+	bool Barrier::wait()
+	{
+		Barrier_state* s = p.get();
+
+		/*
+		 * The generation can't change before we have arrived, so this is the
+		 * phase we take part in.
+		 */
+		int generation = __atomic_load_n(&s->generation, __ATOMIC_ACQUIRE);
+
+		if (__atomic_sub_fetch(&s->remaining, 1, __ATOMIC_ACQ_REL) == 0) {
+			/*
+			 * Re-arm the barrier before we open it, so threads that race
+			 * ahead into the next phase count against the new one.
+			 */
+			__atomic_store_n(&s->remaining, s->count, __ATOMIC_RELAXED);
+			__atomic_add_fetch(&s->generation, 1, __ATOMIC_RELEASE);
+			sync::futex_wake_all(&s->generation);
+			return true;
+		}
+
+		for (int spins = 0;
+				__atomic_load_n(&s->generation, __ATOMIC_ACQUIRE) == generation;
+				spins++) {
+			if (spins < SPINS) {
+				sync::cpu_relax();
+			}
+			else {
+				sync::futex_wait(&s->generation, generation);
+			}
+		}
+		return false;
+	}
+}
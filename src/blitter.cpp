@@ -0,0 +1,431 @@
+/* vim: set ts=4 sts=4 sw=4 tw=80: */
+#include <SDL++/blitter.hpp>
+#include "sync.hpp"
+#include <algorithm>
+
+namespace
+{
+	using namespace sdlpp;
+
+	/**
+	 * The formats we have loops for, in the order of the table below.
+	 */
+	enum Format
+	{
+		RGB565,
+		RGB888,
+		XRGB8888,
+		ARGB8888,
+		ABGR8888,
+		FORMATS,
+		UNKNOWN = FORMATS
+	};
+
+	Format Find_format(const SDL_PixelFormat& fmt)
+	{
+		switch (fmt.BytesPerPixel) {
+		case 2:
+			return Is_format<Rgb565>(fmt) ? RGB565 : UNKNOWN;
+		case 3:
+			return Is_format<Rgb888>(fmt) ? RGB888 : UNKNOWN;
+		case 4:
+			if (Is_format<Xrgb8888>(fmt)) {
+				return XRGB8888;
+			}
+			if (Is_format<Argb8888>(fmt)) {
+				return ARGB8888;
+			}
+			if (Is_format<Abgr8888>(fmt)) {
+				return ABGR8888;
+			}
+			return UNKNOWN;
+		default:
+			return UNKNOWN;
+		}
+	}
+
+#define SDLPP_BLIT_ROW(Src) \
+	{ \
+		Convert_rect<Src, Rgb565>, \
+		Convert_rect<Src, Rgb888>, \
+		Convert_rect<Src, Xrgb8888>, \
+		Convert_rect<Src, Argb8888>, \
+		Convert_rect<Src, Abgr8888> \
+	}
+
+	/**
+	 * The loops, indexed by source and destination format. Pairs of the same
+	 * format are replaced by plain copies below.
+	 */
+	const Blit_loop Loops[FORMATS][FORMATS] = {
+		SDLPP_BLIT_ROW(Rgb565),
+		SDLPP_BLIT_ROW(Rgb888),
+		SDLPP_BLIT_ROW(Xrgb8888),
+		SDLPP_BLIT_ROW(Argb8888),
+		SDLPP_BLIT_ROW(Abgr8888)
+	};
+
+#undef SDLPP_BLIT_ROW
+
+	const Blit_loop Copies[FORMATS] = {
+		Copy_rect<Rgb565>,
+		Copy_rect<Rgb888>,
+		Copy_rect<Xrgb8888>,
+		Copy_rect<Argb8888>,
+		Copy_rect<Abgr8888>
+	};
+
+	/**
+	 * Whether calibrate() found the loop for a pair faster than
+	 * SDL_BlitSurface. Until it runs, none is.
+	 */
+	bool Faster[FORMATS][FORMATS];
+
+	/**
+	 * Picks the loop for a pair of formats, or 0 for SDL_BlitSurface.
+	 */
+	Blit_loop Pick(const SDL_PixelFormat& src, const SDL_PixelFormat& dst,
+			Blitter::Policy policy)
+	{
+		Format s = Find_format(src);
+		Format d = Find_format(dst);
+		if (s == UNKNOWN || d == UNKNOWN
+				|| (policy == Blitter::WHEN_FASTER && !Faster[s][d])) {
+			return 0;
+		}
+		return s == d ? Copies[s] : Loops[s][d];
+	}
+
+	/**
+	 * The surfaces calibrate() times blits between, in the order of Format.
+	 */
+	struct Layout
+	{
+		int depth;
+		Uint32 rmask, gmask, bmask, amask;
+	};
+
+#define SDLPP_LAYOUT(Traits) \
+	{ Traits::BYTES * 8, Traits::RMASK, Traits::GMASK, Traits::BMASK, \
+		Traits::AMASK }
+
+	const Layout Layouts[FORMATS] = {
+		SDLPP_LAYOUT(Rgb565),
+		SDLPP_LAYOUT(Rgb888),
+		SDLPP_LAYOUT(Xrgb8888),
+		SDLPP_LAYOUT(Argb8888),
+		SDLPP_LAYOUT(Abgr8888)
+	};
+
+#undef SDLPP_LAYOUT
+
+	const int CALIBRATION_SIZE = 128;
+	const int CALIBRATION_BLITS = 8;
+	const int CALIBRATION_TRIALS = 3;
+
+	SDL_Surface* Create_layout(const Layout& layout)
+	{
+		SDL_Surface* surface = SDL_CreateRGBSurface(SDL_SWSURFACE,
+				CALIBRATION_SIZE, CALIBRATION_SIZE, layout.depth,
+				layout.rmask, layout.gmask, layout.bmask, layout.amask);
+		if (surface == 0) {
+			return 0;
+		}
+		/* Time plain conversions, as Surface::blit() would do them. */
+		SDL_SetAlpha(surface, 0, SDL_ALPHA_OPAQUE);
+		Uint8* pixels = static_cast<Uint8*>(surface->pixels);
+		for (int i = 0; i < surface->h * surface->pitch; i++) {
+			pixels[i] = i * 7;
+		}
+		return surface;
+	}
+
+	/**
+	 * @return The shortest of a few trials of blitting src to dst, with
+	 * the loop or with SDL_BlitSurface. The first trial also warms up SDL's
+	 * blit mapping.
+	 */
+	Uint64 Time_blits(SDL_Surface* src, SDL_Surface* dst, bool loop)
+	{
+		Uint64 best = ~static_cast<Uint64>(0);
+		for (int t = 0; t < CALIBRATION_TRIALS; t++) {
+			Uint64 start = sync::now_ns();
+			for (int i = 0; i < CALIBRATION_BLITS; i++) {
+				if (loop) {
+					Blitter::blit(src, 0, dst, 0, Blitter::ALWAYS);
+				}
+				else {
+					SDL_BlitSurface(src, 0, dst, 0);
+				}
+			}
+			best = std::min(best, sync::now_ns() - start);
+		}
+		return best;
+	}
+
+	/**
+	 * @return Whether SDL would do a plain copy or conversion for this blit,
+	 * as opposed to keying, blending or a hardware blit.
+	 */
+	bool Plain(SDL_Surface* src, SDL_Surface* dst)
+	{
+		return src != dst
+			&& (src->flags & (SDL_SRCCOLORKEY | SDL_SRCALPHA | SDL_RLEACCEL
+					| SDL_HWSURFACE)) == 0
+			&& (dst->flags & SDL_HWSURFACE) == 0
+			&& !src->locked && !dst->locked;
+	}
+}
+
+namespace sdlpp
+{
+	Blit_loop Blitter::find(const SDL_PixelFormat& src,
+			const SDL_PixelFormat& dst)
+	{
+		return Pick(src, dst, ALWAYS);
+	}
+
+	void Blitter::calibrate()
+	{
+		SDL_Surface* sources[FORMATS];
+		SDL_Surface* targets[FORMATS];
+		for (int f = 0; f < FORMATS; f++) {
+			sources[f] = Create_layout(Layouts[f]);
+			targets[f] = Create_layout(Layouts[f]);
+		}
+
+		for (int s = 0; s < FORMATS; s++) {
+			for (int d = 0; d < FORMATS; d++) {
+				Faster[s][d] = false;
+				if (sources[s] == 0 || targets[d] == 0
+						|| Pick(*sources[s]->format, *targets[d]->format,
+							ALWAYS) == 0) {
+					continue;
+				}
+				Uint64 theirs = Time_blits(sources[s], targets[d], false);
+				Uint64 ours = Time_blits(sources[s], targets[d], true);
+				Faster[s][d] = ours * 10 <= theirs * 9;
+			}
+		}
+
+		for (int f = 0; f < FORMATS; f++) {
+			SDL_FreeSurface(sources[f]);
+			SDL_FreeSurface(targets[f]);
+		}
+	}
+
+	bool Blitter::faster(const SDL_PixelFormat& src,
+			const SDL_PixelFormat& dst)
+	{
+		Format s = Find_format(src);
+		Format d = Find_format(dst);
+		return s != UNKNOWN && d != UNKNOWN && Faster[s][d];
+	}
+
+	int Blitter::blit(SDL_Surface* src, SDL_Rect* src_rect,
+			SDL_Surface* dst, SDL_Rect* dst_rect, Policy policy)
+	{
+		if (src == 0 || dst == 0 || !Plain(src, dst)) {
+			return SDL_BlitSurface(src, src_rect, dst, dst_rect);
+		}
+		Blit_loop loop = Pick(*src->format, *dst->format, policy);
+		if (loop == 0) {
+			return SDL_BlitSurface(src, src_rect, dst, dst_rect);
+		}
+
+		/* What follows is SDL_UpperBlit's clipping. */
+		SDL_Rect full_dst;
+		if (dst_rect == 0) {
+			full_dst.x = full_dst.y = 0;
+			dst_rect = &full_dst;
+		}
+
+		int src_x, src_y, w, h;
+		if (src_rect != 0) {
+			src_x = src_rect->x;
+			w = src_rect->w;
+			if (src_x < 0) {
+				w += src_x;
+				dst_rect->x -= src_x;
+				src_x = 0;
+			}
+			if (src->w - src_x < w) {
+				w = src->w - src_x;
+			}
+
+			src_y = src_rect->y;
+			h = src_rect->h;
+			if (src_y < 0) {
+				h += src_y;
+				dst_rect->y -= src_y;
+				src_y = 0;
+			}
+			if (src->h - src_y < h) {
+				h = src->h - src_y;
+			}
+		}
+		else {
+			src_x = src_y = 0;
+			w = src->w;
+			h = src->h;
+		}
+
+		const SDL_Rect& clip = dst->clip_rect;
+		int dx = clip.x - dst_rect->x;
+		if (dx > 0) {
+			w -= dx;
+			dst_rect->x += dx;
+			src_x += dx;
+		}
+		dx = dst_rect->x + w - clip.x - clip.w;
+		if (dx > 0) {
+			w -= dx;
+		}
+		int dy = clip.y - dst_rect->y;
+		if (dy > 0) {
+			h -= dy;
+			dst_rect->y += dy;
+			src_y += dy;
+		}
+		dy = dst_rect->y + h - clip.y - clip.h;
+		if (dy > 0) {
+			h -= dy;
+		}
+
+		if (w <= 0 || h <= 0) {
+			dst_rect->w = dst_rect->h = 0;
+			return 0;
+		}
+		dst_rect->w = w;
+		dst_rect->h = h;
+
+		/* And what follows is SDL_SoftBlit's locking. */
+		if (SDL_MUSTLOCK(dst) && SDL_LockSurface(dst) < 0) {
+			return -1;
+		}
+		if (SDL_MUSTLOCK(src) && SDL_LockSurface(src) < 0) {
+			if (SDL_MUSTLOCK(dst)) {
+				SDL_UnlockSurface(dst);
+			}
+			return -1;
+		}
+
+		const Uint8* s = static_cast<const Uint8*>(src->pixels)
+			+ src_y * src->pitch + src_x * src->format->BytesPerPixel;
+		Uint8* d = static_cast<Uint8*>(dst->pixels)
+			+ dst_rect->y * dst->pitch
+			+ dst_rect->x * dst->format->BytesPerPixel;
+		loop(s, src->pitch, d, dst->pitch, w, h, src->format->alpha);
+
+		if (SDL_MUSTLOCK(src)) {
+			SDL_UnlockSurface(src);
+		}
+		if (SDL_MUSTLOCK(dst)) {
+			SDL_UnlockSurface(dst);
+		}
+		return 0;
+	}
+
+	int Blitter::blit(SDL_Surface* src, SDL_Rect* src_rect,
+			SDL_Surface* dst, SDL_Rect* dst_rect, const Region& clip,
+			Policy policy)
+	{
+		if (src == 0 || dst == 0) {
+			return SDL_BlitSurface(src, src_rect, dst, dst_rect);
+		}
+
+		SDL_Rect full_dst;
+		if (dst_rect == 0) {
+			full_dst.x = full_dst.y = 0;
+			dst_rect = &full_dst;
+		}
+
+		/* Clip to the source as SDL_UpperBlit does... */
+		int src_x = 0;
+		int src_y = 0;
+		int w = src->w;
+		int h = src->h;
+		int dst_x = dst_rect->x;
+		int dst_y = dst_rect->y;
+		if (src_rect != 0) {
+			src_x = src_rect->x;
+			w = src_rect->w;
+			if (src_x < 0) {
+				w += src_x;
+				dst_x -= src_x;
+				src_x = 0;
+			}
+			if (src->w - src_x < w) {
+				w = src->w - src_x;
+			}
+			src_y = src_rect->y;
+			h = src_rect->h;
+			if (src_y < 0) {
+				h += src_y;
+				dst_y -= src_y;
+				src_y = 0;
+			}
+			if (src->h - src_y < h) {
+				h = src->h - src_y;
+			}
+		}
+
+		/* ...then to the clip rectangle and the region. */
+		Region area(Rect(dst_x, dst_y, w > 0 ? w : 0, h > 0 ? h : 0));
+		area.intersect(Region(dst->clip_rect)).intersect(clip);
+		Rect drawn = area.bounds();
+		dst_rect->x = drawn.x;
+		dst_rect->y = drawn.y;
+		dst_rect->w = drawn.w;
+		dst_rect->h = drawn.h;
+		if (area.empty()) {
+			return 0;
+		}
+
+		Blit_loop loop = Plain(src, dst)
+			? Pick(*src->format, *dst->format, policy) : 0;
+		if (loop == 0) {
+			int result = 0;
+			for (size_t i = 0; i < area.size(); i++) {
+				Rect to = area[i];
+				Rect from(to.x - dst_x + src_x, to.y - dst_y + src_y, to.w,
+						to.h);
+				if (SDL_BlitSurface(src, &from, dst, &to) < 0) {
+					result = -1;
+				}
+			}
+			return result;
+		}
+
+		if (SDL_MUSTLOCK(dst) && SDL_LockSurface(dst) < 0) {
+			return -1;
+		}
+		if (SDL_MUSTLOCK(src) && SDL_LockSurface(src) < 0) {
+			if (SDL_MUSTLOCK(dst)) {
+				SDL_UnlockSurface(dst);
+			}
+			return -1;
+		}
+
+		const int src_bpp = src->format->BytesPerPixel;
+		const int dst_bpp = dst->format->BytesPerPixel;
+		for (size_t i = 0; i < area.size(); i++) {
+			Rect to = area[i];
+			const Uint8* s = static_cast<const Uint8*>(src->pixels)
+				+ (to.y - dst_y + src_y) * src->pitch
+				+ (to.x - dst_x + src_x) * src_bpp;
+			Uint8* d = static_cast<Uint8*>(dst->pixels) + to.y * dst->pitch
+				+ to.x * dst_bpp;
+			loop(s, src->pitch, d, dst->pitch, to.w, to.h,
+					src->format->alpha);
+		}
+
+		if (SDL_MUSTLOCK(src)) {
+			SDL_UnlockSurface(src);
+		}
+		if (SDL_MUSTLOCK(dst)) {
+			SDL_UnlockSurface(dst);
+		}
+		return 0;
+	}
+}
@@ -0,0 +1,357 @@
+/* vim: set ts=4 sts=4 sw=4 tw=80: */
+#include <SDL++/color_correction.hpp>
+#include <SDL++/pixel_format.hpp>
+#include "parallel.hpp"
+#include <cmath>
+
+#if defined(__x86_64__) || (defined(__i386__) && defined(__SSE2__))
+#define SDLPP_HAVE_SSE2 1
+#include <emmintrin.h>
+#endif
+
+namespace
+{
+	using namespace sdlpp;
+
+	/**
+	 * How many pixels we convert to RGBA and back at a time.
+	 */
+	const size_t CHUNK = 256;
+
+	const int FIXED_BITS = 12;
+	const float ONE = 1 << FIXED_BITS;
+
+	/**
+	 * The luma weights of ITU-R BT.601, which saturation and tint keep.
+	 */
+	const float LUMA[3] = { 0.299f, 0.587f, 0.114f };
+
+	/**
+	 * Multiplies two 3x4 affine color matrices: result = a * b.
+	 */
+	void Multiply(const float a[3][4], const float b[3][4],
+			float result[3][4])
+	{
+		for (int i = 0; i < 3; i++) {
+			for (int j = 0; j < 4; j++) {
+				result[i][j] = a[i][0] * b[0][j] + a[i][1] * b[1][j]
+					+ a[i][2] * b[2][j] + (j == 3 ? a[i][3] : 0);
+			}
+		}
+	}
+
+	inline Uint8 Clamp(int x)
+	{
+		return x < 0 ? 0 : x > 255 ? 255 : x;
+	}
+
+	void Matrix_scalar(const Sint16 m[3][4], Uint8* rgba, size_t n)
+	{
+		for (size_t i = 0; i < n; i++, rgba += 4) {
+			int r = rgba[0], g = rgba[1], b = rgba[2];
+			for (int c = 0; c < 3; c++) {
+				int x = m[c][0] * r + m[c][1] * g + m[c][2] * b
+					+ m[c][3] * 256;
+				rgba[c] = Clamp(x >> FIXED_BITS);
+			}
+		}
+	}
+
+#ifdef SDLPP_HAVE_SSE2
+	/**
+	 * Computes one output channel of four pixels, given as 16-bit lanes
+	 * r, g, b, 256 for two pixels in each of lo and hi.
+	 */
+	inline __m128i Channel_sse2(__m128i lo, __m128i hi, __m128i m)
+	{
+		/* madd leaves m0 r + m1 g and m2 b + m3 256 for each pixel. */
+		lo = _mm_madd_epi16(lo, m);
+		hi = _mm_madd_epi16(hi, m);
+		lo = _mm_add_epi32(lo, _mm_srli_epi64(lo, 32));
+		hi = _mm_add_epi32(hi, _mm_srli_epi64(hi, 32));
+		lo = _mm_shuffle_epi32(lo, _MM_SHUFFLE(3, 1, 2, 0));
+		hi = _mm_shuffle_epi32(hi, _MM_SHUFFLE(3, 1, 2, 0));
+		return _mm_srai_epi32(_mm_unpacklo_epi64(lo, hi), FIXED_BITS);
+	}
+
+	void Matrix_sse2(const Sint16 m[3][4], Uint8* rgba, size_t n)
+	{
+		const __m128i zero = _mm_setzero_si128();
+		const __m128i rgb = _mm_set_epi16(0, -1, -1, -1, 0, -1, -1, -1);
+		const __m128i one = _mm_set_epi16(256, 0, 0, 0, 256, 0, 0, 0);
+		__m128i mr = _mm_set_epi16(m[0][3], m[0][2], m[0][1], m[0][0],
+				m[0][3], m[0][2], m[0][1], m[0][0]);
+		__m128i mg = _mm_set_epi16(m[1][3], m[1][2], m[1][1], m[1][0],
+				m[1][3], m[1][2], m[1][1], m[1][0]);
+		__m128i mb = _mm_set_epi16(m[2][3], m[2][2], m[2][1], m[2][0],
+				m[2][3], m[2][2], m[2][1], m[2][0]);
+
+		size_t i = 0;
+		for (; i + 4 <= n; i += 4, rgba += 16) {
+			__m128i v = _mm_loadu_si128(reinterpret_cast<__m128i*>(rgba));
+			__m128i lo = _mm_unpacklo_epi8(v, zero);
+			__m128i hi = _mm_unpackhi_epi8(v, zero);
+			__m128i a = _mm_srli_epi32(v, 24);
+			lo = _mm_or_si128(_mm_and_si128(lo, rgb), one);
+			hi = _mm_or_si128(_mm_and_si128(hi, rgb), one);
+
+			__m128i r = Channel_sse2(lo, hi, mr);
+			__m128i g = Channel_sse2(lo, hi, mg);
+			__m128i b = Channel_sse2(lo, hi, mb);
+
+			/*
+			 * Saturate to bytes as R0-3 B0-3 G0-3 A0-3, then interleave
+			 * twice to get R G B A per pixel.
+			 */
+			__m128i x = _mm_packus_epi16(_mm_packs_epi32(r, b),
+					_mm_packs_epi32(g, a));
+			x = _mm_unpacklo_epi8(x, _mm_unpackhi_epi64(x, x));
+			x = _mm_unpacklo_epi16(x, _mm_unpackhi_epi64(x, x));
+			_mm_storeu_si128(reinterpret_cast<__m128i*>(rgba), x);
+		}
+		Matrix_scalar(m, rgba, n - i);
+	}
+#endif /* SDLPP_HAVE_SSE2 */
+
+	/**
+	 * What the worker threads need to correct a rectangle.
+	 */
+	struct Job
+	{
+		const Color_correction* correction;
+		Pixel_format* format;
+		Uint8* pixels;
+		int pitch;
+		int x;
+		int y;
+		int w;
+	};
+
+	void Correct_rows(void* context, int begin, int end)
+	{
+		const Job& job = *static_cast<Job*>(context);
+		Uint8 rgba[4 * CHUNK];
+		int bpp = job.format->BytesPerPixel;
+		for (int y = begin; y < end; y++) {
+			Uint8* row = job.pixels + (job.y + y) * job.pitch + job.x * bpp;
+			for (int x = 0; x < job.w; x += CHUNK) {
+				size_t n = job.w - x < static_cast<int>(CHUNK)
+					? job.w - x : CHUNK;
+				job.format->get(row + x * bpp, rgba, n);
+				job.correction->apply(rgba, n);
+				job.format->map(rgba, row + x * bpp, n);
+			}
+		}
+	}
+}
+
+namespace sdlpp
+{
+	Color_correction::Color_correction()
+	{
+		reset();
+	}
+
+	void Color_correction::set_gamma(float red, float green, float blue)
+	{
+		float gamma[3] = { red, green, blue };
+		for (int c = 0; c < 3; c++) {
+			/* Like SDL_CalculateGammaRamp. */
+			if (gamma[c] <= 0.0f) {
+				for (int i = 0; i < 256; i++) {
+					tables[c][i] = 0;
+				}
+				continue;
+			}
+			float exponent = 1.0f / gamma[c];
+			for (int i = 0; i < 256; i++) {
+				float v = std::pow(i / 255.0f, exponent) * 255.0f + 0.5f;
+				tables[c][i] = v > 255.0f ? 255 : static_cast<Uint8>(v);
+			}
+		}
+		check_tables();
+	}
+
+	void Color_correction::set_gamma_ramp(const Uint16* red,
+			const Uint16* green, const Uint16* blue)
+	{
+		const Uint16* ramps[3] = { red, green, blue };
+		for (int c = 0; c < 3; c++) {
+			if (ramps[c] == 0) {
+				continue;
+			}
+			for (int i = 0; i < 256; i++) {
+				tables[c][i] = ramps[c][i] >> 8;
+			}
+		}
+		check_tables();
+	}
+
+	void Color_correction::set_matrix(const float m[3][4])
+	{
+		identity_matrix = true;
+		for (int i = 0; i < 3; i++) {
+			for (int j = 0; j < 3; j++) {
+				matrix[i][j] = static_cast<Sint16>(
+						std::floor(m[i][j] * ONE + 0.5f));
+				if (matrix[i][j] != (i == j ? ONE : 0)) {
+					identity_matrix = false;
+				}
+			}
+			/* Rounding is folded into the offset: 8 * 256 is half of ONE. */
+			matrix[i][3] = static_cast<Sint16>(
+					std::floor(m[i][3] * ONE / 256 + 0.5f)) + 8;
+			if (matrix[i][3] != 8) {
+				identity_matrix = false;
+			}
+		}
+	}
+
+	void Color_correction::set_adjustments(float brightness, float contrast,
+			float saturation, float tint)
+	{
+		float s[3][4];
+		for (int i = 0; i < 3; i++) {
+			for (int j = 0; j < 3; j++) {
+				s[i][j] = (1 - saturation) * LUMA[j]
+					+ (i == j ? saturation : 0);
+			}
+			s[i][3] = 0;
+		}
+
+		/* The usual hue rotation about the gray axis. */
+		float a = tint * 3.14159265f / 180;
+		float cs = std::cos(a);
+		float sn = std::sin(a);
+		float h[3][4] = {
+			{ 0.213f + cs * 0.787f - sn * 0.213f,
+				0.715f - cs * 0.715f - sn * 0.715f,
+				0.072f - cs * 0.072f + sn * 0.928f, 0 },
+			{ 0.213f - cs * 0.213f + sn * 0.143f,
+				0.715f + cs * 0.285f + sn * 0.140f,
+				0.072f - cs * 0.072f - sn * 0.283f, 0 },
+			{ 0.213f - cs * 0.213f - sn * 0.787f,
+				0.715f - cs * 0.715f + sn * 0.715f,
+				0.072f + cs * 0.928f + sn * 0.072f, 0 },
+		};
+
+		float offset = 128 * (1 - contrast) + brightness * 255;
+		float c[3][4] = {
+			{ contrast, 0, 0, offset },
+			{ 0, contrast, 0, offset },
+			{ 0, 0, contrast, offset },
+		};
+
+		float hs[3][4];
+		float m[3][4];
+		Multiply(h, s, hs);
+		Multiply(c, hs, m);
+		set_matrix(m);
+	}
+
+	void Color_correction::reset()
+	{
+		for (int c = 0; c < 3; c++) {
+			for (int i = 0; i < 256; i++) {
+				tables[c][i] = i;
+			}
+		}
+		identity_tables = true;
+
+		const float identity[3][4] = {
+			{ 1, 0, 0, 0 },
+			{ 0, 1, 0, 0 },
+			{ 0, 0, 1, 0 },
+		};
+		set_matrix(identity);
+	}
+
+	void Color_correction::apply(Surface& surface)
+	{
+		apply(surface, Rect(0, 0, surface.w(), surface.h()));
+	}
+
+	void Color_correction::apply(Surface& surface, const Rect& area)
+	{
+		apply(surface, vector<Rect>(1, area));
+	}
+
+	void Color_correction::apply(Surface& surface, const vector<Rect>& areas)
+	{
+		/* Correcting the palette again each frame would compound. */
+		if (surface.format()->palette != 0) {
+			throw runtime_error("Correct the colors of a palettized surface "
+					"rather than its pixels");
+		}
+		if (identity_matrix && identity_tables) {
+			return;
+		}
+
+		Pixel_format format(*surface.format());
+		Surface::Lock lock(surface);
+		for (vector<Rect>::const_iterator it = areas.begin();
+				it != areas.end(); ++it) {
+			int x0 = it->x < 0 ? 0 : it->x;
+			int y0 = it->y < 0 ? 0 : it->y;
+			int x1 = it->x + it->w > surface.w() ? surface.w() : it->x + it->w;
+			int y1 = it->y + it->h > surface.h() ? surface.h() : it->y + it->h;
+			if (x1 <= x0 || y1 <= y0) {
+				continue;
+			}
+			Job job = { this, &format, static_cast<Uint8*>(lock.pixels()),
+				surface.pitch(), x0, y0, x1 - x0 };
+			parallel::for_rows(y1 - y0, Correct_rows, &job);
+		}
+	}
+
+	vector<Color> Color_correction::apply(const vector<Color>& colors) const
+	{
+		vector<Uint8> rgba(4 * colors.size());
+		for (size_t i = 0; i < colors.size(); i++) {
+			rgba[4 * i] = colors[i].r;
+			rgba[4 * i + 1] = colors[i].g;
+			rgba[4 * i + 2] = colors[i].b;
+			rgba[4 * i + 3] = 255;
+		}
+		if (!rgba.empty()) {
+			apply(&rgba[0], colors.size());
+		}
+		vector<Color> corrected(colors.size());
+		for (size_t i = 0; i < colors.size(); i++) {
+			corrected[i].r = rgba[4 * i];
+			corrected[i].g = rgba[4 * i + 1];
+			corrected[i].b = rgba[4 * i + 2];
+		}
+		return corrected;
+	}
+
+	void Color_correction::apply(Uint8* rgba, size_t count) const
+	{
+		if (!identity_matrix) {
+#ifdef SDLPP_HAVE_SSE2
+			Matrix_sse2(matrix, rgba, count);
+#else
+			Matrix_scalar(matrix, rgba, count);
+#endif /* SDLPP_HAVE_SSE2 */
+		}
+		if (!identity_tables) {
+			for (size_t i = 0; i < count; i++, rgba += 4) {
+				rgba[0] = tables[0][rgba[0]];
+				rgba[1] = tables[1][rgba[1]];
+				rgba[2] = tables[2][rgba[2]];
+			}
+		}
+	}
+
+	void Color_correction::check_tables()
+	{
+		identity_tables = true;
+		for (int c = 0; c < 3; c++) {
+			for (int i = 0; i < 256; i++) {
+				if (tables[c][i] != i) {
+					identity_tables = false;
+				}
+			}
+		}
+	}
+}
@@ -0,0 +1,263 @@
+/* vim: set ts=4 sts=4 sw=4 tw=80: */
+#include <SDL++/compositor.hpp>
+#include <algorithm>
+
+namespace
+{
+	/**
+	 * Past this many damaged areas, they are merged into one around them
+	 * all, which is cheaper to compose than many slivers.
+	 */
+	const size_t MAX_DAMAGED = 64;
+}
+
+namespace sdlpp
+{
+	Compositor::Compositor(Surface& target) :
+		target(target),
+		background(0)
+	{
+		damage();
+	}
+
+	int Compositor::add_layer(Surface& surface, int x, int y)
+	{
+		Layer layer = { surface, x, y, true, vector<Box>() };
+		SDL_Surface* raw = surface.raw_ptr();
+		if ((raw->flags & (SDL_SRCCOLORKEY | SDL_SRCALPHA)) == 0) {
+			Box all = { 0, 0, raw->w, raw->h };
+			layer.opaque.push_back(all);
+		}
+		stack.push_back(layer);
+		add_damage(bounds(stack.back()), stack.size());
+		return stack.size() - 1;
+	}
+
+	int Compositor::layers() const
+	{
+		return stack.size();
+	}
+
+	void Compositor::set_opaque(int index, const vector<Rect>& areas)
+	{
+		Layer& layer = layer_at(index);
+		SDL_Surface* raw = layer.surface.raw_ptr();
+		const Box all = { 0, 0, raw->w, raw->h };
+		layer.opaque.clear();
+		for (size_t i = 0; i < areas.size(); i++) {
+			Box area = { areas[i].x, areas[i].y, areas[i].x + areas[i].w,
+				areas[i].y + areas[i].h };
+			if (intersect(area, all)) {
+				layer.opaque.push_back(area);
+			}
+		}
+		add_damage(bounds(layer), index + 1);
+	}
+
+	void Compositor::move(int index, int x, int y)
+	{
+		Layer& layer = layer_at(index);
+		if (layer.x == x && layer.y == y) {
+			return;
+		}
+		if (layer.visible) {
+			add_damage(bounds(layer), index + 1);
+		}
+		layer.x = x;
+		layer.y = y;
+		if (layer.visible) {
+			add_damage(bounds(layer), index + 1);
+		}
+	}
+
+	void Compositor::set_visible(int index, bool on)
+	{
+		Layer& layer = layer_at(index);
+		if (layer.visible != on) {
+			layer.visible = on;
+			add_damage(bounds(layer), index + 1);
+		}
+	}
+
+	void Compositor::set_background(Uint32 color)
+	{
+		background = color;
+		Box all = { 0, 0, target.w(), target.h() };
+		add_damage(all, 0);
+	}
+
+	void Compositor::damage(int index, const Rect& area)
+	{
+		Layer& layer = layer_at(index);
+		if (!layer.visible) {
+			return;
+		}
+		Box box = { layer.x + area.x, layer.y + area.y,
+			layer.x + area.x + area.w, layer.y + area.y + area.h };
+		if (intersect(box, bounds(layer))) {
+			add_damage(box, index + 1);
+		}
+	}
+
+	void Compositor::damage(const Rect& area)
+	{
+		Box box = { area.x, area.y, area.x + area.w, area.y + area.h };
+		add_damage(box, stack.size());
+	}
+
+	void Compositor::damage()
+	{
+		Box all = { 0, 0, target.w(), target.h() };
+		add_damage(all, stack.size());
+	}
+
+	bool Compositor::compose(vector<Rect>& updated)
+	{
+		updated.clear();
+		shown.resize(stack.size());
+		bool ok = true;
+		vector<Box> uncovered;
+		for (size_t d = 0; d < damaged.size(); d++) {
+			const Box& area = damaged[d];
+
+			/*
+			 * Go down the stack, noting which parts of the area each layer
+			 * shows, until opaque layers cover all of it.
+			 */
+			uncovered.assign(1, area);
+			for (size_t i = stack.size(); i-- > 0; ) {
+				shown[i].clear();
+				Layer& layer = stack[i];
+				if (!layer.visible || uncovered.empty()) {
+					continue;
+				}
+				const Box b = bounds(layer);
+				for (size_t j = 0; j < uncovered.size(); j++) {
+					Box piece = uncovered[j];
+					if (intersect(piece, b)) {
+						shown[i].push_back(piece);
+					}
+				}
+				for (size_t j = 0; j < layer.opaque.size(); j++) {
+					const Box& o = layer.opaque[j];
+					Box cut = { layer.x + o.x0, layer.y + o.y0,
+						layer.x + o.x1, layer.y + o.y1 };
+					subtract(uncovered, cut);
+				}
+			}
+
+			/* Then draw them back up. */
+			for (size_t j = 0; j < uncovered.size(); j++) {
+				const Box& u = uncovered[j];
+				Rect rect(u.x0, u.y0, u.x1 - u.x0, u.y1 - u.y0);
+				ok = target.fill(&rect, background) && ok;
+			}
+			for (size_t i = 0; i < stack.size(); i++) {
+				Layer& layer = stack[i];
+				for (size_t j = 0; j < shown[i].size(); j++) {
+					const Box& piece = shown[i][j];
+					Rect src_rect(piece.x0 - layer.x, piece.y0 - layer.y,
+							piece.x1 - piece.x0, piece.y1 - piece.y0);
+					Rect dst_rect(piece.x0, piece.y0);
+					ok = layer.surface.blit(src_rect, target, dst_rect) && ok;
+				}
+			}
+			updated.push_back(Rect(area.x0, area.y0, area.x1 - area.x0,
+						area.y1 - area.y0));
+		}
+		damaged.clear();
+		return ok;
+	}
+
+	bool Compositor::intersect(Box& a, const Box& b)
+	{
+		a.x0 = std::max(a.x0, b.x0);
+		a.y0 = std::max(a.y0, b.y0);
+		a.x1 = std::min(a.x1, b.x1);
+		a.y1 = std::min(a.y1, b.y1);
+		return a.x0 < a.x1 && a.y0 < a.y1;
+	}
+
+	void Compositor::subtract(vector<Box>& areas, const Box& cut)
+	{
+		size_t count = areas.size();
+		for (size_t i = 0; i < count; ) {
+			Box a = areas[i];
+			Box common = a;
+			if (!intersect(common, cut)) {
+				i++;
+				continue;
+			}
+
+			/* Keep what is above, below, left and right of the cut. */
+			areas[i] = areas[--count];
+			areas[count] = areas.back();
+			areas.pop_back();
+			Box pieces[4] = {
+				{ a.x0, a.y0, a.x1, common.y0 },
+				{ a.x0, common.y1, a.x1, a.y1 },
+				{ a.x0, common.y0, common.x0, common.y1 },
+				{ common.x1, common.y0, a.x1, common.y1 }
+			};
+			for (int k = 0; k < 4; k++) {
+				if (pieces[k].x0 < pieces[k].x1
+						&& pieces[k].y0 < pieces[k].y1) {
+					areas.push_back(pieces[k]);
+				}
+			}
+		}
+	}
+
+	Compositor::Layer& Compositor::layer_at(int layer)
+	{
+		if (layer < 0 || static_cast<size_t>(layer) >= stack.size()) {
+			throw runtime_error("The compositor has no such layer");
+		}
+		return stack[layer];
+	}
+
+	Compositor::Box Compositor::bounds(Layer& layer)
+	{
+		Box box = { layer.x, layer.y, layer.x + layer.surface.w(),
+			layer.y + layer.surface.h() };
+		return box;
+	}
+
+	void Compositor::add_damage(const Box& area, size_t first)
+	{
+		Box all = { 0, 0, target.w(), target.h() };
+		Box clipped = area;
+		if (!intersect(clipped, all)) {
+			return;
+		}
+
+		vector<Box> pieces(1, clipped);
+		for (size_t i = first; i < stack.size() && !pieces.empty(); i++) {
+			Layer& layer = stack[i];
+			if (!layer.visible) {
+				continue;
+			}
+			for (size_t j = 0; j < layer.opaque.size(); j++) {
+				const Box& o = layer.opaque[j];
+				Box cut = { layer.x + o.x0, layer.y + o.y0, layer.x + o.x1,
+					layer.y + o.y1 };
+				subtract(pieces, cut);
+			}
+		}
+		for (size_t i = 0; i < damaged.size() && !pieces.empty(); i++) {
+			subtract(pieces, damaged[i]);
+		}
+		damaged.insert(damaged.end(), pieces.begin(), pieces.end());
+
+		if (damaged.size() > MAX_DAMAGED) {
+			Box around = damaged[0];
+			for (size_t i = 1; i < damaged.size(); i++) {
+				around.x0 = std::min(around.x0, damaged[i].x0);
+				around.y0 = std::min(around.y0, damaged[i].y0);
+				around.x1 = std::max(around.x1, damaged[i].x1);
+				around.y1 = std::max(around.y1, damaged[i].y1);
+			}
+			damaged.assign(1, around);
+		}
+	}
+}
@@ -0,0 +1,453 @@
+/* vim: set ts=4 sts=4 sw=4 tw=80: */
+#include "compressed.hpp"
+#include "lz4.hpp"
+#include <algorithm>
+#include <climits>
+#include <cstring>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace
+{
+	using sdlpp::RW_ops;
+	using std::runtime_error;
+	using std::string;
+
+	const char MAGIC[8] = { 'S', 'D', 'L', 'P', 'P', 'L', 'Z', '4' };
+	const char INDEX_MAGIC[4] = { 'L', 'Z', '4', 'I' };
+	const Uint32 VERSION = 1;
+
+	const int HEADER_SIZE = 16;
+	const int TRAILER_SIZE = 16;
+
+	/** Set in a block's stored size if it didn't compress. */
+	const Uint32 STORED = 0x80000000;
+
+	/** A larger block size is taken for a corrupt header. */
+	const int MAX_BLOCK_SIZE = 1 << 24;
+
+	inline Uint32 Read32(const Uint8* bytes)
+	{
+		return bytes[0] | bytes[1] << 8 | bytes[2] << 16
+			| static_cast<Uint32>(bytes[3]) << 24;
+	}
+
+	inline void Write32(Uint8* bytes, Uint32 value)
+	{
+		bytes[0] = value;
+		bytes[1] = value >> 8;
+		bytes[2] = value >> 16;
+		bytes[3] = value >> 24;
+	}
+
+	/**
+	 * Reads count bytes, however many reads it takes.
+	 * @return false if the source ends or fails first.
+	 */
+	bool Read_fully(SDL_RWops* source, void* to, int count)
+	{
+		Uint8* at = static_cast<Uint8*>(to);
+		while (count > 0) {
+			int n = SDL_RWread(source, at, 1, count);
+			if (n <= 0) {
+				return false;
+			}
+			at += n;
+			count -= n;
+		}
+		return true;
+	}
+
+	inline bool Write_fully(SDL_RWops* source, const void* from, int count)
+	{
+		return SDL_RWwrite(source, from, 1, count) == count;
+	}
+
+	/**
+	 * The state of a compressing or decompressing SDL_RWops.
+	 */
+	struct Stream
+	{
+		Stream(const RW_ops& source, bool compressing, int block_size) :
+			source(source),
+			compressing(compressing),
+			block_size(block_size),
+			base(SDL_RWseek(this->source.raw_ptr(), 0, RW_SEEK_CUR)),
+			index_offset(0),
+			length(0),
+			position(0),
+			current(-1),
+			source_at(-1),
+			filled(0),
+			finished(false),
+			failed(false)
+		{
+			/* A source that can't tell where it is starts at 0. */
+			if (base < 0) {
+				base = 0;
+			}
+		}
+
+		/**
+		 * @return How long a block is before compression.
+		 */
+		int length_of(int block) const
+		{
+			return std::min(block_size, length - block * block_size);
+		}
+
+		RW_ops source;
+		bool compressing;
+		int block_size;
+
+		/** Where the stream starts in the source. */
+		int base;
+
+		/** Where the blocks and the index are, from base. */
+		std::vector<Uint32> offsets;
+		Uint32 index_offset;
+
+		/** How long the stream is before compression. */
+		int length;
+
+		/** Where reading is at, before compression. */
+		int position;
+
+		/** The block decompressed into block, or -1. */
+		int current;
+
+		/**
+		 * Where the source is, from base, or -1 if unknown. Blocks read in
+		 * order then need no seeks.
+		 */
+		int source_at;
+
+		/** A block before compression, and after. */
+		std::vector<Uint8> block;
+		std::vector<Uint8> packed;
+
+		/** How much of block is written, when compressing. */
+		int filled;
+
+		bool finished;
+		bool failed;
+	};
+
+	inline Stream& StreamOf(SDL_RWops* ops)
+	{
+		return *static_cast<Stream*>(ops->hidden.unknown.data1);
+	}
+
+	/**
+	 * Reads the header and the index of a stream.
+	 * @throw runtime_error
+	 */
+	void Open(Stream& stream)
+	{
+		SDL_RWops* source = stream.source.raw_ptr();
+		Uint8 header[HEADER_SIZE];
+		if (!Read_fully(source, header, HEADER_SIZE)
+				|| std::memcmp(header, MAGIC, sizeof MAGIC)) {
+			throw runtime_error("Not an LZ4 stream");
+		}
+		if (Read32(header + 8) != VERSION) {
+			throw runtime_error("LZ4 stream of another version");
+		}
+		Uint32 block_size = Read32(header + 12);
+		if (block_size == 0 || block_size > MAX_BLOCK_SIZE) {
+			throw runtime_error("Corrupt LZ4 stream header");
+		}
+		stream.block_size = block_size;
+
+		Uint8 trailer[TRAILER_SIZE];
+		int end = SDL_RWseek(source, -TRAILER_SIZE, RW_SEEK_END);
+		if (end < stream.base + HEADER_SIZE
+				|| !Read_fully(source, trailer, TRAILER_SIZE)
+				|| std::memcmp(trailer + 12, INDEX_MAGIC, sizeof INDEX_MAGIC)) {
+			throw runtime_error("LZ4 stream has no index");
+		}
+		Uint32 index_offset = Read32(trailer);
+		Uint32 count = Read32(trailer + 4);
+		Uint32 length = Read32(trailer + 8);
+		if (length > INT_MAX
+				|| count != (static_cast<Uint64>(length) + block_size - 1)
+					/ block_size
+				|| index_offset < HEADER_SIZE
+				|| index_offset + static_cast<Uint64>(count) * 4
+					!= static_cast<Uint64>(end - stream.base)) {
+			throw runtime_error("Corrupt LZ4 stream index");
+		}
+
+		std::vector<Uint8> index(count * 4);
+		if (count > 0 && (SDL_RWseek(source, stream.base + index_offset,
+						RW_SEEK_SET) < 0
+					|| !Read_fully(source, &index[0], index.size()))) {
+			throw runtime_error("Can't read LZ4 stream index");
+		}
+		stream.offsets.resize(count);
+		for (Uint32 i = 0; i < count; i++) {
+			Uint32 offset = Read32(&index[i * 4]);
+			Uint32 lowest = i == 0 ? HEADER_SIZE : stream.offsets[i - 1] + 4;
+			if (offset < lowest || offset > index_offset - 4
+					|| (i == 0 && offset != HEADER_SIZE)) {
+				throw runtime_error("Corrupt LZ4 stream index");
+			}
+			stream.offsets[i] = offset;
+		}
+		stream.index_offset = index_offset;
+		stream.length = length;
+		stream.block.resize(block_size);
+		stream.packed.resize(sdlpp::lz4::bound(block_size));
+	}
+
+	/**
+	 * Reads and decompresses a block.
+	 * @return false if it can't be read or is corrupt.
+	 */
+	bool Load(Stream& stream, int block)
+	{
+		SDL_RWops* source = stream.source.raw_ptr();
+		stream.current = -1;
+		const int offset = stream.offsets[block];
+		if (stream.source_at != offset && SDL_RWseek(source,
+					stream.base + offset, RW_SEEK_SET) < 0) {
+			stream.source_at = -1;
+			return false;
+		}
+		stream.source_at = -1;
+
+		Uint8 word[4];
+		if (!Read_fully(source, word, 4)) {
+			return false;
+		}
+		const Uint32 stored = Read32(word);
+		const int size = stored & ~STORED;
+		const int expected = stream.length_of(block);
+		const Uint32 next = block + 1 < static_cast<int>(stream.offsets.size())
+			? stream.offsets[block + 1] : stream.index_offset;
+
+		/* Blocks lie end to end, so the index tells a block's size too. */
+		bool ok = static_cast<Uint32>(size) == next - offset - 4;
+		if (ok && (stored & STORED)) {
+			ok = size == expected && Read_fully(source, &stream.block[0], size);
+		}
+		else if (ok) {
+			ok = size <= static_cast<int>(stream.packed.size())
+				&& Read_fully(source, &stream.packed[0], size)
+				&& sdlpp::lz4::decompress(&stream.packed[0], size,
+						&stream.block[0], expected) == expected;
+		}
+		if (!ok) {
+			SDL_SetError("Corrupt LZ4 stream block");
+			return false;
+		}
+		stream.current = block;
+		stream.source_at = next;
+		return true;
+	}
+
+	/**
+	 * Compresses and writes the bytes written so far.
+	 * @return false if the source fails.
+	 */
+	bool Emit(Stream& stream)
+	{
+		int size = sdlpp::lz4::compress(&stream.block[0], stream.filled,
+				&stream.packed[0]);
+		Uint32 word = size;
+		const Uint8* bytes = &stream.packed[0];
+		if (size >= stream.filled) {
+			size = stream.filled;
+			word = size | STORED;
+			bytes = &stream.block[0];
+		}
+
+		Uint8 header[4];
+		Write32(header, word);
+		SDL_RWops* source = stream.source.raw_ptr();
+		if (!Write_fully(source, header, 4)
+				|| !Write_fully(source, bytes, size)) {
+			stream.failed = true;
+			return false;
+		}
+		stream.offsets.push_back(stream.source_at);
+		stream.source_at += 4 + size;
+		stream.filled = 0;
+		return true;
+	}
+
+	/**
+	 * Writes the last block and the index, once.
+	 * @return false if the stream couldn't be written whole.
+	 */
+	bool Finish(Stream& stream)
+	{
+		if (stream.finished) {
+			return !stream.failed;
+		}
+		stream.finished = true;
+		if (stream.failed || (stream.filled > 0 && !Emit(stream))) {
+			return false;
+		}
+
+		const int count = stream.offsets.size();
+		std::vector<Uint8> index(count * 4 + TRAILER_SIZE);
+		for (int i = 0; i < count; i++) {
+			Write32(&index[i * 4], stream.offsets[i]);
+		}
+		Uint8* trailer = &index[count * 4];
+		Write32(trailer, stream.source_at);
+		Write32(trailer + 4, count);
+		Write32(trailer + 8, stream.length);
+		std::memcpy(trailer + 12, INDEX_MAGIC, sizeof INDEX_MAGIC);
+		if (!Write_fully(stream.source.raw_ptr(), &index[0], index.size())) {
+			stream.failed = true;
+			return false;
+		}
+		return true;
+	}
+
+	int Compressed_seek(SDL_RWops* ops, int offset, int whence)
+	{
+		Stream& stream = StreamOf(ops);
+		int here = stream.compressing ? stream.length : stream.position;
+		int target = whence == RW_SEEK_SET ? offset
+			: whence == RW_SEEK_CUR ? here + offset
+			: stream.length + offset;
+		if (stream.compressing) {
+			/* Only where writing is at, to tell where that is. */
+			if (target != stream.length) {
+				SDL_SetError("Compressing RW_ops can't seek");
+				return -1;
+			}
+			return target;
+		}
+		stream.position = std::max(0, std::min(target, stream.length));
+		return stream.position;
+	}
+
+	int Compressed_read(SDL_RWops* ops, void* ptr, int size, int maxnum)
+	{
+		Stream& stream = StreamOf(ops);
+		if (stream.compressing) {
+			SDL_SetError("Compressing RW_ops can't be read");
+			return -1;
+		}
+		if (size <= 0 || maxnum <= 0) {
+			return 0;
+		}
+
+		Uint8* to = static_cast<Uint8*>(ptr);
+		const int wanted = size * maxnum;
+		int done = 0;
+		while (done < wanted && stream.position < stream.length) {
+			int block = stream.position / stream.block_size;
+			if (block != stream.current && !Load(stream, block)) {
+				return done > 0 ? done / size : -1;
+			}
+			int from = stream.position - block * stream.block_size;
+			int n = std::min(stream.length_of(block) - from, wanted - done);
+			std::memcpy(to + done, &stream.block[from], n);
+			stream.position += n;
+			done += n;
+		}
+		return done / size;
+	}
+
+	int Compressed_write(SDL_RWops* ops, const void* ptr, int size, int num)
+	{
+		Stream& stream = StreamOf(ops);
+		if (!stream.compressing || stream.finished) {
+			SDL_SetError(stream.compressing ? "Compressing RW_ops is closed"
+					: "Decompressing RW_ops can't be written to");
+			return -1;
+		}
+		if (size <= 0 || num <= 0) {
+			return 0;
+		}
+		if (stream.failed || num > (INT_MAX - stream.length) / size) {
+			return -1;
+		}
+
+		const Uint8* from = static_cast<const Uint8*>(ptr);
+		int remaining = size * num;
+		while (remaining > 0) {
+			int n = std::min(stream.block_size - stream.filled, remaining);
+			std::memcpy(&stream.block[stream.filled], from, n);
+			stream.filled += n;
+			stream.length += n;
+			from += n;
+			remaining -= n;
+			if (stream.filled == stream.block_size && !Emit(stream)) {
+				return -1;
+			}
+		}
+		return num;
+	}
+
+	int Compressed_close(SDL_RWops* ops)
+	{
+		/* The source is shared, so it's for its owner to close. */
+		Stream& stream = StreamOf(ops);
+		return !stream.compressing || Finish(stream) ? 0 : -1;
+	}
+}
+
+namespace sdlpp
+{
+	namespace compressed
+	{
+		SDL_RWops* create(const RW_ops& source, RW_ops::Direction direction,
+				int block_size)
+		{
+			std::auto_ptr<Stream> stream(new Stream(source,
+						direction == RW_ops::COMPRESS, block_size));
+			if (stream->compressing) {
+				if (block_size <= 0 || block_size > MAX_BLOCK_SIZE) {
+					throw runtime_error("LZ4 block size is out of range");
+				}
+				stream->block.resize(block_size);
+				stream->packed.resize(lz4::bound(block_size));
+
+				Uint8 header[HEADER_SIZE];
+				std::memcpy(header, MAGIC, sizeof MAGIC);
+				Write32(header + 8, VERSION);
+				Write32(header + 12, block_size);
+				if (!Write_fully(stream->source.raw_ptr(), header,
+							HEADER_SIZE)) {
+					throw runtime_error(string()
+							+ "Can't write LZ4 stream header: "
+							+ SDL_GetError());
+				}
+				stream->source_at = HEADER_SIZE;
+			}
+			else {
+				Open(*stream);
+			}
+
+			SDL_RWops* ops = SDL_AllocRW();
+			if (ops == 0) {
+				throw runtime_error(string()
+						+ "SDL_AllocRW returned NULL: "
+						+ SDL_GetError());
+			}
+			ops->seek = Compressed_seek;
+			ops->read = Compressed_read;
+			ops->write = Compressed_write;
+			ops->close = Compressed_close;
+			ops->hidden.unknown.data1 = stream.release();
+			return ops;
+		}
+
+		void destroy(SDL_RWops* ops)
+		{
+			Stream* stream = &StreamOf(ops);
+			if (stream->compressing) {
+				Finish(*stream);
+			}
+			delete stream;
+			SDL_FreeRW(ops);
+		}
+	}
+}
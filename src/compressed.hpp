@@ -0,0 +1,43 @@
+#ifndef SDLPP_COMPRESSED_HPP_INCLUDED
+#define SDLPP_COMPRESSED_HPP_INCLUDED
+/* vim: set ts=4 sts=4 sw=4 tw=80: */
+
+/*
+ * SDL_RWops that compress what they write, or decompress what they read,
+ * as streams of LZ4 blocks. This header is private to the library and not
+ * installed.
+ *
+ * A stream starts with the magic "SDLPPLZ4", a version and the block size,
+ * each 32 bits and little-endian like all numbers in it. The blocks follow,
+ * each the block size before compression but the last, and each a 32-bit
+ * stored size, whose top bit is set if the block was stored as is, then
+ * that many bytes. An index of the blocks' offsets ends the stream,
+ * followed by its offset, the block count, the length before compression
+ * and the magic "LZ4I".
+ */
+
+#include "SDL.h"
+#include <SDL++/rw_ops.hpp>
+
+namespace sdlpp
+{
+	namespace compressed
+	{
+		/**
+		 * Starts reading a stream from where source is, or writing one
+		 * there.
+		 *
+		 * @throw runtime_error
+		 */
+		SDL_RWops* create(const RW_ops& source, RW_ops::Direction direction,
+				int block_size);
+
+		/**
+		 * Ends a stream being written, if it isn't yet, and frees an
+		 * SDL_RWops from create().
+		 */
+		void destroy(SDL_RWops* ops);
+	}
+}
+
+#endif /* SDLPP_COMPRESSED_HPP_INCLUDED */
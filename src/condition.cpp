@@ -1,27 +1,35 @@
 /* vim: set ts=4 sts=4 sw=4 tw=80: */
 #include <SDL++/condition.hpp>
+#include "profiled.hpp"
 #include <string>
 
+namespace
+{
+	typedef sdlpp::profiled::Deleter<SDL_cond> Deleter;
+}
+
 namespace sdlpp
 {
 	using std::string;
 
 	Condition::Condition() :
-		shared_ptr_base<SDL_cond>(SDL_CreateCond(), SDL_DestroyCond)
+		shared_ptr_base<SDL_cond>(SDL_CreateCond(), Deleter(SDL_DestroyCond))
 	{
 		if (p.get() == 0) {
 			throw runtime_error(string()
 					+ "SDL_CreateCond returned NULL: "
 					+ SDL_GetError());
 		}
+		profiled::attach(p, Lock_stats::CONDITION);
 	}
 
 	Condition::Condition(SDL_cond* condition) :
-		shared_ptr_base<SDL_cond>(condition, SDL_DestroyCond)
+		shared_ptr_base<SDL_cond>(condition, Deleter(SDL_DestroyCond))
 	{
 		if (p.get() == 0) {
 			throw runtime_error("Attempted to wrap a NULL condition");
 		}
+		profiled::attach(p, Lock_stats::CONDITION);
 	}
 
 	Condition::Condition(const Condition& that) :
@@ -34,12 +42,35 @@ namespace sdlpp
 
 	bool Condition::wait(Mutex& mutex)
 	{
+#ifdef SDLPP_PROFILE_LOCKS
+		/*
+		 * SDL_CondWait releases the mutex while it waits, so we end its
+		 * hold time here and start a new one once we have it back.
+		 */
+		Lock_profiler::Record* held = profiled::record(mutex.p);
+		Lock_profiler::released(held);
+		Uint64 start = Lock_profiler::now();
+		bool ok = SDL_CondWait(p.get(), mutex.raw_ptr()) == 0;
+		Lock_profiler::waited(profiled::record(p), start);
+		Lock_profiler::acquired(held, Lock_profiler::now());
+		return ok;
+#else
 		return SDL_CondWait(p.get(), mutex.raw_ptr()) == 0;
+#endif /* SDLPP_PROFILE_LOCKS */
 	}
 
 	bool Condition::wait_timeout(Mutex& mutex, Uint32 ms)
 	{
+#ifdef SDLPP_PROFILE_LOCKS
+		Lock_profiler::Record* held = profiled::record(mutex.p);
+		Lock_profiler::released(held);
+		Uint64 start = Lock_profiler::now();
+		int rc = SDL_CondWaitTimeout(p.get(), mutex.raw_ptr(), ms);
+		Lock_profiler::waited(profiled::record(p), start);
+		Lock_profiler::acquired(held, Lock_profiler::now());
+#else
 		int rc = SDL_CondWaitTimeout(p.get(), mutex.raw_ptr(), ms);
+#endif /* SDLPP_PROFILE_LOCKS */
 		if (rc == 0) {
 			return true;
 		}
@@ -0,0 +1,66 @@
+/* vim: set ts=4 sts=4 sw=4 tw=80: */
+#include <SDL++/latch.hpp>
+#include "sync.hpp"
+
+namespace
+{
+	/**
+	 * How often we re-check the count before we go to sleep.
+	 */
+	const int SPINS = 200;
+
+	sdlpp::Latch_state* CreateState(unsigned count)
+	{
+		sdlpp::Latch_state* s = new sdlpp::Latch_state;
+		s->count = count;
+		return s;
+	}
+}
+
+namespace sdlpp
+{
+	Latch::Latch(unsigned count) :
+		shared_ptr_base<Latch_state>(CreateState(count))
+	{
+	}
+
+	Latch::Latch(const Latch& that) :
+		shared_ptr_base<Latch_state>(that)
+	{
+	}
+
+	void Latch::count_down(unsigned n)
+	{
+		int before = __atomic_fetch_sub(&p->count, static_cast<int>(n),
+				__ATOMIC_RELEASE);
+		if (before > 0 && before <= static_cast<int>(n)) {
+			sync::futex_wake_all(&p->count);
+		}
+	}
+
+	void Latch::wait()
+	{
+		int count;
+		for (int spins = 0;
+				(count = __atomic_load_n(&p->count, __ATOMIC_ACQUIRE)) > 0;
+				spins++) {
+			if (spins < SPINS) {
+				sync::cpu_relax();
+			}
+			else {
+				sync::futex_wait(&p->count, count);
+			}
+		}
+	}
+
+	bool Latch::try_wait() const
+	{
+		return __atomic_load_n(&p->count, __ATOMIC_ACQUIRE) <= 0;
+	}
+
+	void Latch::arrive_and_wait(unsigned n)
+	{
+		count_down(n);
+		wait();
+	}
+}
@@ -0,0 +1,282 @@
+/* vim: set ts=4 sts=4 sw=4 tw=80: */
+#include <SDL++/lock_profiler.hpp>
+#include <SDL++/adaptive_mutex.hpp>
+#include "sync.hpp"
+#include <algorithm>
+#include <cstring>
+#include <iomanip>
+#include <map>
+
+namespace sdlpp
+{
+	struct Lock_profiler::Record
+	{
+		/**
+		 * Guards the rest. Only the hooks for this object and snapshots
+		 * take it, and it is never profiled itself.
+		 */
+		Adaptive_mutex mutex;
+
+		Lock_stats stats;
+
+		/** When the current owner of a Mutex took it, or 0. */
+		Uint64 hold_start;
+	};
+}
+
+namespace
+{
+	using sdlpp::Adaptive_mutex;
+	using sdlpp::Lock_profiler;
+	using sdlpp::Lock_stats;
+	using std::map;
+
+	typedef Lock_profiler::Record Record;
+
+	/**
+	 * All profiled objects. Its lock is taken to attach or detach an
+	 * object, to name one and for snapshots, never for a wait.
+	 */
+	struct Registry
+	{
+		Adaptive_mutex mutex;
+		map<const void*, Record*> records;
+	};
+
+	Registry& registry()
+	{
+		static Registry r;
+		return r;
+	}
+
+	void Clear(Lock_stats& s)
+	{
+		s.owner = 0;
+		s.acquisitions = 0;
+		s.contended = 0;
+		s.total_wait_ns = 0;
+		s.max_wait_ns = 0;
+		s.total_hold_ns = 0;
+		s.max_hold_ns = 0;
+		std::memset(s.histogram, 0, sizeof(s.histogram));
+	}
+
+	Record* Create(const void* object, Lock_stats::Kind kind)
+	{
+		Record* record = new Record();
+		record->stats.object = object;
+		record->stats.kind = kind;
+		Clear(record->stats);
+		record->hold_start = 0;
+		return record;
+	}
+
+	int Bucket(Uint64 ns)
+	{
+		int b = 0;
+		while (ns > 1 && b < Lock_stats::BUCKETS - 1) {
+			ns >>= 1;
+			b++;
+		}
+		return b;
+	}
+
+	void RecordWait(Lock_stats& s, Uint64 wait)
+	{
+		s.acquisitions++;
+		if (wait >= sdlpp::Lock_profiler::CONTENDED_NS) {
+			s.contended++;
+		}
+		s.total_wait_ns += wait;
+		s.max_wait_ns = std::max(s.max_wait_ns, wait);
+		s.histogram[Bucket(wait)]++;
+	}
+
+	bool MoreWait(const Lock_stats& a, const Lock_stats& b)
+	{
+		return a.total_wait_ns > b.total_wait_ns;
+	}
+
+	const char* KindName(Lock_stats::Kind kind)
+	{
+		switch (kind) {
+		case Lock_stats::MUTEX:
+			return "mutex";
+		case Lock_stats::SEMAPHORE:
+			return "semaphore";
+		case Lock_stats::CONDITION:
+			return "condition";
+		default:
+			return "?";
+		}
+	}
+}
+
+namespace sdlpp
+{
+	const Uint64 Lock_profiler::CONTENDED_NS;
+
+	vector<Lock_stats> Lock_profiler::snapshot()
+	{
+		Registry& r = registry();
+		vector<Lock_stats> result;
+		Adaptive_mutex::Lock l(r.mutex);
+		result.reserve(r.records.size());
+		for (map<const void*, Record*>::iterator it = r.records.begin();
+				it != r.records.end(); ++it) {
+			Adaptive_mutex::Lock rl(it->second->mutex);
+			result.push_back(it->second->stats);
+		}
+		return result;
+	}
+
+	vector<Lock_stats> Lock_profiler::top(size_t n)
+	{
+		vector<Lock_stats> all = snapshot();
+		n = std::min(n, all.size());
+		std::partial_sort(all.begin(), all.begin() + n, all.end(), MoreWait);
+		all.resize(n);
+		return all;
+	}
+
+	void Lock_profiler::dump(ostream& out, size_t n)
+	{
+		vector<Lock_stats> stats = top(n);
+		out << std::left
+			<< std::setw(24) << "name"
+			<< std::setw(10) << "kind"
+			<< std::right
+			<< std::setw(10) << "owner"
+			<< std::setw(12) << "acquired"
+			<< std::setw(12) << "contended"
+			<< std::setw(14) << "wait us"
+			<< std::setw(12) << "max us"
+			<< std::setw(14) << "hold us"
+			<< '\n';
+		for (size_t i = 0; i < stats.size(); i++) {
+			const Lock_stats& s = stats[i];
+			out << std::left
+				<< std::setw(24) << (s.name.empty() ? "(unnamed)" : s.name)
+				<< std::setw(10) << KindName(s.kind)
+				<< std::right
+				<< std::setw(10) << s.owner
+				<< std::setw(12) << s.acquisitions
+				<< std::setw(12) << s.contended
+				<< std::setw(14) << s.total_wait_ns / 1000
+				<< std::setw(12) << s.max_wait_ns / 1000
+				<< std::setw(14) << s.total_hold_ns / 1000
+				<< '\n';
+		}
+	}
+
+	void Lock_profiler::reset()
+	{
+		Registry& r = registry();
+		Adaptive_mutex::Lock l(r.mutex);
+		for (map<const void*, Record*>::iterator it = r.records.begin();
+				it != r.records.end(); ++it) {
+			Record& record = *it->second;
+			Adaptive_mutex::Lock rl(record.mutex);
+			Uint32 owner = record.stats.owner;
+			Clear(record.stats);
+			record.stats.owner = owner;
+		}
+	}
+
+	bool Lock_profiler::enabled()
+	{
+#ifdef SDLPP_PROFILE_LOCKS
+		return true;
+#else
+		return false;
+#endif
+	}
+
+	Uint64 Lock_profiler::now()
+	{
+		return sync::now_ns();
+	}
+
+	Lock_profiler::Record* Lock_profiler::attach(const void* object,
+			Lock_stats::Kind kind)
+	{
+		Record* record = Create(object, kind);
+		Registry& r = registry();
+		Adaptive_mutex::Lock l(r.mutex);
+		r.records[object] = record;
+		return record;
+	}
+
+	void Lock_profiler::detach(Record* record)
+	{
+		Registry& r = registry();
+		{
+			Adaptive_mutex::Lock l(r.mutex);
+			map<const void*, Record*>::iterator it =
+				r.records.find(record->stats.object);
+			if (it != r.records.end() && it->second == record) {
+				r.records.erase(it);
+			}
+		}
+		delete record;
+	}
+
+	void Lock_profiler::waited(Record* record, Uint64 start)
+	{
+		if (record == 0) {
+			return;
+		}
+		Uint64 wait = now() - start;
+		Adaptive_mutex::Lock l(record->mutex);
+		RecordWait(record->stats, wait);
+	}
+
+	void Lock_profiler::acquired(Record* record, Uint64 start)
+	{
+		if (record == 0) {
+			return;
+		}
+		Uint64 end = now();
+		Adaptive_mutex::Lock l(record->mutex);
+		RecordWait(record->stats, end - start);
+		record->stats.owner = SDL_ThreadID();
+		record->hold_start = end;
+	}
+
+	void Lock_profiler::released(Record* record)
+	{
+		if (record == 0) {
+			return;
+		}
+		Uint64 end = now();
+		Adaptive_mutex::Lock l(record->mutex);
+		Lock_stats& s = record->stats;
+		if (record->hold_start != 0) {
+			Uint64 hold = end - record->hold_start;
+			s.total_hold_ns += hold;
+			s.max_hold_ns = std::max(s.max_hold_ns, hold);
+			record->hold_start = 0;
+		}
+		s.owner = 0;
+	}
+
+	void Lock_profiler::name_object(const void* object, const string& name)
+	{
+#ifdef SDLPP_PROFILE_LOCKS
+		/*
+		 * Objects we don't profile have no record, and making one here
+		 * would outlive them: only detach() frees records.
+		 */
+		Registry& r = registry();
+		Adaptive_mutex::Lock l(r.mutex);
+		map<const void*, Record*>::iterator it = r.records.find(object);
+		if (it != r.records.end()) {
+			Adaptive_mutex::Lock rl(it->second->mutex);
+			it->second->stats.name = name;
+		}
+#else
+		(void) object;
+		(void) name;
+#endif /* SDLPP_PROFILE_LOCKS */
+	}
+}
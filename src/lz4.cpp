@@ -0,0 +1,211 @@
+/* vim: set ts=4 sts=4 sw=4 tw=80: */
+#include "lz4.hpp"
+#include <cstring>
+
+namespace
+{
+	const int MIN_MATCH = 4;
+
+	/** The last match starts this far from the end of a block, or more. */
+	const int MATCH_LIMIT = 12;
+
+	/** The last bytes of a block are always literals. */
+	const int LAST_LITERALS = 5;
+
+	const int MAX_OFFSET = 0xffff;
+
+	const int HASH_BITS = 12;
+
+	/** After this many misses in a row, skip further between tries. */
+	const int SKIP_SHIFT = 6;
+
+	inline Uint32 Read32(const Uint8* bytes)
+	{
+		Uint32 value;
+		std::memcpy(&value, bytes, sizeof value);
+		return value;
+	}
+
+	inline Uint32 Hash(Uint32 sequence)
+	{
+		return sequence * 2654435761U >> (32 - HASH_BITS);
+	}
+
+	/**
+	 * Writes what a length doesn't fit in its 4 bits of a token.
+	 */
+	inline Uint8* Write_length(Uint8* to, int length)
+	{
+		while (length >= 255) {
+			*to++ = 255;
+			length -= 255;
+		}
+		*to++ = length;
+		return to;
+	}
+
+	/**
+	 * Reads what a length didn't fit in its 4 bits of a token.
+	 *
+	 * @return false if the input ends first or the length grows past limit,
+	 * so that a corrupt run of 255s can't overflow it.
+	 */
+	inline bool Read_length(const Uint8*& from, const Uint8* end, int& length,
+			int limit)
+	{
+		Uint8 byte;
+		do {
+			if (from == end) {
+				return false;
+			}
+			byte = *from++;
+			length += byte;
+			if (length > limit) {
+				return false;
+			}
+		} while (byte == 255);
+		return true;
+	}
+
+	/**
+	 * Writes a sequence: literals, then a match unless match_length is 0.
+	 */
+	Uint8* Write_sequence(Uint8* to, const Uint8* literals, int literal_length,
+			int offset, int match_length)
+	{
+		Uint8* token = to++;
+		*token = (literal_length < 15 ? literal_length : 15) << 4;
+		if (literal_length >= 15) {
+			to = Write_length(to, literal_length - 15);
+		}
+		std::memcpy(to, literals, literal_length);
+		to += literal_length;
+		if (match_length == 0) {
+			return to;
+		}
+
+		*to++ = offset;
+		*to++ = offset >> 8;
+		int length = match_length - MIN_MATCH;
+		*token |= length < 15 ? length : 15;
+		if (length >= 15) {
+			to = Write_length(to, length - 15);
+		}
+		return to;
+	}
+}
+
+namespace sdlpp
+{
+	namespace lz4
+	{
+		int compress(const Uint8* from, int size, Uint8* to)
+		{
+			/* Where each hashed 4 bytes were last seen, or -1. */
+			int seen[1 << HASH_BITS];
+			std::memset(seen, -1, sizeof seen);
+
+			Uint8* out = to;
+			int anchor = 0;
+			int i = 0;
+			int misses = 0;
+			while (i < size - MATCH_LIMIT) {
+				Uint32 sequence = Read32(from + i);
+				Uint32 hash = Hash(sequence);
+				int candidate = seen[hash];
+				seen[hash] = i;
+				if (candidate < 0 || i - candidate > MAX_OFFSET
+						|| Read32(from + candidate) != sequence) {
+					i += 1 + (misses++ >> SKIP_SHIFT);
+					continue;
+				}
+				misses = 0;
+
+				/* Grow the match back over literals, then forward. */
+				while (i > anchor && candidate > 0
+						&& from[i - 1] == from[candidate - 1]) {
+					i--;
+					candidate--;
+				}
+				int length = MIN_MATCH;
+				while (i + length < size - LAST_LITERALS
+						&& from[candidate + length] == from[i + length]) {
+					length++;
+				}
+
+				out = Write_sequence(out, from + anchor, i - anchor,
+						i - candidate, length);
+				i += length;
+				anchor = i;
+			}
+			out = Write_sequence(out, from + anchor, size - anchor, 0, 0);
+			return out - to;
+		}
+
+		int decompress(const Uint8* from, int size, Uint8* to, int capacity)
+		{
+			const Uint8* in = from;
+			const Uint8* in_end = from + size;
+			Uint8* out = to;
+			Uint8* out_end = to + capacity;
+			for (;;) {
+				if (in == in_end) {
+					return -1;
+				}
+				Uint8 token = *in++;
+
+				int literal_length = token >> 4;
+				int literal_limit = out_end - out;
+				if (in_end - in < literal_limit) {
+					literal_limit = in_end - in;
+				}
+				if (literal_length == 15 && !Read_length(in, in_end,
+						literal_length, literal_limit)) {
+					return -1;
+				}
+				if (literal_length > in_end - in
+						|| literal_length > out_end - out) {
+					return -1;
+				}
+				std::memcpy(out, in, literal_length);
+				in += literal_length;
+				out += literal_length;
+
+				/* The last sequence has no match. */
+				if (in == in_end) {
+					return out - to;
+				}
+
+				if (in_end - in < 2) {
+					return -1;
+				}
+				int offset = in[0] | in[1] << 8;
+				in += 2;
+				if (offset == 0 || offset > out - to) {
+					return -1;
+				}
+				int match_length = token & 15;
+				if (match_length == 15 && !Read_length(in, in_end,
+						match_length, out_end - out - MIN_MATCH)) {
+					return -1;
+				}
+				match_length += MIN_MATCH;
+				if (match_length > out_end - out) {
+					return -1;
+				}
+
+				/* A match may overlap what it writes, repeating it. */
+				const Uint8* match = out - offset;
+				if (offset >= match_length) {
+					std::memcpy(out, match, match_length);
+					out += match_length;
+				}
+				else {
+					for (int i = 0; i < match_length; i++) {
+						*out++ = *match++;
+					}
+				}
+			}
+		}
+	}
+}
@@ -0,0 +1,42 @@
+#ifndef SDLPP_LZ4_HPP_INCLUDED
+#define SDLPP_LZ4_HPP_INCLUDED
+/* vim: set ts=4 sts=4 sw=4 tw=80: */
+
+/*
+ * The LZ4 block format: byte-oriented LZ77 that decompresses at memory
+ * speed. This header is private to the library and not installed.
+ */
+
+#include "SDL.h"
+
+namespace sdlpp
+{
+	namespace lz4
+	{
+		/**
+		 * @return The most bytes compress() can make of size bytes.
+		 */
+		inline int bound(int size)
+		{
+			return size + size / 255 + 16;
+		}
+
+		/**
+		 * Compresses a block.
+		 *
+		 * @param to Room for at least bound(size) bytes.
+		 * @return How many bytes it compressed to.
+		 */
+		int compress(const Uint8* from, int size, Uint8* to);
+
+		/**
+		 * Decompresses a block, checking that it is well formed.
+		 *
+		 * @return How many bytes it decompressed to, or -1 if it is
+		 * corrupt or decompresses to more than capacity.
+		 */
+		int decompress(const Uint8* from, int size, Uint8* to, int capacity);
+	}
+}
+
+#endif /* SDLPP_LZ4_HPP_INCLUDED */
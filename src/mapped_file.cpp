@@ -0,0 +1,136 @@
+/* vim: set ts=4 sts=4 sw=4 tw=80: */
+#include "mapped_file.hpp"
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <stdexcept>
+
+#if defined(__unix__) || defined(__APPLE__)
+#define SDLPP_HAVE_MMAP 1
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace
+{
+	using std::runtime_error;
+	using std::string;
+
+	/** Stands in for the bytes of an empty file, which can't be mapped. */
+	const Uint8 NOTHING = 0;
+
+	string Failure(const string& what, const string& file_name)
+	{
+		return what + " " + file_name + ": " + std::strerror(errno);
+	}
+}
+
+namespace sdlpp
+{
+	Mapped_file::Mapped_file(const string& file_name) :
+		bytes(&NOTHING),
+		length(0),
+		mapped(false)
+	{
+#ifdef SDLPP_HAVE_MMAP
+		int fd = open(file_name.c_str(), O_RDONLY);
+		if (fd < 0) {
+			throw runtime_error(Failure("Can't open", file_name));
+		}
+		struct stat status;
+		if (fstat(fd, &status) < 0) {
+			string error = Failure("Can't stat", file_name);
+			::close(fd);
+			throw runtime_error(error);
+		}
+		length = status.st_size;
+		if (length > 0) {
+			void* address = mmap(0, length, PROT_READ, MAP_PRIVATE, fd, 0);
+			if (address == MAP_FAILED) {
+				string error = Failure("Can't map", file_name);
+				::close(fd);
+				throw runtime_error(error);
+			}
+			bytes = static_cast<const Uint8*>(address);
+			mapped = true;
+		}
+
+		/* The mapping holds on to the file by itself. */
+		::close(fd);
+#else
+		FILE* fp = std::fopen(file_name.c_str(), "rb");
+		if (fp == 0) {
+			throw runtime_error(Failure("Can't open", file_name));
+		}
+		Uint8 buffer[65536];
+		size_t count;
+		while ((count = std::fread(buffer, 1, sizeof buffer, fp)) > 0) {
+			copy.insert(copy.end(), buffer, buffer + count);
+		}
+		bool failed = std::ferror(fp) != 0;
+		std::fclose(fp);
+		if (failed) {
+			throw runtime_error("Can't read " + file_name);
+		}
+		if (!copy.empty()) {
+			bytes = &copy[0];
+			length = copy.size();
+		}
+#endif /* SDLPP_HAVE_MMAP */
+	}
+
+	Mapped_file::~Mapped_file()
+	{
+#ifdef SDLPP_HAVE_MMAP
+		if (mapped) {
+			munmap(const_cast<Uint8*>(bytes), length);
+		}
+#endif /* SDLPP_HAVE_MMAP */
+	}
+
+	const Uint8* Mapped_file::data() const
+	{
+		return bytes;
+	}
+
+	size_t Mapped_file::size() const
+	{
+		return length;
+	}
+
+	void Mapped_file::advise(RW_ops::Access access, size_t offset,
+			size_t count)
+	{
+#if defined(SDLPP_HAVE_MMAP) && defined(MADV_NORMAL)
+		if (!mapped || offset >= length) {
+			return;
+		}
+		int advice = MADV_NORMAL;
+		switch (access) {
+		case RW_ops::SEQUENTIAL:
+			advice = MADV_SEQUENTIAL;
+			break;
+		case RW_ops::RANDOM:
+			advice = MADV_RANDOM;
+			break;
+		case RW_ops::WILL_NEED:
+			advice = MADV_WILLNEED;
+			break;
+		default:
+			break;
+		}
+
+		/* madvise wants whole pages. */
+		size_t page = sysconf(_SC_PAGESIZE);
+		size_t start = offset - offset % page;
+		size_t end = count < length - offset ? offset + count : length;
+		madvise(const_cast<Uint8*>(bytes) + start, end - start, advice);
+#else
+		(void) access;
+		(void) offset;
+		(void) count;
+#endif
+	}
+}
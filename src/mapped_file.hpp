@@ -0,0 +1,53 @@
+#ifndef SDLPP_MAPPED_FILE_HPP_INCLUDED
+#define SDLPP_MAPPED_FILE_HPP_INCLUDED
+/* vim: set ts=4 sts=4 sw=4 tw=80: */
+
+/*
+ * Read-only file mappings for RW_ops. This header is private to the library
+ * and not installed.
+ */
+
+#include "SDL.h"
+#include <SDL++/rw_ops.hpp>
+#include <string>
+#include <vector>
+
+namespace sdlpp
+{
+	/**
+	 * A file mapped read-only into memory, or read into it where files
+	 * can't be mapped. It is unmapped when destroyed.
+	 */
+	class Mapped_file
+	{
+	public:
+		/**
+		 * @throw runtime_error If the file can't be opened or mapped.
+		 */
+		explicit Mapped_file(const std::string& file_name);
+
+		~Mapped_file();
+
+		const Uint8* data() const;
+		size_t size() const;
+
+		/**
+		 * Tells the system how some bytes of the file will be read. Does
+		 * nothing where it can't be told.
+		 */
+		void advise(RW_ops::Access access, size_t offset, size_t count);
+
+	private:
+		Mapped_file(const Mapped_file& that);
+		Mapped_file& operator= (const Mapped_file& that);
+
+		const Uint8* bytes;
+		size_t length;
+		bool mapped;
+
+		/** The file, if it was read rather than mapped. */
+		std::vector<Uint8> copy;
+	};
+}
+
+#endif /* SDLPP_MAPPED_FILE_HPP_INCLUDED */
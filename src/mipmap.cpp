@@ -0,0 +1,404 @@
+/* vim: set ts=4 sts=4 sw=4 tw=80: */
+#include <SDL++/mipmap.hpp>
+#include <SDL++/mutex.hpp>
+#include <SDL++/pixel_format.hpp>
+#include <SDL++/pixel_traits.hpp>
+#include "parallel.hpp"
+#include <cmath>
+#include <string>
+#include <vector>
+
+#if defined(__x86_64__) || (defined(__i386__) && defined(__SSE2__))
+#define SDLPP_HAVE_SSE2 1
+#include <emmintrin.h>
+#endif
+
+namespace
+{
+	using std::vector;
+
+	/**
+	 * Averages 2x2 blocks of four-byte pixels from two rows into w pixels.
+	 * The rows hold 2 * w pixels, or just one if w is 1 and the level
+	 * before was 1 wide.
+	 */
+	void Halve_scalar(const Uint8* row0, const Uint8* row1, Uint8* out,
+			int w, int src_w)
+	{
+		for (int x = 0; x < w; x++, out += 4) {
+			int left = 4 * 2 * x;
+			int right = 2 * x + 1 < src_w ? left + 4 : left;
+			for (int c = 0; c < 4; c++) {
+				out[c] = (row0[left + c] + row0[right + c]
+						+ row1[left + c] + row1[right + c] + 2) >> 2;
+			}
+		}
+	}
+
+#ifdef SDLPP_HAVE_SSE2
+	/**
+	 * Averages four pixels of two rows, given as 16 bytes each, into two.
+	 * The result holds the two pixels times four, in 16-bit lanes.
+	 */
+	inline __m128i Sum_sse2(__m128i a, __m128i b)
+	{
+		const __m128i zero = _mm_setzero_si128();
+		__m128i lo = _mm_add_epi16(_mm_unpacklo_epi8(a, zero),
+				_mm_unpacklo_epi8(b, zero));
+		__m128i hi = _mm_add_epi16(_mm_unpackhi_epi8(a, zero),
+				_mm_unpackhi_epi8(b, zero));
+		lo = _mm_add_epi16(lo, _mm_srli_si128(lo, 8));
+		hi = _mm_add_epi16(hi, _mm_srli_si128(hi, 8));
+		return _mm_unpacklo_epi64(lo, hi);
+	}
+
+	void Halve_sse2(const Uint8* row0, const Uint8* row1, Uint8* out,
+			int w, int src_w)
+	{
+		const __m128i two = _mm_set1_epi16(2);
+		int x = 0;
+		if (src_w >= 2 * w) {
+			for (; x + 4 <= w; x += 4) {
+				const __m128i* a = reinterpret_cast<const __m128i*>(
+						row0 + 8 * x);
+				const __m128i* b = reinterpret_cast<const __m128i*>(
+						row1 + 8 * x);
+				__m128i lo = Sum_sse2(_mm_loadu_si128(a), _mm_loadu_si128(b));
+				__m128i hi = Sum_sse2(_mm_loadu_si128(a + 1),
+						_mm_loadu_si128(b + 1));
+				lo = _mm_srli_epi16(_mm_add_epi16(lo, two), 2);
+				hi = _mm_srli_epi16(_mm_add_epi16(hi, two), 2);
+				_mm_storeu_si128(reinterpret_cast<__m128i*>(out + 4 * x),
+						_mm_packus_epi16(lo, hi));
+			}
+		}
+		Halve_scalar(row0 + 8 * x, row1 + 8 * x, out + 4 * x, w - x,
+				src_w - 2 * x);
+	}
+#endif /* SDLPP_HAVE_SSE2 */
+
+	inline void Halve(const Uint8* row0, const Uint8* row1, Uint8* out,
+			int w, int src_w)
+	{
+#ifdef SDLPP_HAVE_SSE2
+		Halve_sse2(row0, row1, out, w, src_w);
+#else
+		Halve_scalar(row0, row1, out, w, src_w);
+#endif /* SDLPP_HAVE_SSE2 */
+	}
+
+	inline Uint32 Load(const Uint8* p, int bpp)
+	{
+		switch (bpp) {
+		case 1:
+			return *p;
+		case 2:
+			return sdlpp::Pixel_storage_16::load(p);
+		case 3:
+			return sdlpp::Pixel_storage_24::load(p);
+		default:
+			return sdlpp::Pixel_storage_32::load(p);
+		}
+	}
+
+	inline void Store(Uint8* p, int bpp, Uint32 pixel)
+	{
+		switch (bpp) {
+		case 1:
+			*p = pixel;
+			break;
+		case 2:
+			sdlpp::Pixel_storage_16::store(p, pixel);
+			break;
+		case 3:
+			sdlpp::Pixel_storage_24::store(p, pixel);
+			break;
+		default:
+			sdlpp::Pixel_storage_32::store(p, pixel);
+			break;
+		}
+	}
+
+	/**
+	 * What the worker threads need to build a level.
+	 */
+	struct Job
+	{
+		const Uint8* src;
+		int src_pitch;
+		int src_w;
+		int src_h;
+		Uint8* dst;
+		int dst_pitch;
+		int w;
+
+		/**
+		 * Whether the pixels have four bytes we may average as they are,
+		 * rather than through format.
+		 */
+		bool direct;
+		sdlpp::Pixel_format* format;
+
+		/** Whether pixels that match key under key_mask are transparent. */
+		bool keyed;
+		Uint32 key_mask;
+		Uint32 key;
+		int bpp;
+	};
+
+	/**
+	 * Like Halve, for colorkeyed rows: averages only the pixels of each
+	 * block that don't match the key, and notes in empty which blocks have
+	 * none. row0 and row1 are the pixels, rgba0 and rgba1 the same pixels
+	 * as R, G, B, A.
+	 */
+	void Halve_keyed(const Job& job, const Uint8* row0, const Uint8* row1,
+			const Uint8* rgba0, const Uint8* rgba1, Uint8* out, Uint8* empty)
+	{
+		const Uint8* rows[2] = { row0, row1 };
+		const Uint8* rgbas[2] = { rgba0, rgba1 };
+		for (int x = 0; x < job.w; x++, out += 4) {
+			int xs[2] = { 2 * x, 2 * x + 1 < job.src_w ? 2 * x + 1 : 2 * x };
+			int sum[4] = { 0, 0, 0, 0 };
+			int n = 0;
+			for (int i = 0; i < 4; i++) {
+				int sx = xs[i & 1];
+				Uint32 pixel = Load(rows[i >> 1] + sx * job.bpp, job.bpp);
+				if ((pixel & job.key_mask) == job.key) {
+					continue;
+				}
+				const Uint8* p = rgbas[i >> 1] + 4 * sx;
+				for (int c = 0; c < 4; c++) {
+					sum[c] += p[c];
+				}
+				n++;
+			}
+			empty[x] = n == 0;
+			for (int c = 0; c < 4; c++) {
+				out[c] = n > 0 ? (sum[c] + n / 2) / n : 0;
+			}
+		}
+	}
+
+	/**
+	 * Builds rows [begin, end) of a level.
+	 */
+	void Halve_rows(void* context, int begin, int end)
+	{
+		const Job& job = *static_cast<Job*>(context);
+		vector<Uint8> rgba(job.direct ? 0 : 3 * 4 * job.src_w + job.w);
+		Uint8* rows[2] = { 0, 0 };
+		Uint8* out = 0;
+		Uint8* empty = 0;
+		if (!job.direct) {
+			rows[0] = &rgba[0];
+			rows[1] = &rgba[4 * job.src_w];
+			out = &rgba[8 * job.src_w];
+			empty = &rgba[12 * job.src_w];
+		}
+
+		for (int y = begin; y < end; y++) {
+			const Uint8* row0 = job.src + 2 * y * job.src_pitch;
+			const Uint8* row1 = 2 * y + 1 < job.src_h
+				? row0 + job.src_pitch : row0;
+			Uint8* dst = job.dst + y * job.dst_pitch;
+			if (job.direct) {
+				Halve(row0, row1, dst, job.w, job.src_w);
+				continue;
+			}
+			job.format->get(row0, rows[0], job.src_w);
+			job.format->get(row1, rows[1], job.src_w);
+			if (!job.keyed) {
+				Halve(rows[0], rows[1], out, job.w, job.src_w);
+				job.format->map(out, dst, job.w);
+				continue;
+			}
+			Halve_keyed(job, row0, row1, rows[0], rows[1], out, empty);
+			job.format->map(out, dst, job.w);
+			for (int x = 0; x < job.w; x++) {
+				if (empty[x]) {
+					Store(dst + x * job.bpp, job.bpp, job.key);
+				}
+			}
+		}
+	}
+
+	/**
+	 * Makes a surface of the given size in the format of another, with the
+	 * same colorkey and alpha.
+	 */
+	sdlpp::Surface Create_like(SDL_Surface* like, int w, int h)
+	{
+		const SDL_PixelFormat* format = like->format;
+		sdlpp::Surface surface(SDL_SWSURFACE, w, h, format->BitsPerPixel,
+				format->Rmask, format->Gmask, format->Bmask, format->Amask);
+		if (format->palette != 0) {
+			SDL_SetColors(surface.raw_ptr(), format->palette->colors, 0,
+					format->palette->ncolors);
+		}
+		SDL_SetAlpha(surface.raw_ptr(), like->flags & SDL_SRCALPHA,
+				format->alpha);
+		if (like->flags & SDL_SRCCOLORKEY) {
+			SDL_SetColorKey(surface.raw_ptr(), SDL_SRCCOLORKEY,
+					format->colorkey);
+		}
+		return surface;
+	}
+
+	/**
+	 * Fills dst from src, the level before it.
+	 */
+	void Build(SDL_Surface* src, SDL_Surface* dst)
+	{
+		if (SDL_MUSTLOCK(src) && SDL_LockSurface(src) < 0) {
+			throw sdlpp::runtime_error(std::string()
+					+ "Can't lock a surface to build a mipmap level: "
+					+ SDL_GetError());
+		}
+		sdlpp::Pixel_format format(*src->format);
+		Job job;
+		job.src = static_cast<const Uint8*>(src->pixels);
+		job.src_pitch = src->pitch;
+		job.src_w = src->w;
+		job.src_h = src->h;
+		job.dst = static_cast<Uint8*>(dst->pixels);
+		job.dst_pitch = dst->pitch;
+		job.w = dst->w;
+		const SDL_PixelFormat& f = *src->format;
+		job.keyed = (src->flags & SDL_SRCCOLORKEY) != 0;
+		job.key_mask = f.palette != 0 ? 0xFFFFFFFF
+			: f.Rmask | f.Gmask | f.Bmask;
+		job.key = f.colorkey & job.key_mask;
+		job.bpp = f.BytesPerPixel;
+		job.direct = f.BytesPerPixel == 4 && f.palette == 0 && !job.keyed;
+		job.format = &format;
+		sdlpp::parallel::for_rows(dst->h, Halve_rows, &job, 16);
+		if (SDL_MUSTLOCK(src)) {
+			SDL_UnlockSurface(src);
+		}
+	}
+}
+
+namespace sdlpp
+{
+	/**
+	 * The levels that copies of a Mipmap share.
+	 */
+	struct Mipmap::Chain
+	{
+		Chain(Surface& base) :
+			count(1),
+			built(1)
+		{
+			int size = base.w() > base.h() ? base.w() : base.h();
+			while (size > 1) {
+				size /= 2;
+				count++;
+			}
+			/* The levels never move, so readers need no lock. */
+			levels.reserve(count);
+			levels.push_back(base);
+		}
+
+		/** Held while building levels. */
+		Mutex mutex;
+
+		vector<Surface> levels;
+		int count;
+
+		/** How many levels are ready. */
+		int built;
+	};
+
+	Mipmap::Mipmap(Surface& base) :
+		chain(new Chain(base))
+	{
+	}
+
+	Mipmap::Mipmap(const Mipmap& that) :
+		chain(that.chain)
+	{
+	}
+
+	int Mipmap::levels() const
+	{
+		return chain->count;
+	}
+
+	int Mipmap::w(int level) const
+	{
+		int w = chain->levels[0].w() >> level;
+		return w > 0 ? w : 1;
+	}
+
+	int Mipmap::h(int level) const
+	{
+		int h = chain->levels[0].h() >> level;
+		return h > 0 ? h : 1;
+	}
+
+	Surface Mipmap::level(int level)
+	{
+		if (level < 0 || level >= chain->count) {
+			throw runtime_error("The mipmap has no such level");
+		}
+		if (level < __atomic_load_n(&chain->built, __ATOMIC_ACQUIRE)) {
+			return chain->levels[level];
+		}
+
+		Mutex::Lock lock(chain->mutex);
+		while (chain->built <= level) {
+			int n = chain->built;
+			Surface surface(Create_like(chain->levels[n - 1].raw_ptr(), w(n),
+						h(n)));
+			Build(chain->levels[n - 1].raw_ptr(), surface.raw_ptr());
+			chain->levels.push_back(surface);
+			__atomic_store_n(&chain->built, n + 1, __ATOMIC_RELEASE);
+		}
+		return chain->levels[level];
+	}
+
+	int Mipmap::level_for(double scale) const
+	{
+		if (!(scale < 1)) {
+			return 0;
+		}
+		if (scale <= 0) {
+			return chain->count - 1;
+		}
+		/* 1 / scale is m * 2^e with m in [0.5, 1), so we want e - 1. */
+		int e;
+		std::frexp(1 / scale, &e);
+		return e - 1 < chain->count ? e - 1 : chain->count - 1;
+	}
+
+	bool Mipmap::blit(Surface& dst, Rect& dst_rect, Scaler::Filter filter)
+	{
+		Rect all(0, 0, w(0), h(0));
+		return blit(all, dst, dst_rect, filter);
+	}
+
+	bool Mipmap::blit(Rect& src_rect, Surface& dst, Rect& dst_rect,
+			Scaler::Filter filter)
+	{
+		if (src_rect.w == 0 || src_rect.h == 0) {
+			dst_rect.w = dst_rect.h = 0;
+			return true;
+		}
+		double x_scale = static_cast<double>(dst_rect.w) / src_rect.w;
+		double y_scale = static_cast<double>(dst_rect.h) / src_rect.h;
+		int n = level_for(x_scale > y_scale ? x_scale : y_scale);
+		Surface source(level(n));
+
+		/* The same area, in the coordinates of level n. */
+		double fx = static_cast<double>(w(n)) / w(0);
+		double fy = static_cast<double>(h(n)) / h(0);
+		int x0 = static_cast<int>(std::floor(src_rect.x * fx));
+		int y0 = static_cast<int>(std::floor(src_rect.y * fy));
+		int x1 = static_cast<int>(std::ceil((src_rect.x + src_rect.w) * fx));
+		int y1 = static_cast<int>(std::ceil((src_rect.y + src_rect.h) * fy));
+		Rect area(x0, y0, x1 - x0, y1 - y0);
+		return Scaler::blit(source.raw_ptr(), &area, dst.raw_ptr(),
+				&dst_rect, filter) == 0;
+	}
+}
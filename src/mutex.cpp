@@ -1,5 +1,11 @@
 /* vim: set ts=4 sts=4 sw=4 tw=80: */
 #include <SDL++/mutex.hpp>
+#include "profiled.hpp"
+
+namespace
+{
+	typedef sdlpp::profiled::Deleter<SDL_mutex> Deleter;
+}
 
 /*
  * We need to write shared_ptr_base<SDL_mutex>::p here, because SDL_mutex is a
@@ -9,19 +15,21 @@
 namespace sdlpp
 {
 	Mutex::Mutex() :
-		shared_ptr_base<SDL_mutex>(SDL_CreateMutex(), SDL_DestroyMutex)
+		shared_ptr_base<SDL_mutex>(SDL_CreateMutex(), Deleter(SDL_DestroyMutex))
 	{
 		if (shared_ptr_base<SDL_mutex>::p.get() == 0) {
 			throw runtime_error("SDL_CreateMutex returned NULL");
 		}
+		profiled::attach(shared_ptr_base<SDL_mutex>::p, Lock_stats::MUTEX);
 	}
 
 	Mutex::Mutex(SDL_mutex* mutex) :
-		shared_ptr_base<SDL_mutex>(mutex, SDL_DestroyMutex)
+		shared_ptr_base<SDL_mutex>(mutex, Deleter(SDL_DestroyMutex))
 	{
 		if (shared_ptr_base<SDL_mutex>::p.get() == 0) {
 			throw runtime_error("Attempted to wrap a NULL mutex");
 		}
+		profiled::attach(shared_ptr_base<SDL_mutex>::p, Lock_stats::MUTEX);
 	}
 
 	Mutex::Mutex(const Mutex& that) :
@@ -31,4 +39,22 @@ namespace sdlpp
 			throw runtime_error("Attempted to copy-construct a NULL mutex");
 		}
 	}
+
+#ifdef SDLPP_PROFILE_LOCKS
+	bool Mutex::lock()
+	{
+		Uint64 start = Lock_profiler::now();
+		bool locked = SDL_mutexP(shared_ptr_base<SDL_mutex>::p.get()) == 0;
+		Lock_profiler::acquired(
+				profiled::record(shared_ptr_base<SDL_mutex>::p), start);
+		return locked;
+	}
+
+	bool Mutex::unlock()
+	{
+		Lock_profiler::released(
+				profiled::record(shared_ptr_base<SDL_mutex>::p));
+		return SDL_mutexV(shared_ptr_base<SDL_mutex>::p.get()) == 0;
+	}
+#endif /* SDLPP_PROFILE_LOCKS */
 }
@@ -1,6 +1,11 @@
 /* vim: set ts=4 sts=4 sw=4 tw=80: */
 #include <SDL++/overlay.hpp>
+#include <SDL++/pixel_format.hpp>
+#include "parallel.hpp"
+#include "yuv.hpp"
+#include <cstring>
 #include <string>
+#include <vector>
 
 namespace
 {
@@ -21,6 +26,225 @@ namespace
 		}
 		return overlay;
 	}
+
+	/**
+	 * What the worker threads need to fill an overlay from a surface.
+	 */
+	struct Upload
+	{
+		sdlpp::Pixel_format* format;
+		const Uint8* pixels;
+		int pitch;
+		int w;
+		int h;
+		Uint32 fourcc;
+		Uint8** planes;
+		Uint16* pitches;
+	};
+
+	/**
+	 * Converts pairs of rows [begin, end).
+	 */
+	void Upload_rows(void* context, int begin, int end)
+	{
+		using namespace sdlpp;
+		const Upload& job = *static_cast<Upload*>(context);
+		int cw = job.w / 2;
+		bool planar = job.fourcc == SDL_IYUV_OVERLAY
+			|| job.fourcc == SDL_YV12_OVERLAY;
+		/* Room for one more pixel per row, to make up the last pair. */
+		std::vector<Uint8> rgba(8 * (job.w + 1));
+		std::vector<Uint8> temp(planar ? 0 : job.w + 2 * cw + 3);
+		Uint8* rows[2] = { &rgba[0], &rgba[4 * (job.w + 1)] };
+
+		/* IYUV has U in the second plane, YV12 has V there. */
+		Uint8* u_plane = job.planes[job.fourcc == SDL_IYUV_OVERLAY ? 1 : 2];
+		Uint8* v_plane = job.planes[job.fourcc == SDL_IYUV_OVERLAY ? 2 : 1];
+		int u_pitch = job.pitches[job.fourcc == SDL_IYUV_OVERLAY ? 1 : 2];
+		int v_pitch = job.pitches[job.fourcc == SDL_IYUV_OVERLAY ? 2 : 1];
+
+		for (int pair = begin; pair < end; pair++) {
+			int y = 2 * pair;
+			int n = y + 1 < job.h ? 2 : 1;
+			for (int i = 0; i < n; i++) {
+				job.format->get(job.pixels + (y + i) * job.pitch, rows[i],
+						job.w);
+			}
+
+			if (planar) {
+				for (int i = 0; i < n; i++) {
+					yuv::rgba_to_y(rows[i],
+							job.planes[0] + (y + i) * job.pitches[0], job.w);
+				}
+				/*
+				 * The planes have room for h / 2 rows of chroma, so an odd
+				 * last row shares the chroma of the one above.
+				 */
+				if (n == 2) {
+					yuv::rgba_to_uv(rows[0], rows[1],
+							u_plane + pair * u_pitch,
+							v_plane + pair * v_pitch, cw);
+				}
+			}
+			else {
+				/*
+				 * The last pixel of an odd row makes a pair with a copy of
+				 * itself. The row may only have room for its half.
+				 */
+				int odd = job.w % 2;
+				int room = job.pitches[0] - 4 * cw;
+				Uint8* ys = &temp[0];
+				Uint8* us = ys + job.w + 1;
+				Uint8* vs = us + cw + 1;
+				for (int i = 0; i < n; i++) {
+					Uint8* out = job.planes[0] + (y + i) * job.pitches[0];
+					if (odd) {
+						std::memcpy(rows[i] + 4 * job.w,
+								rows[i] + 4 * (job.w - 1), 4);
+					}
+					yuv::rgba_to_y(rows[i], ys, job.w + odd);
+					yuv::rgba_to_uv(rows[i], rows[i], us, vs, cw + odd);
+					yuv::pack(ys, us, vs, out, cw, job.fourcc);
+					if (odd) {
+						Uint8 last[4];
+						yuv::pack(ys + 2 * cw, us + cw, vs + cw, last, 1,
+								job.fourcc);
+						std::memcpy(out + 4 * cw, last, room < 4 ? room : 4);
+					}
+				}
+			}
+		}
+	}
+
+	/**
+	 * What the worker threads need to draw an overlay onto the display.
+	 */
+	struct Display
+	{
+		sdlpp::Pixel_format* format;
+		Uint8* pixels;
+		int pitch;
+		int bpp;
+		Uint32 fourcc;
+		Uint8** planes;
+		Uint16* pitches;
+		int w;
+		int h;
+
+		/** The part of the display we draw to. */
+		SDL_Rect dst;
+
+		/*
+		 * Where the first row and column of dst sample the overlay, and how
+		 * far apart the samples are, in 16.16 fixed point.
+		 */
+		int x_start;
+		int x_step;
+		int y_start;
+		int y_step;
+	};
+
+	/**
+	 * Converts one row of an overlay into rgba, with w * 4 bytes.
+	 *
+	 * @param temp Room for w + 2 * (w / 2 + 1) bytes.
+	 */
+	void Overlay_row(const Display& job, int y, Uint8* rgba, Uint8* temp)
+	{
+		using namespace sdlpp;
+		int cw = job.w / 2;
+		Uint8* ys = temp;
+		Uint8* us = ys + job.w;
+		Uint8* vs = us + cw + 1;
+		const Uint8* luma = ys;
+		const Uint8* u = us;
+		const Uint8* v = vs;
+
+		if (job.fourcc == SDL_IYUV_OVERLAY || job.fourcc == SDL_YV12_OVERLAY) {
+			luma = job.planes[0] + y * job.pitches[0];
+			int ch = job.h / 2;
+			if (cw == 0 || ch == 0) {
+				std::memset(us, 128, cw + 1);
+				std::memset(vs, 128, cw + 1);
+			}
+			else {
+				/* IYUV has U in the second plane, YV12 has V there. */
+				int ui = job.fourcc == SDL_IYUV_OVERLAY ? 1 : 2;
+				int vi = 3 - ui;
+				int cy = y / 2 < ch ? y / 2 : ch - 1;
+				u = job.planes[ui] + cy * job.pitches[ui];
+				v = job.planes[vi] + cy * job.pitches[vi];
+				if (job.w % 2) {
+					/* The last pixel of an odd row has no chroma of its own. */
+					std::memcpy(us, u, cw);
+					std::memcpy(vs, v, cw);
+					us[cw] = us[cw - 1];
+					vs[cw] = vs[cw - 1];
+					u = us;
+					v = vs;
+				}
+			}
+		}
+		else {
+			const Uint8* row = job.planes[0] + y * job.pitches[0];
+			yuv::unpack(row, ys, us, vs, cw, job.fourcc);
+			if (job.w % 2) {
+				/*
+				 * The last pixel may only have half a pair: its luma and one
+				 * chroma sample. The other sample is the one of the pair
+				 * before it.
+				 */
+				Uint8 last[4];
+				Uint8 luma_pair[2];
+				int room = job.pitches[0] - 4 * cw;
+				if (cw) {
+					std::memcpy(last, row + 4 * cw - 4, 4);
+				}
+				else {
+					std::memset(last, 128, 4);
+				}
+				std::memcpy(last, row + 4 * cw, room < 4 ? room : 4);
+				yuv::unpack(last, luma_pair, us + cw, vs + cw, 1, job.fourcc);
+				ys[job.w - 1] = luma_pair[0];
+			}
+		}
+		yuv::yuv_to_rgba(luma, u, v, rgba, job.w);
+	}
+
+	/**
+	 * Draws rows [begin, end) of the destination rectangle.
+	 */
+	void Display_rows(void* context, int begin, int end)
+	{
+		const Display& job = *static_cast<Display*>(context);
+		std::vector<Uint8> rgba(4 * job.w);
+		std::vector<Uint8> temp(2 * job.w + 2);
+		std::vector<Uint32> scaled(job.x_step == 1 << 16 ? 0 : job.dst.w);
+		int converted = -1;
+
+		for (int row = begin; row < end; row++) {
+			int y = (job.y_start + row * job.y_step) >> 16;
+			if (y != converted) {
+				Overlay_row(job, y, &rgba[0], &temp[0]);
+				converted = y;
+			}
+
+			const Uint8* line;
+			if (scaled.empty()) {
+				line = &rgba[4 * (job.x_start >> 16)];
+			}
+			else {
+				const Uint32* src = reinterpret_cast<const Uint32*>(&rgba[0]);
+				int x = job.x_start;
+				for (int i = 0; i < job.dst.w; i++, x += job.x_step) {
+					scaled[i] = src[x >> 16];
+				}
+				line = reinterpret_cast<const Uint8*>(&scaled[0]);
+			}
+			job.format->map(line, job.pixels + (job.dst.y + row) * job.pitch
+					+ job.dst.x * job.bpp, job.dst.w);
+		}
+	}
 }
 
 namespace sdlpp
@@ -50,4 +274,144 @@ namespace sdlpp
 			throw runtime_error("Attempted to copy-construct a NULL overlay");
 		}
 	}
+
+	Overlay::Plane Overlay::plane(int index)
+	{
+		if (index < 0 || index >= planes()) {
+			throw runtime_error("The overlay has no such plane");
+		}
+		int width = w();
+		int height = h();
+		switch (format()) {
+		case IYUV:
+		case YV12:
+			if (index > 0) {
+				width /= 2;
+				height /= 2;
+			}
+			break;
+		default:
+			width *= 2;
+			break;
+		}
+		return Plane(pixels()[index], width, height, pitches()[index]);
+	}
+
+	int Overlay::planar_index(int component) const
+	{
+		switch (format()) {
+		case IYUV:
+			return component;
+		case YV12:
+			/* Y, V, U */
+			return component == 0 ? 0 : 3 - component;
+		default:
+			throw runtime_error("The overlay is not in a planar format");
+		}
+	}
+
+	bool Overlay::upload(Surface& source)
+	{
+		switch (format()) {
+		case IYUV:
+		case YV12:
+		case YUY2:
+		case UYVY:
+		case YVYU:
+			break;
+		default:
+			return false;
+		}
+
+		Pixel_format pixel_format(*source.format());
+		Surface::Lock source_lock(source);
+		Lock lock(*this);
+		Upload job = {
+			&pixel_format,
+			static_cast<const Uint8*>(source_lock.pixels()),
+			source.pitch(),
+			source.w() < w() ? source.w() : w(),
+			source.h() < h() ? source.h() : h(),
+			format(),
+			lock.pixels(),
+			pitches()
+		};
+		parallel::for_rows((job.h + 1) / 2, Upload_rows, &job, 8);
+		return true;
+	}
+
+	bool Overlay::display(Rect& dstrect)
+	{
+		SDL_Surface* screen = SDL_GetVideoSurface();
+		if (hw_overlay() || screen == 0) {
+			return SDL_DisplayYUVOverlay(p.get(), &dstrect) == 0;
+		}
+		switch (format()) {
+		case IYUV:
+		case YV12:
+		case YUY2:
+		case UYVY:
+		case YVYU:
+			break;
+		default:
+			return SDL_DisplayYUVOverlay(p.get(), &dstrect) == 0;
+		}
+		if (dstrect.w == 0 || dstrect.h == 0) {
+			return true;
+		}
+
+		/* Clip to the screen, like SDL_DisplayYUVOverlay does. */
+		int x0 = dstrect.x > 0 ? dstrect.x : 0;
+		int y0 = dstrect.y > 0 ? dstrect.y : 0;
+		int x1 = dstrect.x + dstrect.w;
+		int y1 = dstrect.y + dstrect.h;
+		if (x1 > screen->w) {
+			x1 = screen->w;
+		}
+		if (y1 > screen->h) {
+			y1 = screen->h;
+		}
+		if (x0 >= x1 || y0 >= y1) {
+			return true;
+		}
+
+		Display job;
+		job.x_step = (w() << 16) / dstrect.w;
+		job.y_step = (h() << 16) / dstrect.h;
+		job.x_start = (x0 - dstrect.x) * job.x_step + job.x_step / 2;
+		job.y_start = (y0 - dstrect.y) * job.y_step + job.y_step / 2;
+		if (job.x_step == 1 << 16) {
+			job.x_start = (x0 - dstrect.x) << 16;
+		}
+		if (job.y_step == 1 << 16) {
+			job.y_start = (y0 - dstrect.y) << 16;
+		}
+		job.dst.x = x0;
+		job.dst.y = y0;
+		job.dst.w = x1 - x0;
+		job.dst.h = y1 - y0;
+
+		if (SDL_MUSTLOCK(screen) && SDL_LockSurface(screen) < 0) {
+			return false;
+		}
+		{
+			Pixel_format pixel_format(*screen->format);
+			Lock lock(*this);
+			job.format = &pixel_format;
+			job.pixels = static_cast<Uint8*>(screen->pixels);
+			job.pitch = screen->pitch;
+			job.bpp = screen->format->BytesPerPixel;
+			job.fourcc = format();
+			job.planes = lock.pixels();
+			job.pitches = pitches();
+			job.w = w();
+			job.h = h();
+			parallel::for_rows(job.dst.h, Display_rows, &job, 8);
+		}
+		if (SDL_MUSTLOCK(screen)) {
+			SDL_UnlockSurface(screen);
+		}
+		SDL_UpdateRects(screen, 1, &job.dst);
+		return true;
+	}
 }
@@ -0,0 +1,87 @@
+/* vim: set ts=4 sts=4 sw=4 tw=80: */
+#include <SDL++/overlay_ring.hpp>
+
+namespace sdlpp
+{
+	Overlay_ring::Overlay_ring(int width, int height, Uint32 format,
+			Video_surface& display, int count) :
+		free_frames(count),
+		ready_frames(count),
+		free_count(count),
+		filling(-1),
+		showing(-1)
+	{
+		if (count < 2) {
+			throw runtime_error("An Overlay_ring needs at least two overlays");
+		}
+		overlays.reserve(count);
+		for (int i = 0; i < count; i++) {
+			overlays.push_back(Overlay(width, height, format, display));
+			free_frames.push(i);
+		}
+	}
+
+	Overlay& Overlay_ring::begin_frame()
+	{
+		if (filling < 0) {
+			free_count.wait();
+			free_frames.pop(filling);
+		}
+		return overlays[filling];
+	}
+
+	Overlay* Overlay_ring::try_begin_frame()
+	{
+		if (filling < 0) {
+			if (!free_count.try_wait()) {
+				return 0;
+			}
+			free_frames.pop(filling);
+		}
+		return &overlays[filling];
+	}
+
+	void Overlay_ring::end_frame()
+	{
+		if (filling < 0) {
+			return;
+		}
+		/* There are as many slots as overlays, so this can't fail. */
+		ready_frames.push(filling);
+		filling = -1;
+	}
+
+	Overlay* Overlay_ring::next()
+	{
+		int index;
+		if (ready_frames.pop(index)) {
+			release(showing);
+			showing = index;
+		}
+		return showing < 0 ? 0 : &overlays[showing];
+	}
+
+	Overlay* Overlay_ring::latest()
+	{
+		int index;
+		while (ready_frames.pop(index)) {
+			release(showing);
+			showing = index;
+		}
+		return showing < 0 ? 0 : &overlays[showing];
+	}
+
+	bool Overlay_ring::display(Rect& dstrect)
+	{
+		Overlay* overlay = next();
+		return overlay != 0 && overlay->display(dstrect);
+	}
+
+	void Overlay_ring::release(int index)
+	{
+		if (index >= 0) {
+			free_frames.push(index);
+			free_count.post();
+		}
+	}
+}
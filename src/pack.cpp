@@ -0,0 +1,309 @@
+/* vim: set ts=4 sts=4 sw=4 tw=80: */
+#include <SDL++/pack.hpp>
+#include "mapped_file.hpp"
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+
+namespace
+{
+	using std::runtime_error;
+	using std::string;
+
+	const char MAGIC[8] = { 'S', 'D', 'L', 'P', 'P', 'A', 'C', 'K' };
+	const Uint32 VERSION = 1;
+
+	/** The magic, the version and the entry count. */
+	const size_t HEADER_SIZE = 16;
+
+	/** An index entry, less its name. */
+	const size_t ENTRY_SIZE = 14;
+
+	const size_t MAX_NAME_LENGTH = 0xffff;
+
+	/**
+	 * The table for CRC-32 as zlib and PNG compute it, a byte at a time.
+	 */
+	struct Crc_table
+	{
+		Crc_table()
+		{
+			for (Uint32 i = 0; i < 256; i++) {
+				Uint32 crc = i;
+				for (int bit = 0; bit < 8; bit++) {
+					crc = crc & 1 ? 0xedb88320 ^ (crc >> 1) : crc >> 1;
+				}
+				entries[i] = crc;
+			}
+		}
+
+		Uint32 entries[256];
+	};
+
+	const Crc_table CRC_TABLE;
+
+	/**
+	 * Carries on a CRC-32 over more bytes. Start with a crc of 0.
+	 */
+	Uint32 Crc32(Uint32 crc, const Uint8* bytes, size_t count)
+	{
+		crc = ~crc;
+		for (size_t i = 0; i < count; i++) {
+			crc = CRC_TABLE.entries[(crc ^ bytes[i]) & 0xff] ^ (crc >> 8);
+		}
+		return ~crc;
+	}
+
+	inline Uint32 Read16(const Uint8* bytes)
+	{
+		return bytes[0] | bytes[1] << 8;
+	}
+
+	inline Uint32 Read32(const Uint8* bytes)
+	{
+		return bytes[0] | bytes[1] << 8 | bytes[2] << 16
+			| static_cast<Uint32>(bytes[3]) << 24;
+	}
+
+	inline void Write16(Uint8* bytes, Uint32 value)
+	{
+		bytes[0] = value;
+		bytes[1] = value >> 8;
+	}
+
+	inline void Write32(Uint8* bytes, Uint32 value)
+	{
+		bytes[0] = value;
+		bytes[1] = value >> 8;
+		bytes[2] = value >> 16;
+		bytes[3] = value >> 24;
+	}
+
+	/**
+	 * Orders names byte by byte, as std::string does.
+	 */
+	int Compare(const char* a, size_t a_length, const char* b, size_t b_length)
+	{
+		int result = std::memcmp(a, b, std::min(a_length, b_length));
+		if (result != 0) {
+			return result;
+		}
+		return a_length < b_length ? -1 : a_length > b_length ? 1 : 0;
+	}
+
+	/**
+	 * Writes a whole buffer, or throws.
+	 */
+	void Write(FILE* fp, const void* bytes, size_t count,
+			const string& file_name)
+	{
+		if (std::fwrite(bytes, 1, count, fp) != count) {
+			throw runtime_error("Can't write " + file_name);
+		}
+	}
+}
+
+namespace sdlpp
+{
+	Pack::Pack(const string& file_name) :
+		file(new Mapped_file(file_name))
+	{
+		const Uint8* bytes = file->data();
+		const size_t size = file->size();
+		if (size < HEADER_SIZE || std::memcmp(bytes, MAGIC, sizeof MAGIC)) {
+			throw runtime_error(file_name + " is not a pack");
+		}
+		if (Read32(bytes + 8) != VERSION) {
+			throw runtime_error(file_name + " is a pack of another version");
+		}
+
+		const Uint32 count = Read32(bytes + 12);
+		entries.reserve(std::min<size_t>(count, size / ENTRY_SIZE));
+		size_t at = HEADER_SIZE;
+		for (Uint32 i = 0; i < count; i++) {
+			if (size - at < ENTRY_SIZE) {
+				throw runtime_error(file_name + ": index is cut short");
+			}
+			Entry entry;
+			entry.offset = Read32(bytes + at);
+			entry.length = Read32(bytes + at + 4);
+			entry.checksum = Read32(bytes + at + 8);
+			entry.name_length = Read16(bytes + at + 12);
+			at += ENTRY_SIZE;
+			if (size - at < entry.name_length) {
+				throw runtime_error(file_name + ": index is cut short");
+			}
+			entry.name = reinterpret_cast<const char*>(bytes + at);
+			at += entry.name_length;
+
+			if (entry.offset > size || entry.length > size - entry.offset) {
+				throw runtime_error(file_name + ": entry "
+						+ string(entry.name, entry.name_length)
+						+ " lies past the end");
+			}
+
+			/* Finding entries relies on the order. */
+			if (!entries.empty() && Compare(entries.back().name,
+						entries.back().name_length, entry.name,
+						entry.name_length) >= 0) {
+				throw runtime_error(file_name + ": index is out of order");
+			}
+			entries.push_back(entry);
+		}
+	}
+
+	int Pack::size() const
+	{
+		return entries.size();
+	}
+
+	string Pack::name(int index) const
+	{
+		const Entry& entry = entries.at(index);
+		return string(entry.name, entry.name_length);
+	}
+
+	bool Pack::contains(const string& name) const
+	{
+		return find(name) != 0;
+	}
+
+	bool Pack::verify(const string& name) const
+	{
+		const Entry* entry = find(name);
+		if (entry == 0) {
+			throw runtime_error("No entry " + name + " in pack");
+		}
+		return Crc32(0, data(*entry), entry->length) == entry->checksum;
+	}
+
+	const Pack::Entry* Pack::find(const string& name) const
+	{
+		size_t low = 0;
+		size_t high = entries.size();
+		while (low < high) {
+			size_t middle = low + (high - low) / 2;
+			const Entry& entry = entries[middle];
+			int order = Compare(entry.name, entry.name_length, name.data(),
+					name.size());
+			if (order == 0) {
+				return &entry;
+			}
+			if (order < 0) {
+				low = middle + 1;
+			}
+			else {
+				high = middle;
+			}
+		}
+		return 0;
+	}
+
+	const Uint8* Pack::data(const Entry& entry) const
+	{
+		return file->data() + entry.offset;
+	}
+
+	void Pack::Writer::add(const string& name, const string& file_name)
+	{
+		if (name.size() > MAX_NAME_LENGTH) {
+			throw runtime_error("Pack entry name is too long: " + name);
+		}
+		files.push_back(std::make_pair(name, file_name));
+	}
+
+	void Pack::Writer::write(const string& file_name) const
+	{
+		std::vector<std::pair<string, string> > sorted(files);
+		std::sort(sorted.begin(), sorted.end());
+		size_t index_size = 0;
+		for (size_t i = 0; i < sorted.size(); i++) {
+			if (i > 0 && sorted[i].first == sorted[i - 1].first) {
+				throw runtime_error("Two pack entries are named "
+						+ sorted[i].first);
+			}
+			index_size += ENTRY_SIZE + sorted[i].first.size();
+		}
+
+		FILE* fp = std::fopen(file_name.c_str(), "wb");
+		if (fp == 0) {
+			throw runtime_error("Can't create " + file_name);
+		}
+		try {
+			Uint8 header[HEADER_SIZE];
+			std::memcpy(header, MAGIC, sizeof MAGIC);
+			Write32(header + 8, VERSION);
+			Write32(header + 12, sorted.size());
+			Write(fp, header, sizeof header, file_name);
+
+			/*
+			 * Lengths and checksums are known once the files are copied, so
+			 * the index is written twice: first to make room for it, then
+			 * for real.
+			 */
+			std::vector<Uint8> index(index_size);
+			if (index_size > 0) {
+				Write(fp, &index[0], index_size, file_name);
+			}
+
+			Uint64 offset = HEADER_SIZE + index_size;
+			Uint8* at = index.empty() ? 0 : &index[0];
+			std::vector<Uint8> buffer(65536);
+			for (size_t i = 0; i < sorted.size(); i++) {
+				const string& name = sorted[i].first;
+				const string& source_name = sorted[i].second;
+				FILE* source = std::fopen(source_name.c_str(), "rb");
+				if (source == 0) {
+					throw runtime_error("Can't open " + source_name);
+				}
+				Uint64 length = 0;
+				Uint32 crc = 0;
+				size_t count;
+				while ((count = std::fread(&buffer[0], 1, buffer.size(),
+								source)) > 0) {
+					if (std::fwrite(&buffer[0], 1, count, fp) != count) {
+						std::fclose(source);
+						throw runtime_error("Can't write " + file_name);
+					}
+					crc = Crc32(crc, &buffer[0], count);
+					length += count;
+				}
+				bool failed = std::ferror(source) != 0;
+				std::fclose(source);
+				if (failed) {
+					throw runtime_error("Can't read " + source_name);
+				}
+				if (offset + length > 0xffffffff) {
+					throw runtime_error(file_name + " would be over 4 GB");
+				}
+
+				Write32(at, offset);
+				Write32(at + 4, length);
+				Write32(at + 8, crc);
+				Write16(at + 12, name.size());
+				std::memcpy(at + ENTRY_SIZE, name.data(), name.size());
+				at += ENTRY_SIZE + name.size();
+				offset += length;
+			}
+
+			if (index_size > 0) {
+				if (std::fseek(fp, HEADER_SIZE, SEEK_SET) != 0) {
+					throw runtime_error("Can't seek in " + file_name);
+				}
+				Write(fp, &index[0], index_size, file_name);
+			}
+			if (std::fclose(fp) != 0) {
+				fp = 0;
+				throw runtime_error("Can't write " + file_name);
+			}
+		}
+		catch (...) {
+			/* Don't leave half a pack behind. */
+			if (fp != 0) {
+				std::fclose(fp);
+			}
+			std::remove(file_name.c_str());
+			throw;
+		}
+	}
+}
@@ -0,0 +1,606 @@
+/* vim: set ts=4 sts=4 sw=4 tw=80: */
+#include <SDL++/painter.hpp>
+#include "span.hpp"
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+
+namespace
+{
+	using sdlpp::Painter;
+	using std::vector;
+
+	const double PI = 3.14159265358979323846;
+
+	/** Rows of anti-aliased polygons are sampled this many times. */
+	const int SUBSAMPLES = 4;
+
+	/** How far arcs may stray from the true curve, in pixels. */
+	const double ARC_TOLERANCE = 0.1;
+
+	/**
+	 * An edge of a polygon, from its top down, without its bottom.
+	 */
+	struct Edge
+	{
+		double y0;
+		double y1;
+
+		/** The x at y0, and how much it grows per row. */
+		double x0;
+		double slope;
+
+		/** 1 if the outline goes down along the edge, -1 if up. */
+		int winding;
+	};
+
+	struct Crossing
+	{
+		double x;
+		int winding;
+	};
+
+	bool Edge_above(const Edge& a, const Edge& b)
+	{
+		return a.y0 < b.y0;
+	}
+
+	bool Crossing_before(const Crossing& a, const Crossing& b)
+	{
+		return a.x < b.x;
+	}
+
+	inline double Fraction(double x)
+	{
+		return x - std::floor(x);
+	}
+
+	/**
+	 * Clips a line to a rectangle, the Liang-Barsky way.
+	 *
+	 * @return false if none of the line is left.
+	 */
+	bool Clip_line(double& x0, double& y0, double& x1, double& y1,
+			double left, double top, double right, double bottom)
+	{
+		double dx = x1 - x0;
+		double dy = y1 - y0;
+		double p[4] = { -dx, dx, -dy, dy };
+		double q[4] = { x0 - left, right - x0, y0 - top, bottom - y0 };
+		double t0 = 0;
+		double t1 = 1;
+		for (int i = 0; i < 4; i++) {
+			if (p[i] == 0) {
+				if (q[i] < 0) {
+					return false;
+				}
+				continue;
+			}
+			double t = q[i] / p[i];
+			if (p[i] < 0) {
+				if (t > t1) {
+					return false;
+				}
+				t0 = t > t0 ? t : t0;
+			}
+			else {
+				if (t < t0) {
+					return false;
+				}
+				t1 = t < t1 ? t : t1;
+			}
+		}
+		double ox = x0;
+		double oy = y0;
+		x0 = ox + t0 * dx;
+		y0 = oy + t0 * dy;
+		x1 = ox + t1 * dx;
+		y1 = oy + t1 * dy;
+		return true;
+	}
+
+	/**
+	 * @return How many segments a quarter of a circle needs to stay within
+	 * ARC_TOLERANCE of it.
+	 */
+	int Quarter_segments(double radius)
+	{
+		if (radius <= ARC_TOLERANCE) {
+			return 1;
+		}
+		double step = 2 * std::acos(1 - ARC_TOLERANCE / radius);
+		int segments = static_cast<int>(std::ceil(PI / 2 / step));
+		return segments > 2 ? segments : 2;
+	}
+
+	/**
+	 * Adds the points of a quarter of a circle, from angle from on.
+	 */
+	void Add_arc(vector<Painter::Point>& points, double x, double y,
+			double radius, double from, int segments)
+	{
+		for (int i = 0; i <= segments; i++) {
+			double angle = from + PI / 2 * i / segments;
+			points.push_back(Painter::Point(x + radius * std::cos(angle),
+						y + radius * std::sin(angle)));
+		}
+	}
+
+	/**
+	 * Adds how much of each pixel the span [xa, xb) of one sample covers.
+	 * Pixels it covers whole are counted in delta, where they start and
+	 * where they end, to be summed up along the row. The cells written to
+	 * are added to cells.
+	 */
+	void Accumulate(float* cover, float* delta, double xa, double xb,
+			float weight, vector<int>& cells)
+	{
+		int ia = static_cast<int>(std::floor(xa));
+		int ib = static_cast<int>(std::floor(xb));
+		cells.push_back(ia);
+		if (ia == ib) {
+			cover[ia] += (xb - xa) * weight;
+			return;
+		}
+		cover[ia] += (ia + 1 - xa) * weight;
+		delta[ia + 1] += weight;
+		delta[ib] -= weight;
+		cover[ib] += (xb - ib) * weight;
+		cells.push_back(ia + 1);
+		cells.push_back(ib);
+	}
+
+	inline Uint8 To_alpha(float coverage, Uint8 alpha)
+	{
+		int a = static_cast<int>(coverage * alpha + 0.5f);
+		return a < 0 ? 0 : a > 255 ? 255 : a;
+	}
+}
+
+namespace sdlpp
+{
+	Painter::Painter(Surface& target) :
+		target(target),
+		surface(target.raw_ptr()),
+		format(*surface->format),
+		must_lock(SDL_MUSTLOCK(surface)),
+		antialiasing(false),
+		direct(surface->format->BytesPerPixel == 4
+				&& surface->format->palette == 0),
+		pixel(0),
+		alpha(SDL_ALPHA_OPAQUE),
+		color_row(4 * surface->w),
+		alpha_row(surface->w),
+		coverage(surface->w),
+		cover(surface->w + 1),
+		cover_delta(surface->w + 1),
+		scratch(direct ? 0 : 4 * surface->w)
+	{
+		if (must_lock && SDL_LockSurface(surface) < 0) {
+			throw runtime_error(std::string()
+					+ "Can't lock a surface to paint on it: "
+					+ SDL_GetError());
+		}
+		set_color(0, 0, 0);
+	}
+
+	Painter::~Painter()
+	{
+		if (must_lock) {
+			SDL_UnlockSurface(surface);
+		}
+	}
+
+	void Painter::set_color(Uint8 r, Uint8 g, Uint8 b, Uint8 a)
+	{
+		pixel = SDL_MapRGBA(surface->format, r, g, b, a);
+		alpha = a;
+		std::fill(alpha_row.begin(), alpha_row.end(), a);
+		if (direct) {
+			span::fill(&color_row[0], pixel, surface->w, 4);
+			return;
+		}
+		for (int x = 0; x < surface->w; x++) {
+			color_row[4 * x] = r;
+			color_row[4 * x + 1] = g;
+			color_row[4 * x + 2] = b;
+			color_row[4 * x + 3] = a;
+		}
+	}
+
+	void Painter::set_antialiasing(bool on)
+	{
+		antialiasing = on;
+	}
+
+	void Painter::line(double x0, double y0, double x1, double y1)
+	{
+		if (antialiasing) {
+			smooth_line(x0, y0, x1, y1);
+		}
+		else {
+			plain_line(x0, y0, x1, y1, true);
+		}
+	}
+
+	void Painter::polyline(const vector<Point>& points, bool closed)
+	{
+		if (points.size() < 2) {
+			if (!points.empty()) {
+				line(points[0].x, points[0].y, points[0].x, points[0].y);
+			}
+			return;
+		}
+		size_t count = closed ? points.size() : points.size() - 1;
+		for (size_t i = 0; i < count; i++) {
+			const Point& a = points[i];
+			const Point& b = points[(i + 1) % points.size()];
+			if (antialiasing) {
+				smooth_line(a.x, a.y, b.x, b.y);
+			}
+			else {
+				plain_line(a.x, a.y, b.x, b.y, !closed && i + 1 == count);
+			}
+		}
+	}
+
+	void Painter::polygon(const vector<Point>& points)
+	{
+		vector<Edge> edges;
+		edges.reserve(points.size());
+		double bottom = 0;
+		for (size_t i = 0; i < points.size(); i++) {
+			const Point& a = points[i];
+			const Point& b = points[(i + 1) % points.size()];
+			if (a.y == b.y) {
+				continue;
+			}
+			const Point& top = a.y < b.y ? a : b;
+			const Point& end = a.y < b.y ? b : a;
+			Edge edge = { top.y, end.y, top.x,
+				(end.x - top.x) / (end.y - top.y), a.y < b.y ? 1 : -1 };
+			edges.push_back(edge);
+			bottom = edges.size() == 1 || end.y > bottom ? end.y : bottom;
+		}
+		if (edges.empty()) {
+			return;
+		}
+		std::sort(edges.begin(), edges.end(), Edge_above);
+
+		const SDL_Rect& clip = surface->clip_rect;
+		const int left = clip.x;
+		const int right = clip.x + clip.w;
+		int first = static_cast<int>(std::floor(std::max<double>(edges[0].y0,
+						clip.y)));
+		int last = static_cast<int>(std::ceil(std::min<double>(bottom,
+						clip.y + clip.h)));
+		const int samples = antialiasing ? SUBSAMPLES : 1;
+		const float weight = 1.0f / samples;
+
+		vector<size_t> active;
+		vector<Crossing> crossings;
+		vector<int> cells;
+		size_t next = 0;
+		for (int y = first; y < last; y++) {
+			cells.clear();
+			for (int s = 0; s < samples; s++) {
+				double ys = y + (s + 0.5) / samples;
+				while (next < edges.size() && edges[next].y0 <= ys) {
+					active.push_back(next++);
+				}
+				size_t kept = 0;
+				crossings.clear();
+				for (size_t i = 0; i < active.size(); i++) {
+					const Edge& e = edges[active[i]];
+					if (e.y1 <= ys) {
+						continue;
+					}
+					active[kept++] = active[i];
+					Crossing c = { e.x0 + (ys - e.y0) * e.slope, e.winding };
+					crossings.push_back(c);
+				}
+				active.resize(kept);
+				std::sort(crossings.begin(), crossings.end(), Crossing_before);
+
+				int winding = 0;
+				double start = 0;
+				for (size_t i = 0; i < crossings.size(); i++) {
+					int before = winding;
+					winding += crossings[i].winding;
+					if (before == 0 && winding != 0) {
+						start = crossings[i].x;
+						continue;
+					}
+					if (before == 0 || winding != 0) {
+						continue;
+					}
+					double xa = std::max<double>(start, left);
+					double xb = std::min<double>(crossings[i].x, right);
+					if (xa >= xb) {
+						continue;
+					}
+					if (antialiasing) {
+						Accumulate(&cover[0], &cover_delta[0], xa, xb, weight,
+								cells);
+					}
+					else {
+						/* The pixels whose centres are in [xa, xb). */
+						fill_span(y, static_cast<int>(std::ceil(xa - 0.5)),
+								static_cast<int>(std::ceil(xb - 0.5)));
+					}
+				}
+			}
+			if (cells.empty()) {
+				continue;
+			}
+
+			/*
+			 * Turn the coverage of the row into alphas, and clear it. Between
+			 * the cells written to, it is the same all along.
+			 */
+			std::sort(cells.begin(), cells.end());
+			cells.erase(std::unique(cells.begin(), cells.end()), cells.end());
+			const int lo = cells.front();
+			const int end = std::min(cells.back() + 1, right);
+			float whole = 0;
+			int x = lo;
+			for (size_t i = 0; i < cells.size(); i++) {
+				int cell = cells[i];
+				if (x < cell && x < right) {
+					std::memset(&coverage[x], To_alpha(whole, alpha),
+							std::min(cell, right) - x);
+				}
+				whole += cover_delta[cell];
+				if (cell < right) {
+					coverage[cell] = To_alpha(cover[cell] + whole, alpha);
+				}
+				cover[cell] = cover_delta[cell] = 0;
+				x = cell + 1;
+			}
+			for (x = lo; x < end; ) {
+				int start = x;
+				if (coverage[x] == 0) {
+					x++;
+				}
+				else if (coverage[x] == 255) {
+					while (x < end && coverage[x] == 255) {
+						x++;
+					}
+					fill_span(y, start, x);
+				}
+				else {
+					while (x < end && coverage[x] != 0 && coverage[x] != 255) {
+						x++;
+					}
+					blend(y, start, &coverage[start], x - start);
+				}
+			}
+		}
+	}
+
+	void Painter::circle(double x, double y, double radius)
+	{
+		if (radius <= 0) {
+			return;
+		}
+		int segments = Quarter_segments(radius);
+		vector<Point> points;
+		points.reserve(4 * (segments + 1));
+		for (int quarter = 0; quarter < 4; quarter++) {
+			Add_arc(points, x, y, radius, quarter * PI / 2, segments);
+		}
+		polygon(points);
+	}
+
+	void Painter::rounded_rect(const Rect& rect, double radius)
+	{
+		double x0 = rect.x;
+		double y0 = rect.y;
+		double x1 = x0 + rect.w;
+		double y1 = y0 + rect.h;
+		double r = std::min(radius, std::min(rect.w, rect.h) / 2.0);
+		vector<Point> points;
+		if (r <= 0) {
+			points.push_back(Point(x0, y0));
+			points.push_back(Point(x1, y0));
+			points.push_back(Point(x1, y1));
+			points.push_back(Point(x0, y1));
+			polygon(points);
+			return;
+		}
+		int segments = Quarter_segments(r);
+		points.reserve(4 * (segments + 1));
+		Add_arc(points, x1 - r, y0 + r, r, -PI / 2, segments);
+		Add_arc(points, x1 - r, y1 - r, r, 0, segments);
+		Add_arc(points, x0 + r, y1 - r, r, PI / 2, segments);
+		Add_arc(points, x0 + r, y0 + r, r, PI, segments);
+		polygon(points);
+	}
+
+	void Painter::plain_line(double x0, double y0, double x1, double y1,
+			bool last)
+	{
+		/* Clipping with a margin keeps the pixels inside where they'd be. */
+		const SDL_Rect& clip = surface->clip_rect;
+		if (!Clip_line(x0, y0, x1, y1, clip.x - 1, clip.y - 1,
+					clip.x + clip.w + 1, clip.y + clip.h + 1)) {
+			return;
+		}
+		int x = static_cast<int>(std::floor(x0));
+		int y = static_cast<int>(std::floor(y0));
+		const int end_x = static_cast<int>(std::floor(x1));
+		const int end_y = static_cast<int>(std::floor(y1));
+		const int dx = std::abs(end_x - x);
+		const int dy = -std::abs(end_y - y);
+		const int step_x = x < end_x ? 1 : -1;
+		const int step_y = y < end_y ? 1 : -1;
+		int error = dx + dy;
+
+		/* Bresenham's, gathering pixels into runs along rows. */
+		bool have_run = false;
+		int run_y = 0;
+		int run_lo = 0;
+		int run_hi = 0;
+		for (;;) {
+			bool at_end = x == end_x && y == end_y;
+			if (at_end && !last) {
+				break;
+			}
+			if (have_run && y == run_y
+					&& (x == run_hi + 1 || x == run_lo - 1)) {
+				run_lo = x < run_lo ? x : run_lo;
+				run_hi = x > run_hi ? x : run_hi;
+			}
+			else {
+				if (have_run) {
+					fill_span(run_y, run_lo, run_hi + 1);
+				}
+				have_run = true;
+				run_y = y;
+				run_lo = run_hi = x;
+			}
+			if (at_end) {
+				break;
+			}
+			int twice = 2 * error;
+			if (twice >= dy) {
+				error += dy;
+				x += step_x;
+			}
+			if (twice <= dx) {
+				error += dx;
+				y += step_y;
+			}
+		}
+		if (have_run) {
+			fill_span(run_y, run_lo, run_hi + 1);
+		}
+	}
+
+	void Painter::smooth_line(double x0, double y0, double x1, double y1)
+	{
+		const SDL_Rect& clip = surface->clip_rect;
+		if (!Clip_line(x0, y0, x1, y1, clip.x - 2, clip.y - 2,
+					clip.x + clip.w + 2, clip.y + clip.h + 2)) {
+			return;
+		}
+		/* Xiaolin Wu's, with pixel centres on whole coordinates. */
+		x0 -= 0.5;
+		y0 -= 0.5;
+		x1 -= 0.5;
+		y1 -= 0.5;
+		bool steep = std::fabs(y1 - y0) > std::fabs(x1 - x0);
+		if (steep) {
+			std::swap(x0, y0);
+			std::swap(x1, y1);
+		}
+		if (x0 > x1) {
+			std::swap(x0, x1);
+			std::swap(y0, y1);
+		}
+		double dx = x1 - x0;
+		double gradient = dx == 0 ? 1 : (y1 - y0) / dx;
+
+		/* The ends cover their pixels by how far the line reaches in. */
+		int ends[2];
+		double along = 0;
+		for (int i = 0; i < 2; i++) {
+			double x = i == 0 ? x0 : x1;
+			double y = i == 0 ? y0 : y1;
+			double end_x = std::floor(x + 0.5);
+			double end_y = y + gradient * (end_x - x);
+			double gap = i == 0 ? 1 - Fraction(x + 0.5) : Fraction(x + 0.5);
+			int px = static_cast<int>(end_x);
+			int py = static_cast<int>(std::floor(end_y));
+			int f = static_cast<int>(Fraction(end_y) * 255 + 0.5);
+			int g = static_cast<int>(gap * 255 + 0.5);
+			if (steep) {
+				plot(py, px, span::div255((255 - f) * g));
+				plot(py + 1, px, span::div255(f * g));
+			}
+			else {
+				plot(px, py, span::div255((255 - f) * g));
+				plot(px, py + 1, span::div255(f * g));
+			}
+			ends[i] = px;
+			if (i == 0) {
+				along = end_y + gradient;
+			}
+		}
+
+		/*
+		 * In between, step along in 16.16 fixed point; the clipping keeps it
+		 * well within range.
+		 */
+		const int step = static_cast<int>(gradient * 65536);
+		int y = static_cast<int>(std::floor(along * 65536));
+		for (int x = ends[0] + 1; x < ends[1]; x++, y += step) {
+			int row = y >> 16;
+			int f = (y >> 8) & 0xFF;
+			if (steep) {
+				plot(row, x, 255 - f);
+				plot(row + 1, x, f);
+			}
+			else {
+				plot(x, row, 255 - f);
+				plot(x, row + 1, f);
+			}
+		}
+	}
+
+	void Painter::fill_span(int y, int x0, int x1)
+	{
+		const SDL_Rect& clip = surface->clip_rect;
+		if (y < clip.y || y >= clip.y + clip.h) {
+			return;
+		}
+		x0 = x0 > clip.x ? x0 : clip.x;
+		x1 = x1 < clip.x + clip.w ? x1 : clip.x + clip.w;
+		if (x0 >= x1 || alpha == SDL_ALPHA_TRANSPARENT) {
+			return;
+		}
+		if (alpha == SDL_ALPHA_OPAQUE) {
+			const int bpp = surface->format->BytesPerPixel;
+			span::fill(static_cast<Uint8*>(surface->pixels) + y * surface->pitch
+					+ x0 * bpp, pixel, x1 - x0, bpp);
+			return;
+		}
+		blend(y, x0, &alpha_row[x0], x1 - x0);
+	}
+
+	void Painter::blend(int y, int x, const Uint8* alphas, int count)
+	{
+		Uint8* out = static_cast<Uint8*>(surface->pixels) + y * surface->pitch
+			+ x * surface->format->BytesPerPixel;
+		if (direct) {
+			span::blend32(&color_row[0], alphas, out, count,
+					~surface->format->Amask);
+			return;
+		}
+		format.get(out, &scratch[0], count);
+		span::blend_rgba(&color_row[0], alphas, &scratch[0], count);
+		format.map(&scratch[0], out, count);
+	}
+
+	void Painter::plot(int x, int y, int amount)
+	{
+		const SDL_Rect& clip = surface->clip_rect;
+		if (x < clip.x || x >= clip.x + clip.w
+				|| y < clip.y || y >= clip.y + clip.h) {
+			return;
+		}
+		Uint8 a = span::div255(amount * alpha);
+		if (a == 0) {
+			return;
+		}
+		if (direct) {
+			span::blend_pixel32(pixel, a,
+					static_cast<Uint8*>(surface->pixels) + y * surface->pitch
+					+ 4 * x, ~surface->format->Amask);
+			return;
+		}
+		blend(y, x, &a, 1);
+	}
+}
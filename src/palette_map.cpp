@@ -0,0 +1,164 @@
+/* vim: set ts=4 sts=4 sw=4 tw=80: */
+#include <SDL++/palette_map.hpp>
+#include <cstring>
+
+namespace
+{
+	/**
+	 * The cells are 16 units wide along each axis.
+	 */
+	const int CELL_BITS = 4;
+	const int CELL_SIZE = 1 << CELL_BITS;
+	const int CELLS_PER_AXIS = 1 << (8 - CELL_BITS);
+	const int CELLS = CELLS_PER_AXIS * CELLS_PER_AXIS * CELLS_PER_AXIS;
+
+	SDL_Palette* GetPalette(sdlpp::Surface& surface)
+	{
+		SDL_Palette* palette = surface.format()->palette;
+		if (palette == 0) {
+			throw std::runtime_error(
+					"Attempted to create a Palette_map for a surface without "
+					"a palette");
+		}
+		return palette;
+	}
+
+	inline int Square(int x)
+	{
+		return x * x;
+	}
+
+	/**
+	 * @return The squared distance between c and the nearest point of
+	 * [lo, lo + CELL_SIZE - 1].
+	 */
+	inline int Near(int c, int lo)
+	{
+		int hi = lo + CELL_SIZE - 1;
+		return c < lo ? Square(lo - c) : c > hi ? Square(c - hi) : 0;
+	}
+
+	/**
+	 * @return The squared distance between c and the farthest point of
+	 * [lo, lo + CELL_SIZE - 1].
+	 */
+	inline int Far(int c, int lo)
+	{
+		int hi = lo + CELL_SIZE - 1;
+		return c - lo > hi - c ? Square(c - lo) : Square(hi - c);
+	}
+}
+
+namespace sdlpp
+{
+	Uint32 Palette_map::Generation = 0;
+
+	Palette_map::Palette_map(Surface& surface) :
+		surface(surface),
+		generation(__atomic_load_n(&Generation, __ATOMIC_RELAXED))
+	{
+		rebuild();
+	}
+
+	void Palette_map::map(const Uint8* rgba, Uint8* pixels, size_t count)
+	{
+		for (size_t i = 0; i < count; i++, rgba += 4) {
+			pixels[i] = map(rgba[0], rgba[1], rgba[2]);
+		}
+	}
+
+	void Palette_map::rebuild()
+	{
+		SDL_Palette* palette = GetPalette(surface);
+		colors.assign(palette->colors, palette->colors + palette->ncolors);
+		Cell empty = { 0, 0 };
+		cells.assign(CELLS, empty);
+		candidates.clear();
+		last_r = last_g = last_b = 0;
+		last_index = search(0, 0, 0);
+	}
+
+	void Palette_map::palette_changed()
+	{
+		__atomic_add_fetch(&Generation, 1, __ATOMIC_RELAXED);
+	}
+
+	void Palette_map::refresh()
+	{
+		generation = __atomic_load_n(&Generation, __ATOMIC_RELAXED);
+		SDL_Palette* palette = GetPalette(surface);
+		if (palette->ncolors != static_cast<int>(colors.size())
+				|| (palette->ncolors > 0 && std::memcmp(palette->colors,
+						&colors[0], colors.size() * sizeof(SDL_Color)) != 0)) {
+			rebuild();
+		}
+	}
+
+	Uint8 Palette_map::search(Uint8 r, Uint8 g, Uint8 b)
+	{
+		unsigned index = (r >> CELL_BITS) << (2 * (8 - CELL_BITS))
+			| (g >> CELL_BITS) << (8 - CELL_BITS)
+			| b >> CELL_BITS;
+		Cell& cell = cells[index];
+		if (cell.count == 0) {
+			if (colors.empty()) {
+				return 0;
+			}
+			build(cell, index);
+		}
+
+		/*
+		 * Like SDL_FindColor, we keep the first of equally near entries. The
+		 * candidates are in palette order, so we find the same one.
+		 */
+		const Uint8* it = &candidates[cell.first];
+		const Uint8* end = it + cell.count;
+		Uint8 best = *it;
+		int best_distance = 0x7fffffff;
+		for (; it != end; ++it) {
+			const SDL_Color& c = colors[*it];
+			int distance = Square(c.r - r) + Square(c.g - g)
+				+ Square(c.b - b);
+			if (distance < best_distance) {
+				best = *it;
+				best_distance = distance;
+				if (distance == 0) {
+					break;
+				}
+			}
+		}
+		return best;
+	}
+
+	void Palette_map::build(Cell& cell, unsigned index)
+	{
+		int r = (index >> (2 * (8 - CELL_BITS))) << CELL_BITS;
+		int g = ((index >> (8 - CELL_BITS)) & (CELLS_PER_AXIS - 1)) << CELL_BITS;
+		int b = (index & (CELLS_PER_AXIS - 1)) << CELL_BITS;
+
+		/*
+		 * Every color in the cell is at most bound away from some entry, so
+		 * an entry that is farther than bound from the whole cell can never
+		 * be the nearest.
+		 */
+		int n = colors.size();
+		vector<int> near(n);
+		int bound = 0x7fffffff;
+		for (int i = 0; i < n; i++) {
+			const SDL_Color& c = colors[i];
+			near[i] = Near(c.r, r) + Near(c.g, g) + Near(c.b, b);
+			int far = Far(c.r, r) + Far(c.g, g) + Far(c.b, b);
+			if (far < bound) {
+				bound = far;
+			}
+		}
+
+		cell.first = candidates.size();
+		for (int i = 0; i < n; i++) {
+			if (near[i] <= bound) {
+				candidates.push_back(i);
+			}
+		}
+		cell.count = candidates.size() - cell.first;
+	}
+}
@@ -0,0 +1,200 @@
+/* vim: set ts=4 sts=4 sw=4 tw=80: */
+#include "parallel.hpp"
+#include "sync.hpp"
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <unistd.h>
+#endif
+
+namespace
+{
+	using namespace sdlpp::parallel;
+
+	/**
+	 * The most workers we start, however many CPUs there are.
+	 */
+	const int MAX_WORKERS = 31;
+
+	/**
+	 * How many bands we cut per thread, so threads that finish early can
+	 * help with the rest.
+	 */
+	const int BANDS_PER_THREAD = 4;
+
+	/*
+	 * A job is published in a single 64-bit ticket: the job's generation,
+	 * its number of bands, and the next band to hand out. Threads claim
+	 * bands by bumping the ticket, and only read the job's other fields
+	 * after a successful claim. A job can't finish while one of its bands
+	 * is claimed, so those fields can't change under a thread that holds a
+	 * claim, even if it woke up late.
+	 */
+	const int BAND_BITS = 20;
+	const Uint64 BAND_MASK = (1 << BAND_BITS) - 1;
+
+	struct Pool
+	{
+		/** Set while a for_rows() call owns the pool. */
+		int busy;
+
+		/** Bumped for every job; idle workers sleep on it. */
+		int wake;
+
+		/** Bands of the current job that aren't done yet. */
+		int pending;
+
+		Uint64 ticket;
+
+		Band_func func;
+		void* context;
+		int rows;
+		int band_rows;
+
+		int workers;
+		bool started;
+	};
+
+	Pool pool;
+
+	int Cpu_count()
+	{
+#ifdef _SC_NPROCESSORS_ONLN
+		long n = sysconf(_SC_NPROCESSORS_ONLN);
+		return n > 0 ? n : 1;
+#else
+		return 1;
+#endif
+	}
+
+	/**
+	 * Claims the next band of the current job.
+	 *
+	 * @return false if all bands are handed out.
+	 */
+	bool Claim(int& band)
+	{
+		Uint64 ticket = __atomic_load_n(&pool.ticket, __ATOMIC_RELAXED);
+		for (;;) {
+			Uint64 next = ticket & BAND_MASK;
+			Uint64 bands = (ticket >> BAND_BITS) & BAND_MASK;
+			if (next >= bands) {
+				return false;
+			}
+			if (__atomic_compare_exchange_n(&pool.ticket, &ticket, ticket + 1,
+						true, __ATOMIC_ACQUIRE, __ATOMIC_RELAXED)) {
+				band = next;
+				return true;
+			}
+		}
+	}
+
+	/**
+	 * Runs bands of the current job until none are left.
+	 */
+	void Work()
+	{
+		int band;
+		while (Claim(band)) {
+			int begin = band * pool.band_rows;
+			int end = begin + pool.band_rows;
+			if (end > pool.rows) {
+				end = pool.rows;
+			}
+			pool.func(pool.context, begin, end);
+			if (__atomic_sub_fetch(&pool.pending, 1, __ATOMIC_ACQ_REL) == 0) {
+				sdlpp::sync::futex_wake_all(&pool.pending);
+			}
+		}
+	}
+
+	int Worker(void*)
+	{
+		for (;;) {
+			int wake = __atomic_load_n(&pool.wake, __ATOMIC_ACQUIRE);
+			Work();
+			sdlpp::sync::futex_wait(&pool.wake, wake);
+		}
+		return 0;
+	}
+
+	void Start()
+	{
+		pool.started = true;
+		pool.workers = Cpu_count() - 1;
+		if (pool.workers > MAX_WORKERS) {
+			pool.workers = MAX_WORKERS;
+		}
+		for (int i = 0; i < pool.workers; i++) {
+			/*
+			 * The workers live as long as the process. If we can't start
+			 * one, we make do with those we have.
+			 */
+			if (SDL_CreateThread(Worker, 0) == 0) {
+				pool.workers = i;
+				break;
+			}
+		}
+	}
+}
+
+namespace sdlpp
+{
+	namespace parallel
+	{
+		void for_rows(int rows, Band_func func, void* context, int min_rows)
+		{
+			if (rows <= 0) {
+				return;
+			}
+			if (min_rows < 1) {
+				min_rows = 1;
+			}
+			if (rows < 2 * min_rows
+					|| __atomic_exchange_n(&pool.busy, 1, __ATOMIC_ACQUIRE)) {
+				func(context, 0, rows);
+				return;
+			}
+			if (!pool.started) {
+				Start();
+			}
+			if (pool.workers == 0) {
+				__atomic_store_n(&pool.busy, 0, __ATOMIC_RELEASE);
+				func(context, 0, rows);
+				return;
+			}
+
+			int bands = (pool.workers + 1) * BANDS_PER_THREAD;
+			if (bands > rows / min_rows) {
+				bands = rows / min_rows;
+			}
+			pool.func = func;
+			pool.context = context;
+			pool.rows = rows;
+			pool.band_rows = (rows + bands - 1) / bands;
+			bands = (rows + pool.band_rows - 1) / pool.band_rows;
+			__atomic_store_n(&pool.pending, bands, __ATOMIC_RELAXED);
+
+			Uint64 generation = (__atomic_load_n(&pool.ticket, __ATOMIC_RELAXED)
+					>> (2 * BAND_BITS)) + 1;
+			__atomic_store_n(&pool.ticket,
+					generation << (2 * BAND_BITS)
+					| static_cast<Uint64>(bands) << BAND_BITS,
+					__ATOMIC_RELEASE);
+			__atomic_add_fetch(&pool.wake, 1, __ATOMIC_RELEASE);
+			sync::futex_wake_all(&pool.wake);
+
+			Work();
+			int pending;
+			while ((pending = __atomic_load_n(&pool.pending, __ATOMIC_ACQUIRE))
+					!= 0) {
+				sync::futex_wait(&pool.pending, pending);
+			}
+			__atomic_store_n(&pool.busy, 0, __ATOMIC_RELEASE);
+		}
+
+		int threads()
+		{
+			return pool.started ? pool.workers + 1 : Cpu_count();
+		}
+	}
+}
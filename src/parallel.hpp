@@ -0,0 +1,45 @@
+#ifndef SDLPP_PARALLEL_HPP_INCLUDED
+#define SDLPP_PARALLEL_HPP_INCLUDED
+/* vim: set ts=4 sts=4 sw=4 tw=80: */
+
+/*
+ * A small pool of worker threads for the pixel pipelines. This header is
+ * private to the library and not installed.
+ */
+
+#include "SDL.h"
+
+namespace sdlpp
+{
+	namespace parallel
+	{
+		/**
+		 * Processes rows [begin, end) of some image.
+		 */
+		typedef void (*Band_func)(void* context, int begin, int end);
+
+		/**
+		 * Splits rows [0, rows) into bands and runs func on each band, in
+		 * the pool's worker threads and in the calling thread. Returns when
+		 * all bands are done.
+		 *
+		 * The workers are started on first use, one fewer than there are
+		 * CPUs. If the pool is busy with another call, e.g. because func
+		 * itself calls for_rows(), the rows are processed in the calling
+		 * thread instead.
+		 *
+		 * @param min_rows Bands are no smaller than this, so small images
+		 * aren't spread over threads that would cost more than they save.
+		 */
+		void for_rows(int rows, Band_func func, void* context,
+				int min_rows = 16);
+
+		/**
+		 * @return How many threads for_rows() spreads work over, including
+		 * the calling thread.
+		 */
+		int threads();
+	}
+}
+
+#endif /* SDLPP_PARALLEL_HPP_INCLUDED */
@@ -0,0 +1,498 @@
+/* vim: set ts=4 sts=4 sw=4 tw=80: */
+#include <SDL++/pixel_format.hpp>
+#include <cstring>
+
+#if defined(__x86_64__) || (defined(__i386__) && defined(__SSE2__))
+#define SDLPP_HAVE_SSE2 1
+#include <emmintrin.h>
+#include <immintrin.h>
+#endif
+
+/*
+ * The bulk conversions use the same arithmetic as SDL_MapRGBA and
+ * SDL_GetRGBA, so they return exactly what calling those per pixel would.
+ *
+ * The kernels convert between RGBA quadruples and pixels held in 16-bit or
+ * 32-bit integers. 24 bpp pixels go through a small 32-bit buffer.
+ */
+
+namespace
+{
+	using std::size_t;
+
+	typedef void (*Pack32)(const SDL_PixelFormat*, const Uint8*, Uint32*, size_t);
+	typedef void (*Pack16)(const SDL_PixelFormat*, const Uint8*, Uint16*, size_t);
+	typedef void (*Unpack32)(const SDL_PixelFormat*, const Uint32*, Uint8*, size_t);
+	typedef void (*Unpack16)(const SDL_PixelFormat*, const Uint16*, Uint8*, size_t);
+
+	/**
+	 * How many 24 bpp pixels we convert per round through the buffer.
+	 */
+	const size_t CHUNK = 256;
+
+	inline Uint32 Pack(const SDL_PixelFormat* f, const Uint8* c)
+	{
+		return (c[0] >> f->Rloss) << f->Rshift
+			| (c[1] >> f->Gloss) << f->Gshift
+			| (c[2] >> f->Bloss) << f->Bshift
+			| (c[3] >> f->Aloss) << f->Ashift;
+	}
+
+	inline Uint8 Expand(Uint32 pixel, Uint32 mask, Uint8 shift, Uint8 loss)
+	{
+		Uint32 v = (pixel & mask) >> shift;
+		return (v << loss) + (v >> (8 - (loss << 1)));
+	}
+
+	inline void Unpack(const SDL_PixelFormat* f, Uint32 pixel, Uint8* c)
+	{
+		c[0] = Expand(pixel, f->Rmask, f->Rshift, f->Rloss);
+		c[1] = Expand(pixel, f->Gmask, f->Gshift, f->Gloss);
+		c[2] = Expand(pixel, f->Bmask, f->Bshift, f->Bloss);
+		c[3] = f->Amask ? Expand(pixel, f->Amask, f->Ashift, f->Aloss) : 255;
+	}
+
+	void Pack32_scalar(const SDL_PixelFormat* f, const Uint8* rgba,
+			Uint32* out, size_t n)
+	{
+		for (size_t i = 0; i < n; i++) {
+			out[i] = Pack(f, rgba + 4 * i);
+		}
+	}
+
+	void Pack16_scalar(const SDL_PixelFormat* f, const Uint8* rgba,
+			Uint16* out, size_t n)
+	{
+		for (size_t i = 0; i < n; i++) {
+			out[i] = Pack(f, rgba + 4 * i);
+		}
+	}
+
+	void Unpack32_scalar(const SDL_PixelFormat* f, const Uint32* in,
+			Uint8* rgba, size_t n)
+	{
+		for (size_t i = 0; i < n; i++) {
+			Unpack(f, in[i], rgba + 4 * i);
+		}
+	}
+
+	void Unpack16_scalar(const SDL_PixelFormat* f, const Uint16* in,
+			Uint8* rgba, size_t n)
+	{
+		for (size_t i = 0; i < n; i++) {
+			Unpack(f, in[i], rgba + 4 * i);
+		}
+	}
+
+#ifdef SDLPP_HAVE_SSE2
+	/*
+	 * The shift and loss amounts are the same for every pixel of a format,
+	 * so the SIMD kernels shift all lanes by a count held in a register.
+	 */
+
+	inline __m128i Pack_sse2(const SDL_PixelFormat* f, __m128i v)
+	{
+		const __m128i ff = _mm_set1_epi32(0xff);
+		__m128i r = _mm_and_si128(v, ff);
+		__m128i g = _mm_and_si128(_mm_srli_epi32(v, 8), ff);
+		__m128i b = _mm_and_si128(_mm_srli_epi32(v, 16), ff);
+		__m128i a = _mm_srli_epi32(v, 24);
+		r = _mm_sll_epi32(_mm_srl_epi32(r, _mm_cvtsi32_si128(f->Rloss)),
+				_mm_cvtsi32_si128(f->Rshift));
+		g = _mm_sll_epi32(_mm_srl_epi32(g, _mm_cvtsi32_si128(f->Gloss)),
+				_mm_cvtsi32_si128(f->Gshift));
+		b = _mm_sll_epi32(_mm_srl_epi32(b, _mm_cvtsi32_si128(f->Bloss)),
+				_mm_cvtsi32_si128(f->Bshift));
+		a = _mm_sll_epi32(_mm_srl_epi32(a, _mm_cvtsi32_si128(f->Aloss)),
+				_mm_cvtsi32_si128(f->Ashift));
+		return _mm_or_si128(_mm_or_si128(r, g), _mm_or_si128(b, a));
+	}
+
+	inline __m128i Expand_sse2(__m128i px, Uint32 mask, Uint8 shift,
+			Uint8 loss)
+	{
+		__m128i v = _mm_srl_epi32(_mm_and_si128(px, _mm_set1_epi32(mask)),
+				_mm_cvtsi32_si128(shift));
+		return _mm_add_epi32(_mm_sll_epi32(v, _mm_cvtsi32_si128(loss)),
+				_mm_srl_epi32(v, _mm_cvtsi32_si128(8 - (loss << 1))));
+	}
+
+	inline __m128i Unpack_sse2(const SDL_PixelFormat* f, __m128i px)
+	{
+		__m128i r = Expand_sse2(px, f->Rmask, f->Rshift, f->Rloss);
+		__m128i g = Expand_sse2(px, f->Gmask, f->Gshift, f->Gloss);
+		__m128i b = Expand_sse2(px, f->Bmask, f->Bshift, f->Bloss);
+		__m128i a = f->Amask
+			? Expand_sse2(px, f->Amask, f->Ashift, f->Aloss)
+			: _mm_set1_epi32(0xff);
+		return _mm_or_si128(
+				_mm_or_si128(r, _mm_slli_epi32(g, 8)),
+				_mm_or_si128(_mm_slli_epi32(b, 16), _mm_slli_epi32(a, 24)));
+	}
+
+	/**
+	 * Narrows two vectors of 32-bit lanes to one vector of their low 16
+	 * bits. packs_epi32 saturates, so we sign-extend the low halves first.
+	 */
+	inline __m128i Narrow_sse2(__m128i lo, __m128i hi)
+	{
+		lo = _mm_srai_epi32(_mm_slli_epi32(lo, 16), 16);
+		hi = _mm_srai_epi32(_mm_slli_epi32(hi, 16), 16);
+		return _mm_packs_epi32(lo, hi);
+	}
+
+	void Pack32_sse2(const SDL_PixelFormat* f, const Uint8* rgba,
+			Uint32* out, size_t n)
+	{
+		size_t i = 0;
+		for (; i + 4 <= n; i += 4) {
+			__m128i v = _mm_loadu_si128(
+					reinterpret_cast<const __m128i*>(rgba + 4 * i));
+			_mm_storeu_si128(reinterpret_cast<__m128i*>(out + i),
+					Pack_sse2(f, v));
+		}
+		Pack32_scalar(f, rgba + 4 * i, out + i, n - i);
+	}
+
+	void Pack16_sse2(const SDL_PixelFormat* f, const Uint8* rgba,
+			Uint16* out, size_t n)
+	{
+		size_t i = 0;
+		for (; i + 8 <= n; i += 8) {
+			__m128i lo = Pack_sse2(f, _mm_loadu_si128(
+						reinterpret_cast<const __m128i*>(rgba + 4 * i)));
+			__m128i hi = Pack_sse2(f, _mm_loadu_si128(
+						reinterpret_cast<const __m128i*>(rgba + 4 * i + 16)));
+			_mm_storeu_si128(reinterpret_cast<__m128i*>(out + i),
+					Narrow_sse2(lo, hi));
+		}
+		Pack16_scalar(f, rgba + 4 * i, out + i, n - i);
+	}
+
+	void Unpack32_sse2(const SDL_PixelFormat* f, const Uint32* in,
+			Uint8* rgba, size_t n)
+	{
+		size_t i = 0;
+		for (; i + 4 <= n; i += 4) {
+			__m128i px = _mm_loadu_si128(
+					reinterpret_cast<const __m128i*>(in + i));
+			_mm_storeu_si128(reinterpret_cast<__m128i*>(rgba + 4 * i),
+					Unpack_sse2(f, px));
+		}
+		Unpack32_scalar(f, in + i, rgba + 4 * i, n - i);
+	}
+
+	void Unpack16_sse2(const SDL_PixelFormat* f, const Uint16* in,
+			Uint8* rgba, size_t n)
+	{
+		const __m128i zero = _mm_setzero_si128();
+		size_t i = 0;
+		for (; i + 8 <= n; i += 8) {
+			__m128i px = _mm_loadu_si128(
+					reinterpret_cast<const __m128i*>(in + i));
+			_mm_storeu_si128(reinterpret_cast<__m128i*>(rgba + 4 * i),
+					Unpack_sse2(f, _mm_unpacklo_epi16(px, zero)));
+			_mm_storeu_si128(reinterpret_cast<__m128i*>(rgba + 4 * i + 16),
+					Unpack_sse2(f, _mm_unpackhi_epi16(px, zero)));
+		}
+		Unpack16_scalar(f, in + i, rgba + 4 * i, n - i);
+	}
+
+	/*
+	 * The AVX2 kernels are compiled for AVX2 regardless of the compiler
+	 * flags and only called if the CPU supports it.
+	 */
+
+#define SDLPP_AVX2 __attribute__((target("avx2")))
+
+	SDLPP_AVX2
+	inline __m256i Pack_avx2(const SDL_PixelFormat* f, __m256i v)
+	{
+		const __m256i ff = _mm256_set1_epi32(0xff);
+		__m256i r = _mm256_and_si256(v, ff);
+		__m256i g = _mm256_and_si256(_mm256_srli_epi32(v, 8), ff);
+		__m256i b = _mm256_and_si256(_mm256_srli_epi32(v, 16), ff);
+		__m256i a = _mm256_srli_epi32(v, 24);
+		r = _mm256_sll_epi32(_mm256_srl_epi32(r, _mm_cvtsi32_si128(f->Rloss)),
+				_mm_cvtsi32_si128(f->Rshift));
+		g = _mm256_sll_epi32(_mm256_srl_epi32(g, _mm_cvtsi32_si128(f->Gloss)),
+				_mm_cvtsi32_si128(f->Gshift));
+		b = _mm256_sll_epi32(_mm256_srl_epi32(b, _mm_cvtsi32_si128(f->Bloss)),
+				_mm_cvtsi32_si128(f->Bshift));
+		a = _mm256_sll_epi32(_mm256_srl_epi32(a, _mm_cvtsi32_si128(f->Aloss)),
+				_mm_cvtsi32_si128(f->Ashift));
+		return _mm256_or_si256(_mm256_or_si256(r, g), _mm256_or_si256(b, a));
+	}
+
+	SDLPP_AVX2
+	inline __m256i Expand_avx2(__m256i px, Uint32 mask, Uint8 shift,
+			Uint8 loss)
+	{
+		__m256i v = _mm256_srl_epi32(
+				_mm256_and_si256(px, _mm256_set1_epi32(mask)),
+				_mm_cvtsi32_si128(shift));
+		return _mm256_add_epi32(_mm256_sll_epi32(v, _mm_cvtsi32_si128(loss)),
+				_mm256_srl_epi32(v, _mm_cvtsi32_si128(8 - (loss << 1))));
+	}
+
+	SDLPP_AVX2
+	inline __m256i Unpack_avx2(const SDL_PixelFormat* f, __m256i px)
+	{
+		__m256i r = Expand_avx2(px, f->Rmask, f->Rshift, f->Rloss);
+		__m256i g = Expand_avx2(px, f->Gmask, f->Gshift, f->Gloss);
+		__m256i b = Expand_avx2(px, f->Bmask, f->Bshift, f->Bloss);
+		__m256i a = f->Amask
+			? Expand_avx2(px, f->Amask, f->Ashift, f->Aloss)
+			: _mm256_set1_epi32(0xff);
+		return _mm256_or_si256(
+				_mm256_or_si256(r, _mm256_slli_epi32(g, 8)),
+				_mm256_or_si256(_mm256_slli_epi32(b, 16),
+					_mm256_slli_epi32(a, 24)));
+	}
+
+	SDLPP_AVX2
+	void Pack32_avx2(const SDL_PixelFormat* f, const Uint8* rgba,
+			Uint32* out, size_t n)
+	{
+		size_t i = 0;
+		for (; i + 8 <= n; i += 8) {
+			__m256i v = _mm256_loadu_si256(
+					reinterpret_cast<const __m256i*>(rgba + 4 * i));
+			_mm256_storeu_si256(reinterpret_cast<__m256i*>(out + i),
+					Pack_avx2(f, v));
+		}
+		Pack32_sse2(f, rgba + 4 * i, out + i, n - i);
+	}
+
+	SDLPP_AVX2
+	void Pack16_avx2(const SDL_PixelFormat* f, const Uint8* rgba,
+			Uint16* out, size_t n)
+	{
+		size_t i = 0;
+		for (; i + 16 <= n; i += 16) {
+			__m256i lo = Pack_avx2(f, _mm256_loadu_si256(
+						reinterpret_cast<const __m256i*>(rgba + 4 * i)));
+			__m256i hi = Pack_avx2(f, _mm256_loadu_si256(
+						reinterpret_cast<const __m256i*>(rgba + 4 * i + 32)));
+			lo = _mm256_srai_epi32(_mm256_slli_epi32(lo, 16), 16);
+			hi = _mm256_srai_epi32(_mm256_slli_epi32(hi, 16), 16);
+			/* packs works within 128-bit lanes; put the quarters in order. */
+			__m256i packed = _mm256_permute4x64_epi64(
+					_mm256_packs_epi32(lo, hi), 0xd8);
+			_mm256_storeu_si256(reinterpret_cast<__m256i*>(out + i), packed);
+		}
+		Pack16_sse2(f, rgba + 4 * i, out + i, n - i);
+	}
+
+	SDLPP_AVX2
+	void Unpack32_avx2(const SDL_PixelFormat* f, const Uint32* in,
+			Uint8* rgba, size_t n)
+	{
+		size_t i = 0;
+		for (; i + 8 <= n; i += 8) {
+			__m256i px = _mm256_loadu_si256(
+					reinterpret_cast<const __m256i*>(in + i));
+			_mm256_storeu_si256(reinterpret_cast<__m256i*>(rgba + 4 * i),
+					Unpack_avx2(f, px));
+		}
+		Unpack32_sse2(f, in + i, rgba + 4 * i, n - i);
+	}
+
+	SDLPP_AVX2
+	void Unpack16_avx2(const SDL_PixelFormat* f, const Uint16* in,
+			Uint8* rgba, size_t n)
+	{
+		size_t i = 0;
+		for (; i + 8 <= n; i += 8) {
+			__m256i px = _mm256_cvtepu16_epi32(_mm_loadu_si128(
+						reinterpret_cast<const __m128i*>(in + i)));
+			_mm256_storeu_si256(reinterpret_cast<__m256i*>(rgba + 4 * i),
+					Unpack_avx2(f, px));
+		}
+		Unpack16_sse2(f, in + i, rgba + 4 * i, n - i);
+	}
+
+#undef SDLPP_AVX2
+#endif /* SDLPP_HAVE_SSE2 */
+
+	/**
+	 * The kernels for the CPU we run on.
+	 */
+	struct Kernels
+	{
+		Pack32 pack32;
+		Pack16 pack16;
+		Unpack32 unpack32;
+		Unpack16 unpack16;
+	};
+
+	Kernels Select()
+	{
+#ifdef SDLPP_HAVE_SSE2
+		__builtin_cpu_init();
+		if (__builtin_cpu_supports("avx2")) {
+			Kernels k = { Pack32_avx2, Pack16_avx2, Unpack32_avx2, Unpack16_avx2 };
+			return k;
+		}
+		Kernels k = { Pack32_sse2, Pack16_sse2, Unpack32_sse2, Unpack16_sse2 };
+		return k;
+#else
+		Kernels k = { Pack32_scalar, Pack16_scalar, Unpack32_scalar,
+			Unpack16_scalar };
+		return k;
+#endif /* SDLPP_HAVE_SSE2 */
+	}
+
+	const Kernels& kernels()
+	{
+		static const Kernels k = Select();
+		return k;
+	}
+
+	/**
+	 * @return Whether SDL_GetRGBA's arithmetic is well-defined for this
+	 * format, so we may do it ourselves. Formats with channels narrower than
+	 * four bits (or missing colour channels) make SDL shift by a negative
+	 * amount; we leave those to SDL.
+	 */
+	bool Unpackable(const SDL_PixelFormat* f)
+	{
+		return f->palette == 0
+			&& f->Rmask != 0 && f->Gmask != 0 && f->Bmask != 0
+			&& f->Rloss <= 4 && f->Gloss <= 4 && f->Bloss <= 4
+			&& (f->Amask == 0 || f->Aloss <= 4);
+	}
+
+	inline void Store24(Uint8* p, Uint32 pixel)
+	{
+#if SDL_BYTEORDER == SDL_LIL_ENDIAN
+		p[0] = pixel;
+		p[1] = pixel >> 8;
+		p[2] = pixel >> 16;
+#else
+		p[0] = pixel >> 16;
+		p[1] = pixel >> 8;
+		p[2] = pixel;
+#endif
+	}
+
+	inline Uint32 Load24(const Uint8* p)
+	{
+#if SDL_BYTEORDER == SDL_LIL_ENDIAN
+		return p[0] | p[1] << 8 | p[2] << 16;
+#else
+		return p[0] << 16 | p[1] << 8 | p[2];
+#endif
+	}
+}
+
+namespace sdlpp
+{
+	void Pixel_format::map(const Uint8* rgba, void* pixels, size_t count)
+	{
+		const Kernels& k = kernels();
+		Uint8* out = static_cast<Uint8*>(pixels);
+
+		if (palette != 0) {
+			/* Palettized formats need SDL's nearest colour search. */
+			for (size_t i = 0; i < count; i++, rgba += 4) {
+				Uint32 pixel = SDL_MapRGBA(this, rgba[0], rgba[1], rgba[2],
+						rgba[3]);
+				switch (BytesPerPixel) {
+				case 1:
+					out[i] = pixel;
+					break;
+				case 2:
+					reinterpret_cast<Uint16*>(out)[i] = pixel;
+					break;
+				default:
+					reinterpret_cast<Uint32*>(out)[i] = pixel;
+					break;
+				}
+			}
+			return;
+		}
+
+		switch (BytesPerPixel) {
+		case 4:
+			k.pack32(this, rgba, static_cast<Uint32*>(pixels), count);
+			break;
+		case 3: {
+			Uint32 buffer[CHUNK];
+			while (count > 0) {
+				size_t n = count < CHUNK ? count : CHUNK;
+				k.pack32(this, rgba, buffer, n);
+				for (size_t i = 0; i < n; i++, out += 3) {
+					Store24(out, buffer[i]);
+				}
+				rgba += 4 * n;
+				count -= n;
+			}
+			break;
+		}
+		case 2:
+			k.pack16(this, rgba, static_cast<Uint16*>(pixels), count);
+			break;
+		default:
+			for (size_t i = 0; i < count; i++) {
+				out[i] = Pack(this, rgba + 4 * i);
+			}
+			break;
+		}
+	}
+
+	void Pixel_format::get(const void* pixels, Uint8* rgba, size_t count)
+	{
+		const Kernels& k = kernels();
+		const Uint8* in = static_cast<const Uint8*>(pixels);
+
+		if (!Unpackable(this)) {
+			for (size_t i = 0; i < count; i++, rgba += 4) {
+				Uint32 pixel;
+				switch (BytesPerPixel) {
+				case 1:
+					pixel = in[i];
+					break;
+				case 2:
+					pixel = reinterpret_cast<const Uint16*>(in)[i];
+					break;
+				case 3:
+					pixel = Load24(in + 3 * i);
+					break;
+				default:
+					pixel = reinterpret_cast<const Uint32*>(in)[i];
+					break;
+				}
+				SDL_GetRGBA(pixel, this, &rgba[0], &rgba[1], &rgba[2], &rgba[3]);
+			}
+			return;
+		}
+
+		switch (BytesPerPixel) {
+		case 4:
+			k.unpack32(this, static_cast<const Uint32*>(pixels), rgba, count);
+			break;
+		case 3: {
+			Uint32 buffer[CHUNK];
+			while (count > 0) {
+				size_t n = count < CHUNK ? count : CHUNK;
+				for (size_t i = 0; i < n; i++, in += 3) {
+					buffer[i] = Load24(in);
+				}
+				k.unpack32(this, buffer, rgba, n);
+				rgba += 4 * n;
+				count -= n;
+			}
+			break;
+		}
+		case 2:
+			k.unpack16(this, static_cast<const Uint16*>(pixels), rgba, count);
+			break;
+		default:
+			for (size_t i = 0; i < count; i++) {
+				Unpack(this, in[i], rgba + 4 * i);
+			}
+			break;
+		}
+	}
+}
@@ -0,0 +1,314 @@
+/* vim: set ts=4 sts=4 sw=4 tw=80: */
+#include "prefetch.hpp"
+#include <SDL++/condition.hpp>
+#include <SDL++/mutex.hpp>
+#include <algorithm>
+#include <cstring>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace
+{
+	using sdlpp::Condition;
+	using sdlpp::Mutex;
+	using sdlpp::RW_ops;
+	using std::runtime_error;
+	using std::string;
+
+	struct Block
+	{
+		std::vector<Uint8> bytes;
+
+		/** Where in the source the block starts. */
+		int start;
+
+		/** How many bytes were read into it. */
+		int count;
+	};
+
+	/**
+	 * The state of a prefetching SDL_RWops.
+	 *
+	 * The reader thread fills the blocks after the ready ones, in turn,
+	 * while the consumer reads the ready ones from head on. Only the reader
+	 * touches the source, except for seeks, which the consumer does itself
+	 * once the reader is between reads. A seek bumps the generation, so
+	 * that a block read from before the seek is dropped.
+	 */
+	struct Stream
+	{
+		Stream(const RW_ops& source, int block_size, int blocks) :
+			source(source),
+			blocks(blocks),
+			head(0),
+			ready(0),
+			position(0),
+			next(SDL_RWseek(this->source.raw_ptr(), 0, RW_SEEK_CUR)),
+			generation(0),
+			reading(false),
+			seeking(false),
+			at_end(false),
+			failed(false),
+			quit(false),
+			thread(0)
+		{
+			for (int i = 0; i < blocks; i++) {
+				this->blocks[i].bytes.resize(block_size);
+			}
+
+			/* A source that can't tell where it is starts at 0. */
+			if (next < 0) {
+				next = 0;
+			}
+		}
+
+		/**
+		 * @return Where the consumer is in the source.
+		 */
+		int tell() const
+		{
+			return ready > 0 ? blocks[head].start + position : next;
+		}
+
+		/**
+		 * Hands the head block back to the reader.
+		 */
+		void pop()
+		{
+			head = (head + 1) % blocks.size();
+			ready--;
+			position = 0;
+		}
+
+		RW_ops source;
+		std::vector<Block> blocks;
+
+		Mutex mutex;
+		Condition changed;
+
+		/** The block the consumer reads, and how many are ready from it. */
+		int head;
+		int ready;
+
+		/** Where in the head block the consumer is. */
+		int position;
+
+		/** Where in the source the reader reads next. */
+		int next;
+
+		unsigned generation;
+		bool reading;
+
+		/** Holds the reader off while the consumer moves the source. */
+		bool seeking;
+
+		/** Set when the source has no more to give, until a seek. */
+		bool at_end;
+		bool failed;
+
+		bool quit;
+		SDL_Thread* thread;
+	};
+
+	inline Stream& StreamOf(SDL_RWops* ops)
+	{
+		return *static_cast<Stream*>(ops->hidden.unknown.data1);
+	}
+
+	int Reader(void* data)
+	{
+		Stream& stream = *static_cast<Stream*>(data);
+		for (;;) {
+			Block* block;
+			unsigned generation;
+			int start;
+			{
+				Mutex::Lock lock(stream.mutex);
+				while (!stream.quit && (stream.seeking || stream.at_end
+							|| stream.ready
+							== static_cast<int>(stream.blocks.size()))) {
+					stream.changed.wait(stream.mutex);
+				}
+				if (stream.quit) {
+					return 0;
+				}
+				block = &stream.blocks[(stream.head + stream.ready)
+					% stream.blocks.size()];
+				generation = stream.generation;
+				start = stream.next;
+				stream.reading = true;
+			}
+
+			/*
+			 * The block after the ready ones isn't the consumer's, so it is
+			 * filled without holding the lock.
+			 */
+			int count = SDL_RWread(stream.source.raw_ptr(), &block->bytes[0],
+					1, block->bytes.size());
+
+			Mutex::Lock lock(stream.mutex);
+			stream.reading = false;
+			if (generation == stream.generation) {
+				if (count > 0) {
+					block->start = start;
+					block->count = count;
+					stream.ready++;
+					stream.next += count;
+				}
+				else {
+					stream.at_end = true;
+					stream.failed = count < 0;
+				}
+			}
+			stream.changed.broadcast();
+		}
+	}
+
+	int Prefetch_seek(SDL_RWops* ops, int offset, int whence)
+	{
+		Stream& stream = StreamOf(ops);
+		Mutex::Lock lock(stream.mutex);
+		int target = whence == RW_SEEK_SET ? offset : stream.tell() + offset;
+
+		/* Within what is read ahead, or where the reader is reading. */
+		int lowest = stream.ready > 0
+			? stream.blocks[stream.head].start : stream.next;
+		if (whence != RW_SEEK_END && target >= lowest
+				&& target <= stream.next) {
+			while (stream.ready > 0 && target >= stream.blocks[stream.head].start
+					+ stream.blocks[stream.head].count) {
+				stream.pop();
+			}
+			if (stream.ready > 0) {
+				stream.position = target - stream.blocks[stream.head].start;
+			}
+			stream.changed.broadcast();
+			return target;
+		}
+
+		/* Drop everything read ahead, and wait for the source. */
+		stream.generation++;
+		stream.head = (stream.head + stream.ready) % stream.blocks.size();
+		stream.ready = 0;
+		stream.position = 0;
+		stream.seeking = true;
+		while (stream.reading) {
+			stream.changed.wait(stream.mutex);
+		}
+		int result = whence == RW_SEEK_END
+			? SDL_RWseek(stream.source.raw_ptr(), offset, RW_SEEK_END)
+			: SDL_RWseek(stream.source.raw_ptr(), target, RW_SEEK_SET);
+		if (result >= 0) {
+			stream.next = result;
+		}
+		else {
+			/* Carry on from wherever the source was left. */
+			int here = SDL_RWseek(stream.source.raw_ptr(), 0, RW_SEEK_CUR);
+			if (here >= 0) {
+				stream.next = here;
+			}
+		}
+		stream.seeking = false;
+		stream.at_end = false;
+		stream.failed = false;
+		stream.changed.broadcast();
+		return result;
+	}
+
+	int Prefetch_read(SDL_RWops* ops, void* ptr, int size, int maxnum)
+	{
+		Stream& stream = StreamOf(ops);
+		if (size <= 0 || maxnum <= 0) {
+			return 0;
+		}
+
+		Mutex::Lock lock(stream.mutex);
+		Uint8* to = static_cast<Uint8*>(ptr);
+		const int wanted = size * maxnum;
+		int done = 0;
+		while (done < wanted) {
+			if (stream.ready == 0) {
+				if (stream.at_end) {
+					if (stream.failed && done == 0) {
+						return -1;
+					}
+					break;
+				}
+				stream.changed.wait(stream.mutex);
+				continue;
+			}
+
+			Block& block = stream.blocks[stream.head];
+			int n = std::min(block.count - stream.position, wanted - done);
+			std::memcpy(to + done, &block.bytes[stream.position], n);
+			stream.position += n;
+			done += n;
+			if (stream.position == block.count) {
+				stream.pop();
+				stream.changed.broadcast();
+			}
+		}
+		return done / size;
+	}
+
+	int Prefetch_write(SDL_RWops*, const void*, int, int)
+	{
+		SDL_SetError("Prefetching RW_ops can't be written to");
+		return -1;
+	}
+
+	int Prefetch_close(SDL_RWops*)
+	{
+		/* The source is shared, so it's for its owner to close. */
+		return 0;
+	}
+}
+
+namespace sdlpp
+{
+	namespace prefetch
+	{
+		SDL_RWops* create(const RW_ops& source, int block_size, int blocks)
+		{
+			if (block_size <= 0 || blocks <= 0) {
+				throw runtime_error(
+						"RW_ops prefetch block size and count must be positive");
+			}
+			std::auto_ptr<Stream> stream(
+					new Stream(source, block_size, blocks));
+			SDL_RWops* ops = SDL_AllocRW();
+			if (ops == 0) {
+				throw runtime_error(string()
+						+ "SDL_AllocRW returned NULL: "
+						+ SDL_GetError());
+			}
+			stream->thread = SDL_CreateThread(Reader, stream.get());
+			if (stream->thread == 0) {
+				SDL_FreeRW(ops);
+				throw runtime_error(string()
+						+ "SDL_CreateThread returned NULL: "
+						+ SDL_GetError());
+			}
+			ops->seek = Prefetch_seek;
+			ops->read = Prefetch_read;
+			ops->write = Prefetch_write;
+			ops->close = Prefetch_close;
+			ops->hidden.unknown.data1 = stream.release();
+			return ops;
+		}
+
+		void destroy(SDL_RWops* ops)
+		{
+			Stream* stream = &StreamOf(ops);
+			{
+				Mutex::Lock lock(stream->mutex);
+				stream->quit = true;
+				stream->changed.broadcast();
+			}
+			SDL_WaitThread(stream->thread, 0);
+			delete stream;
+			SDL_FreeRW(ops);
+		}
+	}
+}
@@ -0,0 +1,33 @@
+#ifndef SDLPP_PREFETCH_HPP_INCLUDED
+#define SDLPP_PREFETCH_HPP_INCLUDED
+/* vim: set ts=4 sts=4 sw=4 tw=80: */
+
+/*
+ * SDL_RWops that read their source ahead in a thread of their own. This
+ * header is private to the library and not installed.
+ */
+
+#include "SDL.h"
+#include <SDL++/rw_ops.hpp>
+
+namespace sdlpp
+{
+	namespace prefetch
+	{
+		/**
+		 * Starts reading source ahead, into a ring of blocks, and returns
+		 * an SDL_RWops that reads from those blocks. It can seek but not
+		 * write.
+		 *
+		 * @throw runtime_error
+		 */
+		SDL_RWops* create(const RW_ops& source, int block_size, int blocks);
+
+		/**
+		 * Stops the reading ahead and frees an SDL_RWops from create().
+		 */
+		void destroy(SDL_RWops* ops);
+	}
+}
+
+#endif /* SDLPP_PREFETCH_HPP_INCLUDED */
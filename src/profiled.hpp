@@ -0,0 +1,70 @@
+#ifndef SDLPP_PROFILED_HPP_INCLUDED
+#define SDLPP_PROFILED_HPP_INCLUDED
+/* vim: set ts=4 sts=4 sw=4 tw=80: */
+
+/*
+ * How Mutex, Semaphore and Condition keep their Lock_profiler records. This
+ * header is private to the library and not installed.
+ */
+
+#include "SDL.h"
+#include <SDL++/lock_profiler.hpp>
+#include <SDL++/shared_ptr_base.hpp>
+
+namespace sdlpp
+{
+	namespace profiled
+	{
+		/**
+		 * Destroys the SDL object of a Mutex, Semaphore or Condition once
+		 * the last wrapper of it is gone. It also holds the object's record,
+		 * so that the wrappers reach it through their shared_ptr, without a
+		 * lookup and without the profiler's lock.
+		 */
+		template <typename T>
+		struct Deleter
+		{
+			explicit Deleter(void (*destroy)(T*)) : destroy(destroy), record(0)
+			{ }
+
+			void operator()(T* object)
+			{
+				if (record != 0) {
+					Lock_profiler::detach(record);
+				}
+				destroy(object);
+			}
+
+			void (*destroy)(T*);
+			Lock_profiler::Record* record;
+		};
+
+#ifdef SDLPP_PROFILE_LOCKS
+		/**
+		 * Starts profiling the object of p, which must have a Deleter.
+		 */
+		template <typename T>
+		void attach(const shared_ptr<T>& p, Lock_stats::Kind kind)
+		{
+			std::tr1::get_deleter<Deleter<T> >(p)->record =
+				Lock_profiler::attach(p.get(), kind);
+		}
+#else
+		template <typename T>
+		void attach(const shared_ptr<T>&, Lock_stats::Kind)
+		{ }
+#endif /* SDLPP_PROFILE_LOCKS */
+
+		/**
+		 * @return The record of the object of p, or 0 if it has none.
+		 */
+		template <typename T>
+		Lock_profiler::Record* record(const shared_ptr<T>& p)
+		{
+			Deleter<T>* d = std::tr1::get_deleter<Deleter<T> >(p);
+			return d != 0 ? d->record : 0;
+		}
+	}
+}
+
+#endif /* SDLPP_PROFILED_HPP_INCLUDED */
@@ -0,0 +1,235 @@
+/* vim: set ts=4 sts=4 sw=4 tw=80: */
+#include <SDL++/region.hpp>
+#include <algorithm>
+#include <climits>
+
+namespace sdlpp
+{
+	Region::Region()
+	{
+	}
+
+	Region::Region(const SDL_Rect& rect)
+	{
+		if (rect.w > 0 && rect.h > 0) {
+			Box box = { rect.x, rect.y, rect.x + rect.w, rect.y + rect.h };
+			boxes.push_back(box);
+		}
+	}
+
+	bool Region::empty() const
+	{
+		return boxes.empty();
+	}
+
+	Rect Region::bounds() const
+	{
+		if (boxes.empty()) {
+			return Rect();
+		}
+		int x0 = INT_MAX;
+		int x1 = INT_MIN;
+		for (size_t i = 0; i < boxes.size(); i++) {
+			x0 = std::min(x0, boxes[i].x0);
+			x1 = std::max(x1, boxes[i].x1);
+		}
+		int y0 = boxes.front().y0;
+		return Rect(x0, y0, x1 - x0, boxes.back().y1 - y0);
+	}
+
+	bool Region::contains(int x, int y) const
+	{
+		/* Find the first span of the band holding y, if any. */
+		size_t low = 0;
+		size_t high = boxes.size();
+		while (low < high) {
+			size_t middle = (low + high) / 2;
+			if (boxes[middle].y1 <= y) {
+				low = middle + 1;
+			}
+			else {
+				high = middle;
+			}
+		}
+		for (size_t i = low; i < boxes.size() && boxes[i].y0 <= y
+				&& boxes[i].x0 <= x; i++) {
+			if (x < boxes[i].x1) {
+				return true;
+			}
+		}
+		return false;
+	}
+
+	size_t Region::size() const
+	{
+		return boxes.size();
+	}
+
+	Rect Region::operator[] (size_t i) const
+	{
+		const Box& box = boxes[i];
+		return Rect(box.x0, box.y0, box.x1 - box.x0, box.y1 - box.y0);
+	}
+
+	bool Region::operator== (const Region& that) const
+	{
+		if (boxes.size() != that.boxes.size()) {
+			return false;
+		}
+		for (size_t i = 0; i < boxes.size(); i++) {
+			const Box& a = boxes[i];
+			const Box& b = that.boxes[i];
+			if (a.x0 != b.x0 || a.y0 != b.y0 || a.x1 != b.x1 || a.y1 != b.y1) {
+				return false;
+			}
+		}
+		return true;
+	}
+
+	bool Region::operator!= (const Region& that) const
+	{
+		return !(*this == that);
+	}
+
+	Region& Region::unite(const Region& that)
+	{
+		combine(that, UNION);
+		return *this;
+	}
+
+	Region& Region::intersect(const Region& that)
+	{
+		combine(that, INTERSECTION);
+		return *this;
+	}
+
+	Region& Region::subtract(const Region& that)
+	{
+		combine(that, DIFFERENCE);
+		return *this;
+	}
+
+	void Region::translate(int dx, int dy)
+	{
+		for (size_t i = 0; i < boxes.size(); i++) {
+			boxes[i].x0 += dx;
+			boxes[i].y0 += dy;
+			boxes[i].x1 += dx;
+			boxes[i].y1 += dy;
+		}
+	}
+
+	void Region::combine(const Region& that, Operation operation)
+	{
+		const vector<Box>& a = boxes;
+		const vector<Box>& b = that.boxes;
+		if (operation == INTERSECTION && (a.empty() || b.empty())) {
+			boxes.clear();
+			return;
+		}
+		if (b.empty()) {
+			return;
+		}
+		if (a.empty() && operation != UNION) {
+			return;
+		}
+
+		/* Cut both regions at the tops and bottoms of all their bands. */
+		vector<int> ys;
+		ys.reserve(2 * (a.size() + b.size()));
+		for (size_t i = 0; i < a.size(); i++) {
+			ys.push_back(a[i].y0);
+			ys.push_back(a[i].y1);
+		}
+		for (size_t i = 0; i < b.size(); i++) {
+			ys.push_back(b[i].y0);
+			ys.push_back(b[i].y1);
+		}
+		std::sort(ys.begin(), ys.end());
+		ys.erase(std::unique(ys.begin(), ys.end()), ys.end());
+
+		vector<Box> out;
+		size_t last_band = 0;
+		size_t ia = 0;
+		size_t ib = 0;
+		for (size_t k = 0; k + 1 < ys.size(); k++) {
+			const int top = ys[k];
+			const int bottom = ys[k + 1];
+
+			/* The spans of each region in this band, if any. */
+			while (ia < a.size() && a[ia].y1 <= top) {
+				ia++;
+			}
+			size_t ea = ia;
+			while (ea < a.size() && a[ea].y0 == a[ia].y0 && a[ia].y0 <= top) {
+				ea++;
+			}
+			while (ib < b.size() && b[ib].y1 <= top) {
+				ib++;
+			}
+			size_t eb = ib;
+			while (eb < b.size() && b[eb].y0 == b[ib].y0 && b[ib].y0 <= top) {
+				eb++;
+			}
+
+			/*
+			 * Walk the ends of the spans of both left to right, noting
+			 * where the result goes in and out.
+			 */
+			const size_t band = out.size();
+			size_t pa = 2 * ia;
+			size_t pb = 2 * ib;
+			bool in_a = false;
+			bool in_b = false;
+			bool inside = false;
+			int start = 0;
+			while (pa < 2 * ea || pb < 2 * eb) {
+				int xa = pa < 2 * ea
+					? (pa % 2 == 0 ? a[pa / 2].x0 : a[pa / 2].x1) : INT_MAX;
+				int xb = pb < 2 * eb
+					? (pb % 2 == 0 ? b[pb / 2].x0 : b[pb / 2].x1) : INT_MAX;
+				int x = std::min(xa, xb);
+				if (xa == x) {
+					in_a = !in_a;
+					pa++;
+				}
+				if (xb == x) {
+					in_b = !in_b;
+					pb++;
+				}
+				bool now = operation == UNION ? in_a || in_b
+					: operation == INTERSECTION ? in_a && in_b
+					: in_a && !in_b;
+				if (now && !inside) {
+					start = x;
+				}
+				else if (!now && inside) {
+					Box box = { start, top, x, bottom };
+					out.push_back(box);
+				}
+				inside = now;
+			}
+
+			/* Merge the band into the one above if they are alike. */
+			const size_t count = out.size() - band;
+			if (count == 0) {
+				continue;
+			}
+			bool alike = band > 0 && out[last_band].y1 == top
+				&& band - last_band == count;
+			for (size_t i = 0; i < count && alike; i++) {
+				alike = out[last_band + i].x0 == out[band + i].x0
+					&& out[last_band + i].x1 == out[band + i].x1;
+			}
+			if (!alike) {
+				last_band = band;
+				continue;
+			}
+			for (size_t i = 0; i < count; i++) {
+				out[last_band + i].y1 = bottom;
+			}
+			out.resize(band);
+		}
+		boxes.swap(out);
+	}
+}
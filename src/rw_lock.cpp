@@ -0,0 +1,114 @@
+/* vim: set ts=4 sts=4 sw=4 tw=80: */
+#include <SDL++/rw_lock.hpp>
+#include "sync.hpp"
+
+namespace
+{
+	/**
+	 * How often we re-check the lock before we go to sleep.
+	 */
+	const int SPINS = 100;
+
+	sdlpp::Rw_lock_state* CreateState()
+	{
+		sdlpp::Rw_lock_state* s = new sdlpp::Rw_lock_state;
+		s->state = 0;
+		s->writers_waiting = 0;
+		s->sleepers = 0;
+		s->seq = 0;
+		return s;
+	}
+
+	bool CanRead(sdlpp::Rw_lock_state* s)
+	{
+		return __atomic_load_n(&s->state, __ATOMIC_SEQ_CST) >= 0
+			&& __atomic_load_n(&s->writers_waiting, __ATOMIC_SEQ_CST) == 0;
+	}
+
+	bool CanWrite(sdlpp::Rw_lock_state* s)
+	{
+		return __atomic_load_n(&s->state, __ATOMIC_SEQ_CST) == 0;
+	}
+
+	/**
+	 * Sleeps until the lock is released, unless can() became true in the
+	 * meantime. We announce ourselves in sleepers before we re-check, so a
+	 * thread that releases the lock after our check is sure to wake us.
+	 */
+	void Sleep(sdlpp::Rw_lock_state* s, bool (*can)(sdlpp::Rw_lock_state*))
+	{
+		__atomic_add_fetch(&s->sleepers, 1, __ATOMIC_SEQ_CST);
+		int seq = __atomic_load_n(&s->seq, __ATOMIC_SEQ_CST);
+		if (!can(s)) {
+			sdlpp::sync::futex_wait(&s->seq, seq);
+		}
+		__atomic_sub_fetch(&s->sleepers, 1, __ATOMIC_SEQ_CST);
+	}
+}
+
+namespace sdlpp
+{
+	Rw_lock::Rw_lock() :
+		shared_ptr_base<Rw_lock_state>(CreateState())
+	{
+	}
+
+	Rw_lock::Rw_lock(const Rw_lock& that) :
+		shared_ptr_base<Rw_lock_state>(that)
+	{
+	}
+
+	void Rw_lock::lock_read_contended()
+	{
+		Rw_lock_state* s = p.get();
+		for (int spins = 0; ; spins++) {
+			int readers = __atomic_load_n(&s->state, __ATOMIC_RELAXED);
+			if (readers >= 0
+					&& __atomic_load_n(&s->writers_waiting, __ATOMIC_RELAXED) == 0) {
+				if (__atomic_compare_exchange_n(&s->state, &readers,
+							readers + 1, false,
+							__ATOMIC_ACQUIRE, __ATOMIC_RELAXED)) {
+					return;
+				}
+				continue;
+			}
+			if (spins < SPINS) {
+				sync::cpu_relax();
+			}
+			else {
+				Sleep(s, CanRead);
+			}
+		}
+	}
+
+	void Rw_lock::lock_write_contended()
+	{
+		Rw_lock_state* s = p.get();
+
+		/* Hold off new readers while we wait. */
+		__atomic_add_fetch(&s->writers_waiting, 1, __ATOMIC_SEQ_CST);
+		for (int spins = 0; ; spins++) {
+			int expected = 0;
+			if (__atomic_compare_exchange_n(&s->state, &expected, -1, false,
+						__ATOMIC_ACQUIRE, __ATOMIC_RELAXED)) {
+				break;
+			}
+			if (spins < SPINS) {
+				sync::cpu_relax();
+			}
+			else {
+				Sleep(s, CanWrite);
+			}
+		}
+		__atomic_sub_fetch(&s->writers_waiting, 1, __ATOMIC_SEQ_CST);
+	}
+
+	void Rw_lock::release()
+	{
+		Rw_lock_state* s = p.get();
+		__atomic_add_fetch(&s->seq, 1, __ATOMIC_SEQ_CST);
+		if (__atomic_load_n(&s->sleepers, __ATOMIC_SEQ_CST) != 0) {
+			sync::futex_wake_all(&s->seq);
+		}
+	}
+}
@@ -1,8 +1,19 @@
 /* vim: set ts=4 sts=4 sw=4 tw=80: */
 #include <SDL++/rw_ops.hpp>
+#include <SDL++/pack.hpp>
+#include "compressed.hpp"
+#include "mapped_file.hpp"
+#include "prefetch.hpp"
+#include <algorithm>
+#include <climits>
+#include <cstring>
+#include <vector>
 
 namespace
 {
+	using sdlpp::RW_ops;
+	using sdlpp::shared_ptr;
+	using std::auto_ptr;
 	using std::runtime_error;
 	using std::string;
 
@@ -64,6 +75,238 @@ namespace
 		}
 		return ops;
 	}
+
+	/**
+	 * Frees an SDL_RWops that reads from a mapped file, then lets go of the
+	 * file.
+	 */
+	struct Mapping_deleter
+	{
+		shared_ptr<sdlpp::Mapped_file> file;
+
+		void operator()(SDL_RWops* ops)
+		{
+			SDL_FreeRW(ops);
+		}
+	};
+
+	/**
+	 * Maps a file and makes an SDL_RWops that reads from the mapping.
+	 * @throw runtime_error
+	 */
+	sdlpp::shared_ptr_base<SDL_RWops> Map_file(const string& file_name,
+			RW_ops::Access access)
+	{
+		shared_ptr<sdlpp::Mapped_file> file(new sdlpp::Mapped_file(file_name));
+		if (file->size() > static_cast<size_t>(INT_MAX)) {
+			throw runtime_error(file_name + " is too large for an SDL_RWops");
+		}
+		file->advise(access, 0, file->size());
+		Mapping_deleter deleter = { file };
+		return sdlpp::shared_ptr_base<SDL_RWops>(
+				RWFromConstMem(file->data(), file->size()), deleter);
+	}
+
+	/**
+	 * The state of an SDL_RWops that buffers another one. The buffer holds
+	 * either bytes read ahead from the source or bytes waiting to be written
+	 * to it, never both; once it is empty, it may be used either way.
+	 */
+	struct Buffer
+	{
+		Buffer(const RW_ops& source, int window) :
+			source(source),
+			bytes(window),
+			start(SDL_RWseek(this->source.raw_ptr(), 0, RW_SEEK_CUR)),
+			count(0),
+			position(0),
+			writing(false)
+		{
+			/* A source that can't tell where it is starts at 0. */
+			if (start < 0) {
+				start = 0;
+			}
+		}
+
+		/**
+		 * Writes the pending bytes, if any.
+		 * @return false if they weren't all written.
+		 */
+		bool flush()
+		{
+			if (!writing || count == 0) {
+				return true;
+			}
+			int written = SDL_RWwrite(source.raw_ptr(), &bytes[0], 1, count);
+			if (written > 0) {
+				start += written;
+			}
+			bool complete = written == count;
+			count = 0;
+			return complete;
+		}
+
+		RW_ops source;
+		std::vector<Uint8> bytes;
+
+		/** Where in the source the buffer starts. */
+		int start;
+
+		/** How many bytes the buffer holds. */
+		int count;
+
+		/** Where in the buffer reading got to, if it holds bytes read. */
+		int position;
+
+		bool writing;
+	};
+
+	inline Buffer& BufferOf(SDL_RWops* ops)
+	{
+		return *static_cast<Buffer*>(ops->hidden.unknown.data1);
+	}
+
+	int Buffered_seek(SDL_RWops* ops, int offset, int whence)
+	{
+		Buffer& buffer = BufferOf(ops);
+		int here = buffer.start
+			+ (buffer.writing ? buffer.count : buffer.position);
+		int target = whence == RW_SEEK_SET ? offset : here + offset;
+
+		/* Where the source ends is for it to say. */
+		if (whence != RW_SEEK_END) {
+			if (!buffer.writing && target >= buffer.start
+					&& target <= buffer.start + buffer.count) {
+				buffer.position = target - buffer.start;
+				return target;
+			}
+			if (buffer.writing && target == here) {
+				return here;
+			}
+		}
+
+		if (!buffer.flush()) {
+			return -1;
+		}
+		int result = whence == RW_SEEK_END
+			? SDL_RWseek(buffer.source.raw_ptr(), offset, RW_SEEK_END)
+			: SDL_RWseek(buffer.source.raw_ptr(), target, RW_SEEK_SET);
+		if (result >= 0) {
+			buffer.start = result;
+			buffer.count = 0;
+			buffer.position = 0;
+		}
+		return result;
+	}
+
+	int Buffered_read(SDL_RWops* ops, void* ptr, int size, int maxnum)
+	{
+		Buffer& buffer = BufferOf(ops);
+		if (size <= 0 || maxnum <= 0) {
+			return 0;
+		}
+		if (buffer.writing) {
+			if (!buffer.flush()) {
+				return -1;
+			}
+			buffer.writing = false;
+		}
+
+		SDL_RWops* source = buffer.source.raw_ptr();
+		Uint8* to = static_cast<Uint8*>(ptr);
+		const int window = buffer.bytes.size();
+		const int wanted = size * maxnum;
+		int done = 0;
+		while (done < wanted) {
+			int available = buffer.count - buffer.position;
+			if (available > 0) {
+				int n = std::min(available, wanted - done);
+				std::memcpy(to + done, &buffer.bytes[buffer.position], n);
+				buffer.position += n;
+				done += n;
+				continue;
+			}
+
+			/* All read: move the buffer past its bytes, where the source is. */
+			buffer.start += buffer.count;
+			buffer.count = 0;
+			buffer.position = 0;
+			int n;
+			if (wanted - done >= window) {
+				/* Too much to be worth copying twice. */
+				n = SDL_RWread(source, to + done, 1, wanted - done);
+				if (n > 0) {
+					buffer.start += n;
+					done += n;
+				}
+			}
+			else {
+				n = SDL_RWread(source, &buffer.bytes[0], 1, window);
+				if (n > 0) {
+					buffer.count = n;
+				}
+			}
+			if (n <= 0) {
+				if (n < 0 && done == 0) {
+					return -1;
+				}
+				break;
+			}
+		}
+		return done / size;
+	}
+
+	int Buffered_write(SDL_RWops* ops, const void* ptr, int size, int num)
+	{
+		Buffer& buffer = BufferOf(ops);
+		if (size <= 0 || num <= 0) {
+			return 0;
+		}
+
+		SDL_RWops* source = buffer.source.raw_ptr();
+		if (!buffer.writing) {
+			/* Drop what was read ahead, putting the source back. */
+			if (buffer.position != buffer.count) {
+				if (SDL_RWseek(source, buffer.start + buffer.position,
+							RW_SEEK_SET) < 0) {
+					return -1;
+				}
+			}
+			buffer.start += buffer.position;
+			buffer.count = 0;
+			buffer.position = 0;
+			buffer.writing = true;
+		}
+
+		const int window = buffer.bytes.size();
+		const int total = size * num;
+		if (buffer.count + total > window && !buffer.flush()) {
+			return -1;
+		}
+		if (total >= window) {
+			int written = SDL_RWwrite(source, ptr, size, num);
+			if (written > 0) {
+				buffer.start += written * size;
+			}
+			return written;
+		}
+		std::memcpy(&buffer.bytes[buffer.count], ptr, total);
+		buffer.count += total;
+		return num;
+	}
+
+	int Buffered_close(SDL_RWops* ops)
+	{
+		return BufferOf(ops).flush() ? 0 : -1;
+	}
+
+	void Free_buffered(SDL_RWops* ops)
+	{
+		Buffer* buffer = &BufferOf(ops);
+		buffer->flush();
+		delete buffer;
+		SDL_FreeRW(ops);
+	}
 }
 
 namespace sdlpp
@@ -90,6 +333,64 @@ namespace sdlpp
 	{
 	}
 
+	RW_ops::RW_ops(const string& file_name, Access access) :
+			shared_ptr_base<SDL_RWops>(Map_file(file_name, access))
+	{
+	}
+
+	RW_ops::RW_ops(const char* file_name, Access access) :
+			shared_ptr_base<SDL_RWops>(Map_file(file_name, access))
+	{
+	}
+
+	RW_ops::RW_ops(const RW_ops& source, int window)
+	{
+		if (window <= 0) {
+			throw runtime_error("RW_ops buffer window must be positive");
+		}
+		auto_ptr<Buffer> buffer(new Buffer(source, window));
+		SDL_RWops* ops = SDL_AllocRW();
+		if (ops == 0) {
+			throw runtime_error(string()
+					+ "SDL_AllocRW returned NULL: "
+					+ SDL_GetError());
+		}
+		ops->seek = Buffered_seek;
+		ops->read = Buffered_read;
+		ops->write = Buffered_write;
+		ops->close = Buffered_close;
+		ops->hidden.unknown.data1 = buffer.release();
+		p = shared_ptr<SDL_RWops>(ops, Free_buffered);
+	}
+
+	RW_ops::RW_ops(const RW_ops& source, int block_size, int blocks) :
+			shared_ptr_base<SDL_RWops>(
+					prefetch::create(source, block_size, blocks),
+					prefetch::destroy)
+	{
+	}
+
+	RW_ops::RW_ops(const Pack& pack, const string& entry_name)
+	{
+		const Pack::Entry* entry = pack.find(entry_name);
+		if (entry == 0) {
+			throw runtime_error("No entry " + entry_name + " in pack");
+		}
+		if (entry->length > static_cast<Uint32>(INT_MAX)) {
+			throw runtime_error(entry_name + " is too large for an SDL_RWops");
+		}
+		Mapping_deleter deleter = { pack.file };
+		p = shared_ptr<SDL_RWops>(
+				RWFromConstMem(pack.data(*entry), entry->length), deleter);
+	}
+
+	RW_ops::RW_ops(const RW_ops& source, Direction direction, int block_size) :
+			shared_ptr_base<SDL_RWops>(
+					compressed::create(source, direction, block_size),
+					compressed::destroy)
+	{
+	}
+
 	int RW_ops::seek(int offset, int whence)
 	{
 		return SDL_RWseek(p.get(), offset, whence);
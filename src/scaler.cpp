@@ -0,0 +1,555 @@
+/* vim: set ts=4 sts=4 sw=4 tw=80: */
+#include <SDL++/scaler.hpp>
+#include <SDL++/pixel_format.hpp>
+#include "parallel.hpp"
+#include <cmath>
+#include <cstring>
+#include <vector>
+
+#if defined(__x86_64__) || (defined(__i386__) && defined(__SSE2__))
+#define SDLPP_HAVE_SSE2 1
+#include <emmintrin.h>
+#endif
+
+namespace
+{
+	using sdlpp::Scaler;
+	using std::vector;
+
+	/** The weights of each destination pixel add up to 1 << WEIGHT_BITS. */
+	const int WEIGHT_BITS = 14;
+
+	/**
+	 * The horizontal pass leaves colors times 1 << INTER_BITS, which still
+	 * fits the signed 16 bits that _mm_madd_epi16 takes.
+	 */
+	const int INTER_BITS = 7;
+
+	/** How many destination columns we filter at a time. */
+	const int TILE_WIDTH = 256;
+
+	/**
+	 * The source pixels, and their weights, that make up each destination
+	 * pixel along one axis. Every destination pixel reads count consecutive
+	 * source pixels from its start on, so the SSE2 loops can take them in
+	 * pairs; the weights of pixels it doesn't need are 0.
+	 */
+	struct Taps
+	{
+		int count;
+		vector<int> start;
+		vector<Sint16> weights;
+	};
+
+	/**
+	 * Works out the taps of n destination pixels from first on, when
+	 * src_size pixels are scaled to dst_size.
+	 */
+	void Make_taps(Taps& taps, Scaler::Filter filter, int src_size,
+			int dst_size, int first, int n)
+	{
+		double scale = static_cast<double>(src_size) / dst_size;
+		int widest = filter == Scaler::BOX
+			? static_cast<int>(std::ceil(scale)) + 1 : 2;
+		widest += widest % 2;
+		taps.count = widest < src_size ? widest : src_size;
+		taps.start.resize(n);
+		taps.weights.assign(n * taps.count, 0);
+
+		vector<double> weights(taps.count);
+		for (int i = 0; i < n; i++) {
+			weights.assign(taps.count, 0);
+			int start;
+			if (filter == Scaler::BOX) {
+				double lo = (first + i) * scale;
+				double hi = lo + scale;
+				int begin = static_cast<int>(lo);
+				start = begin < src_size - taps.count
+					? begin : src_size - taps.count;
+				for (int j = begin; j < hi && j < src_size; j++) {
+					double covered = (j + 1 < hi ? j + 1 : hi)
+						- (j > lo ? j : lo);
+					weights[j - start] += covered / scale;
+				}
+			}
+			else {
+				double center = (first + i + 0.5) * scale - 0.5;
+				if (center < 0) {
+					center = 0;
+				}
+				if (center > src_size - 1) {
+					center = src_size - 1;
+				}
+				int left = static_cast<int>(center);
+				int right = left + 1 < src_size ? left + 1 : left;
+				start = left < src_size - taps.count
+					? left : src_size - taps.count;
+				weights[left - start] += 1 - (center - left);
+				weights[right - start] += center - left;
+			}
+
+			/* Round, and make the weights add up exactly. */
+			Sint16* out = &taps.weights[i * taps.count];
+			int sum = 0;
+			int largest = 0;
+			for (int j = 0; j < taps.count; j++) {
+				out[j] = static_cast<Sint16>(
+						weights[j] * (1 << WEIGHT_BITS) + 0.5);
+				sum += out[j];
+				if (out[j] > out[largest]) {
+					largest = j;
+				}
+			}
+			out[largest] += (1 << WEIGHT_BITS) - sum;
+			taps.start[i] = start;
+		}
+	}
+
+	/**
+	 * Works out the source pixel nearest to each of n destination pixels
+	 * from first on.
+	 */
+	void Make_nearest(vector<int>& nearest, int src_size, int dst_size,
+			int first, int n)
+	{
+		double scale = static_cast<double>(src_size) / dst_size;
+		nearest.resize(n);
+		for (int i = 0; i < n; i++) {
+			int j = static_cast<int>((first + i + 0.5) * scale);
+			nearest[i] = j < src_size ? j : src_size - 1;
+		}
+	}
+
+	/**
+	 * Filters a row of four-byte pixels horizontally, for the destination
+	 * columns [first, first + n).
+	 */
+	void Horizontal_scalar(const Uint8* src, const Taps& taps, int first,
+			int n, Sint16* out)
+	{
+		const int shift = WEIGHT_BITS - INTER_BITS;
+		for (int x = first; x < first + n; x++, out += 4) {
+			const Uint8* p = src + 4 * taps.start[x];
+			const Sint16* w = &taps.weights[x * taps.count];
+			int sum[4] = { 0, 0, 0, 0 };
+			for (int t = 0; t < taps.count; t++, p += 4) {
+				for (int c = 0; c < 4; c++) {
+					sum[c] += p[c] * w[t];
+				}
+			}
+			for (int c = 0; c < 4; c++) {
+				out[c] = (sum[c] + (1 << (shift - 1))) >> shift;
+			}
+		}
+	}
+
+	/**
+	 * Blends lanes [i, n) of count intermediate rows into bytes.
+	 */
+	void Vertical_scalar(const Sint16* const* rows, const Sint16* w,
+			int count, int i, int n, Uint8* out)
+	{
+		const int shift = WEIGHT_BITS + INTER_BITS;
+		for (; i < n; i++) {
+			int sum = 1 << (shift - 1);
+			for (int t = 0; t < count; t++) {
+				sum += rows[t][i] * w[t];
+			}
+			sum >>= shift;
+			out[i] = sum > 255 ? 255 : sum;
+		}
+	}
+
+#ifdef SDLPP_HAVE_SSE2
+	/**
+	 * Two weights, as the 32-bit lane that _mm_madd_epi16 pairs them with.
+	 */
+	inline __m128i Weight_pair_sse2(const Sint16* w)
+	{
+		/* In memory, the pair already is that lane. */
+		int pair;
+		std::memcpy(&pair, w, sizeof pair);
+		return _mm_set1_epi32(pair);
+	}
+
+	/**
+	 * The weighted sum of the taps of one destination pixel, with four
+	 * 32-bit lanes. COUNT is the number of taps if it is known when
+	 * compiling, which lets the compiler unroll the common cases.
+	 */
+	template <int COUNT>
+	inline __m128i Taps_sse2(const Uint8* p, const Sint16* w, int count)
+	{
+		const __m128i zero = _mm_setzero_si128();
+		if (COUNT != 0) {
+			count = COUNT;
+		}
+		__m128i sum = _mm_set1_epi32(1 << (WEIGHT_BITS - INTER_BITS - 1));
+		for (int t = 0; t < count; t += 2, p += 8) {
+			/* Two pixels, as r0 r1 g0 g1 b0 b1 a0 a1. */
+			__m128i px = _mm_unpacklo_epi8(
+					_mm_loadl_epi64(reinterpret_cast<const __m128i*>(p)),
+					zero);
+			px = _mm_unpacklo_epi16(px, _mm_srli_si128(px, 8));
+			sum = _mm_add_epi32(sum,
+					_mm_madd_epi16(px, Weight_pair_sse2(w + t)));
+		}
+		return _mm_srai_epi32(sum, WEIGHT_BITS - INTER_BITS);
+	}
+
+	/**
+	 * Like Horizontal_scalar, for an even number of taps.
+	 */
+	template <int COUNT>
+	void Horizontal_sse2(const Uint8* src, const Taps& taps, int first,
+			int n, Sint16* out)
+	{
+		const int count = taps.count;
+		const int* start = &taps.start[0];
+		const Sint16* w = &taps.weights[0];
+		int x = first;
+		for (; x + 2 <= first + n; x += 2, out += 8) {
+			__m128i a = Taps_sse2<COUNT>(src + 4 * start[x], w + x * count,
+					count);
+			__m128i b = Taps_sse2<COUNT>(src + 4 * start[x + 1],
+					w + (x + 1) * count, count);
+			_mm_storeu_si128(reinterpret_cast<__m128i*>(out),
+					_mm_packs_epi32(a, b));
+		}
+		if (x < first + n) {
+			__m128i a = Taps_sse2<COUNT>(src + 4 * start[x], w + x * count,
+					count);
+			_mm_storel_epi64(reinterpret_cast<__m128i*>(out),
+					_mm_packs_epi32(a, a));
+		}
+	}
+
+	/**
+	 * Like Vertical_scalar, for an even number of rows.
+	 */
+	void Vertical_sse2(const Sint16* const* rows, const Sint16* w,
+			int count, int n, Uint8* out)
+	{
+		const int shift = WEIGHT_BITS + INTER_BITS;
+		const __m128i round = _mm_set1_epi32(1 << (shift - 1));
+		int i = 0;
+		for (; i + 16 <= n; i += 16) {
+			__m128i sum0 = round, sum1 = round, sum2 = round, sum3 = round;
+			for (int t = 0; t < count; t += 2) {
+				const __m128i* a = reinterpret_cast<const __m128i*>(
+						rows[t] + i);
+				const __m128i* b = reinterpret_cast<const __m128i*>(
+						rows[t + 1] + i);
+				__m128i a0 = _mm_loadu_si128(a);
+				__m128i a1 = _mm_loadu_si128(a + 1);
+				__m128i b0 = _mm_loadu_si128(b);
+				__m128i b1 = _mm_loadu_si128(b + 1);
+				__m128i k = Weight_pair_sse2(w + t);
+				sum0 = _mm_add_epi32(sum0,
+						_mm_madd_epi16(_mm_unpacklo_epi16(a0, b0), k));
+				sum1 = _mm_add_epi32(sum1,
+						_mm_madd_epi16(_mm_unpackhi_epi16(a0, b0), k));
+				sum2 = _mm_add_epi32(sum2,
+						_mm_madd_epi16(_mm_unpacklo_epi16(a1, b1), k));
+				sum3 = _mm_add_epi32(sum3,
+						_mm_madd_epi16(_mm_unpackhi_epi16(a1, b1), k));
+			}
+			__m128i lo = _mm_packs_epi32(_mm_srai_epi32(sum0, shift),
+					_mm_srai_epi32(sum1, shift));
+			__m128i hi = _mm_packs_epi32(_mm_srai_epi32(sum2, shift),
+					_mm_srai_epi32(sum3, shift));
+			_mm_storeu_si128(reinterpret_cast<__m128i*>(out + i),
+					_mm_packus_epi16(lo, hi));
+		}
+		Vertical_scalar(rows, w, count, i, n, out);
+	}
+#endif /* SDLPP_HAVE_SSE2 */
+
+	inline void Horizontal(const Uint8* src, const Taps& taps, int first,
+			int n, Sint16* out)
+	{
+#ifdef SDLPP_HAVE_SSE2
+		if (taps.count == 2) {
+			Horizontal_sse2<2>(src, taps, first, n, out);
+			return;
+		}
+		if (taps.count % 2 == 0) {
+			Horizontal_sse2<0>(src, taps, first, n, out);
+			return;
+		}
+#endif /* SDLPP_HAVE_SSE2 */
+		Horizontal_scalar(src, taps, first, n, out);
+	}
+
+	inline void Vertical(const Sint16* const* rows, const Sint16* w,
+			int count, int n, Uint8* out)
+	{
+#ifdef SDLPP_HAVE_SSE2
+		if (count % 2 == 0) {
+			Vertical_sse2(rows, w, count, n, out);
+			return;
+		}
+#endif /* SDLPP_HAVE_SSE2 */
+		Vertical_scalar(rows, w, count, 0, n, out);
+	}
+
+	/**
+	 * What the worker threads need to scale a rectangle.
+	 */
+	struct Job
+	{
+		/** The top left of the source rectangle. */
+		const Uint8* src;
+		int src_pitch;
+		int src_bpp;
+		int src_w;
+
+		/** The top left of the area we draw. */
+		Uint8* dst;
+		int dst_pitch;
+		int dst_bpp;
+		int w;
+
+		/**
+		 * Whether we may filter the bytes of the surfaces as they are,
+		 * rather than through src_format and dst_format.
+		 */
+		bool direct;
+		sdlpp::Pixel_format* src_format;
+		sdlpp::Pixel_format* dst_format;
+
+		/* For BILINEAR and BOX. */
+		Taps columns;
+		Taps rows;
+
+		/* For NEAREST. */
+		vector<int> nearest_columns;
+		vector<int> nearest_rows;
+	};
+
+	/**
+	 * Filters rows [begin, end) of the destination, a tile of columns at a
+	 * time. Each tile keeps the horizontally filtered source rows that the
+	 * vertical taps need in a ring.
+	 */
+	void Filter_rows(void* context, int begin, int end)
+	{
+		const Job& job = *static_cast<Job*>(context);
+		const Taps& columns = job.columns;
+		const Taps& rows = job.rows;
+		vector<Sint16> ring(rows.count * 4 * TILE_WIDTH);
+		vector<int> ring_rows(rows.count);
+		vector<const Sint16*> lines(rows.count);
+		vector<Uint8> rgba(job.direct ? 0 : 4 * job.src_w);
+		vector<Uint8> out(job.direct ? 0 : 4 * TILE_WIDTH);
+
+		for (int x = 0; x < job.w; x += TILE_WIDTH) {
+			int n = job.w - x < TILE_WIDTH ? job.w - x : TILE_WIDTH;
+			int first = columns.start[x];
+			int last = columns.start[x + n - 1] + columns.count;
+			ring_rows.assign(rows.count, -1);
+
+			for (int y = begin; y < end; y++) {
+				for (int t = 0; t < rows.count; t++) {
+					int row = rows.start[y] + t;
+					int slot = row % rows.count;
+					Sint16* line = &ring[slot * 4 * TILE_WIDTH];
+					if (ring_rows[slot] != row) {
+						const Uint8* src = job.src + row * job.src_pitch;
+						if (!job.direct) {
+							job.src_format->get(src + first * job.src_bpp,
+									&rgba[4 * first], last - first);
+							src = &rgba[0];
+						}
+						Horizontal(src, columns, x, n, line);
+						ring_rows[slot] = row;
+					}
+					lines[t] = line;
+				}
+
+				Uint8* dst = job.dst + y * job.dst_pitch + x * job.dst_bpp;
+				const Sint16* w = &rows.weights[y * rows.count];
+				if (job.direct) {
+					Vertical(&lines[0], w, rows.count, 4 * n, dst);
+				}
+				else {
+					Vertical(&lines[0], w, rows.count, 4 * n, &out[0]);
+					job.dst_format->map(&out[0], dst, n);
+				}
+			}
+		}
+	}
+
+	template <typename T>
+	inline void Gather(const Uint8* src, const vector<int>& columns,
+			Uint8* dst)
+	{
+		const T* s = reinterpret_cast<const T*>(src);
+		T* d = reinterpret_cast<T*>(dst);
+		for (size_t i = 0; i < columns.size(); i++) {
+			d[i] = s[columns[i]];
+		}
+	}
+
+	/**
+	 * Scales rows [begin, end) of the destination by picking pixels.
+	 */
+	void Nearest_rows(void* context, int begin, int end)
+	{
+		const Job& job = *static_cast<Job*>(context);
+		const vector<int>& columns = job.nearest_columns;
+		int first = columns.front();
+		int last = columns.back() + 1;
+		vector<Uint8> rgba(job.direct ? 0 : 4 * job.src_w);
+		vector<Uint8> out(job.direct ? 0 : 4 * job.w);
+
+		for (int y = begin; y < end; y++) {
+			const Uint8* src = job.src + job.nearest_rows[y] * job.src_pitch;
+			Uint8* dst = job.dst + y * job.dst_pitch;
+			if (!job.direct) {
+				job.src_format->get(src + first * job.src_bpp,
+						&rgba[4 * first], last - first);
+				Gather<Uint32>(&rgba[0], columns, &out[0]);
+				job.dst_format->map(&out[0], dst, job.w);
+				continue;
+			}
+			switch (job.src_bpp) {
+			case 1:
+				Gather<Uint8>(src, columns, dst);
+				break;
+			case 2:
+				Gather<Uint16>(src, columns, dst);
+				break;
+			case 3:
+				for (int i = 0; i < job.w; i++, dst += 3) {
+					const Uint8* p = src + 3 * columns[i];
+					dst[0] = p[0];
+					dst[1] = p[1];
+					dst[2] = p[2];
+				}
+				break;
+			default:
+				Gather<Uint32>(src, columns, dst);
+				break;
+			}
+		}
+	}
+
+	/**
+	 * Whether pixels of a may be copied to b as they are.
+	 */
+	bool Same_format(const SDL_PixelFormat& a, const SDL_PixelFormat& b)
+	{
+		return a.BytesPerPixel == b.BytesPerPixel
+			&& a.Rmask == b.Rmask && a.Gmask == b.Gmask
+			&& a.Bmask == b.Bmask && a.Amask == b.Amask
+			&& a.palette == b.palette;
+	}
+}
+
+namespace sdlpp
+{
+	int Scaler::blit(SDL_Surface* src, SDL_Rect* src_rect,
+			SDL_Surface* dst, SDL_Rect* dst_rect, Filter filter)
+	{
+		if (src == 0 || dst == 0) {
+			SDL_SetError("Scaler::blit passed a NULL surface");
+			return -1;
+		}
+		if (src == dst) {
+			SDL_SetError("Scaler::blit can't scale a surface onto itself");
+			return -1;
+		}
+
+		int src_x = 0;
+		int src_y = 0;
+		int src_w = src->w;
+		int src_h = src->h;
+		if (src_rect != 0) {
+			int x1 = src_rect->x + src_rect->w;
+			int y1 = src_rect->y + src_rect->h;
+			src_x = src_rect->x > 0 ? src_rect->x : 0;
+			src_y = src_rect->y > 0 ? src_rect->y : 0;
+			src_w = (x1 < src->w ? x1 : src->w) - src_x;
+			src_h = (y1 < src->h ? y1 : src->h) - src_y;
+		}
+
+		SDL_Rect full_dst;
+		if (dst_rect == 0) {
+			full_dst.x = full_dst.y = 0;
+			full_dst.w = dst->w;
+			full_dst.h = dst->h;
+			dst_rect = &full_dst;
+		}
+		int dst_w = dst_rect->w;
+		int dst_h = dst_rect->h;
+
+		/* The scale is set; now clip what we draw. */
+		const SDL_Rect& clip = dst->clip_rect;
+		int x0 = dst_rect->x > clip.x ? dst_rect->x : clip.x;
+		int y0 = dst_rect->y > clip.y ? dst_rect->y : clip.y;
+		int x1 = dst_rect->x + dst_w < clip.x + clip.w
+			? dst_rect->x + dst_w : clip.x + clip.w;
+		int y1 = dst_rect->y + dst_h < clip.y + clip.h
+			? dst_rect->y + dst_h : clip.y + clip.h;
+		if (src_w <= 0 || src_h <= 0 || x0 >= x1 || y0 >= y1) {
+			dst_rect->w = dst_rect->h = 0;
+			return 0;
+		}
+
+		Job job;
+		job.w = x1 - x0;
+		int h = y1 - y0;
+		if (filter == NEAREST) {
+			Make_nearest(job.nearest_columns, src_w, dst_w,
+					x0 - dst_rect->x, job.w);
+			Make_nearest(job.nearest_rows, src_h, dst_h,
+					y0 - dst_rect->y, h);
+		}
+		else {
+			Make_taps(job.columns, filter, src_w, dst_w, x0 - dst_rect->x,
+					job.w);
+			Make_taps(job.rows, filter, src_h, dst_h, y0 - dst_rect->y, h);
+		}
+
+		if (SDL_MUSTLOCK(dst) && SDL_LockSurface(dst) < 0) {
+			return -1;
+		}
+		if (SDL_MUSTLOCK(src) && SDL_LockSurface(src) < 0) {
+			if (SDL_MUSTLOCK(dst)) {
+				SDL_UnlockSurface(dst);
+			}
+			return -1;
+		}
+
+		Pixel_format src_format(*src->format);
+		Pixel_format dst_format(*dst->format);
+		job.src_bpp = src->format->BytesPerPixel;
+		job.src = static_cast<const Uint8*>(src->pixels)
+			+ src_y * src->pitch + src_x * job.src_bpp;
+		job.src_pitch = src->pitch;
+		job.src_w = src_w;
+		job.dst_bpp = dst->format->BytesPerPixel;
+		job.dst = static_cast<Uint8*>(dst->pixels)
+			+ y0 * dst->pitch + x0 * job.dst_bpp;
+		job.dst_pitch = dst->pitch;
+		job.src_format = &src_format;
+		job.dst_format = &dst_format;
+		job.direct = Same_format(*src->format, *dst->format)
+			&& (filter == NEAREST || job.src_bpp == 4);
+		parallel::for_rows(h, filter == NEAREST ? Nearest_rows : Filter_rows,
+				&job, 16);
+
+		if (SDL_MUSTLOCK(src)) {
+			SDL_UnlockSurface(src);
+		}
+		if (SDL_MUSTLOCK(dst)) {
+			SDL_UnlockSurface(dst);
+		}
+		dst_rect->x = x0;
+		dst_rect->y = y0;
+		dst_rect->w = job.w;
+		dst_rect->h = h;
+		return 0;
+	}
+}
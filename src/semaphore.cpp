@@ -1,73 +1,230 @@
 #include <SDL++/semaphore.hpp>
+#include "profiled.hpp"
+#include "sync.hpp"
+#include <climits>
+
+#if defined(__linux__)
+#define SDLPP_FUTEX_SEMAPHORE 1
+#endif
+
+namespace
+{
+	typedef sdlpp::profiled::Deleter<SDL_sem> Deleter;
+	typedef sdlpp::profiled::Deleter<sdlpp::Semaphore_state> State_deleter;
+
+	/**
+	 * How often we try again before we go to sleep.
+	 */
+	const int SPINS = 200;
+
+	void DestroyState(sdlpp::Semaphore_state* s)
+	{
+		delete s;
+	}
+
+	/**
+	 * Takes n from the value of s without blocking, if it has that much.
+	 * Taking less would let two waiters each hold part of what one of them
+	 * needs, and wait for each other forever.
+	 *
+	 * @return Whether it took n.
+	 */
+	bool Take(sdlpp::Semaphore_state* s, Uint32 n)
+	{
+		int value = __atomic_load_n(&s->value, __ATOMIC_RELAXED);
+		while (value > 0 && static_cast<Uint32>(value) >= n) {
+			if (__atomic_compare_exchange_n(&s->value, &value,
+						value - static_cast<int>(n), true,
+						__ATOMIC_ACQUIRE, __ATOMIC_RELAXED)) {
+				return true;
+			}
+		}
+		return false;
+	}
+
+	/**
+	 * Takes n from the value of s at once, spinning briefly and then
+	 * sleeping until it has that much.
+	 *
+	 * @return false if timeout milliseconds passed first.
+	 */
+	bool TakeAll(sdlpp::Semaphore_state* s, Uint32 n, Uint32 timeout)
+	{
+		Uint64 deadline = timeout == SDL_MUTEX_MAXWAIT ? 0
+			: sdlpp::sync::now_ns() + timeout * 1000000ULL;
+		for (int spins = 0; ; spins++) {
+			int value = __atomic_load_n(&s->value, __ATOMIC_RELAXED);
+			if (Take(s, n)) {
+				return true;
+			}
+			if (spins < SPINS) {
+				sdlpp::sync::cpu_relax();
+				continue;
+			}
+
+			Uint32 left = SDL_MUTEX_MAXWAIT;
+			if (timeout != SDL_MUTEX_MAXWAIT) {
+				Uint64 now = sdlpp::sync::now_ns();
+				if (now >= deadline) {
+					return false;
+				}
+				left = static_cast<Uint32>((deadline - now + 999999) / 1000000);
+			}
+			/*
+			 * Posters look at sleepers after they raise the value, and the
+			 * kernel checks the value after we raised sleepers, so one of us
+			 * sees the other.
+			 */
+			int* sleepers = n > 1 ? &s->batch_sleepers : &s->sleepers;
+			__atomic_add_fetch(sleepers, 1, __ATOMIC_SEQ_CST);
+			sdlpp::sync::futex_wait(&s->value, value, left);
+			__atomic_sub_fetch(sleepers, 1, __ATOMIC_SEQ_CST);
+		}
+	}
+
+	/**
+	 * Adds n to the value of s, and wakes up to n sleepers with one call.
+	 * A sleeper that waits for more than one may not be satisfied by what
+	 * we add, and must not use up a wake-up another could have used, so if
+	 * there are any, we wake all.
+	 */
+	void Give(sdlpp::Semaphore_state* s, Uint32 n)
+	{
+		__atomic_add_fetch(&s->value, static_cast<int>(n), __ATOMIC_SEQ_CST);
+		if (__atomic_load_n(&s->batch_sleepers, __ATOMIC_SEQ_CST) > 0) {
+			sdlpp::sync::futex_wake_all(&s->value);
+		}
+		else if (__atomic_load_n(&s->sleepers, __ATOMIC_SEQ_CST) > 0) {
+			sdlpp::sync::futex_wake(&s->value,
+					n > INT_MAX ? INT_MAX : static_cast<int>(n));
+		}
+	}
+}
 
 namespace sdlpp
 {
-	Semaphore::Semaphore(Uint32 initial_value) :
-		shared_ptr_base<SDL_sem>(SDL_CreateSemaphore(initial_value), SDL_DestroySemaphore)
+	Semaphore::Semaphore(Uint32 initial_value)
 	{
+#ifdef SDLPP_FUTEX_SEMAPHORE
+		Semaphore_state* s = new Semaphore_state;
+		s->value = initial_value;
+		s->sleepers = 0;
+		s->batch_sleepers = 0;
+		state = shared_ptr<Semaphore_state>(s, State_deleter(DestroyState));
+		profiled::attach(state, Lock_stats::SEMAPHORE);
+#else
+		p = shared_ptr<SDL_sem>(SDL_CreateSemaphore(initial_value),
+				Deleter(SDL_DestroySemaphore));
 		if (p.get() == 0) {
 			throw runtime_error("SDL_CreateSemaphore returned NULL");
 		}
+		profiled::attach(p, Lock_stats::SEMAPHORE);
+#endif /* SDLPP_FUTEX_SEMAPHORE */
 	}
 
 	Semaphore::Semaphore(SDL_sem* semaphore) :
-		shared_ptr_base<SDL_sem>(semaphore, SDL_DestroySemaphore)
+		shared_ptr_base<SDL_sem>(semaphore, Deleter(SDL_DestroySemaphore))
 	{
 		if (p.get() == 0) {
 			throw runtime_error("NULL is not a valid semaphore");
 		}
+		profiled::attach(p, Lock_stats::SEMAPHORE);
 	}
 
 	Semaphore::Semaphore(const Semaphore& that) :
-		shared_ptr_base<SDL_sem>(that)
+		shared_ptr_base<SDL_sem>(that),
+		state(that.state)
 	{
-		if (p.get() == 0) {
+		if (p.get() == 0 && state.get() == 0) {
 			throw runtime_error("Attempted to copy-construct a NULL semaphore");
 		}
 	}
 
 	bool Semaphore::wait()
 	{
-		return SDL_SemWait(p.get()) == 0;
+		return wait(1);
+	}
+
+	bool Semaphore::wait(Uint32 n)
+	{
+#ifdef SDLPP_PROFILE_LOCKS
+		Uint64 start = Lock_profiler::now();
+#endif /* SDLPP_PROFILE_LOCKS */
+		bool ok = true;
+		if (state.get() != 0) {
+			TakeAll(state.get(), n, SDL_MUTEX_MAXWAIT);
+		}
+		else {
+			for (Uint32 i = 0; ok && i < n; i++) {
+				ok = SDL_SemWait(p.get()) == 0;
+			}
+		}
+#ifdef SDLPP_PROFILE_LOCKS
+		Lock_profiler::waited(state.get() != 0 ? profiled::record(state)
+				: profiled::record(p), start);
+#endif /* SDLPP_PROFILE_LOCKS */
+		return ok;
 	}
 
 	bool Semaphore::try_wait()
 	{
-		int ret = SDL_SemTryWait(p.get());
-		switch (ret) {
-		case -2: /* SDL_MUTEX_TIMEOUT */
-			throw runtime_error("Attempt to lock semaphore timed out");
-		case -1:
-			return false;
-		case 0:
-			return true;
-		default:
-			return false;
+		if (state.get() != 0) {
+			return Take(state.get(), 1);
 		}
+		/* SDL_MUTEX_TIMEDOUT if it would block, -1 on errors. */
+		return SDL_SemTryWait(p.get()) == 0;
 	}
 
 	bool Semaphore::wait_timeout(Uint32 timeout)
 	{
-		int ret = SDL_SemWaitTimeout(p.get(), timeout);
-		switch (ret) {
-		case -2: /* SDL_MUTEX_TIMEOUT */
-			throw runtime_error("Attempt to lock semaphore timed out");
-		case -1:
-			return false;
-		case 0:
-			return true;
-		default:
-			return false;
+		if (state.get() != 0) {
+#ifdef SDLPP_PROFILE_LOCKS
+			Uint64 start = Lock_profiler::now();
+			bool ok = TakeAll(state.get(), 1, timeout);
+			Lock_profiler::waited(profiled::record(state), start);
+			return ok;
+#else
+			return TakeAll(state.get(), 1, timeout);
+#endif /* SDLPP_PROFILE_LOCKS */
 		}
+
+#ifdef SDLPP_PROFILE_LOCKS
+		Uint64 start = Lock_profiler::now();
+		int ret = SDL_SemWaitTimeout(p.get(), timeout);
+		Lock_profiler::waited(profiled::record(p), start);
+#else
+		int ret = SDL_SemWaitTimeout(p.get(), timeout);
+#endif /* SDLPP_PROFILE_LOCKS */
+		/* SDL_MUTEX_TIMEDOUT on timeouts, -1 on errors. */
+		return ret == 0;
 	}
 
 	bool Semaphore::post()
 	{
-		return SDL_SemPost(p.get()) == 0;
+		return post(1);
+	}
+
+	bool Semaphore::post(Uint32 n)
+	{
+		if (state.get() != 0) {
+			Give(state.get(), n);
+			return true;
+		}
+
+		for (Uint32 i = 0; i < n; i++) {
+			if (SDL_SemPost(p.get()) != 0) {
+				return false;
+			}
+		}
+		return true;
 	}
 
 	Uint32 Semaphore::value()
 	{
+		if (state.get() != 0) {
+			int value = __atomic_load_n(&state->value, __ATOMIC_RELAXED);
+			return value > 0 ? value : 0;
+		}
 		return SDL_SemValue(p.get());
 	}
 }
@@ -0,0 +1,200 @@
+/* vim: set ts=4 sts=4 sw=4 tw=80: */
+#include "span.hpp"
+#include <cstring>
+
+#if defined(__x86_64__) || (defined(__i386__) && defined(__SSE2__))
+#define SDLPP_HAVE_SSE2 1
+#include <emmintrin.h>
+#endif
+
+namespace
+{
+	void Blend32_scalar(const Uint8* in, const Uint8* alpha, Uint8* out,
+			int count, Uint32 mask)
+	{
+		for (int i = 0; i < count; i++, in += 4, out += 4) {
+			Uint32 pixel;
+			std::memcpy(&pixel, in, 4);
+			sdlpp::span::blend_pixel32(pixel, alpha[i], out, mask);
+		}
+	}
+
+	void Copy32_scalar(const Uint8* in, Uint8* out, int count, Uint32 mask)
+	{
+		for (int i = 0; i < count; i++, in += 4, out += 4) {
+			Uint32 pixel, old;
+			std::memcpy(&pixel, in, 4);
+			std::memcpy(&old, out, 4);
+			pixel = (pixel & mask) | (old & ~mask);
+			std::memcpy(out, &pixel, 4);
+		}
+	}
+
+#ifdef SDLPP_HAVE_SSE2
+	/**
+	 * Blends two pixels, given as 16-bit lanes with their alphas. The same
+	 * arithmetic as Blend32_scalar, so they give the same bytes.
+	 */
+	inline __m128i Blend_sse2(__m128i in, __m128i out, __m128i alpha)
+	{
+		const __m128i max = _mm_set1_epi16(255);
+		const __m128i half = _mm_set1_epi16(128);
+		__m128i x = _mm_add_epi16(_mm_mullo_epi16(in, alpha),
+				_mm_mullo_epi16(out, _mm_xor_si128(alpha, max)));
+		x = _mm_add_epi16(x, half);
+		return _mm_srli_epi16(_mm_add_epi16(x, _mm_srli_epi16(x, 8)), 8);
+	}
+
+	void Blend32_sse2(const Uint8* in, const Uint8* alpha, Uint8* out,
+			int count, Uint32 mask)
+	{
+		const __m128i zero = _mm_setzero_si128();
+		const __m128i blended = _mm_set1_epi32(mask);
+		int i = 0;
+		for (; i + 4 <= count; i += 4) {
+			Uint32 four;
+			std::memcpy(&four, alpha + i, 4);
+			if (four == 0) {
+				continue;
+			}
+			/* Spread each alpha over the four bytes of its pixel. */
+			__m128i a = _mm_cvtsi32_si128(four);
+			a = _mm_unpacklo_epi8(a, a);
+			a = _mm_and_si128(_mm_unpacklo_epi16(a, a), blended);
+
+			__m128i s = _mm_loadu_si128(
+					reinterpret_cast<const __m128i*>(in + 4 * i));
+			__m128i* p = reinterpret_cast<__m128i*>(out + 4 * i);
+			__m128i d = _mm_loadu_si128(p);
+			__m128i lo = Blend_sse2(_mm_unpacklo_epi8(s, zero),
+					_mm_unpacklo_epi8(d, zero), _mm_unpacklo_epi8(a, zero));
+			__m128i hi = Blend_sse2(_mm_unpackhi_epi8(s, zero),
+					_mm_unpackhi_epi8(d, zero), _mm_unpackhi_epi8(a, zero));
+			_mm_storeu_si128(p, _mm_packus_epi16(lo, hi));
+		}
+		Blend32_scalar(in + 4 * i, alpha + i, out + 4 * i, count - i, mask);
+	}
+
+	void Copy32_sse2(const Uint8* in, Uint8* out, int count, Uint32 mask)
+	{
+		const __m128i copied = _mm_set1_epi32(mask);
+		int i = 0;
+		for (; i + 4 <= count; i += 4) {
+			__m128i s = _mm_loadu_si128(
+					reinterpret_cast<const __m128i*>(in + 4 * i));
+			__m128i* p = reinterpret_cast<__m128i*>(out + 4 * i);
+			__m128i d = _mm_loadu_si128(p);
+			_mm_storeu_si128(p, _mm_or_si128(_mm_and_si128(s, copied),
+						_mm_andnot_si128(copied, d)));
+		}
+		Copy32_scalar(in + 4 * i, out + 4 * i, count - i, mask);
+	}
+
+	void Fill32_sse2(Uint8* out, Uint32 pixel, int count)
+	{
+		const __m128i value = _mm_set1_epi32(pixel);
+		int i = 0;
+		for (; i + 4 <= count; i += 4) {
+			_mm_storeu_si128(reinterpret_cast<__m128i*>(out + 4 * i), value);
+		}
+		for (; i < count; i++) {
+			std::memcpy(out + 4 * i, &pixel, 4);
+		}
+	}
+
+	void Fill16_sse2(Uint8* out, Uint16 pixel, int count)
+	{
+		const __m128i value = _mm_set1_epi16(pixel);
+		int i = 0;
+		for (; i + 8 <= count; i += 8) {
+			_mm_storeu_si128(reinterpret_cast<__m128i*>(out + 2 * i), value);
+		}
+		for (; i < count; i++) {
+			std::memcpy(out + 2 * i, &pixel, 2);
+		}
+	}
+#endif /* SDLPP_HAVE_SSE2 */
+}
+
+namespace sdlpp
+{
+	namespace span
+	{
+		void fill(Uint8* out, Uint32 pixel, int count, int bpp)
+		{
+			switch (bpp) {
+			case 1:
+				std::memset(out, pixel, count);
+				break;
+			case 2: {
+#ifdef SDLPP_HAVE_SSE2
+				Fill16_sse2(out, pixel, count);
+#else
+				Uint16 value = pixel;
+				for (int i = 0; i < count; i++) {
+					std::memcpy(out + 2 * i, &value, 2);
+				}
+#endif /* SDLPP_HAVE_SSE2 */
+				break;
+			}
+			case 3: {
+				Uint8 bytes[3];
+#if SDL_BYTEORDER == SDL_LIL_ENDIAN
+				bytes[0] = pixel;
+				bytes[1] = pixel >> 8;
+				bytes[2] = pixel >> 16;
+#else
+				bytes[0] = pixel >> 16;
+				bytes[1] = pixel >> 8;
+				bytes[2] = pixel;
+#endif
+				for (int i = 0; i < count; i++, out += 3) {
+					out[0] = bytes[0];
+					out[1] = bytes[1];
+					out[2] = bytes[2];
+				}
+				break;
+			}
+			default:
+#ifdef SDLPP_HAVE_SSE2
+				Fill32_sse2(out, pixel, count);
+#else
+				for (int i = 0; i < count; i++) {
+					std::memcpy(out + 4 * i, &pixel, 4);
+				}
+#endif /* SDLPP_HAVE_SSE2 */
+				break;
+			}
+		}
+
+		void blend32(const Uint8* in, const Uint8* alpha, Uint8* out,
+				int count, Uint32 mask)
+		{
+#ifdef SDLPP_HAVE_SSE2
+			Blend32_sse2(in, alpha, out, count, mask);
+#else
+			Blend32_scalar(in, alpha, out, count, mask);
+#endif /* SDLPP_HAVE_SSE2 */
+		}
+
+		void copy32(const Uint8* in, Uint8* out, int count, Uint32 mask)
+		{
+#ifdef SDLPP_HAVE_SSE2
+			Copy32_sse2(in, out, count, mask);
+#else
+			Copy32_scalar(in, out, count, mask);
+#endif /* SDLPP_HAVE_SSE2 */
+		}
+
+		void blend_rgba(const Uint8* in, const Uint8* alpha, Uint8* out,
+				int count)
+		{
+			for (int i = 0; i < count; i++, in += 4, out += 4) {
+				int a = alpha[i];
+				for (int c = 0; c < 3; c++) {
+					out[c] = div255(in[c] * a + out[c] * (255 - a));
+				}
+			}
+		}
+	}
+}
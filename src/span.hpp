@@ -0,0 +1,82 @@
+#ifndef SDLPP_SPAN_HPP_INCLUDED
+#define SDLPP_SPAN_HPP_INCLUDED
+/* vim: set ts=4 sts=4 sw=4 tw=80: */
+
+/*
+ * Kernels that fill and blend horizontal runs of pixels, shared by Sprite,
+ * Painter and Surface. This header is private to the library and not
+ * installed.
+ */
+
+#include "SDL.h"
+#include <cstring>
+
+namespace sdlpp
+{
+	namespace span
+	{
+		/**
+		 * @return x / 255, rounded, for x up to 255 * 255.
+		 */
+		inline int div255(int x)
+		{
+			x += 128;
+			return (x + (x >> 8)) >> 8;
+		}
+
+		/**
+		 * Fills count pixels with the same value.
+		 *
+		 * @param bpp The bytes per pixel, 1 to 4.
+		 */
+		void fill(Uint8* out, Uint32 pixel, int count, int bpp);
+
+		/**
+		 * Blends count four-byte pixels onto out by their alphas, with
+		 * rounding: out = (in * a + out * (255 - a)) / 255.
+		 *
+		 * @param mask The bits of a pixel to blend, as it is stored. The
+		 * others keep their value in out, as the alpha channel of the
+		 * destination should.
+		 */
+		void blend32(const Uint8* in, const Uint8* alpha, Uint8* out,
+				int count, Uint32 mask);
+
+		/**
+		 * Copies count four-byte pixels onto out.
+		 *
+		 * @param mask The bits of a pixel to copy, as for blend32().
+		 */
+		void copy32(const Uint8* in, Uint8* out, int count, Uint32 mask);
+
+		/**
+		 * Blends one four-byte pixel onto out, as blend32() does, two
+		 * channels at a time.
+		 */
+		inline void blend_pixel32(Uint32 in, Uint8 alpha, Uint8* out,
+				Uint32 mask)
+		{
+			const Uint32 lanes = 0x00FF00FF;
+			const Uint32 half = 0x00800080;
+			Uint32 pixel;
+			std::memcpy(&pixel, out, 4);
+			Uint32 a = alpha;
+			Uint32 rb = (in & lanes) * a + (pixel & lanes) * (255 - a) + half;
+			rb = ((rb + ((rb >> 8) & lanes)) >> 8) & lanes;
+			Uint32 ga = ((in >> 8) & lanes) * a
+				+ ((pixel >> 8) & lanes) * (255 - a) + half;
+			ga = (ga + ((ga >> 8) & lanes)) & ~lanes;
+			pixel = ((rb | ga) & mask) | (pixel & ~mask);
+			std::memcpy(out, &pixel, 4);
+		}
+
+		/**
+		 * Blends count RGBA pixels onto out by their alphas, as blend32()
+		 * does, keeping the alpha of out.
+		 */
+		void blend_rgba(const Uint8* in, const Uint8* alpha, Uint8* out,
+				int count);
+	}
+}
+
+#endif /* SDLPP_SPAN_HPP_INCLUDED */
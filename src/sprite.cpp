@@ -0,0 +1,347 @@
+/* vim: set ts=4 sts=4 sw=4 tw=80: */
+#include <SDL++/sprite.hpp>
+#include <SDL++/pixel_format.hpp>
+#include <SDL++/pixel_traits.hpp>
+#include "span.hpp"
+#include <cstring>
+#include <string>
+#include <vector>
+
+namespace
+{
+	using std::vector;
+
+	/**
+	 * A run of pixels in a row that are drawn. The pixels between runs are
+	 * skipped.
+	 */
+	struct Span
+	{
+		/** The column of the first pixel. */
+		int x;
+		int length;
+
+		/** Where the pixels start, counted in pixels. */
+		int offset;
+
+		/** Where their alphas start, or -1 if the span is opaque. */
+		int alpha;
+	};
+
+	inline Uint32 Load(const Uint8* p, int bpp)
+	{
+		switch (bpp) {
+		case 1:
+			return *p;
+		case 2:
+			return sdlpp::Pixel_storage_16::load(p);
+		case 3:
+			return sdlpp::Pixel_storage_24::load(p);
+		default:
+			return sdlpp::Pixel_storage_32::load(p);
+		}
+	}
+
+	bool Same_format(const SDL_PixelFormat& a, const SDL_PixelFormat& b)
+	{
+		if (a.BytesPerPixel != b.BytesPerPixel
+				|| a.Rmask != b.Rmask || a.Gmask != b.Gmask
+				|| a.Bmask != b.Bmask || a.Amask != b.Amask
+				|| (a.palette == 0) != (b.palette == 0)) {
+			return false;
+		}
+		/* Our copy of the palette is never the one of the surface. */
+		return a.palette == 0 || (a.palette->ncolors == b.palette->ncolors
+				&& std::memcmp(a.palette->colors, b.palette->colors,
+					a.palette->ncolors * sizeof(SDL_Color)) == 0);
+	}
+}
+
+namespace sdlpp
+{
+	/**
+	 * The spans that copies of a Sprite share.
+	 */
+	struct Sprite::Data
+	{
+		/**
+		 * Encodes the pixels of src, leaving out those masked off.
+		 */
+		Data(SDL_Surface* src, SDL_Surface* mask) :
+			w(src->w),
+			h(src->h),
+			format(*src->format)
+		{
+			if (src->format->palette != 0) {
+				const SDL_Palette& p = *src->format->palette;
+				colors.assign(p.colors, p.colors + p.ncolors);
+				palette.ncolors = p.ncolors;
+				palette.colors = colors.empty() ? 0 : &colors[0];
+				format.palette = &palette;
+			}
+			if (mask != 0 && (mask->w != w || mask->h != h)) {
+				throw runtime_error("The mask of a sprite must have its size");
+			}
+			if (SDL_MUSTLOCK(src) && SDL_LockSurface(src) < 0) {
+				throw runtime_error(std::string()
+						+ "Can't lock a surface to build a sprite: "
+						+ SDL_GetError());
+			}
+			if (mask != 0 && SDL_MUSTLOCK(mask) && SDL_LockSurface(mask) < 0) {
+				if (SDL_MUSTLOCK(src)) {
+					SDL_UnlockSurface(src);
+				}
+				throw runtime_error(std::string()
+						+ "Can't lock a mask to build a sprite: "
+						+ SDL_GetError());
+			}
+			build(src, mask);
+			if (mask != 0 && SDL_MUSTLOCK(mask)) {
+				SDL_UnlockSurface(mask);
+			}
+			if (SDL_MUSTLOCK(src)) {
+				SDL_UnlockSurface(src);
+			}
+		}
+
+		/**
+		 * Appends the spans of src. Its surfaces must be locked.
+		 */
+		void build(SDL_Surface* src, SDL_Surface* mask);
+
+		int w;
+		int h;
+
+		/** The format of the pixels, with its own copy of the palette. */
+		Pixel_format format;
+		SDL_Palette palette;
+		vector<SDL_Color> colors;
+
+		/** Where the spans of each row start, and where the last ends. */
+		vector<int> rows;
+		vector<Span> spans;
+		vector<Uint8> pixels;
+		vector<Uint8> alphas;
+
+	private:
+		Data(const Data& that);
+		Data& operator= (const Data& that);
+	};
+
+	void Sprite::Data::build(SDL_Surface* src, SDL_Surface* mask)
+	{
+		const SDL_PixelFormat& f = *src->format;
+		const int bpp = f.BytesPerPixel;
+		const bool keyed = (src->flags & SDL_SRCCOLORKEY) != 0;
+		const Uint32 key_mask = f.palette != 0 ? 0xFFFFFFFF
+			: f.Rmask | f.Gmask | f.Bmask;
+		const Uint32 key = f.colorkey & key_mask;
+		const int surface_alpha = f.Amask == 0 && (src->flags & SDL_SRCALPHA)
+			? f.alpha : 255;
+
+		rows.reserve(h + 1);
+		for (int y = 0; y < h; y++) {
+			rows.push_back(spans.size());
+			const Uint8* row = static_cast<const Uint8*>(src->pixels)
+				+ y * src->pitch;
+			const Uint8* mask_row = mask == 0 ? 0
+				: static_cast<const Uint8*>(mask->pixels) + y * mask->pitch;
+
+			for (int x = 0; x < w; x++) {
+				Uint32 pixel = Load(row + x * bpp, bpp);
+				int a = surface_alpha;
+				if (keyed && (pixel & key_mask) == key) {
+					a = 0;
+				}
+				else if (mask_row != 0 && Load(mask_row
+							+ x * mask->format->BytesPerPixel,
+							mask->format->BytesPerPixel) == 0) {
+					a = 0;
+				}
+				else if (f.Amask != 0) {
+					Uint8 r, g, b, alpha;
+					SDL_GetRGBA(pixel, src->format, &r, &g, &b, &alpha);
+					a = alpha;
+				}
+				if (a == 0) {
+					continue;
+				}
+
+				/* Extend the last span if it ends here and is alike. */
+				bool opaque = a == 255;
+				Span* last = spans.size() > static_cast<size_t>(rows.back())
+					? &spans.back() : 0;
+				if (last == 0 || last->x + last->length != x
+						|| (last->alpha < 0) != opaque) {
+					Span run = { x, 0, static_cast<int>(pixels.size() / bpp),
+						opaque ? -1 : static_cast<int>(alphas.size()) };
+					spans.push_back(run);
+					last = &spans.back();
+				}
+				last->length++;
+				pixels.insert(pixels.end(), row + x * bpp, row + (x + 1) * bpp);
+				if (!opaque) {
+					alphas.push_back(a);
+				}
+			}
+		}
+		rows.push_back(spans.size());
+	}
+
+	Sprite::Sprite(Surface& src) :
+		data(new Data(src.raw_ptr(), 0))
+	{
+	}
+
+	Sprite::Sprite(Surface& src, Surface& mask) :
+		data(new Data(src.raw_ptr(), mask.raw_ptr()))
+	{
+	}
+
+	int Sprite::w() const
+	{
+		return data->w;
+	}
+
+	int Sprite::h() const
+	{
+		return data->h;
+	}
+
+	int Sprite::pixels() const
+	{
+		return data->pixels.size() / data->format.BytesPerPixel;
+	}
+
+	bool Sprite::blit(Surface& dst, Rect& dst_rect)
+	{
+		Rect all(0, 0, data->w, data->h);
+		return blit(all, dst, dst_rect);
+	}
+
+	bool Sprite::blit(Rect& src_rect, Surface& dst, Rect& dst_rect)
+	{
+		SDL_Surface* d = dst.raw_ptr();
+
+		/* What follows is SDL_UpperBlit's clipping. */
+		int src_x = src_rect.x;
+		int w = src_rect.w;
+		if (src_x < 0) {
+			w += src_x;
+			dst_rect.x -= src_x;
+			src_x = 0;
+		}
+		if (data->w - src_x < w) {
+			w = data->w - src_x;
+		}
+		int src_y = src_rect.y;
+		int h = src_rect.h;
+		if (src_y < 0) {
+			h += src_y;
+			dst_rect.y -= src_y;
+			src_y = 0;
+		}
+		if (data->h - src_y < h) {
+			h = data->h - src_y;
+		}
+
+		const SDL_Rect& clip = d->clip_rect;
+		int dx = clip.x - dst_rect.x;
+		if (dx > 0) {
+			w -= dx;
+			dst_rect.x += dx;
+			src_x += dx;
+		}
+		dx = dst_rect.x + w - clip.x - clip.w;
+		if (dx > 0) {
+			w -= dx;
+		}
+		int dy = clip.y - dst_rect.y;
+		if (dy > 0) {
+			h -= dy;
+			dst_rect.y += dy;
+			src_y += dy;
+		}
+		dy = dst_rect.y + h - clip.y - clip.h;
+		if (dy > 0) {
+			h -= dy;
+		}
+		if (w <= 0 || h <= 0) {
+			dst_rect.w = dst_rect.h = 0;
+			return true;
+		}
+		dst_rect.w = w;
+		dst_rect.h = h;
+
+		if (SDL_MUSTLOCK(d) && SDL_LockSurface(d) < 0) {
+			return false;
+		}
+
+		const int bpp = data->format.BytesPerPixel;
+		const int dst_bpp = d->format->BytesPerPixel;
+		const bool same = Same_format(data->format, *d->format);
+		const bool direct = same && bpp == 4;
+		Pixel_format dst_format(*d->format);
+		const Uint32 blended = ~d->format->Amask;
+		const bool keep_alpha = d->format->Amask != 0;
+		vector<Uint8> src_rgba(direct ? 0 : 4 * w);
+		vector<Uint8> dst_rgba(direct ? 0 : 4 * w);
+
+		const vector<Span>& spans = data->spans;
+		const int end_x = src_x + w;
+		for (int y = 0; y < h; y++) {
+			Uint8* row = static_cast<Uint8*>(d->pixels)
+				+ (dst_rect.y + y) * d->pitch
+				+ (dst_rect.x - src_x) * dst_bpp;
+			int last = data->rows[src_y + y + 1];
+			for (int i = data->rows[src_y + y]; i < last && spans[i].x < end_x;
+					i++) {
+				const Span& run = spans[i];
+				int begin = run.x > src_x ? run.x : src_x;
+				int end = run.x + run.length;
+				end = end < end_x ? end : end_x;
+				if (begin >= end) {
+					continue;
+				}
+				int skip = begin - run.x;
+				int count = end - begin;
+				const Uint8* in = &data->pixels[(run.offset + skip) * bpp];
+				Uint8* out = row + begin * dst_bpp;
+
+				if (run.alpha < 0 && same && !keep_alpha) {
+					std::memcpy(out, in, count * bpp);
+					continue;
+				}
+				if (run.alpha < 0 && direct) {
+					span::copy32(in, out, count, blended);
+					continue;
+				}
+				if (run.alpha < 0) {
+					data->format.get(in, &src_rgba[0], count);
+					if (keep_alpha) {
+						dst_format.get(out, &dst_rgba[0], count);
+						for (int j = 3; j < 4 * count; j += 4) {
+							src_rgba[j] = dst_rgba[j];
+						}
+					}
+					dst_format.map(&src_rgba[0], out, count);
+					continue;
+				}
+				const Uint8* alpha = &data->alphas[run.alpha + skip];
+				if (direct) {
+					span::blend32(in, alpha, out, count, blended);
+					continue;
+				}
+				data->format.get(in, &src_rgba[0], count);
+				dst_format.get(out, &dst_rgba[0], count);
+				span::blend_rgba(&src_rgba[0], alpha, &dst_rgba[0], count);
+				dst_format.map(&dst_rgba[0], out, count);
+			}
+		}
+
+		if (SDL_MUSTLOCK(d)) {
+			SDL_UnlockSurface(d);
+		}
+		return true;
+	}
+}
@@ -1,5 +1,8 @@
 /* vim: set ts=4 sts=4 sw=4 tw=80: */
 #include <SDL++/surface.hpp>
+#include <SDL++/blitter.hpp>
+#include <SDL++/palette_map.hpp>
+#include "span.hpp"
 
 namespace
 {
@@ -104,30 +107,54 @@ namespace sdlpp
 
 	bool Surface::blit(Surface& dst)
 	{
-		return SDL_BlitSurface(
+		return Blitter::blit(
 				p.get(), 0,
-				dst.raw_ptr(), 0) == 0;
+				dst.raw_ptr(), 0, Blitter::WHEN_FASTER) == 0;
 	}
 
 	bool Surface::blit(Rect& src_rect, Surface& dst)
 	{
-		return SDL_BlitSurface(
+		return Blitter::blit(
 				p.get(), &src_rect,
-				dst.raw_ptr(), 0) == 0;
+				dst.raw_ptr(), 0, Blitter::WHEN_FASTER) == 0;
 	}
 
 	bool Surface::blit(Rect& src_rect, Surface& dst, Rect& dst_rect)
 	{
-		return SDL_BlitSurface(
+		return Blitter::blit(
 				p.get(), &src_rect,
-				dst.raw_ptr(), &dst_rect) == 0;
+				dst.raw_ptr(), &dst_rect, Blitter::WHEN_FASTER) == 0;
 	}
 
 	bool Surface::blit(Surface& dst, Rect& dst_rect)
 	{
-		return SDL_BlitSurface(
+		return Blitter::blit(
 				p.get(), 0,
-				dst.raw_ptr(), &dst_rect) == 0;
+				dst.raw_ptr(), &dst_rect, Blitter::WHEN_FASTER) == 0;
+	}
+
+	bool Surface::blit(Rect& src_rect, Surface& dst, Rect& dst_rect,
+			const Region& clip)
+	{
+		return Blitter::blit(
+				p.get(), &src_rect,
+				dst.raw_ptr(), &dst_rect, clip, Blitter::WHEN_FASTER) == 0;
+	}
+
+	bool Surface::blit_scaled(Surface& dst, Rect& dst_rect,
+			Scaler::Filter filter)
+	{
+		return Scaler::blit(
+				p.get(), 0,
+				dst.raw_ptr(), &dst_rect, filter) == 0;
+	}
+
+	bool Surface::blit_scaled(Rect& src_rect, Surface& dst, Rect& dst_rect,
+			Scaler::Filter filter)
+	{
+		return Scaler::blit(
+				p.get(), &src_rect,
+				dst.raw_ptr(), &dst_rect, filter) == 0;
 	}
 
 	bool Surface::fill(Rect* rect, Uint32 color)
@@ -135,6 +162,38 @@ namespace sdlpp
 		return SDL_FillRect(p.get(), rect, color) == 0;
 	}
 
+	bool Surface::fill(const Region& region, Uint32 color)
+	{
+		Region area(p->clip_rect);
+		area.intersect(region);
+		if ((p->flags & SDL_HWSURFACE) != 0) {
+			/* SDL may have the hardware fill these. */
+			bool ok = true;
+			for (size_t i = 0; i < area.size(); i++) {
+				Rect rect = area[i];
+				ok = SDL_FillRect(p.get(), &rect, color) == 0 && ok;
+			}
+			return ok;
+		}
+
+		if (SDL_MUSTLOCK(p.get()) && SDL_LockSurface(p.get()) < 0) {
+			return false;
+		}
+		const int bpp = p->format->BytesPerPixel;
+		for (size_t i = 0; i < area.size(); i++) {
+			Rect rect = area[i];
+			Uint8* row = static_cast<Uint8*>(p->pixels) + rect.y * p->pitch
+				+ rect.x * bpp;
+			for (int y = 0; y < rect.h; y++, row += p->pitch) {
+				span::fill(row, color, rect.w, bpp);
+			}
+		}
+		if (SDL_MUSTLOCK(p.get())) {
+			SDL_UnlockSurface(p.get());
+		}
+		return true;
+	}
+
 	bool Surface::convert(SDL_PixelFormat* fmt, Uint32 flags)
 	{
 		/**
@@ -199,17 +258,23 @@ namespace sdlpp
 
 	bool Surface::set_colors(SDL_Color* colors, int firstcolor, int ncolors)
 	{
-		return SDL_SetColors(p.get(), colors, firstcolor, ncolors);
+		bool set = SDL_SetColors(p.get(), colors, firstcolor, ncolors);
+		Palette_map::palette_changed();
+		return set;
 	}
 
 	bool Surface::set_colors(vector<SDL_Color>& colors, int firstcolor, int ncolors)
 	{
-		return SDL_SetColors(p.get(), &colors[0], firstcolor, ncolors);
+		bool set = SDL_SetColors(p.get(), &colors[0], firstcolor, ncolors);
+		Palette_map::palette_changed();
+		return set;
 	}
 
 	bool Surface::set_colors(vector<Color>& colors, int firstcolor, int ncolors)
 	{
-		return SDL_SetColors(p.get(), &colors[0], firstcolor, ncolors);
+		bool set = SDL_SetColors(p.get(), &colors[0], firstcolor, ncolors);
+		Palette_map::palette_changed();
+		return set;
 	}
 
 	bool Surface::set_color_key(Uint32 flag, Uint32 key)
@@ -219,17 +284,23 @@ namespace sdlpp
 
 	bool Surface::set_palette(int flags, SDL_Color* colors, int firstcolor, int ncolors)
 	{
-		return SDL_SetPalette(p.get(), flags, colors, firstcolor, ncolors);
+		bool set = SDL_SetPalette(p.get(), flags, colors, firstcolor, ncolors);
+		Palette_map::palette_changed();
+		return set;
 	}
 	
 	bool Surface::set_palette(int flags, std::vector<SDL_Color>& colors, int firstcolor, int ncolors)
 	{
-		return SDL_SetPalette(p.get(), flags, &colors[0], firstcolor, ncolors);
+		bool set = SDL_SetPalette(p.get(), flags, &colors[0], firstcolor, ncolors);
+		Palette_map::palette_changed();
+		return set;
 	}
 
 	bool Surface::set_palette(int flags, std::vector<Color>& colors, int firstcolor, int ncolors)
 	{
-		return SDL_SetPalette(p.get(), flags, &colors[0], firstcolor, ncolors);
+		bool set = SDL_SetPalette(p.get(), flags, &colors[0], firstcolor, ncolors);
+		Palette_map::palette_changed();
+		return set;
 	}
 
 	bool Surface::must_lock()
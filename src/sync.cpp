@@ -0,0 +1,140 @@
+/* vim: set ts=4 sts=4 sw=4 tw=80: */
+#include "sync.hpp"
+#include <climits>
+
+#if defined(__linux__)
+#include <linux/futex.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#include <errno.h>
+#else
+#include <stdexcept>
+#endif /* __linux__ */
+#include <time.h>
+
+namespace
+{
+#if !defined(__linux__)
+	using std::runtime_error;
+
+	/**
+	 * One slot of the emulated futex table. Addresses that hash to the same
+	 * bucket share a condition variable, so wake-ups are broadcast and
+	 * waiters re-check their own word.
+	 */
+	struct Bucket
+	{
+		SDL_mutex* mutex;
+		SDL_cond* cond;
+	};
+
+	class Parking_lot
+	{
+	public:
+		enum { SIZE = 64 };
+
+		Parking_lot()
+		{
+			for (int i = 0; i < SIZE; i++) {
+				buckets[i].mutex = SDL_CreateMutex();
+				buckets[i].cond = SDL_CreateCond();
+				if (buckets[i].mutex == 0 || buckets[i].cond == 0) {
+					throw runtime_error("Failed to create the futex table");
+				}
+			}
+		}
+
+		~Parking_lot()
+		{
+			for (int i = 0; i < SIZE; i++) {
+				SDL_DestroyCond(buckets[i].cond);
+				SDL_DestroyMutex(buckets[i].mutex);
+			}
+		}
+
+		Bucket& bucket(int* addr)
+		{
+			unsigned long a = reinterpret_cast<unsigned long>(addr);
+			return buckets[(a >> 4) % SIZE];
+		}
+
+	private:
+		Bucket buckets[SIZE];
+	};
+
+	Parking_lot& parking_lot()
+	{
+		static Parking_lot lot;
+		return lot;
+	}
+#endif /* !__linux__ */
+}
+
+namespace sdlpp
+{
+	namespace sync
+	{
+#if defined(__linux__)
+		bool futex_wait(int* addr, int expected, Uint32 timeout)
+		{
+			struct timespec ts;
+			struct timespec* tsp = 0;
+			if (timeout != SDL_MUTEX_MAXWAIT) {
+				ts.tv_sec = timeout / 1000;
+				ts.tv_nsec = (timeout % 1000) * 1000000L;
+				tsp = &ts;
+			}
+			long rc = syscall(SYS_futex, addr, FUTEX_WAIT_PRIVATE, expected,
+					tsp, 0, 0);
+			return !(rc == -1 && errno == ETIMEDOUT);
+		}
+
+		void futex_wake(int* addr, int count)
+		{
+			syscall(SYS_futex, addr, FUTEX_WAKE_PRIVATE, count, 0, 0, 0);
+		}
+#else
+		bool futex_wait(int* addr, int expected, Uint32 timeout)
+		{
+			Bucket& b = parking_lot().bucket(addr);
+			bool woken = true;
+			SDL_mutexP(b.mutex);
+			if (__atomic_load_n(addr, __ATOMIC_ACQUIRE) == expected) {
+				if (timeout == SDL_MUTEX_MAXWAIT) {
+					SDL_CondWait(b.cond, b.mutex);
+				}
+				else {
+					woken = SDL_CondWaitTimeout(b.cond, b.mutex, timeout)
+						!= SDL_MUTEX_TIMEDOUT;
+				}
+			}
+			SDL_mutexV(b.mutex);
+			return woken;
+		}
+
+		void futex_wake(int* addr, int)
+		{
+			Bucket& b = parking_lot().bucket(addr);
+			SDL_mutexP(b.mutex);
+			SDL_CondBroadcast(b.cond);
+			SDL_mutexV(b.mutex);
+		}
+#endif /* __linux__ */
+
+		void futex_wake_all(int* addr)
+		{
+			futex_wake(addr, INT_MAX);
+		}
+
+		Uint64 now_ns()
+		{
+#if defined(CLOCK_MONOTONIC)
+			struct timespec ts;
+			clock_gettime(CLOCK_MONOTONIC, &ts);
+			return static_cast<Uint64>(ts.tv_sec) * 1000000000ULL + ts.tv_nsec;
+#else
+			return static_cast<Uint64>(SDL_GetTicks()) * 1000000ULL;
+#endif
+		}
+	}
+}
@@ -0,0 +1,61 @@
+#ifndef SDLPP_SYNC_HPP_INCLUDED
+#define SDLPP_SYNC_HPP_INCLUDED
+/* vim: set ts=4 sts=4 sw=4 tw=80: */
+
+/*
+ * Low-level helpers shared by the synchronization primitives. This header is
+ * private to the library and not installed.
+ */
+
+#include "SDL.h"
+
+namespace sdlpp
+{
+	namespace sync
+	{
+		/**
+		 * Tells the CPU that we are spinning. This is a pause instruction on
+		 * x86 and a yield hint on ARM.
+		 */
+		inline void cpu_relax()
+		{
+#if defined(__i386__) || defined(__x86_64__)
+			__builtin_ia32_pause();
+#elif defined(__aarch64__) || defined(__arm__)
+			__asm__ __volatile__("yield" ::: "memory");
+#else
+			__asm__ __volatile__("" ::: "memory");
+#endif
+		}
+
+		/**
+		 * Blocks while *addr == expected, or until timeout milliseconds have
+		 * passed. May return spuriously; callers must re-check *addr.
+		 *
+		 * @note On Linux this is the futex system call. Elsewhere we emulate
+		 * it with a small table of SDL mutexes and condition variables keyed
+		 * on the address.
+		 *
+		 * @return false if the wait timed out, true otherwise.
+		 */
+		bool futex_wait(int* addr, int expected,
+				Uint32 timeout = SDL_MUTEX_MAXWAIT);
+
+		/**
+		 * Wakes up to count threads blocked in futex_wait on addr.
+		 */
+		void futex_wake(int* addr, int count);
+
+		/**
+		 * Wakes all threads blocked in futex_wait on addr.
+		 */
+		void futex_wake_all(int* addr);
+
+		/**
+		 * @return A monotonic timestamp in nanoseconds.
+		 */
+		Uint64 now_ns();
+	}
+}
+
+#endif /* SDLPP_SYNC_HPP_INCLUDED */
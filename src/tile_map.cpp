@@ -0,0 +1,355 @@
+/* vim: set ts=4 sts=4 sw=4 tw=80: */
+#include <SDL++/tile_map.hpp>
+#include <SDL++/pixel_format.hpp>
+#include <SDL++/pixel_traits.hpp>
+#include <algorithm>
+#include <cstring>
+#include <string>
+
+namespace
+{
+	using std::vector;
+
+	inline Uint32 Load(const Uint8* p, int bpp)
+	{
+		switch (bpp) {
+		case 1:
+			return *p;
+		case 2:
+			return sdlpp::Pixel_storage_16::load(p);
+		case 3:
+			return sdlpp::Pixel_storage_24::load(p);
+		default:
+			return sdlpp::Pixel_storage_32::load(p);
+		}
+	}
+
+	/**
+	 * Locks a surface if it needs to be, for as long as it lives.
+	 */
+	class Lock
+	{
+	public:
+		Lock(SDL_Surface* surface) :
+			surface(surface),
+			must_lock(SDL_MUSTLOCK(surface))
+		{
+			if (must_lock && SDL_LockSurface(surface) < 0) {
+				throw sdlpp::runtime_error(std::string()
+						+ "Can't lock a surface to build a tile chunk: "
+						+ SDL_GetError());
+			}
+		}
+
+		~Lock()
+		{
+			if (must_lock) {
+				SDL_UnlockSurface(surface);
+			}
+		}
+
+	private:
+		SDL_Surface* surface;
+		bool must_lock;
+
+		Lock(const Lock& that);
+		Lock& operator= (const Lock& that);
+	};
+
+	/**
+	 * Blits the part of an area of src that is inside the view. The area
+	 * starts at src_x, src_y in src and at map_x, map_y on the map, and the
+	 * view is [x0, x1) by [y0, y1) on the map, drawn from view_x, view_y
+	 * at dst_rect.
+	 */
+	bool Blit_area(sdlpp::Surface& src, int src_x, int src_y, int map_x,
+			int map_y, int w, int h, int x0, int y0, int x1, int y1,
+			sdlpp::Surface& dst, const SDL_Rect& dst_rect, int view_x,
+			int view_y)
+	{
+		int left = std::max(map_x, x0);
+		int top = std::max(map_y, y0);
+		int right = std::min(map_x + w, x1);
+		int bottom = std::min(map_y + h, y1);
+		if (left >= right || top >= bottom) {
+			return true;
+		}
+		sdlpp::Rect src_rect(src_x + left - map_x, src_y + top - map_y,
+				right - left, bottom - top);
+		sdlpp::Rect at(dst_rect.x + left - view_x, dst_rect.y + top - view_y);
+		return src.blit(src_rect, dst, at);
+	}
+}
+
+namespace sdlpp
+{
+	Tile_map::Tile_map(Surface& atlas, int tile_w, int tile_h, int columns,
+			int rows, int layers, int chunk_size) :
+		atlas(atlas),
+		atlas_columns(tile_w > 0 ? atlas.w() / tile_w : 0),
+		tile_count(tile_h > 0 ? atlas_columns * (atlas.h() / tile_h) : 0),
+		tile_width(tile_w),
+		tile_height(tile_h),
+		column_count(columns),
+		row_count(rows),
+		layer_count(layers),
+		chunk_size(chunk_size),
+		chunk_columns(chunk_size > 0 ? (columns + chunk_size - 1) / chunk_size
+				: 0),
+		chunk_rows(chunk_size > 0 ? (rows + chunk_size - 1) / chunk_size : 0)
+	{
+		if (tile_w <= 0 || tile_h <= 0 || columns <= 0 || rows <= 0
+				|| layers <= 0 || chunk_size <= 0) {
+			throw runtime_error("The sizes of a tile map must be positive");
+		}
+		if (tile_count == 0) {
+			throw runtime_error("The atlas of a tile map holds no tile");
+		}
+		cells.assign(static_cast<size_t>(layers) * rows * columns, EMPTY);
+		statics.assign(layers, false);
+		chunks.resize(static_cast<size_t>(layers) * chunk_rows
+				* chunk_columns);
+	}
+
+	int Tile_map::tile_w() const
+	{
+		return tile_width;
+	}
+
+	int Tile_map::tile_h() const
+	{
+		return tile_height;
+	}
+
+	int Tile_map::columns() const
+	{
+		return column_count;
+	}
+
+	int Tile_map::rows() const
+	{
+		return row_count;
+	}
+
+	int Tile_map::layers() const
+	{
+		return layer_count;
+	}
+
+	int Tile_map::tile(int layer, int column, int row) const
+	{
+		return cells[cell(layer, column, row)];
+	}
+
+	void Tile_map::set_tile(int layer, int column, int row, int tile)
+	{
+		if (tile < EMPTY || tile >= tile_count) {
+			throw runtime_error("The atlas of the tile map has no such tile");
+		}
+		int& value = cells[cell(layer, column, row)];
+		if (value == tile) {
+			return;
+		}
+		value = tile;
+		chunks[(static_cast<size_t>(layer) * chunk_rows + row / chunk_size)
+			* chunk_columns + column / chunk_size].dirty = true;
+	}
+
+	void Tile_map::set_static(int layer, bool on)
+	{
+		if (layer < 0 || layer >= layer_count) {
+			throw runtime_error("The tile map has no such layer");
+		}
+		statics[layer] = on;
+		if (!on) {
+			/* Free the chunks, and build them afresh if it comes back. */
+			size_t count = static_cast<size_t>(chunk_rows) * chunk_columns;
+			for (size_t i = layer * count; i < (layer + 1) * count; i++) {
+				chunks[i].surface.reset();
+				chunks[i].dirty = true;
+			}
+		}
+	}
+
+	void Tile_map::invalidate()
+	{
+		for (size_t i = 0; i < chunks.size(); i++) {
+			chunks[i].dirty = true;
+		}
+	}
+
+	bool Tile_map::draw(Surface& dst, const Rect& dst_rect, int view_x,
+			int view_y)
+	{
+		bool ok = true;
+		for (int layer = 0; layer < layer_count; layer++) {
+			ok = draw_layer(layer, dst, dst_rect, view_x, view_y) && ok;
+		}
+		return ok;
+	}
+
+	bool Tile_map::draw_layer(int layer, Surface& dst, const Rect& dst_rect,
+			int view_x, int view_y)
+	{
+		if (layer < 0 || layer >= layer_count) {
+			throw runtime_error("The tile map has no such layer");
+		}
+
+		/* The view, clipped to the map, in map pixels. */
+		int x0 = std::max(view_x, 0);
+		int y0 = std::max(view_y, 0);
+		int x1 = std::min(view_x + dst_rect.w, column_count * tile_width);
+		int y1 = std::min(view_y + dst_rect.h, row_count * tile_height);
+		if (x0 >= x1 || y0 >= y1) {
+			return true;
+		}
+
+		bool ok = true;
+		if (statics[layer]) {
+			int chunk_w = chunk_size * tile_width;
+			int chunk_h = chunk_size * tile_height;
+			for (int cy = y0 / chunk_h; cy <= (y1 - 1) / chunk_h; cy++) {
+				for (int cx = x0 / chunk_w; cx <= (x1 - 1) / chunk_w; cx++) {
+					Chunk& chunk = chunks[(static_cast<size_t>(layer)
+							* chunk_rows + cy) * chunk_columns + cx];
+					if (chunk.dirty) {
+						build(layer, cx, cy);
+					}
+					if (!chunk.surface) {
+						continue;
+					}
+					Surface& surface = *chunk.surface;
+					ok = Blit_area(surface, 0, 0, cx * chunk_w, cy * chunk_h,
+							surface.w(), surface.h(), x0, y0, x1, y1, dst,
+							dst_rect, view_x, view_y) && ok;
+				}
+			}
+			return ok;
+		}
+
+		for (int row = y0 / tile_height; row <= (y1 - 1) / tile_height;
+				row++) {
+			const int* tiles = &cells[cell(layer, 0, row)];
+			for (int column = x0 / tile_width;
+					column <= (x1 - 1) / tile_width; column++) {
+				int tile = tiles[column];
+				if (tile == EMPTY) {
+					continue;
+				}
+				ok = Blit_area(atlas, tile % atlas_columns * tile_width,
+						tile / atlas_columns * tile_height, column * tile_width,
+						row * tile_height, tile_width, tile_height, x0, y0,
+						x1, y1, dst, dst_rect, view_x, view_y) && ok;
+			}
+		}
+		return ok;
+	}
+
+	void Tile_map::build(int layer, int chunk_column, int chunk_row)
+	{
+		Chunk& chunk = chunks[(static_cast<size_t>(layer) * chunk_rows
+				+ chunk_row) * chunk_columns + chunk_column];
+		chunk.surface.reset();
+		chunk.dirty = false;
+
+		const int c0 = chunk_column * chunk_size;
+		const int r0 = chunk_row * chunk_size;
+		const int c1 = std::min(c0 + chunk_size, column_count);
+		const int r1 = std::min(r0 + chunk_size, row_count);
+		bool any = false;
+		bool full = true;
+		for (int row = r0; row < r1; row++) {
+			for (int column = c0; column < c1; column++) {
+				bool empty = cells[cell(layer, column, row)] == EMPTY;
+				any = any || !empty;
+				full = full && !empty;
+			}
+		}
+		if (!any) {
+			return;
+		}
+
+		SDL_Surface* src = atlas.raw_ptr();
+		const SDL_PixelFormat& f = *src->format;
+		const int w = (c1 - c0) * tile_width;
+		const int h = (r1 - r0) * tile_height;
+		const bool opaque = full && f.Amask == 0
+			&& (src->flags & (SDL_SRCCOLORKEY | SDL_SRCALPHA)) == 0;
+		shared_ptr<Surface> surface(opaque
+				? new Surface(SDL_SWSURFACE, w, h, f.BitsPerPixel, f.Rmask,
+					f.Gmask, f.Bmask, f.Amask)
+				: new Surface(SDL_SWSURFACE, w, h, 32, Argb8888::RMASK,
+					Argb8888::GMASK, Argb8888::BMASK, Argb8888::AMASK));
+		SDL_Surface* dst = surface->raw_ptr();
+		if (opaque && f.palette != 0) {
+			SDL_SetColors(dst, f.palette->colors, 0, f.palette->ncolors);
+		}
+		if (!opaque) {
+			SDL_SetAlpha(dst, SDL_SRCALPHA, SDL_ALPHA_OPAQUE);
+		}
+
+		Lock src_lock(src);
+		Lock dst_lock(dst);
+		const int bpp = f.BytesPerPixel;
+		Uint8* pixels = static_cast<Uint8*>(dst->pixels);
+		if (!opaque) {
+			/* Empty cells stay transparent. */
+			for (int y = 0; y < h; y++) {
+				std::memset(pixels + y * dst->pitch, 0, 4 * w);
+			}
+		}
+		Pixel_format src_format(f);
+		Pixel_format dst_format(*dst->format);
+		vector<Uint8> rgba(opaque ? 0 : 4 * tile_width);
+		const bool keyed = (src->flags & SDL_SRCCOLORKEY) != 0;
+		const Uint32 key_mask = f.palette != 0 ? 0xFFFFFFFF
+			: f.Rmask | f.Gmask | f.Bmask;
+		const Uint32 key = f.colorkey & key_mask;
+		const bool surface_alpha = f.Amask == 0
+			&& (src->flags & SDL_SRCALPHA) != 0;
+
+		for (int row = r0; row < r1; row++) {
+			for (int column = c0; column < c1; column++) {
+				int tile = cells[cell(layer, column, row)];
+				if (tile == EMPTY) {
+					continue;
+				}
+				const Uint8* in = static_cast<const Uint8*>(src->pixels)
+					+ tile / atlas_columns * tile_height * src->pitch
+					+ tile % atlas_columns * tile_width * bpp;
+				Uint8* out = pixels + (row - r0) * tile_height * dst->pitch
+					+ (column - c0) * tile_width * dst->format->BytesPerPixel;
+				for (int y = 0; y < tile_height; y++) {
+					const Uint8* line = in + y * src->pitch;
+					Uint8* to = out + y * dst->pitch;
+					if (opaque) {
+						std::memcpy(to, line, tile_width * bpp);
+						continue;
+					}
+					src_format.get(line, &rgba[0], tile_width);
+					for (int x = 0; x < tile_width; x++) {
+						if (keyed && (Load(line + x * bpp, bpp) & key_mask)
+								== key) {
+							rgba[4 * x + 3] = SDL_ALPHA_TRANSPARENT;
+						}
+						else if (surface_alpha) {
+							rgba[4 * x + 3] = f.alpha;
+						}
+					}
+					dst_format.map(&rgba[0], to, tile_width);
+				}
+			}
+		}
+		chunk.surface = surface;
+	}
+
+	size_t Tile_map::cell(int layer, int column, int row) const
+	{
+		if (layer < 0 || layer >= layer_count || column < 0
+				|| column >= column_count || row < 0 || row >= row_count) {
+			throw runtime_error("The tile map has no such cell");
+		}
+		return (static_cast<size_t>(layer) * row_count + row) * column_count
+			+ column;
+	}
+}
@@ -0,0 +1,369 @@
+/* vim: set ts=4 sts=4 sw=4 tw=80: */
+#include "yuv.hpp"
+#include <cstring>
+
+#if defined(__x86_64__) || (defined(__i386__) && defined(__SSE2__))
+#define SDLPP_HAVE_SSE2 1
+#include <emmintrin.h>
+#endif
+
+namespace
+{
+	/*
+	 * BT.601 in 8.8 fixed point. The scalar and SSE2 paths use the same
+	 * integer arithmetic, so they give the same bytes.
+	 */
+	const int YR = 66, YG = 129, YB = 25;
+	const int UR = -38, UG = -74, UB = 112;
+	const int VR = 112, VG = -94, VB = -18;
+
+	/* And back, for luma and chroma with their offsets removed. */
+	const int RY = 298, RV = 409;
+	const int GU = -100, GV = -208;
+	const int BU = 516;
+
+	inline Uint8 Clamp(int c)
+	{
+		return c < 0 ? 0 : c > 255 ? 255 : c;
+	}
+
+	inline Uint8 Y(int r, int g, int b)
+	{
+		return ((YR * r + YG * g + YB * b + 128) >> 8) + 16;
+	}
+
+	/**
+	 * The chroma of the sum of two pixels.
+	 */
+	inline Uint8 U2(int r, int g, int b)
+	{
+		return ((UR * r + UG * g + UB * b + 256) >> 9) + 128;
+	}
+
+	inline Uint8 V2(int r, int g, int b)
+	{
+		return ((VR * r + VG * g + VB * b + 256) >> 9) + 128;
+	}
+
+	void Y_scalar(const Uint8* rgba, Uint8* y, int w)
+	{
+		for (int i = 0; i < w; i++, rgba += 4) {
+			y[i] = Y(rgba[0], rgba[1], rgba[2]);
+		}
+	}
+
+	void Uv_scalar(const Uint8* rgba0, const Uint8* rgba1, Uint8* u,
+			Uint8* v, int cw)
+	{
+		for (int i = 0; i < cw; i++, rgba0 += 8, rgba1 += 8) {
+			/* Average the rows first, rounding like _mm_avg_epu8. */
+			int r = ((rgba0[0] + rgba1[0] + 1) >> 1)
+				+ ((rgba0[4] + rgba1[4] + 1) >> 1);
+			int g = ((rgba0[1] + rgba1[1] + 1) >> 1)
+				+ ((rgba0[5] + rgba1[5] + 1) >> 1);
+			int b = ((rgba0[2] + rgba1[2] + 1) >> 1)
+				+ ((rgba0[6] + rgba1[6] + 1) >> 1);
+			u[i] = U2(r, g, b);
+			v[i] = V2(r, g, b);
+		}
+	}
+
+	void Rgba_scalar(const Uint8* y, const Uint8* u, const Uint8* v,
+			Uint8* rgba, int w)
+	{
+		for (int i = 0; i < w; i++, rgba += 4) {
+			int luma = RY * (y[i] - 16) + 128;
+			int cu = u[i / 2] - 128;
+			int cv = v[i / 2] - 128;
+			rgba[0] = Clamp((luma + RV * cv) >> 8);
+			rgba[1] = Clamp((luma + GU * cu + GV * cv) >> 8);
+			rgba[2] = Clamp((luma + BU * cu) >> 8);
+			rgba[3] = 255;
+		}
+	}
+
+#ifdef SDLPP_HAVE_SSE2
+	/**
+	 * Sums the adjacent 32-bit lanes of the results of two madds, leaving
+	 * the four sums in order.
+	 */
+	inline __m128i Hadd_sse2(__m128i lo, __m128i hi)
+	{
+		lo = _mm_add_epi32(lo, _mm_srli_epi64(lo, 32));
+		hi = _mm_add_epi32(hi, _mm_srli_epi64(hi, 32));
+		lo = _mm_shuffle_epi32(lo, _MM_SHUFFLE(3, 1, 2, 0));
+		hi = _mm_shuffle_epi32(hi, _MM_SHUFFLE(3, 1, 2, 0));
+		return _mm_unpacklo_epi64(lo, hi);
+	}
+
+	/**
+	 * The luma of four pixels, as 32-bit lanes.
+	 */
+	inline __m128i Y4_sse2(__m128i px)
+	{
+		const __m128i zero = _mm_setzero_si128();
+		const __m128i k = _mm_set_epi16(0, YB, YG, YR, 0, YB, YG, YR);
+		__m128i sum = Hadd_sse2(
+				_mm_madd_epi16(_mm_unpacklo_epi8(px, zero), k),
+				_mm_madd_epi16(_mm_unpackhi_epi8(px, zero), k));
+		return _mm_add_epi32(
+				_mm_srai_epi32(_mm_add_epi32(sum, _mm_set1_epi32(128)), 8),
+				_mm_set1_epi32(16));
+	}
+
+	void Y_sse2(const Uint8* rgba, Uint8* y, int w)
+	{
+		int i = 0;
+		for (; i + 16 <= w; i += 16, rgba += 64) {
+			const __m128i* p = reinterpret_cast<const __m128i*>(rgba);
+			__m128i a = _mm_packs_epi32(Y4_sse2(_mm_loadu_si128(p)),
+					Y4_sse2(_mm_loadu_si128(p + 1)));
+			__m128i b = _mm_packs_epi32(Y4_sse2(_mm_loadu_si128(p + 2)),
+					Y4_sse2(_mm_loadu_si128(p + 3)));
+			_mm_storeu_si128(reinterpret_cast<__m128i*>(y + i),
+					_mm_packus_epi16(a, b));
+		}
+		Y_scalar(rgba, y + i, w - i);
+	}
+
+	/**
+	 * Sums horizontal pairs of four pixels, leaving two 16-bit RGBA sums.
+	 */
+	inline __m128i Pairs_sse2(__m128i px)
+	{
+		const __m128i zero = _mm_setzero_si128();
+		__m128i lo = _mm_unpacklo_epi8(px, zero);
+		__m128i hi = _mm_unpackhi_epi8(px, zero);
+		lo = _mm_add_epi16(lo, _mm_srli_si128(lo, 8));
+		hi = _mm_add_epi16(hi, _mm_srli_si128(hi, 8));
+		return _mm_unpacklo_epi64(lo, hi);
+	}
+
+	inline __m128i Chroma_sse2(__m128i pairs0, __m128i pairs1, __m128i k)
+	{
+		__m128i sum = Hadd_sse2(_mm_madd_epi16(pairs0, k),
+				_mm_madd_epi16(pairs1, k));
+		return _mm_add_epi32(
+				_mm_srai_epi32(_mm_add_epi32(sum, _mm_set1_epi32(256)), 9),
+				_mm_set1_epi32(128));
+	}
+
+	void Uv_sse2(const Uint8* rgba0, const Uint8* rgba1, Uint8* u, Uint8* v,
+			int cw)
+	{
+		const __m128i ku = _mm_set_epi16(0, UB, UG, UR, 0, UB, UG, UR);
+		const __m128i kv = _mm_set_epi16(0, VB, VG, VR, 0, VB, VG, VR);
+		int i = 0;
+		for (; i + 8 <= cw; i += 8, rgba0 += 64, rgba1 += 64) {
+			const __m128i* p0 = reinterpret_cast<const __m128i*>(rgba0);
+			const __m128i* p1 = reinterpret_cast<const __m128i*>(rgba1);
+			__m128i pairs[4];
+			for (int j = 0; j < 4; j++) {
+				pairs[j] = Pairs_sse2(_mm_avg_epu8(_mm_loadu_si128(p0 + j),
+							_mm_loadu_si128(p1 + j)));
+			}
+			__m128i us = _mm_packs_epi32(Chroma_sse2(pairs[0], pairs[1], ku),
+					Chroma_sse2(pairs[2], pairs[3], ku));
+			__m128i vs = _mm_packs_epi32(Chroma_sse2(pairs[0], pairs[1], kv),
+					Chroma_sse2(pairs[2], pairs[3], kv));
+			_mm_storel_epi64(reinterpret_cast<__m128i*>(u + i),
+					_mm_packus_epi16(us, us));
+			_mm_storel_epi64(reinterpret_cast<__m128i*>(v + i),
+					_mm_packus_epi16(vs, vs));
+		}
+		Uv_scalar(rgba0, rgba1, u + i, v + i, cw - i);
+	}
+
+	/**
+	 * Loads four chroma samples into the low 16-bit lanes, less 128.
+	 */
+	inline __m128i Chroma4_sse2(const Uint8* c)
+	{
+		int bytes;
+		std::memcpy(&bytes, c, sizeof bytes);
+		return _mm_sub_epi16(
+				_mm_unpacklo_epi8(_mm_cvtsi32_si128(bytes),
+					_mm_setzero_si128()),
+				_mm_set1_epi16(128));
+	}
+
+	/**
+	 * Adds the chroma term of four pairs of pixels to the luma of eight
+	 * pixels, leaving one channel of eight pixels as 16-bit lanes.
+	 */
+	inline __m128i Channel_sse2(__m128i luma_lo, __m128i luma_hi,
+			__m128i chroma)
+	{
+		__m128i lo = _mm_add_epi32(luma_lo, _mm_unpacklo_epi32(chroma, chroma));
+		__m128i hi = _mm_add_epi32(luma_hi, _mm_unpackhi_epi32(chroma, chroma));
+		return _mm_packs_epi32(_mm_srai_epi32(lo, 8), _mm_srai_epi32(hi, 8));
+	}
+
+	void Rgba_sse2(const Uint8* y, const Uint8* u, const Uint8* v,
+			Uint8* rgba, int w)
+	{
+		const __m128i zero = _mm_setzero_si128();
+		const __m128i ky = _mm_set_epi16(128, RY, 128, RY, 128, RY, 128, RY);
+		const __m128i kr = _mm_set_epi16(RV, 0, RV, 0, RV, 0, RV, 0);
+		const __m128i kg = _mm_set_epi16(GV, GU, GV, GU, GV, GU, GV, GU);
+		const __m128i kb = _mm_set_epi16(0, BU, 0, BU, 0, BU, 0, BU);
+		const __m128i one = _mm_set1_epi16(1);
+		const __m128i opaque = _mm_set1_epi16(255);
+		int i = 0;
+		for (; i + 8 <= w; i += 8, rgba += 32) {
+			__m128i ys = _mm_sub_epi16(_mm_unpacklo_epi8(
+						_mm_loadl_epi64(reinterpret_cast<const __m128i*>(y + i)),
+						zero), _mm_set1_epi16(16));
+			__m128i luma_lo = _mm_madd_epi16(_mm_unpacklo_epi16(ys, one), ky);
+			__m128i luma_hi = _mm_madd_epi16(_mm_unpackhi_epi16(ys, one), ky);
+			__m128i uv = _mm_unpacklo_epi16(Chroma4_sse2(u + i / 2),
+					Chroma4_sse2(v + i / 2));
+
+			__m128i r = Channel_sse2(luma_lo, luma_hi, _mm_madd_epi16(uv, kr));
+			__m128i g = Channel_sse2(luma_lo, luma_hi, _mm_madd_epi16(uv, kg));
+			__m128i b = Channel_sse2(luma_lo, luma_hi, _mm_madd_epi16(uv, kb));
+
+			__m128i rb = _mm_packus_epi16(r, b);
+			__m128i ga = _mm_packus_epi16(g, opaque);
+			__m128i rg = _mm_unpacklo_epi8(rb, ga);
+			__m128i ba = _mm_unpackhi_epi8(rb, ga);
+			_mm_storeu_si128(reinterpret_cast<__m128i*>(rgba),
+					_mm_unpacklo_epi16(rg, ba));
+			_mm_storeu_si128(reinterpret_cast<__m128i*>(rgba + 16),
+					_mm_unpackhi_epi16(rg, ba));
+		}
+		Rgba_scalar(y + i, u + i / 2, v + i / 2, rgba, w - i);
+	}
+#endif /* SDLPP_HAVE_SSE2 */
+}
+
+namespace sdlpp
+{
+	namespace yuv
+	{
+		void rgba_to_y(const Uint8* rgba, Uint8* y, int w)
+		{
+#ifdef SDLPP_HAVE_SSE2
+			Y_sse2(rgba, y, w);
+#else
+			Y_scalar(rgba, y, w);
+#endif /* SDLPP_HAVE_SSE2 */
+		}
+
+		void rgba_to_uv(const Uint8* rgba0, const Uint8* rgba1, Uint8* u,
+				Uint8* v, int cw)
+		{
+#ifdef SDLPP_HAVE_SSE2
+			Uv_sse2(rgba0, rgba1, u, v, cw);
+#else
+			Uv_scalar(rgba0, rgba1, u, v, cw);
+#endif /* SDLPP_HAVE_SSE2 */
+		}
+
+		void pack(const Uint8* y, const Uint8* u, const Uint8* v, Uint8* out,
+				int pairs, Uint32 format)
+		{
+			/* Where Y0, the first chroma byte, Y1 and the second go. */
+			const Uint8* first = format == SDL_YVYU_OVERLAY ? v : u;
+			const Uint8* second = format == SDL_YVYU_OVERLAY ? u : v;
+			bool luma_first = format != SDL_UYVY_OVERLAY;
+
+			int i = 0;
+#ifdef SDLPP_HAVE_SSE2
+			for (; i + 8 <= pairs; i += 8, out += 32) {
+				__m128i ys = _mm_loadu_si128(
+						reinterpret_cast<const __m128i*>(y + 2 * i));
+				__m128i cs = _mm_unpacklo_epi8(
+						_mm_loadl_epi64(reinterpret_cast<const __m128i*>(
+								first + i)),
+						_mm_loadl_epi64(reinterpret_cast<const __m128i*>(
+								second + i)));
+				__m128i lo = luma_first
+					? _mm_unpacklo_epi8(ys, cs) : _mm_unpacklo_epi8(cs, ys);
+				__m128i hi = luma_first
+					? _mm_unpackhi_epi8(ys, cs) : _mm_unpackhi_epi8(cs, ys);
+				_mm_storeu_si128(reinterpret_cast<__m128i*>(out), lo);
+				_mm_storeu_si128(reinterpret_cast<__m128i*>(out + 16), hi);
+			}
+#endif /* SDLPP_HAVE_SSE2 */
+			for (; i < pairs; i++, out += 4) {
+				if (luma_first) {
+					out[0] = y[2 * i];
+					out[1] = first[i];
+					out[2] = y[2 * i + 1];
+					out[3] = second[i];
+				}
+				else {
+					out[0] = first[i];
+					out[1] = y[2 * i];
+					out[2] = second[i];
+					out[3] = y[2 * i + 1];
+				}
+			}
+		}
+
+		void unpack(const Uint8* in, Uint8* y, Uint8* u, Uint8* v, int pairs,
+				Uint32 format)
+		{
+			Uint8* first = format == SDL_YVYU_OVERLAY ? v : u;
+			Uint8* second = format == SDL_YVYU_OVERLAY ? u : v;
+			bool luma_first = format != SDL_UYVY_OVERLAY;
+
+			int i = 0;
+#ifdef SDLPP_HAVE_SSE2
+			const __m128i low = _mm_set1_epi16(0xff);
+			for (; i + 8 <= pairs; i += 8, in += 32) {
+				__m128i lo = _mm_loadu_si128(
+						reinterpret_cast<const __m128i*>(in));
+				__m128i hi = _mm_loadu_si128(
+						reinterpret_cast<const __m128i*>(in + 16));
+				__m128i ys, cs;
+				if (luma_first) {
+					ys = _mm_packus_epi16(_mm_and_si128(lo, low),
+							_mm_and_si128(hi, low));
+					cs = _mm_packus_epi16(_mm_srli_epi16(lo, 8),
+							_mm_srli_epi16(hi, 8));
+				}
+				else {
+					ys = _mm_packus_epi16(_mm_srli_epi16(lo, 8),
+							_mm_srli_epi16(hi, 8));
+					cs = _mm_packus_epi16(_mm_and_si128(lo, low),
+							_mm_and_si128(hi, low));
+				}
+				__m128i firsts = _mm_packus_epi16(_mm_and_si128(cs, low),
+						_mm_setzero_si128());
+				__m128i seconds = _mm_packus_epi16(_mm_srli_epi16(cs, 8),
+						_mm_setzero_si128());
+				_mm_storeu_si128(reinterpret_cast<__m128i*>(y + 2 * i), ys);
+				_mm_storel_epi64(reinterpret_cast<__m128i*>(first + i), firsts);
+				_mm_storel_epi64(reinterpret_cast<__m128i*>(second + i),
+						seconds);
+			}
+#endif /* SDLPP_HAVE_SSE2 */
+			for (; i < pairs; i++, in += 4) {
+				if (luma_first) {
+					y[2 * i] = in[0];
+					first[i] = in[1];
+					y[2 * i + 1] = in[2];
+					second[i] = in[3];
+				}
+				else {
+					first[i] = in[0];
+					y[2 * i] = in[1];
+					second[i] = in[2];
+					y[2 * i + 1] = in[3];
+				}
+			}
+		}
+
+		void yuv_to_rgba(const Uint8* y, const Uint8* u, const Uint8* v,
+				Uint8* rgba, int w)
+		{
+#ifdef SDLPP_HAVE_SSE2
+			Rgba_sse2(y, u, v, rgba, w);
+#else
+			Rgba_scalar(y, u, v, rgba, w);
+#endif /* SDLPP_HAVE_SSE2 */
+		}
+	}
+}
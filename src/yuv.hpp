@@ -0,0 +1,59 @@
+#ifndef SDLPP_YUV_HPP_INCLUDED
+#define SDLPP_YUV_HPP_INCLUDED
+/* vim: set ts=4 sts=4 sw=4 tw=80: */
+
+/*
+ * Row kernels for converting between RGB and the YUV overlay formats. This
+ * header is private to the library and not installed.
+ *
+ * We use ITU-R BT.601 with video levels (Y in [16, 235], U and V in
+ * [16, 240]), which is what overlay hardware expects.
+ */
+
+#include "SDL.h"
+
+namespace sdlpp
+{
+	namespace yuv
+	{
+		/**
+		 * Computes the luma of w pixels.
+		 *
+		 * @param rgba Four bytes per pixel, in R, G, B, A order.
+		 */
+		void rgba_to_y(const Uint8* rgba, Uint8* y, int w);
+
+		/**
+		 * Computes the chroma of cw pairs of pixels, averaged over the pair
+		 * and over two rows. Pass the same row twice for 4:2:2.
+		 */
+		void rgba_to_uv(const Uint8* rgba0, const Uint8* rgba1, Uint8* u,
+				Uint8* v, int cw);
+
+		/**
+		 * Interleaves pairs luma pairs with their chroma into a row of a
+		 * packed overlay format: YUY2, UYVY or YVYU.
+		 */
+		void pack(const Uint8* y, const Uint8* u, const Uint8* v, Uint8* out,
+				int pairs, Uint32 format);
+
+		/**
+		 * Splits a row of a packed overlay format into its luma and
+		 * chroma. The reverse of pack().
+		 */
+		void unpack(const Uint8* in, Uint8* y, Uint8* u, Uint8* v, int pairs,
+				Uint32 format);
+
+		/**
+		 * Computes the colors of w pixels. Each pair of pixels shares one
+		 * chroma sample, so u and v hold (w + 1) / 2 samples.
+		 *
+		 * @param rgba Receives four bytes per pixel, in R, G, B, A order.
+		 * Alpha is always opaque.
+		 */
+		void yuv_to_rgba(const Uint8* y, const Uint8* u, const Uint8* v,
+				Uint8* rgba, int w);
+	}
+}
+
+#endif /* SDLPP_YUV_HPP_INCLUDED */
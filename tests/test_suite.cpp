@@ -18,16 +18,48 @@ class test_fixture :
 	CPPUNIT_TEST(test_fake_library_event);
 	CPPUNIT_TEST(test_user_event);
 	CPPUNIT_TEST(test_timer);
+#if defined(__cpp_impl_coroutine) && __cpp_impl_coroutine >= 201902L
+	CPPUNIT_TEST(test_coroutine_scheduler);
+#endif
 	CPPUNIT_TEST(test_task);
 	CPPUNIT_TEST(test_max_events);
 	CPPUNIT_TEST(test_stress);
 	CPPUNIT_TEST(test_video_surface);
 	CPPUNIT_TEST(test_video_surface_blit);
+	CPPUNIT_TEST(test_pixel_format_bulk);
+	CPPUNIT_TEST(test_palette_map);
+	CPPUNIT_TEST(test_blitter);
+	CPPUNIT_TEST(test_scaler);
+	CPPUNIT_TEST(test_mipmap);
+	CPPUNIT_TEST(test_sprite);
+	CPPUNIT_TEST(test_painter);
+	CPPUNIT_TEST(test_tile_map);
+	CPPUNIT_TEST(test_compositor);
+	CPPUNIT_TEST(test_region);
+	CPPUNIT_TEST(test_pointer_index);
+	CPPUNIT_TEST(test_rw_ops_map);
+	CPPUNIT_TEST(test_rw_ops_buffer);
+	CPPUNIT_TEST(test_rw_ops_prefetch);
+	CPPUNIT_TEST(test_pack);
+	CPPUNIT_TEST(test_rw_ops_compressed);
+	CPPUNIT_TEST(test_color_correction);
 	CPPUNIT_TEST(test_mutex);
+	CPPUNIT_TEST(test_adaptive_mutex);
+	CPPUNIT_TEST(test_rw_lock);
+	CPPUNIT_TEST(test_spsc_queue);
+	CPPUNIT_TEST(test_mpmc_queue);
 	CPPUNIT_TEST(test_semaphore);
+	CPPUNIT_TEST(test_semaphore_batch);
+	CPPUNIT_TEST(test_barrier);
+	CPPUNIT_TEST(test_latch);
 	CPPUNIT_TEST(test_condition);
+	CPPUNIT_TEST(test_lock_profiler);
 	CPPUNIT_TEST(test_overlay_1);
 	CPPUNIT_TEST(test_overlay_2);
+	CPPUNIT_TEST(test_overlay_upload);
+	CPPUNIT_TEST(test_overlay_display);
+	CPPUNIT_TEST(test_overlay_planes);
+	CPPUNIT_TEST(test_overlay_ring);
 	//CPPUNIT_TEST(test_thread); XXX: segfaults
 	CPPUNIT_TEST_SUITE_END();
 
@@ -165,6 +197,67 @@ public:
 		a = false;
 	}
 
+#if defined(__cpp_impl_coroutine) && __cpp_impl_coroutine >= 201902L
+	static Coroutine quit_then_sleep(CoroutineScheduler& scheduler,
+			Uint32 ms, int* step)
+	{
+		SDL_QuitEvent quit = co_await scheduler.nextEvent<SDL_QuitEvent>();
+		*step = quit.type == SDL_QUIT ? 1 : -1;
+		co_await scheduler.sleep(ms);
+		*step = 2;
+	}
+
+	void test_coroutine_scheduler()
+	{
+		SDLLibrary library;
+		SDL_Event quit;
+		quit.type = SDL_QUIT;
+		int step = 0;
+		{
+			CoroutineScheduler scheduler(library);
+			scheduler.spawn(quit_then_sleep(scheduler, 50, &step));
+			CPPUNIT_ASSERT(step == 0);
+			CPPUNIT_ASSERT(scheduler.live() == 1);
+
+			CPPUNIT_ASSERT(SDL_PushEvent(&quit) == 0);
+			CPPUNIT_ASSERT(library.PollEvent() == 1);
+			CPPUNIT_ASSERT(step == 1);
+
+			/* The timer's resume event is the next one on the queue. */
+			CPPUNIT_ASSERT(library.WaitEvent() == 1);
+			CPPUNIT_ASSERT(step == 2);
+			CPPUNIT_ASSERT(scheduler.live() == 0);
+		}
+
+		/*
+		 * A resume event still queued when its scheduler goes away goes
+		 * with it, and other user events stay.
+		 */
+		step = 0;
+		{
+			CoroutineScheduler scheduler(library);
+			scheduler.spawn(quit_then_sleep(scheduler, 1, &step));
+			CPPUNIT_ASSERT(SDL_PushEvent(&quit) == 0);
+			CPPUNIT_ASSERT(library.PollEvent() == 1);
+			SDL_Delay(100);
+		}
+		CPPUNIT_ASSERT(step == 1);
+		SDL_Event other;
+		other.type = SDL_USEREVENT;
+		other.user.code = CoroutineScheduler::RESUME_CODE;
+		other.user.data1 = &step;
+		other.user.data2 = 0;
+		CPPUNIT_ASSERT(SDL_PushEvent(&other) == 0);
+		{
+			CoroutineScheduler scheduler(library);
+		}
+		SDL_Event left[2];
+		CPPUNIT_ASSERT(SDL_PeepEvents(left, 2, SDL_GETEVENT,
+					SDL_ALLEVENTS) == 1);
+		CPPUNIT_ASSERT(left[0].user.data1 == &step);
+	}
+#endif
+
 	void test_task()
 	{
 		bool data = true;
@@ -250,22 +343,1312 @@ public:
 		SDL_Delay(1000);
 	}
 
+	void test_pixel_format_bulk()
+	{
+		Uint32 masks[][4] = {
+			{ 0xf800, 0x07e0, 0x001f, 0 },
+			{ 0xff0000, 0x00ff00, 0x0000ff, 0 },
+			{ 0x00ff0000, 0x0000ff00, 0x000000ff, 0xff000000 },
+		};
+		int depths[] = { 16, 24, 32 };
+		const size_t n = 37;
+		Uint8 rgba[4 * n];
+		for (size_t i = 0; i < 4 * n; i++) {
+			rgba[i] = i * 7;
+		}
+		for (int k = 0; k < 3; k++) {
+			Surface surface(SDL_SWSURFACE, n, 1, depths[k], masks[k][0],
+					masks[k][1], masks[k][2], masks[k][3]);
+			Pixel_format format(*surface.format());
+			Uint32 pixels[n];
+			Uint8 back[4 * n];
+			format.map(rgba, pixels, n);
+			format.get(pixels, back, n);
+			for (size_t i = 0; i < n; i++) {
+				Uint32 pixel = format.map(rgba[4 * i], rgba[4 * i + 1],
+						rgba[4 * i + 2], rgba[4 * i + 3]);
+				if (format.BytesPerPixel == 2) {
+					CPPUNIT_ASSERT(reinterpret_cast<Uint16*>(pixels)[i] == pixel);
+				}
+				else if (format.BytesPerPixel == 4) {
+					CPPUNIT_ASSERT(pixels[i] == pixel);
+				}
+				Uint8 c[4];
+				format.GetRGBA(pixel, c[0], c[1], c[2], c[3]);
+				CPPUNIT_ASSERT(SDL_memcmp(c, back + 4 * i, 4) == 0);
+			}
+		}
+	}
+
+	void test_palette_map()
+	{
+		Surface surface(SDL_SWSURFACE, 16, 16, 8, 0, 0, 0, 0);
+		vector<Color> colors;
+		for (int i = 0; i < 256; i++) {
+			colors.push_back(Color(i * 37, i * 11, 255 - i));
+		}
+		CPPUNIT_ASSERT(surface.set_colors(colors, 0, colors.size()));
+		Palette_map palette_map(surface);
+		Pixel_format format(*surface.format());
+		Uint8 rgba[4 * 64];
+		Uint8 pixels[64];
+		for (int i = 0; i < 4 * 64; i++) {
+			rgba[i] = i * 53;
+		}
+		palette_map.map(rgba, pixels, 64);
+		for (int i = 0; i < 64; i++) {
+			CPPUNIT_ASSERT(pixels[i] == format.map(rgba[4 * i], rgba[4 * i + 1],
+						rgba[4 * i + 2]));
+		}
+
+		colors[0] = Color(rgba[0], rgba[1], rgba[2]);
+		CPPUNIT_ASSERT(surface.set_colors(colors, 0, 1));
+		CPPUNIT_ASSERT(palette_map.map(rgba[0], rgba[1], rgba[2]) == 0);
+	}
+
+	void test_blitter()
+	{
+		Surface src(SDL_SWSURFACE, 32, 32, 32, Argb8888::RMASK,
+				Argb8888::GMASK, Argb8888::BMASK, Argb8888::AMASK);
+		Surface ours(SDL_SWSURFACE, 32, 32, 16, Rgb565::RMASK,
+				Rgb565::GMASK, Rgb565::BMASK, Rgb565::AMASK);
+		Surface theirs(SDL_SWSURFACE, 32, 32, 16, Rgb565::RMASK,
+				Rgb565::GMASK, Rgb565::BMASK, Rgb565::AMASK);
+		CPPUNIT_ASSERT(Blitter::find(*src.format(), *ours.format()) != 0);
+		CPPUNIT_ASSERT(!Blitter::faster(*src.format(), *ours.format()));
+		CPPUNIT_ASSERT(src.set_alpha(0, 255));
+		{
+			Surface::Lock l(src);
+			Uint32* pixels = static_cast<Uint32*>(l.pixels());
+			for (int i = 0; i < 32 * src.pitch() / 4; i++) {
+				pixels[i] = static_cast<Uint32>(i) * 0x01020305;
+			}
+		}
+
+		Rect src_rect(-3, 5, 20, 40);
+		Rect our_rect(10, -2, 0, 0);
+		Rect their_rect(our_rect);
+		CPPUNIT_ASSERT(Blitter::blit(src.raw_ptr(), &src_rect, ours.raw_ptr(),
+					&our_rect) == 0);
+		CPPUNIT_ASSERT(SDL_BlitSurface(src.raw_ptr(), &src_rect,
+					theirs.raw_ptr(), &their_rect) == 0);
+		CPPUNIT_ASSERT(our_rect.x == their_rect.x);
+		CPPUNIT_ASSERT(our_rect.y == their_rect.y);
+		CPPUNIT_ASSERT(our_rect.w == their_rect.w);
+		CPPUNIT_ASSERT(our_rect.h == their_rect.h);
+
+		{
+			Surface::Lock l(ours);
+			Surface::Lock m(theirs);
+			for (int y = 0; y < 32; y++) {
+				CPPUNIT_ASSERT(SDL_memcmp(
+							static_cast<Uint8*>(l.pixels()) + y * ours.pitch(),
+							static_cast<Uint8*>(m.pixels()) + y * theirs.pitch(),
+							32 * 2) == 0);
+			}
+		}
+
+		/* Whichever way calibration routes it, Surface::blit() agrees. */
+		Blitter::calibrate();
+		ours.fill(0, 0);
+		our_rect = Rect(0, 0, 0, 0);
+		their_rect = our_rect;
+		CPPUNIT_ASSERT(src.blit(ours, our_rect));
+		CPPUNIT_ASSERT(SDL_BlitSurface(src.raw_ptr(), 0, theirs.raw_ptr(),
+					&their_rect) == 0);
+		Surface::Lock l(ours);
+		Surface::Lock m(theirs);
+		for (int y = 0; y < 32; y++) {
+			CPPUNIT_ASSERT(SDL_memcmp(
+						static_cast<Uint8*>(l.pixels()) + y * ours.pitch(),
+						static_cast<Uint8*>(m.pixels()) + y * theirs.pitch(),
+						32 * 2) == 0);
+		}
+	}
+
+	void test_scaler()
+	{
+		Surface src(SDL_SWSURFACE, 64, 32, 32, Xrgb8888::RMASK,
+				Xrgb8888::GMASK, Xrgb8888::BMASK, Xrgb8888::AMASK);
+		{
+			Surface::Lock l(src);
+			for (int y = 0; y < 32; y++) {
+				Uint32* row = reinterpret_cast<Uint32*>(
+						static_cast<Uint8*>(l.pixels()) + y * src.pitch());
+				for (int x = 0; x < 64; x++) {
+					row[x] = x % 2 ? 0x00FF00 : 0x0000FF;
+				}
+			}
+		}
+
+		/* Halving averages each pair of columns. */
+		Surface half(SDL_SWSURFACE, 32, 16, 32, Xrgb8888::RMASK,
+				Xrgb8888::GMASK, Xrgb8888::BMASK, Xrgb8888::AMASK);
+		Rect all(0, 0, 32, 16);
+		CPPUNIT_ASSERT(src.blit_scaled(half, all, Scaler::BOX));
+		{
+			Surface::Lock l(half);
+			Uint32* pixels = static_cast<Uint32*>(l.pixels());
+			CPPUNIT_ASSERT((pixels[0] & 0xFFFFFF) == 0x008080);
+		}
+
+		/* Enlarging onto a 16-bit surface, clipped on the left. */
+		Surface big(SDL_SWSURFACE, 100, 100, 16, Rgb565::RMASK,
+				Rgb565::GMASK, Rgb565::BMASK, Rgb565::AMASK);
+		Rect area(-20, 10, 128, 64);
+		CPPUNIT_ASSERT(src.blit_scaled(big, area, Scaler::NEAREST));
+		CPPUNIT_ASSERT(area.x == 0 && area.y == 10);
+		CPPUNIT_ASSERT(area.w == 100 && area.h == 64);
+		Surface::Lock l(big);
+		Uint16* row = reinterpret_cast<Uint16*>(
+				static_cast<Uint8*>(l.pixels()) + 10 * big.pitch());
+		CPPUNIT_ASSERT(row[0] == 0x001F && row[2] == 0x07E0);
+	}
+
+	void test_mipmap()
+	{
+		Surface base(SDL_SWSURFACE, 64, 32, 32, Xrgb8888::RMASK,
+				Xrgb8888::GMASK, Xrgb8888::BMASK, Xrgb8888::AMASK);
+		{
+			Surface::Lock l(base);
+			for (int y = 0; y < 32; y++) {
+				Uint32* row = reinterpret_cast<Uint32*>(
+						static_cast<Uint8*>(l.pixels()) + y * base.pitch());
+				for (int x = 0; x < 64; x++) {
+					row[x] = x % 2 ? 0x00FF00 : 0x0000FF;
+				}
+			}
+		}
+
+		Mipmap mipmap(base);
+		CPPUNIT_ASSERT(mipmap.levels() == 7);
+		CPPUNIT_ASSERT(mipmap.w(1) == 32 && mipmap.h(1) == 16);
+		CPPUNIT_ASSERT(mipmap.w(6) == 1 && mipmap.h(6) == 1);
+		CPPUNIT_ASSERT(mipmap.level_for(1) == 0);
+		CPPUNIT_ASSERT(mipmap.level_for(0.5) == 1);
+		CPPUNIT_ASSERT(mipmap.level_for(0.3) == 1);
+		CPPUNIT_ASSERT(mipmap.level_for(0.2) == 2);
+		CPPUNIT_ASSERT(mipmap.level_for(0.001) == 6);
+
+		Surface half(mipmap.level(1));
+		CPPUNIT_ASSERT(half.w() == 32 && half.h() == 16);
+		{
+			Surface::Lock l(half);
+			Uint32* pixels = static_cast<Uint32*>(l.pixels());
+			CPPUNIT_ASSERT((pixels[0] & 0xFFFFFF) == 0x008080);
+		}
+
+		/* Copies share the levels already built. */
+		Mipmap copy(mipmap);
+		CPPUNIT_ASSERT(copy.level(1).raw_ptr() == half.raw_ptr());
+		CPPUNIT_ASSERT_THROW(copy.level(7), runtime_error);
+
+		/* Colorkeyed pixels are neither averaged nor lost. */
+		Surface keyed(SDL_SWSURFACE, 4, 2, 32, Xrgb8888::RMASK,
+				Xrgb8888::GMASK, Xrgb8888::BMASK, Xrgb8888::AMASK);
+		CPPUNIT_ASSERT(SDL_SetColorKey(keyed.raw_ptr(), SDL_SRCCOLORKEY,
+					0xFF00FF) == 0);
+		{
+			Surface::Lock l(keyed);
+			Uint32* row0 = static_cast<Uint32*>(l.pixels());
+			Uint32* row1 = reinterpret_cast<Uint32*>(
+					static_cast<Uint8*>(l.pixels()) + keyed.pitch());
+			row0[0] = row0[1] = row1[0] = row1[1] = 0xFF00FF;
+			row0[2] = row1[3] = 0xFF00FF;
+			row0[3] = 0x0000FF;
+			row1[2] = 0x00FF00;
+		}
+		Mipmap keyed_mipmap(keyed);
+		Surface keyed_half(keyed_mipmap.level(1));
+		CPPUNIT_ASSERT(keyed_half.raw_ptr()->flags & SDL_SRCCOLORKEY);
+		CPPUNIT_ASSERT(keyed_half.format()->colorkey == 0xFF00FF);
+		Surface::Lock l(keyed_half);
+		Uint32* pixels = static_cast<Uint32*>(l.pixels());
+		CPPUNIT_ASSERT((pixels[0] & 0xFFFFFF) == 0xFF00FF);
+		CPPUNIT_ASSERT((pixels[1] & 0xFFFFFF) == 0x008080);
+	}
+
+	void test_sprite()
+	{
+		Surface src(SDL_SWSURFACE, 8, 2, 32, Argb8888::RMASK,
+				Argb8888::GMASK, Argb8888::BMASK, Argb8888::AMASK);
+		{
+			Surface::Lock l(src);
+			Uint32* pixels = static_cast<Uint32*>(l.pixels());
+			pixels[1] = 0xFFFF0000;
+			pixels[2] = 0xFF00FF00;
+			pixels[5] = 0x800000FF;
+		}
+		Sprite sprite(src);
+		CPPUNIT_ASSERT(sprite.w() == 8 && sprite.h() == 2);
+		CPPUNIT_ASSERT(sprite.pixels() == 3);
+
+		Surface dst(SDL_SWSURFACE, 16, 16, 32, Argb8888::RMASK,
+				Argb8888::GMASK, Argb8888::BMASK, Argb8888::AMASK);
+		dst.fill(0, 0xFF000000);
+		Rect at(-1, 3, 0, 0);
+		CPPUNIT_ASSERT(sprite.blit(dst, at));
+		CPPUNIT_ASSERT(at.x == 0 && at.y == 3 && at.w == 7 && at.h == 2);
+		{
+			Surface::Lock l(dst);
+			Uint32* row = reinterpret_cast<Uint32*>(
+					static_cast<Uint8*>(l.pixels()) + 3 * dst.pitch());
+			CPPUNIT_ASSERT(row[0] == 0xFFFF0000 && row[1] == 0xFF00FF00);
+			CPPUNIT_ASSERT(row[2] == 0xFF000000);
+			CPPUNIT_ASSERT(row[4] == 0xFF000080);
+		}
+
+		/* Opaque pixels, too, keep the alpha of the destination. */
+		dst.fill(0, 0x40000000);
+		Rect again(0, 0, 0, 0);
+		CPPUNIT_ASSERT(sprite.blit(dst, again));
+		{
+			Surface::Lock l(dst);
+			Uint32* row = static_cast<Uint32*>(l.pixels());
+			CPPUNIT_ASSERT(row[1] == 0x40FF0000 && row[2] == 0x4000FF00);
+			CPPUNIT_ASSERT(row[0] == 0x40000000);
+		}
+
+		/* A mask leaves out what it has 0 for. */
+		Surface mask(SDL_SWSURFACE, 8, 2, 8, 0, 0, 0, 0);
+		mask.fill(0, 1);
+		Rect hole(1, 0, 1, 1);
+		mask.fill(&hole, 0);
+		CPPUNIT_ASSERT(Sprite(src, mask).pixels() == 2);
+	}
+
+	void test_painter()
+	{
+		Surface surface(SDL_SWSURFACE, 64, 64, 32, Xrgb8888::RMASK,
+				Xrgb8888::GMASK, Xrgb8888::BMASK, Xrgb8888::AMASK);
+		surface.fill(0, 0);
+		{
+			Painter painter(surface);
+			vector<Painter::Point> square;
+			square.push_back(Painter::Point(2, 2));
+			square.push_back(Painter::Point(6, 2));
+			square.push_back(Painter::Point(6, 6));
+			square.push_back(Painter::Point(2, 6));
+			painter.set_color(0xFF, 0, 0);
+			painter.polygon(square);
+
+			/* Where the lines meet is blended only once. */
+			vector<Painter::Point> corner;
+			corner.push_back(Painter::Point(10.5, 20.5));
+			corner.push_back(Painter::Point(30.5, 20.5));
+			corner.push_back(Painter::Point(30.5, 40.5));
+			painter.set_color(0, 0, 0xFF, 0x80);
+			painter.polyline(corner);
+
+			painter.set_antialiasing(true);
+			painter.set_color(0, 0xFF, 0);
+			painter.circle(48, 48, 10);
+		}
+
+		Surface::Lock l(surface);
+		Uint8* pixels = static_cast<Uint8*>(l.pixels());
+		Uint32* row2 = reinterpret_cast<Uint32*>(pixels + 2 * surface.pitch());
+		CPPUNIT_ASSERT(row2[1] == 0 && row2[2] == 0xFF0000);
+		CPPUNIT_ASSERT(row2[5] == 0xFF0000 && row2[6] == 0);
+
+		Uint32* row20 = reinterpret_cast<Uint32*>(pixels + 20 * surface.pitch());
+		CPPUNIT_ASSERT(row20[10] == 0x80 && row20[30] == 0x80);
+		CPPUNIT_ASSERT(row20[31] == 0);
+
+		Uint32* row48 = reinterpret_cast<Uint32*>(pixels + 48 * surface.pitch());
+		CPPUNIT_ASSERT(row48[48] == 0x00FF00);
+		CPPUNIT_ASSERT(row48[38] != 0 && row48[38] != 0x00FF00);
+		CPPUNIT_ASSERT(row48[36] == 0);
+	}
+
+	void test_tile_map()
+	{
+		/* Two tiles of 2 by 2: red, and blue with a transparent corner. */
+		Surface atlas(SDL_SWSURFACE, 4, 2, 32, Xrgb8888::RMASK,
+				Xrgb8888::GMASK, Xrgb8888::BMASK, Xrgb8888::AMASK);
+		{
+			Surface::Lock l(atlas);
+			Uint8* pixels = static_cast<Uint8*>(l.pixels());
+			for (int y = 0; y < 2; y++) {
+				Uint32* row = reinterpret_cast<Uint32*>(pixels
+						+ y * atlas.pitch());
+				row[0] = row[1] = 0xFF0000;
+				row[2] = row[3] = 0x0000FF;
+			}
+			reinterpret_cast<Uint32*>(pixels)[2] = 0xFF00FF;
+		}
+		SDL_SetColorKey(atlas.raw_ptr(), SDL_SRCCOLORKEY, 0xFF00FF);
+
+		Tile_map map(atlas, 2, 2, 8, 8, 2, 4);
+		for (int row = 0; row < 8; row++) {
+			for (int column = 0; column < 8; column++) {
+				map.set_tile(0, column, row, 0);
+			}
+		}
+		map.set_tile(1, 1, 1, 1);
+		map.set_static(0, true);
+		map.set_static(1, true);
+		CPPUNIT_ASSERT(map.tile(1, 0, 0) == Tile_map::EMPTY);
+		CPPUNIT_ASSERT(map.tile(1, 1, 1) == 1);
+
+		Surface screen(SDL_SWSURFACE, 8, 8, 32, Xrgb8888::RMASK,
+				Xrgb8888::GMASK, Xrgb8888::BMASK, Xrgb8888::AMASK);
+		for (int pass = 0; pass < 2; pass++) {
+			screen.fill(0, 0);
+			Rect view(1, 1, 6, 6);
+			CPPUNIT_ASSERT(map.draw(screen, view, 1, 1));
+
+			Surface::Lock l(screen);
+			Uint8* pixels = static_cast<Uint8*>(l.pixels());
+			Uint32* row1 = reinterpret_cast<Uint32*>(pixels
+					+ screen.pitch());
+			Uint32* row2 = reinterpret_cast<Uint32*>(pixels
+					+ 2 * screen.pitch());
+			CPPUNIT_ASSERT(row1[0] == 0 && row1[1] == 0xFF0000);
+			CPPUNIT_ASSERT(row1[6] == 0xFF0000 && row1[7] == 0);
+			CPPUNIT_ASSERT(row2[2 + 2 * pass] == 0xFF0000);
+			CPPUNIT_ASSERT(row2[3 + 2 * pass] == 0x0000FF);
+			CPPUNIT_ASSERT(row2[pass ? 3 : 5] == 0xFF0000);
+
+			/* Moving the tile rebuilds its chunk. */
+			map.set_tile(1, 1, 1, Tile_map::EMPTY);
+			map.set_tile(1, 2, 1, 1);
+		}
+
+		screen.fill(0, 0);
+		map.set_static(1, false);
+		Rect view(0, 0, 8, 8);
+		CPPUNIT_ASSERT(map.draw(screen, view, 0, 0));
+		Surface::Lock l(screen);
+		Uint32* row2 = reinterpret_cast<Uint32*>(static_cast<Uint8*>(
+					l.pixels()) + 2 * screen.pitch());
+		CPPUNIT_ASSERT(row2[4] == 0xFF0000 && row2[5] == 0x0000FF);
+	}
+
+	void test_compositor()
+	{
+		Surface screen(SDL_SWSURFACE, 16, 16, 32, Xrgb8888::RMASK,
+				Xrgb8888::GMASK, Xrgb8888::BMASK, Xrgb8888::AMASK);
+		Surface world(SDL_SWSURFACE, 16, 16, 32, Xrgb8888::RMASK,
+				Xrgb8888::GMASK, Xrgb8888::BMASK, Xrgb8888::AMASK);
+		Surface panel(SDL_SWSURFACE, 4, 4, 32, Xrgb8888::RMASK,
+				Xrgb8888::GMASK, Xrgb8888::BMASK, Xrgb8888::AMASK);
+		world.fill(0, 0xFF0000);
+		panel.fill(0, 0x0000FF);
+
+		Compositor compositor(screen);
+		CPPUNIT_ASSERT(compositor.add_layer(world) == 0);
+		CPPUNIT_ASSERT(compositor.add_layer(panel, 2, 2) == 1);
+		vector<Rect> updated;
+		CPPUNIT_ASSERT(compositor.compose(updated));
+		CPPUNIT_ASSERT(updated.size() == 1 && updated[0].w == 16);
+
+		/* Changes under the opaque panel need no redrawing. */
+		compositor.damage(0, Rect(3, 3, 2, 2));
+		CPPUNIT_ASSERT(compositor.compose(updated));
+		CPPUNIT_ASSERT(updated.empty());
+
+		/* Moving it redraws where it was and where it goes. */
+		compositor.move(1, 10, 2);
+		CPPUNIT_ASSERT(compositor.compose(updated));
+		int area = 0;
+		for (size_t i = 0; i < updated.size(); i++) {
+			area += updated[i].w * updated[i].h;
+		}
+		CPPUNIT_ASSERT(area == 32);
+
+		Surface::Lock l(screen);
+		Uint32* row2 = reinterpret_cast<Uint32*>(static_cast<Uint8*>(
+					l.pixels()) + 2 * screen.pitch());
+		CPPUNIT_ASSERT(row2[2] == 0xFF0000 && row2[9] == 0xFF0000);
+		CPPUNIT_ASSERT(row2[10] == 0x0000FF && row2[13] == 0x0000FF);
+	}
+
+	void test_region()
+	{
+		/* An L shape, made two ways. */
+		Region l(Rect(0, 0, 8, 8));
+		l.subtract(Rect(4, 0, 4, 4));
+		Region same(Rect(0, 4, 8, 4));
+		same.unite(Rect(0, 0, 4, 4));
+		CPPUNIT_ASSERT(l == same);
+		CPPUNIT_ASSERT(l.size() == 2);
+		CPPUNIT_ASSERT(l.contains(3, 3) && !l.contains(4, 3));
+		CPPUNIT_ASSERT(l.contains(7, 7) && !l.contains(8, 7));
+		Rect bounds = l.bounds();
+		CPPUNIT_ASSERT(bounds.x == 0 && bounds.w == 8 && bounds.h == 8);
+
+		Region window(Rect(2, 2, 4, 4));
+		window.intersect(l);
+		CPPUNIT_ASSERT(window.size() == 2 && !window.contains(4, 2));
+		window.subtract(window);
+		CPPUNIT_ASSERT(window.empty());
+
+		Surface surface(SDL_SWSURFACE, 8, 8, 32, Xrgb8888::RMASK,
+				Xrgb8888::GMASK, Xrgb8888::BMASK, Xrgb8888::AMASK);
+		Surface source(SDL_SWSURFACE, 8, 8, 32, Xrgb8888::RMASK,
+				Xrgb8888::GMASK, Xrgb8888::BMASK, Xrgb8888::AMASK);
+		surface.fill(0, 0);
+		source.fill(0, 0x0000FF);
+		CPPUNIT_ASSERT(surface.fill(l, 0xFF0000));
+		Rect src_rect(0, 0, 8, 8);
+		Rect dst_rect(0, 0);
+		CPPUNIT_ASSERT(source.blit(src_rect, surface, dst_rect,
+					Region(Rect(0, 6, 8, 2))));
+		CPPUNIT_ASSERT(dst_rect.y == 6 && dst_rect.h == 2);
+
+		Surface::Lock lock(surface);
+		Uint8* pixels = static_cast<Uint8*>(lock.pixels());
+		Uint32* row0 = reinterpret_cast<Uint32*>(pixels);
+		Uint32* row7 = reinterpret_cast<Uint32*>(pixels
+				+ 7 * surface.pitch());
+		CPPUNIT_ASSERT(row0[3] == 0xFF0000 && row0[4] == 0);
+		CPPUNIT_ASSERT(row7[0] == 0x0000FF && row7[7] == 0x0000FF);
+	}
+
+	struct Counting_listener : public PointerListener
+	{
+		Counting_listener() :
+			motions(0),
+			buttons(0)
+		{
+		}
+
+		virtual void handleMouseMotion(SDL_MouseMotionEvent&)
+		{
+			motions++;
+		}
+
+		virtual void handleMouseButton(SDL_MouseButtonEvent&)
+		{
+			buttons++;
+		}
+
+		int motions;
+		int buttons;
+	};
+
+	void test_pointer_index()
+	{
+		PointerIndex index(16);
+		Counting_listener panel;
+		Counting_listener button;
+		SDL_Rect panel_rect = { 0, 0, 100, 100 };
+		SDL_Rect button_rect = { 40, 40, 10, 10 };
+		index.addListener(&panel, panel_rect);
+		index.addListener(&button, button_rect);
+
+		vector<PointerListener*> found;
+		index.listenersAt(45, 45, found);
+		CPPUNIT_ASSERT(found.size() == 2);
+		CPPUNIT_ASSERT(found[0] == &panel && found[1] == &button);
+		index.listenersAt(50, 45, found);
+		CPPUNIT_ASSERT(found.size() == 1 && found[0] == &panel);
+		index.listenersAt(-1, 45, found);
+		CPPUNIT_ASSERT(found.empty());
+
+		SDL_Event event;
+		event.type = SDL_MOUSEBUTTONDOWN;
+		event.button.x = 45;
+		event.button.y = 45;
+		CPPUNIT_ASSERT(index.dispatchEvent(event));
+		event.type = SDL_MOUSEMOTION;
+		event.motion.x = 10;
+		event.motion.y = 10;
+		CPPUNIT_ASSERT(index.dispatchEvent(event));
+		CPPUNIT_ASSERT(panel.buttons == 1 && panel.motions == 1);
+		CPPUNIT_ASSERT(button.buttons == 1 && button.motions == 0);
+
+		/* Moving keeps the order; removing stops the events. */
+		SDL_Rect moved = { 0, 0, 20, 20 };
+		index.addListener(&button, moved);
+		index.listenersAt(10, 10, found);
+		CPPUNIT_ASSERT(found.size() == 2 && found[0] == &panel);
+		index.removeListener(&panel);
+		CPPUNIT_ASSERT(!index.hasListener(&panel));
+		CPPUNIT_ASSERT(index.dispatchEvent(event));
+		CPPUNIT_ASSERT(panel.motions == 1 && button.motions == 1);
+
+		event.type = SDL_KEYDOWN;
+		CPPUNIT_ASSERT(!index.dispatchEvent(event));
+	}
+
+	void test_rw_ops_map()
+	{
+		const char* name = "test_rw_ops_map.bin";
+		FILE* fp = fopen(name, "wb");
+		CPPUNIT_ASSERT(fp != 0);
+		for (int i = 0; i < 10000; i++) {
+			fputc(i % 251, fp);
+		}
+		fclose(fp);
+
+		{
+			/* The mapping outlives the object it was made by. */
+			RW_ops copy(name, RW_ops::RANDOM);
+			{
+				RW_ops ops(name, RW_ops::SEQUENTIAL);
+				copy = ops;
+			}
+			Uint8 bytes[8];
+			CPPUNIT_ASSERT(copy.seek(5000, RW_SEEK_SET) == 5000);
+			CPPUNIT_ASSERT(copy.read(bytes, 1, 8) == 8);
+			for (int i = 0; i < 8; i++) {
+				CPPUNIT_ASSERT(bytes[i] == (5000 + i) % 251);
+			}
+			CPPUNIT_ASSERT(copy.seek(-2, RW_SEEK_END) == 9998);
+			CPPUNIT_ASSERT(copy.read(bytes, 1, 8) == 2);
+			CPPUNIT_ASSERT(copy.write(bytes, 1, 1) < 1);
+		}
+		remove(name);
+		CPPUNIT_ASSERT_THROW(RW_ops(name, RW_ops::NORMAL), runtime_error);
+	}
+
+	void test_rw_ops_buffer()
+	{
+		Uint8 bytes[100];
+		for (int i = 0; i < 100; i++) {
+			bytes[i] = i;
+		}
+		RW_ops source(static_cast<void*>(bytes), sizeof bytes);
+		CPPUNIT_ASSERT(source.seek(10, RW_SEEK_SET) == 10);
+
+		{
+			RW_ops buffer(source, 16);
+			Uint8 read[40];
+			CPPUNIT_ASSERT(buffer.seek(0, RW_SEEK_CUR) == 10);
+			CPPUNIT_ASSERT(buffer.read(read, 2, 3) == 3);
+			CPPUNIT_ASSERT(read[0] == 10 && read[5] == 15);
+
+			/* Back within the bytes read ahead, then past them. */
+			CPPUNIT_ASSERT(buffer.seek(-4, RW_SEEK_CUR) == 12);
+			CPPUNIT_ASSERT(buffer.read(read, 1, 40) == 40);
+			CPPUNIT_ASSERT(read[0] == 12 && read[39] == 51);
+			CPPUNIT_ASSERT(buffer.seek(-2, RW_SEEK_END) == 98);
+			CPPUNIT_ASSERT(buffer.read(read, 1, 8) == 2);
+			CPPUNIT_ASSERT(read[1] == 99);
+
+			/* Writes wait for the buffer to fill or be flushed. */
+			Uint8 zero = 0;
+			CPPUNIT_ASSERT(buffer.seek(20, RW_SEEK_SET) == 20);
+			CPPUNIT_ASSERT(buffer.write(&zero, 1, 1) == 1);
+			CPPUNIT_ASSERT(buffer.write(&zero, 1, 1) == 1);
+			CPPUNIT_ASSERT(bytes[20] == 20);
+			CPPUNIT_ASSERT(buffer.seek(0, RW_SEEK_CUR) == 22);
+			CPPUNIT_ASSERT(buffer.read(read, 1, 1) == 1);
+			CPPUNIT_ASSERT(read[0] == 22);
+			CPPUNIT_ASSERT(bytes[20] == 0 && bytes[21] == 0);
+			CPPUNIT_ASSERT(buffer.write(&zero, 1, 1) == 1);
+			CPPUNIT_ASSERT(buffer.close() == 0);
+			CPPUNIT_ASSERT(bytes[23] == 0);
+		}
+
+		CPPUNIT_ASSERT_THROW(RW_ops(source, 0), runtime_error);
+	}
+
+	void test_rw_ops_prefetch()
+	{
+		Uint8 bytes[1000];
+		for (int i = 0; i < 1000; i++) {
+			bytes[i] = i % 251;
+		}
+		RW_ops source(static_cast<const void*>(bytes), sizeof bytes);
+
+		{
+			RW_ops stream(source, 64, 4);
+			Uint8 read[300];
+			CPPUNIT_ASSERT(stream.read(read, 3, 100) == 100);
+			for (int i = 0; i < 300; i++) {
+				CPPUNIT_ASSERT(read[i] == i % 251);
+			}
+
+			/* Back within the blocks read ahead, then elsewhere. */
+			CPPUNIT_ASSERT(stream.seek(-10, RW_SEEK_CUR) == 290);
+			CPPUNIT_ASSERT(stream.read(read, 1, 1) == 1);
+			CPPUNIT_ASSERT(read[0] == 290 % 251);
+			CPPUNIT_ASSERT(stream.seek(5, RW_SEEK_SET) == 5);
+			CPPUNIT_ASSERT(stream.read(read, 1, 1) == 1);
+			CPPUNIT_ASSERT(read[0] == 5);
+			CPPUNIT_ASSERT(stream.seek(-3, RW_SEEK_END) == 997);
+			CPPUNIT_ASSERT(stream.read(read, 1, 10) == 3);
+			CPPUNIT_ASSERT(read[2] == 999 % 251);
+			CPPUNIT_ASSERT(stream.read(read, 1, 10) == 0);
+			CPPUNIT_ASSERT(stream.write(read, 1, 1) == -1);
+		}
+
+		CPPUNIT_ASSERT_THROW(RW_ops(source, 64, 0), runtime_error);
+	}
+
+	void test_pack()
+	{
+		const char* names[] = { "test_pack_b.bin", "test_pack_a.bin" };
+		for (int i = 0; i < 2; i++) {
+			FILE* fp = fopen(names[i], "wb");
+			CPPUNIT_ASSERT(fp != 0);
+			for (int j = 0; j < 100 * (i + 1); j++) {
+				fputc(i + j, fp);
+			}
+			fclose(fp);
+		}
+		Pack::Writer writer;
+		writer.add("b", names[0]);
+		writer.add("a", names[1]);
+		writer.write("test_pack.pack");
+		remove(names[0]);
+		remove(names[1]);
+
+		{
+			Pack pack("test_pack.pack");
+			CPPUNIT_ASSERT(pack.size() == 2);
+			CPPUNIT_ASSERT(pack.name(0) == "a" && pack.name(1) == "b");
+			CPPUNIT_ASSERT(pack.contains("b") && !pack.contains("c"));
+			CPPUNIT_ASSERT(pack.verify("a") && pack.verify("b"));
+
+			/* Entries are bounded to their own bytes. */
+			RW_ops a(pack, "a");
+			Uint8 bytes[300];
+			CPPUNIT_ASSERT(a.read(bytes, 1, 300) == 200);
+			CPPUNIT_ASSERT(bytes[0] == 1 && bytes[199] == 200);
+			CPPUNIT_ASSERT(a.seek(0, RW_SEEK_END) == 200);
+			RW_ops b(pack, "b");
+			CPPUNIT_ASSERT(b.seek(-1, RW_SEEK_END) == 99);
+			CPPUNIT_ASSERT(b.read(bytes, 1, 300) == 1 && bytes[0] == 99);
+			CPPUNIT_ASSERT_THROW(RW_ops(pack, "c"), runtime_error);
+		}
+		remove("test_pack.pack");
+
+		CPPUNIT_ASSERT_THROW(Pack("test_pack.pack"), runtime_error);
+	}
+
+	void test_rw_ops_compressed()
+	{
+		static Uint8 plain[10000];
+		static Uint8 stream[20000];
+		for (int i = 0; i < 10000; i++) {
+			plain[i] = i / 16 % 8;
+		}
+
+		int end;
+		{
+			RW_ops sink(static_cast<void*>(stream), sizeof stream);
+			RW_ops writer(sink, RW_ops::COMPRESS, 1024);
+			CPPUNIT_ASSERT(writer.write(plain, 1, 3000) == 3000);
+			CPPUNIT_ASSERT(writer.write(plain + 3000, 1000, 7) == 7);
+			CPPUNIT_ASSERT(writer.seek(0, RW_SEEK_CUR) == 10000);
+			CPPUNIT_ASSERT(writer.seek(0, RW_SEEK_SET) == -1);
+			CPPUNIT_ASSERT(writer.close() == 0);
+			end = sink.seek(0, RW_SEEK_CUR);
+		}
+		CPPUNIT_ASSERT(end < 10000);
+
+		RW_ops source(static_cast<const void*>(stream), end);
+		RW_ops reader(source, RW_ops::DECOMPRESS);
+		Uint8 bytes[10000];
+		CPPUNIT_ASSERT(reader.read(bytes, 1, 10000) == 10000);
+		CPPUNIT_ASSERT(SDL_memcmp(bytes, plain, 10000) == 0);
+
+		/* Seeking decompresses just the block it lands in. */
+		CPPUNIT_ASSERT(reader.seek(-4100, RW_SEEK_END) == 5900);
+		CPPUNIT_ASSERT(reader.read(bytes, 2, 100) == 100);
+		CPPUNIT_ASSERT(SDL_memcmp(bytes, plain + 5900, 200) == 0);
+		CPPUNIT_ASSERT(reader.seek(9999, RW_SEEK_SET) == 9999);
+		CPPUNIT_ASSERT(reader.read(bytes, 1, 10) == 1);
+		CPPUNIT_ASSERT(reader.write(bytes, 1, 1) == -1);
+
+		RW_ops garbage(static_cast<const void*>(plain), sizeof plain);
+		CPPUNIT_ASSERT_THROW(RW_ops(garbage, RW_ops::DECOMPRESS),
+				runtime_error);
+
+		/*
+		 * A block whose literal length runs on in 255s, past what the
+		 * block could hold, is corrupt rather than a length that overflows.
+		 */
+		const Uint32 run = 8421600;
+		const Uint32 size = run + 2;
+		const Uint32 index_offset = 16 + 4 + size;
+		const Uint32 block_size = 1 << 24;
+		vector<Uint8> corrupt(index_offset + 4 + 16, 255);
+		const Uint32 numbers[][2] = {
+			{ 8, 1 }, { 12, block_size }, { 16, size },
+			{ index_offset, 16 }, { index_offset + 4, index_offset },
+			{ index_offset + 8, 1 }, { index_offset + 12, block_size }
+		};
+		for (int i = 0; i < 7; i++) {
+			for (int byte = 0; byte < 4; byte++) {
+				corrupt[numbers[i][0] + byte] = numbers[i][1] >> byte * 8;
+			}
+		}
+		SDL_memcpy(&corrupt[0], "SDLPPLZ4", 8);
+		SDL_memcpy(&corrupt[index_offset + 16], "LZ4I", 4);
+		corrupt[20] = 0xf0;
+		corrupt[21 + run] = 0;
+
+		RW_ops overlong(static_cast<const void*>(&corrupt[0]), corrupt.size());
+		RW_ops broken(overlong, RW_ops::DECOMPRESS);
+		CPPUNIT_ASSERT(broken.read(bytes, 1, 100) == -1);
+	}
+
+	void test_color_correction()
+	{
+		Color_correction correction;
+		Uint8 rgba[] = { 0, 128, 255, 7 };
+		correction.apply(rgba, 1);
+		CPPUNIT_ASSERT(rgba[0] == 0 && rgba[1] == 128 && rgba[2] == 255);
+
+		correction.set_adjustments(0, 1, 0, 0);
+		correction.apply(rgba, 1);
+		CPPUNIT_ASSERT(rgba[0] == rgba[1] && rgba[1] == rgba[2]);
+		CPPUNIT_ASSERT(rgba[3] == 7);
+
+		correction.reset();
+		correction.set_gamma(2, 2, 2);
+		Surface surface(SDL_SWSURFACE, 64, 64, 32, Xrgb8888::RMASK,
+				Xrgb8888::GMASK, Xrgb8888::BMASK, Xrgb8888::AMASK);
+		surface.fill(0, 0x404040);
+		correction.apply(surface, Rect(0, 0, 64, 32));
+		Surface::Lock l(surface);
+		Uint32* pixels = static_cast<Uint32*>(l.pixels());
+		CPPUNIT_ASSERT(pixels[0] == 0x808080);
+		CPPUNIT_ASSERT(pixels[63 * surface.pitch() / 4] == 0x404040);
+
+		/* Palettes are corrected from the original colors, every time. */
+		vector<Color> original(2, Color(0x40, 0x40, 0x40));
+		vector<Color> corrected = correction.apply(original);
+		CPPUNIT_ASSERT(original[1].r == 0x40);
+		CPPUNIT_ASSERT(corrected[1].r == 0x80 && corrected[1].b == 0x80);
+		CPPUNIT_ASSERT(correction.apply(original)[0].g == 0x80);
+		Surface indexed(SDL_SWSURFACE, 8, 8, 8, 0, 0, 0, 0);
+		CPPUNIT_ASSERT_THROW(correction.apply(indexed), runtime_error);
+	}
+
 	void test_mutex()
 	{
 		Mutex m;
 		Mutex::Lock l(m);
 	}
 
+	void test_adaptive_mutex()
+	{
+		Adaptive_mutex m(true);
+		{
+			Adaptive_mutex::Lock l(m);
+		}
+		{
+			Adaptive_mutex copy(m);
+			Adaptive_mutex::Lock l(copy);
+		}
+		Adaptive_mutex::Statistics stats = m.statistics();
+		CPPUNIT_ASSERT(stats.acquisitions == 2);
+		CPPUNIT_ASSERT(stats.contended == 0);
+		m.reset_statistics();
+		CPPUNIT_ASSERT(m.statistics().acquisitions == 0);
+	}
+
+	/**
+	 * What the Rw_lock_threads share: how many hold the lock for reading
+	 * and for writing, and how often a writer shared it with anyone.
+	 */
+	struct Rw_lock_job
+	{
+		Rw_lock* lock;
+		int rounds;
+		int readers;
+		int writers;
+		int overlaps;
+		Semaphore* done;
+	};
+
+	class Rw_lock_thread : public Thread<Rw_lock_job*>
+	{
+	public:
+		Rw_lock_thread(Rw_lock_job& job, bool write) :
+			Thread<Rw_lock_job*>(&job),
+			write(write)
+		{
+		}
+
+		/**
+		 * Takes the lock rounds times, counting overlaps with writers. Then
+		 * it posts done, if any.
+		 */
+		virtual int func(Rw_lock_job* job)
+		{
+			for (int i = 0; i < job->rounds; i++) {
+				if (write) {
+					Rw_lock::Write_lock l(*job->lock);
+					if (__atomic_add_fetch(&job->writers, 1, __ATOMIC_RELAXED) != 1
+							|| __atomic_load_n(&job->readers, __ATOMIC_RELAXED)
+							!= 0) {
+						__atomic_add_fetch(&job->overlaps, 1, __ATOMIC_RELAXED);
+					}
+					__atomic_sub_fetch(&job->writers, 1, __ATOMIC_RELAXED);
+				}
+				else {
+					Rw_lock::Read_lock l(*job->lock);
+					__atomic_add_fetch(&job->readers, 1, __ATOMIC_RELAXED);
+					if (__atomic_load_n(&job->writers, __ATOMIC_RELAXED) != 0) {
+						__atomic_add_fetch(&job->overlaps, 1, __ATOMIC_RELAXED);
+					}
+					__atomic_sub_fetch(&job->readers, 1, __ATOMIC_RELAXED);
+				}
+			}
+			return job->done == 0 || job->done->post() ? 0 : 1;
+		}
+
+	private:
+		bool write;
+	};
+
+	void test_rw_lock()
+	{
+		Rw_lock rw;
+		Semaphore done;
+		Rw_lock_job once = { &rw, 1, 0, 0, 0, &done };
+		Rw_lock_thread reader(once, false), writer(once, true),
+			late_reader(once, false);
+		{
+			Rw_lock::Read_lock r1(rw);
+			Rw_lock::Read_lock r2(rw);
+
+			/* Readers share the lock... */
+			reader.run();
+			CPPUNIT_ASSERT(done.wait_timeout(1000) == true);
+			CPPUNIT_ASSERT(reader.wait() == 0);
+
+			/* ...but a writer waits until they are gone. */
+			writer.run();
+			SDL_Delay(50);
+			CPPUNIT_ASSERT(done.value() == 0);
+		}
+		CPPUNIT_ASSERT(done.wait_timeout(1000) == true);
+		CPPUNIT_ASSERT(writer.wait() == 0);
+		{
+			/* And readers wait for a writer. */
+			Rw_lock::Write_lock w(rw);
+			late_reader.run();
+			SDL_Delay(50);
+			CPPUNIT_ASSERT(done.value() == 0);
+		}
+		CPPUNIT_ASSERT(done.wait_timeout(1000) == true);
+		CPPUNIT_ASSERT(late_reader.wait() == 0);
+
+		Rw_lock_job many = { &rw, 2000, 0, 0, 0, 0 };
+		vector<Rw_lock_thread*> threads;
+		for (int i = 0; i < 4; i++) {
+			threads.push_back(new Rw_lock_thread(many, i % 2 == 0));
+			threads.back()->run();
+		}
+		for (size_t i = 0; i < threads.size(); i++) {
+			CPPUNIT_ASSERT(threads[i]->wait() == 0);
+			delete threads[i];
+		}
+		CPPUNIT_ASSERT(many.overlaps == 0);
+	}
+
+	enum { QUEUE_ITEMS = 20000 };
+
+	class Spsc_producer : public Thread<Spsc_queue<int>*>
+	{
+	public:
+		Spsc_producer(Spsc_queue<int>& queue) :
+			Thread<Spsc_queue<int>*>(&queue)
+		{
+		}
+
+		/**
+		 * Pushes 0 to QUEUE_ITEMS - 1, waiting while the queue is full.
+		 */
+		virtual int func(Spsc_queue<int>* queue)
+		{
+			for (int i = 0; i < QUEUE_ITEMS; i++) {
+				while (!queue->push(i)) {
+					SDL_Delay(0);
+				}
+			}
+			return 0;
+		}
+	};
+
+	void test_spsc_queue()
+	{
+		Spsc_queue<int> q(3);
+		CPPUNIT_ASSERT(q.capacity() == 4);
+		for (int i = 0; i < 4; i++) {
+			CPPUNIT_ASSERT(q.push(i) == true);
+		}
+		CPPUNIT_ASSERT(q.push(4) == false);
+		int value;
+		for (int i = 0; i < 4; i++) {
+			CPPUNIT_ASSERT(q.pop(value) == true);
+			CPPUNIT_ASSERT(value == i);
+		}
+		CPPUNIT_ASSERT(q.pop(value) == false);
+
+		/* From another thread, everything arrives once and in order. */
+		Spsc_queue<int> shared(64);
+		Spsc_producer producer(shared);
+		producer.run();
+		for (int i = 0; i < QUEUE_ITEMS; i++) {
+			while (!shared.pop(value)) {
+				SDL_Delay(0);
+			}
+			CPPUNIT_ASSERT(value == i);
+		}
+		CPPUNIT_ASSERT(producer.wait() == 0);
+		CPPUNIT_ASSERT(shared.empty() == true);
+	}
+
+	/**
+	 * What the Mpmc_producers and Mpmc_consumers share: how many elements
+	 * were popped, and how often each value was.
+	 */
+	struct Mpmc_job
+	{
+		Mpmc_queue<int>* queue;
+		int popped;
+		vector<int> seen;
+	};
+
+	class Mpmc_producer : public Thread<Mpmc_job*>
+	{
+	public:
+		Mpmc_producer(Mpmc_job& job, int first) :
+			Thread<Mpmc_job*>(&job),
+			first(first)
+		{
+		}
+
+		/**
+		 * Pushes QUEUE_ITEMS values from first on, waiting while the queue
+		 * is full.
+		 */
+		virtual int func(Mpmc_job* job)
+		{
+			for (int i = first; i < first + QUEUE_ITEMS; i++) {
+				while (!job->queue->push(i)) {
+					SDL_Delay(0);
+				}
+			}
+			return 0;
+		}
+
+	private:
+		int first;
+	};
+
+	class Mpmc_consumer : public Thread<Mpmc_job*>
+	{
+	public:
+		Mpmc_consumer(Mpmc_job& job) :
+			Thread<Mpmc_job*>(&job)
+		{
+		}
+
+		/**
+		 * Pops until all have been, counting each value. The values of one
+		 * producer must come out in the order it pushed them.
+		 */
+		virtual int func(Mpmc_job* job)
+		{
+			const int total = static_cast<int>(job->seen.size());
+			vector<int> last(total / QUEUE_ITEMS, -1);
+			int value;
+			while (__atomic_load_n(&job->popped, __ATOMIC_RELAXED) < total) {
+				if (!job->queue->pop(value)) {
+					SDL_Delay(0);
+					continue;
+				}
+				__atomic_add_fetch(&job->popped, 1, __ATOMIC_RELAXED);
+				__atomic_add_fetch(&job->seen[value], 1, __ATOMIC_RELAXED);
+				if (value <= last[value / QUEUE_ITEMS]) {
+					return 1;
+				}
+				last[value / QUEUE_ITEMS] = value;
+			}
+			return 0;
+		}
+	};
+
+	void test_mpmc_queue()
+	{
+		Mpmc_queue<int> q(4);
+		for (int i = 0; i < 4; i++) {
+			CPPUNIT_ASSERT(q.push(i) == true);
+		}
+		CPPUNIT_ASSERT(q.push(4) == false);
+		CPPUNIT_ASSERT(q.size() == 4);
+		int value;
+		for (int i = 0; i < 4; i++) {
+			CPPUNIT_ASSERT(q.pop(value) == true);
+			CPPUNIT_ASSERT(value == i);
+		}
+		CPPUNIT_ASSERT(q.pop(value) == false);
+		CPPUNIT_ASSERT(q.empty() == true);
+
+		/* Two producers and two consumers: everything arrives once. */
+		Mpmc_queue<int> shared(64);
+		Mpmc_job job = { &shared, 0, vector<int>(2 * QUEUE_ITEMS) };
+		Mpmc_producer p1(job, 0), p2(job, QUEUE_ITEMS);
+		Mpmc_consumer c1(job), c2(job);
+		c1.run();
+		c2.run();
+		p1.run();
+		p2.run();
+		CPPUNIT_ASSERT(p1.wait() == 0);
+		CPPUNIT_ASSERT(p2.wait() == 0);
+		CPPUNIT_ASSERT(c1.wait() == 0);
+		CPPUNIT_ASSERT(c2.wait() == 0);
+		for (size_t i = 0; i < job.seen.size(); i++) {
+			CPPUNIT_ASSERT(job.seen[i] == 1);
+		}
+		CPPUNIT_ASSERT(shared.empty() == true);
+	}
+
 	void test_semaphore()
 	{
 		Semaphore s;
 	}
 	
+	/**
+	 * What a Semaphore_waiter does: takes count from the semaphore, and
+	 * gives it back if post_back, rounds times. Then it posts done, if any.
+	 */
+	struct Semaphore_job
+	{
+		Semaphore* semaphore;
+		Uint32 count;
+		int rounds;
+		bool post_back;
+		Semaphore* done;
+	};
+
+	class Semaphore_waiter : public Thread<Semaphore_job*>
+	{
+	public:
+		Semaphore_waiter(Semaphore_job& job) :
+			Thread<Semaphore_job*>(&job)
+		{
+		}
+
+		virtual int func(Semaphore_job* job)
+		{
+			for (int i = 0; i < job->rounds; i++) {
+				if (!job->semaphore->wait(job->count)) {
+					return 1;
+				}
+				if (job->post_back && !job->semaphore->post(job->count)) {
+					return 1;
+				}
+			}
+			return job->done == 0 || job->done->post() ? 0 : 1;
+		}
+	};
+
+	void test_semaphore_batch()
+	{
+		Semaphore s;
+		CPPUNIT_ASSERT(s.post(3) == true);
+		CPPUNIT_ASSERT(s.value() == 3);
+		CPPUNIT_ASSERT(s.wait(3) == true);
+		CPPUNIT_ASSERT(s.value() == 0);
+		CPPUNIT_ASSERT(s.try_wait() == false);
+		CPPUNIT_ASSERT(s.wait_timeout(1) == false);
+
+		/* One post(n) wakes all of n sleeping waiters. */
+		Semaphore_job once = { &s, 1, 1, false, 0 };
+		Semaphore_waiter a(once), b(once), c(once);
+		a.run();
+		b.run();
+		c.run();
+		SDL_Delay(50);
+		CPPUNIT_ASSERT(s.post(3) == true);
+		CPPUNIT_ASSERT(a.wait() == 0);
+		CPPUNIT_ASSERT(b.wait() == 0);
+		CPPUNIT_ASSERT(c.wait() == 0);
+		CPPUNIT_ASSERT(s.value() == 0);
+
+		/* wait(2)s posted one at a time: one of them gets both. */
+		Semaphore done;
+		Semaphore_job twos = { &s, 2, 1, false, &done };
+		Semaphore_waiter d(twos), e(twos);
+		d.run();
+		e.run();
+		SDL_Delay(50);
+		CPPUNIT_ASSERT(s.post() == true);
+		SDL_Delay(50);
+		CPPUNIT_ASSERT(s.post() == true);
+		CPPUNIT_ASSERT(done.wait_timeout(1000) == true);
+		CPPUNIT_ASSERT(s.post(2) == true);
+		CPPUNIT_ASSERT(done.wait_timeout(1000) == true);
+		CPPUNIT_ASSERT(d.wait() == 0);
+		CPPUNIT_ASSERT(e.wait() == 0);
+		CPPUNIT_ASSERT(s.value() == 0);
+
+		/*
+		 * With 4, only one of the wait(3)s can go ahead at a time. If they
+		 * took part of it while they wait, they would soon all be stuck.
+		 */
+		Semaphore t(4);
+		Semaphore_job threes = { &t, 3, 2000, true, 0 };
+		Semaphore_job ones = { &t, 1, 2000, true, 0 };
+		Semaphore_waiter f(threes), g(threes), h(threes), i(ones);
+		f.run();
+		g.run();
+		h.run();
+		i.run();
+		CPPUNIT_ASSERT(f.wait() == 0);
+		CPPUNIT_ASSERT(g.wait() == 0);
+		CPPUNIT_ASSERT(h.wait() == 0);
+		CPPUNIT_ASSERT(i.wait() == 0);
+		CPPUNIT_ASSERT(t.value() == 4);
+	}
+
+	enum { BARRIER_THREADS = 4, BARRIER_PHASES = 50 };
+
+	/**
+	 * What the Barrier_threads share: how many arrived in each phase, and
+	 * how often wait() returned true.
+	 */
+	struct Barrier_job
+	{
+		Barrier* barrier;
+		int arrived[BARRIER_PHASES];
+		int last;
+	};
+
+	class Barrier_thread : public Thread<Barrier_job*>
+	{
+	public:
+		Barrier_thread(Barrier_job& job) :
+			Thread<Barrier_job*>(&job)
+		{
+		}
+
+		/**
+		 * Arrives in every phase, and checks that nobody leaves a phase
+		 * before all have arrived.
+		 */
+		virtual int func(Barrier_job* job)
+		{
+			for (int i = 0; i < BARRIER_PHASES; i++) {
+				__atomic_add_fetch(&job->arrived[i], 1, __ATOMIC_RELAXED);
+				if (job->barrier->wait()) {
+					__atomic_add_fetch(&job->last, 1, __ATOMIC_RELAXED);
+				}
+				if (__atomic_load_n(&job->arrived[i], __ATOMIC_RELAXED)
+						!= BARRIER_THREADS) {
+					return 1;
+				}
+			}
+			return 0;
+		}
+	};
+
+	void test_barrier()
+	{
+		CPPUNIT_ASSERT_THROW(Barrier(0), runtime_error);
+		Barrier b(1);
+		CPPUNIT_ASSERT(b.wait() == true);
+		CPPUNIT_ASSERT(b.wait() == true);
+
+		/* The barrier re-arms itself for every phase. */
+		Barrier shared(BARRIER_THREADS);
+		Barrier_job job = { &shared, { 0 }, 0 };
+		vector<Barrier_thread*> threads;
+		for (int i = 0; i < BARRIER_THREADS; i++) {
+			threads.push_back(new Barrier_thread(job));
+			threads.back()->run();
+		}
+		for (int i = 0; i < BARRIER_THREADS; i++) {
+			CPPUNIT_ASSERT(threads[i]->wait() == 0);
+			delete threads[i];
+		}
+		CPPUNIT_ASSERT(job.last == BARRIER_PHASES);
+	}
+
+	/**
+	 * What a Latch_waiter does: waits for the latch, then posts done.
+	 */
+	struct Latch_job
+	{
+		Latch* latch;
+		Semaphore* done;
+	};
+
+	class Latch_waiter : public Thread<Latch_job*>
+	{
+	public:
+		Latch_waiter(Latch_job& job) :
+			Thread<Latch_job*>(&job)
+		{
+		}
+
+		virtual int func(Latch_job* job)
+		{
+			job->latch->wait();
+			return job->done->post() ? 0 : 1;
+		}
+	};
+
+	void test_latch()
+	{
+		Latch l(2);
+		CPPUNIT_ASSERT(l.try_wait() == false);
+		l.count_down();
+		CPPUNIT_ASSERT(l.try_wait() == false);
+		l.arrive_and_wait();
+		CPPUNIT_ASSERT(l.try_wait() == true);
+
+		/* Waiters on other threads pass only once the count reaches 0. */
+		Latch shared(2);
+		Semaphore done;
+		Latch_job job = { &shared, &done };
+		Latch_waiter a(job), b(job), c(job);
+		a.run();
+		b.run();
+		c.run();
+		shared.count_down();
+		SDL_Delay(50);
+		CPPUNIT_ASSERT(done.value() == 0);
+		shared.count_down();
+		CPPUNIT_ASSERT(done.wait(3) == true);
+		CPPUNIT_ASSERT(a.wait() == 0);
+		CPPUNIT_ASSERT(b.wait() == 0);
+		CPPUNIT_ASSERT(c.wait() == 0);
+	}
+
 	void test_condition()
 	{
 		Condition s;
 	}
 
+	void test_lock_profiler()
+	{
+		Mutex m;
+		Lock_profiler::name(m, "test mutex");
+		{
+			Mutex::Lock l(m);
+		}
+		if (!Lock_profiler::enabled()) {
+			/* Naming an object we don't profile leaves no record. */
+			CPPUNIT_ASSERT(Lock_profiler::snapshot().empty());
+			return;
+		}
+
+		/* Other tests' objects may be live too, so look ours up. */
+		vector<Lock_stats> stats = Lock_profiler::snapshot();
+		size_t found = 0;
+		for (size_t i = 0; i < stats.size(); i++) {
+			if (stats[i].object == m.raw_ptr()) {
+				CPPUNIT_ASSERT(stats[i].name == "test mutex");
+				CPPUNIT_ASSERT(stats[i].acquisitions == 1);
+				CPPUNIT_ASSERT(stats[i].owner == 0);
+				found++;
+			}
+		}
+		CPPUNIT_ASSERT(found == 1);
+	}
+
 	class My_thread : public Thread<bool*>
 	{
 	public:
@@ -294,6 +1677,120 @@ public:
 		Overlay::Lock l(o);
 	}
 
+	void test_overlay_upload()
+	{
+		Video_surface screen(250, 250, 32);
+		Surface red(SDL_SWSURFACE, 64, 64, 32, Xrgb8888::RMASK,
+				Xrgb8888::GMASK, Xrgb8888::BMASK, Xrgb8888::AMASK);
+		red.fill(0, 0xFF0000);
+
+		Overlay planar(64, 64, Overlay::IYUV, screen);
+		CPPUNIT_ASSERT(planar.upload(red));
+		{
+			Overlay::Lock l(planar);
+			CPPUNIT_ASSERT(l.pixels()[0][0] == 82);
+			CPPUNIT_ASSERT(l.pixels()[1][0] == 90);
+			CPPUNIT_ASSERT(l.pixels()[2][0] == 240);
+		}
+
+		Overlay packed(64, 64, Overlay::YUY2, screen);
+		CPPUNIT_ASSERT(packed.upload(red));
+		{
+			Overlay::Lock l(packed);
+			Uint8* yuyv = l.pixels()[0];
+			CPPUNIT_ASSERT(yuyv[0] == 82 && yuyv[1] == 90);
+			CPPUNIT_ASSERT(yuyv[2] == 82 && yuyv[3] == 240);
+		}
+
+		/* The last pixel of an odd row makes a pair with itself. */
+		Surface odd(SDL_SWSURFACE, 5, 2, 32, Xrgb8888::RMASK,
+				Xrgb8888::GMASK, Xrgb8888::BMASK, Xrgb8888::AMASK);
+		odd.fill(0, 0xFF0000);
+		Rect last(4, 0, 1, 2);
+		odd.fill(&last, 0x0000FF);
+		Overlay packed_odd(5, 2, Overlay::YUY2, screen);
+		CPPUNIT_ASSERT(packed_odd.upload(odd));
+		Overlay::Lock l(packed_odd);
+		for (int y = 0; y < 2; y++) {
+			Uint8* yuyv = l.pixels()[0] + y * packed_odd.pitches()[0];
+			CPPUNIT_ASSERT(yuyv[6] == 82 && yuyv[7] == 240);
+			CPPUNIT_ASSERT(yuyv[8] == 41 && yuyv[9] == 240);
+		}
+	}
+
+	void test_overlay_display()
+	{
+		Video_surface screen(250, 250, 32);
+		Surface red(SDL_SWSURFACE, 64, 64, 32, Xrgb8888::RMASK,
+				Xrgb8888::GMASK, Xrgb8888::BMASK, Xrgb8888::AMASK);
+		red.fill(0, 0xFF0000);
+		Overlay o(64, 64, Overlay::YV12, screen);
+		CPPUNIT_ASSERT(o.upload(red));
+
+		Rect area(-10, 20, 200, 100);
+		CPPUNIT_ASSERT(o.display(area));
+		Surface::Lock l(screen);
+		Uint32 pixel = *reinterpret_cast<Uint32*>(
+				static_cast<Uint8*>(l.pixels()) + 50 * screen.pitch());
+		Uint8 r, g, b;
+		SDL_GetRGB(pixel, const_cast<SDL_PixelFormat*>(screen.format()),
+				&r, &g, &b);
+		CPPUNIT_ASSERT(r == 255 && g <= 1 && b == 0);
+	}
+
+	void test_overlay_planes()
+	{
+		Video_surface screen(250, 250, 32);
+		Overlay planar(64, 48, Overlay::YV12, screen);
+		{
+			Overlay::Lock l(planar);
+			CPPUNIT_ASSERT(l.y().w() == 64 && l.y().h() == 48);
+			CPPUNIT_ASSERT(l.u().w() == 32 && l.u().h() == 24);
+			CPPUNIT_ASSERT(l.v().pixels() == l.pixels()[1]);
+			CPPUNIT_ASSERT(l.u().pixels() == l.pixels()[2]);
+			l.u()(31, 23) = 42;
+			CPPUNIT_ASSERT(l.u().row(23)[31] == 42);
+			CPPUNIT_ASSERT_THROW(l.plane(3), runtime_error);
+		}
+
+		Overlay packed(64, 48, Overlay::UYVY, screen);
+		Overlay::Lock l(packed);
+		CPPUNIT_ASSERT(l.plane(0).w() == 128 && l.plane(0).h() == 48);
+		CPPUNIT_ASSERT_THROW(l.y(), runtime_error);
+	}
+
+	void test_overlay_ring()
+	{
+		Video_surface screen(250, 250, 32);
+		Overlay_ring ring(64, 48, Overlay::IYUV, screen, 3);
+		CPPUNIT_ASSERT(ring.next() == 0);
+
+		for (int i = 0; i < 3; i++) {
+			Overlay::Lock l(ring.begin_frame());
+			l.y()(0, 0) = i;
+			ring.end_frame();
+		}
+		CPPUNIT_ASSERT(ring.try_begin_frame() == 0);
+
+		Overlay* shown = ring.next();
+		CPPUNIT_ASSERT(shown != 0);
+		{
+			Overlay::Lock l(*shown);
+			CPPUNIT_ASSERT(l.y()(0, 0) == 0);
+		}
+		/* The consumer still holds the frame it shows. */
+		CPPUNIT_ASSERT(ring.try_begin_frame() == 0);
+
+		shown = ring.latest();
+		{
+			Overlay::Lock l(*shown);
+			CPPUNIT_ASSERT(l.y()(0, 0) == 2);
+		}
+		CPPUNIT_ASSERT(ring.next() == shown);
+		CPPUNIT_ASSERT(ring.try_begin_frame() != 0);
+		CPPUNIT_ASSERT(ring.try_begin_frame() != 0);
+	}
+
 	void test_thread()
 	{
 		bool change_me = false;